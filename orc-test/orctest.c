@@ -833,6 +833,41 @@ float_compare (OrcArray *array1, OrcArray *array2, int i, int j)
   return FALSE;
 }
 
+/* Float sums are added in a different order by the code and by the
+ * emulation, so only their values have to be close */
+static int
+accumulator_compare (OrcProgram *program, orc_uint64 a, orc_uint64 b)
+{
+  int i;
+
+  if (a == b) return TRUE;
+
+  for (i = 0; i < program->n_insns; i++) {
+    OrcInstruction *insn = program->insns + i;
+
+    if (insn->dest_args[0] == ORC_VAR_A1 &&
+        (insn->opcode->flags & ORC_STATIC_OPCODE_FLOAT_DEST))
+      break;
+  }
+  if (i == program->n_insns) return FALSE;
+
+  if (program->vars[ORC_VAR_A1].size == 4) {
+    orc_union32 u1, u2;
+
+    u1.i = a;
+    u2.i = b;
+    if (isnan (u1.f) && isnan (u2.f)) return TRUE;
+    return fabs (u1.f - u2.f) <= 1e-5 * MAX (fabs (u1.f), fabs (u2.f));
+  } else {
+    orc_union64 u1, u2;
+
+    u1.i = a;
+    u2.i = b;
+    if (isnan (u1.f) && isnan (u2.f)) return TRUE;
+    return fabs (u1.f - u2.f) <= 1e-12 * MAX (fabs (u1.f), fabs (u2.f));
+  }
+}
+
 OrcTestResult
 orc_test_compare_output (OrcProgram *program)
 {
@@ -884,7 +919,7 @@ orc_test_compare_output_full_for_target (OrcProgram *program, int flags, const c
   int have_dest ORC_GNUC_UNUSED = FALSE;
   OrcCompileResult result;
   int have_acc = FALSE;
-  int acc_exec = 0, acc_emul = 0;
+  orc_uint64 acc_exec = 0, acc_emul = 0;
   int ret = ORC_TEST_OK;
   int bad = 0;
   int misalignment;
@@ -988,7 +1023,9 @@ orc_test_compare_output_full_for_target (OrcProgram *program, int flags, const c
   ORC_DEBUG ("done running");
   for(i=0;i<ORC_N_VARIABLES;i++){
     if (program->vars[i].vartype == ORC_VAR_TYPE_ACCUMULATOR) {
-      acc_exec = ex->accumulators[0];
+      acc_exec = (orc_uint32)ex->accumulators[0];
+      if (program->vars[ORC_VAR_A1].size == 8)
+        acc_exec = orc_executor_get_accumulator_int64 (ex, ORC_VAR_A1);
       have_acc = TRUE;
     }
   }
@@ -1007,7 +1044,9 @@ orc_test_compare_output_full_for_target (OrcProgram *program, int flags, const c
   orc_executor_emulate (ex);
   for(i=0;i<ORC_N_VARIABLES;i++){
     if (program->vars[i].vartype == ORC_VAR_TYPE_ACCUMULATOR) {
-      acc_emul = ex->accumulators[0];
+      acc_emul = (orc_uint32)ex->accumulators[0];
+      if (program->vars[ORC_VAR_A1].size == 8)
+        acc_emul = orc_executor_get_accumulator_int64 (ex, ORC_VAR_A1);
     }
   }
 
@@ -1099,7 +1138,7 @@ orc_test_compare_output_full_for_target (OrcProgram *program, int flags, const c
   }
 
   if (have_acc) {
-    if (acc_emul != acc_exec) {
+    if (!accumulator_compare (program, acc_emul, acc_exec)) {
       for(j=0;j<m;j++){
         for(i=0;i<n;i++){
 
@@ -1139,7 +1178,8 @@ orc_test_compare_output_full_for_target (OrcProgram *program, int flags, const c
           printf(" -> acc\n");
         }
       }
-      printf("acc %d %d\n", acc_emul, acc_exec);
+      printf("acc %" PRId64 " %" PRId64 "\n", (orc_int64)acc_emul,
+          (orc_int64)acc_exec);
       ret = ORC_TEST_FAILED;
     }
   }
@@ -13,6 +13,10 @@ ORC_INTERNAL const char * orc_avx512_get_flag_name (OrcTargetAVX512Flags flag);
 ORC_INTERNAL OrcTarget * orc_avx512_target_init (void);
 
 /* orcavx512compiler.c */
+/* Limits the loads and stores of the masked loops, never handed out by
+ * orc_avx512_compiler_get_mask_reg() */
+#define ORC_AVX512_LOOP_MASK ORC_AVX512_K7
+
 ORC_INTERNAL int orc_avx512_compiler_get_mask_reg (OrcCompiler *c, orc_bool mask_op);
 ORC_INTERNAL void orc_avx512_compiler_release_mask_reg (OrcCompiler *c, int reg);
 
@@ -64,9 +68,15 @@ typedef enum _OrcAVX512InsnOperandFlag {
 ), ORC_AVX512_INSN_OPERAND_OP1_ZMM
 
 #define ORC_AVX512_INSN_TYPE_MEM_AVX512 (\
-  ORC_X86_INSN_OPERAND_OP1_MEM     \
+  ORC_X86_INSN_OPERAND_OP1_MEM |   \
+  ORC_X86_INSN_OPERAND_OP2_REG     \
 ), ORC_AVX512_INSN_OPERAND_OP2_ZMM
 
+#define ORC_AVX512_INSN_TYPE_AVX512_MEM (\
+  ORC_X86_INSN_OPERAND_OP1_REG |   \
+  ORC_X86_INSN_OPERAND_OP2_MEM     \
+), ORC_AVX512_INSN_OPERAND_OP1_ZMM
+
 #define ORC_AVX512_INSN_TYPE_AVX512M_AVX512 (\
   ORC_X86_INSN_OPERAND_REGM_REG              \
 ), (                                         \
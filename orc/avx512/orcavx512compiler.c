@@ -20,7 +20,8 @@
  * @c: The #OrcCompiler to get the register from
  * @mask_op: In case the register is going to be used as a mask in an instruction
  * instead of a source or destination register. If #TRUE the potential range will
- * start from #ORC_AVX512_K1, #ORC_AVX512_K0 otherwise
+ * start from #ORC_AVX512_K1, #ORC_AVX512_K0 otherwise. #ORC_AVX512_K7 is
+ * kept for the masked loops.
  */
 int
 orc_avx512_compiler_get_mask_reg (OrcCompiler *c, orc_bool mask_op)
@@ -302,6 +302,7 @@ static OrcAVX512InsnOp orc_avx512_ops[] = {
   { "vpmulld"      , ORC_TARGET_AVX512_VL_F   , ORC_AVX_INSN_TYPE_SSE_SSE_SSEM                 , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x40, 0, ORC_X86_INSN_OPCODE_FLAG_EVEX_K_Z                                  , ORC_X86_INSN_TUPLE_TYPE_FULL },
   { "vpmulld"      , ORC_TARGET_AVX512_VL_F   , ORC_AVX_INSN_TYPE_AVX_AVX_AVXM                 , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x40, 0, ORC_X86_INSN_OPCODE_FLAG_EVEX_K_Z                                  , ORC_X86_INSN_TUPLE_TYPE_FULL },
   { "vpmulld"      , ORC_TARGET_AVX512_F      , ORC_AVX512_INSN_TYPE_AVX512_AVX512_AVX512M     , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x40, 0, ORC_X86_INSN_OPCODE_FLAG_EVEX_K_Z                                  , ORC_X86_INSN_TUPLE_TYPE_FULL },
+  { "vpsrlvd"      , ORC_TARGET_AVX512_F      , ORC_AVX512_INSN_TYPE_AVX512_AVX512_AVX512M     , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x45, 0, ORC_X86_INSN_OPCODE_FLAG_EVEX_K_Z                                  , ORC_X86_INSN_TUPLE_TYPE_FULL },
   { "kxnorw"       , ORC_TARGET_AVX512_F      , ORC_AVX512_INSN_TYPE_K_K_K                     , ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0X46, 0                                                                                                    },
   { "kxnorb"       , ORC_TARGET_AVX512_DQ     , ORC_AVX512_INSN_TYPE_K_K_K                     , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0X46, 0                                                                                                    },
   { "kxnorq"       , ORC_TARGET_AVX512_BW     , ORC_AVX512_INSN_TYPE_K_K_K                     , ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0X46, 0                                                                     , ORC_X86_INSN_OPCODE_FLAG_VEX_W1},
@@ -575,6 +576,8 @@ static OrcAVX512InsnOp orc_avx512_ops[] = {
   { "vpermw"       , ORC_TARGET_AVX512_VL_BW  , ORC_AVX_INSN_TYPE_SSE_SSE_SSEM                 , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x8d, 0, ORC_X86_INSN_OPCODE_FLAG_EVEX_K_Z | ORC_X86_INSN_OPCODE_FLAG_VEX_W1, ORC_X86_INSN_TUPLE_TYPE_FULL_MEM },
   { "vpermw"       , ORC_TARGET_AVX512_VL_BW  , ORC_AVX_INSN_TYPE_AVX_AVX_AVXM                 , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x8d, 0, ORC_X86_INSN_OPCODE_FLAG_EVEX_K_Z | ORC_X86_INSN_OPCODE_FLAG_VEX_W1, ORC_X86_INSN_TUPLE_TYPE_FULL_MEM },
   { "vpermw"       , ORC_TARGET_AVX512_BW     , ORC_AVX512_INSN_TYPE_AVX512_AVX512_AVX512M     , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x8d, 0, ORC_X86_INSN_OPCODE_FLAG_EVEX_K_Z | ORC_X86_INSN_OPCODE_FLAG_VEX_W1, ORC_X86_INSN_TUPLE_TYPE_FULL_MEM },
+  { "vpgatherdd"   , ORC_TARGET_AVX512_F      , ORC_AVX512_INSN_TYPE_AVX512_MEM                , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x90, 0, ORC_X86_INSN_OPCODE_FLAG_EVEX_K                                    , ORC_X86_INSN_TUPLE_TYPE_T1_SCALAR },
+  { "vpgatherdq"   , ORC_TARGET_AVX512_F      , ORC_AVX512_INSN_TYPE_AVX512_MEM                , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x90, 0, ORC_X86_INSN_OPCODE_FLAG_EVEX_K | ORC_X86_INSN_OPCODE_FLAG_VEX_W1  , ORC_X86_INSN_TUPLE_TYPE_T1_SCALAR },
 
   { "kmovw"        , ORC_TARGET_AVX512_F      , ORC_AVX512_INSN_TYPE_K_KM16                    , ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x90                                                                                                           },
   { "kmovq"        , ORC_TARGET_AVX512_BW     , ORC_AVX512_INSN_TYPE_K_KM64                    , ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x90, 0                                                                     , ORC_X86_INSN_OPCODE_FLAG_VEX_W1 },
@@ -585,13 +588,13 @@ static OrcAVX512InsnOp orc_avx512_ops[] = {
   { "kmovb"        , ORC_TARGET_AVX512_DQ     , ORC_AVX512_INSN_TYPE_M8_K                      , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x91                                                                                                          },
   { "kmovd"        , ORC_TARGET_AVX512_BW     , ORC_AVX512_INSN_TYPE_M32_K                     , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x91, 0                                                                     , ORC_X86_INSN_OPCODE_FLAG_VEX_W1 },
   { "kmovw"        , ORC_TARGET_AVX512_F      , ORC_AVX512_INSN_TYPE_K_REG32                   , ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x92                                                                                                          },
-  { "kmovq"        , ORC_TARGET_AVX512_BW     , ORC_AVX512_INSN_TYPE_K_REG64                   , ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x92, 0                                                                     , ORC_X86_INSN_OPCODE_FLAG_VEX_W1 },
+  { "kmovq"        , ORC_TARGET_AVX512_BW     , ORC_AVX512_INSN_TYPE_K_REG64                   , ORC_X86_INSN_OPCODE_PREFIX_0XF2, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x92, 0                                                                     , ORC_X86_INSN_OPCODE_FLAG_VEX_W1 },
   { "kmovb"        , ORC_TARGET_AVX512_DQ     , ORC_AVX512_INSN_TYPE_K_REG32                   , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x92                                                                                                          },
-  { "kmovd"        , ORC_TARGET_AVX512_BW     , ORC_AVX512_INSN_TYPE_K_REG32                   , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x92, 0                                                                     , ORC_X86_INSN_OPCODE_FLAG_VEX_W1 },
+  { "kmovd"        , ORC_TARGET_AVX512_BW     , ORC_AVX512_INSN_TYPE_K_REG32                   , ORC_X86_INSN_OPCODE_PREFIX_0XF2, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x92                                                                                                          },
   { "kmovw"        , ORC_TARGET_AVX512_F      , ORC_AVX512_INSN_TYPE_REG32_K                   , ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x93                                                                                                          },
-  { "kmovq"        , ORC_TARGET_AVX512_BW     , ORC_AVX512_INSN_TYPE_REG64_K                   , ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x93, 0                                                                     , ORC_X86_INSN_OPCODE_FLAG_VEX_W1 },
+  { "kmovq"        , ORC_TARGET_AVX512_BW     , ORC_AVX512_INSN_TYPE_REG64_K                   , ORC_X86_INSN_OPCODE_PREFIX_0XF2, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x93, 0                                                                     , ORC_X86_INSN_OPCODE_FLAG_VEX_W1 },
   { "kmovb"        , ORC_TARGET_AVX512_DQ     , ORC_AVX512_INSN_TYPE_REG32_K                   , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x93                                                                                                          },
-  { "kmovd"        , ORC_TARGET_AVX512_BW     , ORC_AVX512_INSN_TYPE_REG32_K                   , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x93, 0                                                                     , ORC_X86_INSN_OPCODE_FLAG_VEX_W1 },
+  { "kmovd"        , ORC_TARGET_AVX512_BW     , ORC_AVX512_INSN_TYPE_REG32_K                   , ORC_X86_INSN_OPCODE_PREFIX_0XF2, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0x93                                                                                                          },
 
   { "vcmpeqps"     , ORC_TARGET_AVX512_VL_F   , ORC_AVX512_INSN_TYPE_K_SSE_SSEM                , ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0xc2, 0, ORC_X86_INSN_OPCODE_FLAG_EVEX_K                                    , ORC_X86_INSN_TUPLE_TYPE_FULL_MEM },
   { "vcmpeqps"     , ORC_TARGET_AVX512_VL_F   , ORC_AVX512_INSN_TYPE_K_AVX_AVXM                , ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F  , 0xc2, 0, ORC_X86_INSN_OPCODE_FLAG_EVEX_K                                    , ORC_X86_INSN_TUPLE_TYPE_FULL_MEM },
@@ -1147,6 +1150,109 @@ orc_avx512_insn_emit_mov_reg_memoffset (OrcCompiler *c, int size, int s0,
   }
 }
 
+/* The masked moves, by element size and by register size */
+static const OrcAVX512Insn orc_avx512_masked_loads[4][3] = {
+  { ORC_AVX512_INSN_SSE_vmovdqu8_r_rm, ORC_AVX512_INSN_AVX_vmovdqu8_r_rm,
+    ORC_AVX512_INSN_vmovdqu8_r_rm },
+  { ORC_AVX512_INSN_SSE_vmovdqu16_r_rm, ORC_AVX512_INSN_AVX_vmovdqu16_r_rm,
+    ORC_AVX512_INSN_vmovdqu16_r_rm },
+  { ORC_AVX512_INSN_SSE_vmovdqu32_r_rm, ORC_AVX512_INSN_AVX_vmovdqu32_r_rm,
+    ORC_AVX512_INSN_vmovdqu32_r_rm },
+  { ORC_AVX512_INSN_SSE_vmovdqu64_r_rm, ORC_AVX512_INSN_AVX_vmovdqu64_r_rm,
+    ORC_AVX512_INSN_vmovdqu64_r_rm },
+};
+
+static const OrcAVX512Insn orc_avx512_masked_stores[4][3] = {
+  { ORC_AVX512_INSN_SSE_vmovdqu8_rm_r, ORC_AVX512_INSN_AVX_vmovdqu8_rm_r,
+    ORC_AVX512_INSN_vmovdqu8_rm_r },
+  { ORC_AVX512_INSN_SSE_vmovdqu16_rm_r, ORC_AVX512_INSN_AVX_vmovdqu16_rm_r,
+    ORC_AVX512_INSN_vmovdqu16_rm_r },
+  { ORC_AVX512_INSN_SSE_vmovdqu32_rm_r, ORC_AVX512_INSN_AVX_vmovdqu32_rm_r,
+    ORC_AVX512_INSN_vmovdqu32_rm_r },
+  { ORC_AVX512_INSN_SSE_vmovdqu64_rm_r, ORC_AVX512_INSN_AVX_vmovdqu64_rm_r,
+    ORC_AVX512_INSN_vmovdqu64_rm_r },
+};
+
+/* Returns the row of the masked moves for @element_size and sets @width to
+ * the column for @size, and @reg to the register of that width */
+static int
+orc_avx512_insn_get_masked_mov (int size, int element_size, int *width,
+    int *reg)
+{
+  if (size <= 16) {
+    *width = 0;
+    *reg = ORC_AVX512_SSE_REG (*reg);
+  } else if (size <= 32) {
+    *width = 1;
+    *reg = ORC_AVX512_AVX_REG (*reg);
+  } else {
+    *width = 2;
+  }
+
+  switch (element_size) {
+    case 1:
+      return 0;
+    case 2:
+      return 1;
+    case 4:
+      return 2;
+    default:
+      return 3;
+  }
+}
+
+/**
+ * orc_avx512_insn_emit_mov_memoffset_reg_mask:
+ *
+ * Loads the elements of @size bytes of memory content selected by a mask,
+ * and zeroes the others
+ *
+ * @c: The #OrcCompiler that emits the instruction
+ * @size: The size of the memory content in bytes
+ * @element_size: The size of an element in bytes
+ * @offset: The offset to add to the base address at @s0
+ * @s0: The source address
+ * @d: The destination register to get the contents into
+ * @m: The mask, with a bit per element
+ */
+void
+orc_avx512_insn_emit_mov_memoffset_reg_mask (OrcCompiler *c, int size,
+    int element_size, int offset, int s0, int d, int m)
+{
+  int width;
+  int row;
+
+  row = orc_avx512_insn_get_masked_mov (size, element_size, &width, &d);
+  orc_avx512_insn_emit_load_memoffset (c, orc_avx512_masked_loads[row][width],
+      0, offset, s0, ORC_REG_INVALID, d, m, TRUE);
+}
+
+/**
+ * orc_avx512_insn_emit_mov_reg_memoffset_mask:
+ *
+ * Stores the elements of a register selected by a mask, leaving the
+ * memory of the others untouched
+ *
+ * @c: The #OrcCompiler that emits the instruction
+ * @size: The size of the memory content in bytes
+ * @element_size: The size of an element in bytes
+ * @s0: The source register to get the contents from
+ * @offset: The offset to add to the base address at @d
+ * @d: The register that holds the destination address
+ * @m: The mask, with a bit per element
+ */
+void
+orc_avx512_insn_emit_mov_reg_memoffset_mask (OrcCompiler *c, int size,
+    int element_size, int s0, int offset, int d, int m)
+{
+  int width;
+  int row;
+
+  row = orc_avx512_insn_get_masked_mov (size, element_size, &width, &s0);
+  orc_avx512_insn_emit_store_memoffset (c,
+      orc_avx512_masked_stores[row][width], 0, offset, s0, d, m, FALSE);
+}
+
 /**
  * orc_avx512_insn_emit_avx512:
  *
@@ -1264,6 +1370,52 @@ orc_avx512_insn_emit_load_memoffset (OrcCompiler *c, OrcAVX512Insn i,
   xinsn->offset = offset;
 }
 
+/**
+ * orc_avx512_insn_emit_gather:
+ *
+ * Emit an AVX512 gather, loading each element selected by the mask from
+ * the address @s0 + @offset + (element of @index << @shift)
+ *
+ * @c: The #OrcCompiler that emits the instruction
+ * @i: The #OrcAVX512Insn to emit
+ * @offset: The offset to add to the base address at @s0
+ * @s0: The register that holds the base address
+ * @index: The register with the index of each element
+ * @shift: The scale of the indexes, from 0 to 3
+ * @d: The register to set the contents to
+ * @m: The mask, cleared once the elements are loaded. The elements not
+ * selected keep the contents of @d
+ */
+void
+orc_avx512_insn_emit_gather (OrcCompiler *c, OrcAVX512Insn i, int offset,
+    int s0, int index, int shift, int d, int m)
+{
+  OrcX86Insn *xinsn;
+  OrcX86InsnOperandSize size = c->is_64bit ? ORC_X86_INSN_OPERAND_SIZE_64 :
+      ORC_X86_INSN_OPERAND_SIZE_32;
+  const OrcAVX512InsnOp *op = orc_avx512_ops + i;
+
+  if (!orc_avx512_insn_validate_operands (c, i, size, d, s0, ORC_REG_INVALID,
+      ORC_REG_INVALID, 0)) {
+    return;
+  }
+  /* The index can not be the destination, nor the mask k0 */
+  if (m == ORC_REG_INVALID || m == ORC_AVX512_K0 || index == d ||
+      index == ORC_AVX512_AVX_REG (d)) {
+    ORC_COMPILER_ERROR (c, "Invalid registers for %s", op->name);
+    return;
+  }
+  xinsn = orc_x86_get_output_insn (c);
+  orc_avx512_insn_from_opcode (xinsn, i, op, m, FALSE);
+  orc_x86_insn_set_operands (xinsn, op->operands,
+      ORC_X86_INSN_OPERAND_SIZE_NONE, d, s0, ORC_REG_INVALID, ORC_REG_INVALID);
+  orc_x86_insn_set_mem (xinsn, op->operands, size,
+      ORC_X86_INSN_OPERAND_TYPE_IDX, d, s0, ORC_REG_INVALID, ORC_REG_INVALID);
+  xinsn->offset = offset;
+  xinsn->index_reg = index;
+  xinsn->shift = shift;
+}
+
 /**
  * orc_avx512_insn_emit_imm:
  *
@@ -242,6 +242,7 @@ typedef enum _OrcAVX512Insn {
   ORC_AVX512_INSN_SSE_vpmulld,
   ORC_AVX512_INSN_AVX_vpmulld,
   ORC_AVX512_INSN_vpmulld,
+  ORC_AVX512_INSN_vpsrlvd,
   ORC_AVX512_INSN_kxnorw,
   ORC_AVX512_INSN_kxnorb,
   ORC_AVX512_INSN_kxnorq,
@@ -504,6 +505,8 @@ typedef enum _OrcAVX512Insn {
   ORC_AVX512_INSN_SSE_vpermw,
   ORC_AVX512_INSN_AVX_vpermw,
   ORC_AVX512_INSN_vpermw,
+  ORC_AVX512_INSN_vpgatherdd,
+  ORC_AVX512_INSN_vpgatherdq,
   ORC_AVX512_INSN_kmovw_k_km,
   ORC_AVX512_INSN_kmovq_k_km,
   ORC_AVX512_INSN_kmovb_k_km,
@@ -1001,6 +1004,9 @@ typedef enum _OrcAVX512Insn {
 #define orc_avx512_insn_emit_vpmulld(c, s0, s1, d, m, z) \
   orc_avx512_insn_emit_avx512 (c, ORC_AVX512_INSN_vpmulld, s0, s1, ORC_REG_INVALID, d, m, z)
 
+#define orc_avx512_insn_emit_vpsrlvd(c, s0, s1, d, m, z) \
+  orc_avx512_insn_emit_avx512 (c, ORC_AVX512_INSN_vpsrlvd, s0, s1, ORC_REG_INVALID, d, m, z)
+
 #define orc_avx512_insn_avx_emit_vpmulld(c, s0, s1, d, m, z) \
   orc_avx512_insn_emit_avx512 (c, ORC_AVX512_INSN_AVX_vpmulld, s0, s1, ORC_REG_INVALID, d, m, z)
 
@@ -1456,6 +1462,12 @@ typedef enum _OrcAVX512Insn {
 #define orc_avx512_insn_sse_emit_vpermw(c, s0, s1, d, m, z) \
   orc_avx512_insn_emit_avx512 (c, ORC_AVX512_INSN_SSE_vpermw, s0, s1, ORC_REG_INVALID, d, m, z)
 
+#define orc_avx512_insn_emit_vpgatherdd(c, o, s0, i, sh, d, m) \
+  orc_avx512_insn_emit_gather (c, ORC_AVX512_INSN_vpgatherdd, o, s0, i, sh, d, m)
+
+#define orc_avx512_insn_emit_vpgatherdq(c, o, s0, i, sh, d, m) \
+  orc_avx512_insn_emit_gather (c, ORC_AVX512_INSN_vpgatherdq, o, s0, i, sh, d, m)
+
 #define orc_avx512_insn_emit_vcmpeqps(c, s0, s1, d, m, z) \
   orc_avx512_insn_emit_avx512 (c, ORC_AVX512_INSN_vcmpeqps, s0, s1, ORC_REG_INVALID, d, m, z);
 
@@ -1839,6 +1851,12 @@ ORC_API void orc_avx512_insn_emit_mov_memoffset_reg (OrcCompiler *c, int size,
 ORC_API void orc_avx512_insn_emit_mov_reg_memoffset (OrcCompiler *c, int size,
     int s0, int offset, int d, int aligned, int uncached);
 
+ORC_API void orc_avx512_insn_emit_mov_memoffset_reg_mask (OrcCompiler *c,
+    int size, int element_size, int offset, int s0, int d, int m);
+
+ORC_API void orc_avx512_insn_emit_mov_reg_memoffset_mask (OrcCompiler *c,
+    int size, int element_size, int s0, int offset, int d, int m);
+
 ORC_API void orc_avx512_insn_emit_avx512 (OrcCompiler *c, OrcAVX512Insn i,
     int s0, int s1, int s2, int d, int m, orc_bool z);
 
@@ -1848,6 +1866,8 @@ ORC_API void orc_avx512_insn_emit_store_memoffset (OrcCompiler *c,
 ORC_API void orc_avx512_insn_emit_load_memoffset (OrcCompiler *c,
     OrcAVX512Insn i, int imm, int offset, int s0, int s1, int d, int m,
     orc_bool z);
+ORC_API void orc_avx512_insn_emit_gather (OrcCompiler *c, OrcAVX512Insn i,
+    int offset, int s0, int index, int shift, int d, int m);
 ORC_API void orc_avx512_insn_emit_imm (OrcCompiler *c, OrcAVX512Insn i,
     int size, int imm, int src0, int src1, int dest, int m, orc_bool z);
 ORC_API void orc_avx512_insn_emit_size (OrcCompiler *c, OrcAVX512Insn i,
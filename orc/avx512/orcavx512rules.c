@@ -423,8 +423,13 @@ orc_avx512_rule_loadX (OrcCompiler *c, void *user, OrcInstruction *insn)
   int ptr_reg;
 
   ptr_reg = orc_x86_compiler_load_src_argument (c, insn, 0);
-  orc_avx512_insn_emit_mov_memoffset_reg (c, ORC_SIZE (c, src->size), offset,
-      ptr_reg, dest->alloc, dest->is_aligned);
+  if (c->loop_mask != ORC_REG_INVALID) {
+    orc_avx512_insn_emit_mov_memoffset_reg_mask (c, ORC_SIZE (c, src->size),
+        src->size, offset, ptr_reg, dest->alloc, c->loop_mask);
+  } else {
+    orc_avx512_insn_emit_mov_memoffset_reg (c, ORC_SIZE (c, src->size),
+        offset, ptr_reg, dest->alloc, dest->is_aligned);
+  }
   src->update_type = ORC_VARIABLE_UPDATE_TYPE_FULL;
 }
 
@@ -437,8 +442,13 @@ orc_avx512_rule_storeX (OrcCompiler *c, void *user, OrcInstruction *insn)
   int ptr_reg;
 
   ptr_reg = orc_x86_compiler_load_dest_argument (c, insn, 0);
-  orc_avx512_insn_emit_mov_reg_memoffset (c, ORC_SIZE (c, dest->size),
-      src->alloc, offset, ptr_reg, dest->is_aligned, dest->is_uncached);
+  if (c->loop_mask != ORC_REG_INVALID) {
+    orc_avx512_insn_emit_mov_reg_memoffset_mask (c, ORC_SIZE (c, dest->size),
+        dest->size, src->alloc, offset, ptr_reg, c->loop_mask);
+  } else {
+    orc_avx512_insn_emit_mov_reg_memoffset (c, ORC_SIZE (c, dest->size),
+        src->alloc, offset, ptr_reg, dest->is_aligned, dest->is_uncached);
+  }
   dest->update_type = ORC_VARIABLE_UPDATE_TYPE_FULL;
 }
 
@@ -740,6 +750,308 @@ orc_avx512_rule_loadoffX (OrcCompiler *c, void *user, OrcInstruction *insn)
   src0->update_type = ORC_VARIABLE_UPDATE_TYPE_FULL;
 }
 
+/* The resampling loads read the source at 16.16 fixed point positions.
+ * The integer part of the position is kept in the pointer and the
+ * fraction in the ptr_offset register. This leaves in @pos the positions
+ * of the first sixteen elements and in @inc the increment of sixteen
+ * elements */
+static void
+orc_avx512_ldres_load_positions (OrcCompiler *c, OrcInstruction *insn,
+    int pos, int inc)
+{
+  OrcConstant iota_c = ORC_CONSTANT_INIT_U512 (
+      0x0000000100000000UL,
+      0x0000000300000002UL,
+      0x0000000500000004UL,
+      0x0000000700000006UL,
+      0x0000000900000008UL,
+      0x0000000b0000000aUL,
+      0x0000000d0000000cUL,
+      0x0000000f0000000eUL
+  );
+  OrcVariable *src = ORC_SRC_VAR (c, insn, 0);
+  OrcVariable *increment = ORC_SRC_VAR (c, insn, 2);
+  int iota = orc_compiler_get_constant_full (c, &iota_c);
+  int tmp = orc_compiler_get_temp_reg (c);
+
+  if (increment->vartype == ORC_VAR_TYPE_PARAM) {
+    orc_x86_emit_mov_memoffset_reg (c, 4,
+        (int)ORC_STRUCT_OFFSET (OrcExecutor, params[insn->src_args[2]]),
+        c->exec_reg, c->gp_tmpreg);
+  } else {
+    orc_x86_emit_mov_imm_reg (c, 4, increment->value.i, c->gp_tmpreg);
+  }
+  orc_avx512_insn_emit_x86_vpbroadcastd (c, c->gp_tmpreg, inc,
+      ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpmulld (c, inc, iota, pos, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpslld_r_r_i (c, 4, inc, inc, ORC_REG_INVALID, FALSE);
+
+  orc_avx512_insn_emit_x86_vpbroadcastd (c, src->ptr_offset, tmp,
+      ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpaddd (c, pos, tmp, pos, ORC_REG_INVALID, FALSE);
+  orc_compiler_release_temp_reg (c, tmp);
+}
+
+/* Selects the first @n elements of a gather */
+static void
+orc_avx512_ldres_load_mask (OrcCompiler *c, int n, int mask)
+{
+  orc_x86_emit_mov_imm_reg (c, 4, (1 << n) - 1, c->gp_tmpreg);
+  orc_avx512_insn_emit_size (c, ORC_AVX512_INSN_kmovw_k_r, 4, c->gp_tmpreg,
+      ORC_REG_INVALID, ORC_REG_INVALID, mask, ORC_REG_INVALID, FALSE);
+}
+
+/* Moves the pointer and the fraction to the position of the next
+ * iteration */
+static void
+orc_avx512_ldres_advance (OrcCompiler *c, OrcInstruction *insn)
+{
+  OrcVariable *src = ORC_SRC_VAR (c, insn, 0);
+  OrcVariable *increment = ORC_SRC_VAR (c, insn, 2);
+  int shift;
+
+  if (increment->vartype == ORC_VAR_TYPE_PARAM) {
+    orc_x86_emit_mov_imm_reg (c, 4, 1 << c->loop_shift, c->gp_tmpreg);
+    orc_x86_emit_imul_memoffset_reg (c, 4,
+        (int)ORC_STRUCT_OFFSET (OrcExecutor, params[insn->src_args[2]]),
+        c->exec_reg, c->gp_tmpreg);
+    orc_x86_emit_add_reg_reg (c, 4, c->gp_tmpreg, src->ptr_offset);
+  } else {
+    orc_x86_emit_add_imm_reg (c, 4, increment->value.i << c->loop_shift,
+        src->ptr_offset, FALSE);
+  }
+
+  orc_x86_emit_mov_reg_reg (c, 4, src->ptr_offset, c->gp_tmpreg);
+  orc_x86_emit_sar_imm_reg (c, 4, 16, c->gp_tmpreg);
+  orc_variable_get_shift (src, &shift);
+  orc_x86_emit_add_reg_reg_shift (c, 8, c->gp_tmpreg, src->ptr_register,
+      shift);
+  orc_x86_emit_and_imm_reg (c, 4, 0xffff, src->ptr_offset);
+
+  src->update_type = 0;
+}
+
+/* Gathers the first @n bytes at the positions of @pos, plus one if @next,
+ * into the low byte of each dword of @dest. The dwords are read from
+ * aligned addresses, @align being the misalignment of the pointer, so no
+ * page after the last byte is touched */
+static void
+orc_avx512_ldres_gather_bytes (OrcCompiler *c, OrcVariable *src, int pos,
+    orc_bool next, int align, int n, int idx, int shift, int mask, int dest)
+{
+  int low = orc_compiler_get_constant (c, 4, 0xff);
+
+  orc_avx512_insn_emit_vpsrad_r_r_i (c, 16, pos, shift, ORC_REG_INVALID,
+      FALSE);
+  if (next) {
+    int one = orc_compiler_get_constant (c, 4, 1);
+    orc_avx512_insn_emit_vpaddd (c, shift, one, shift, ORC_REG_INVALID,
+        FALSE);
+  }
+  orc_avx512_insn_emit_vpaddd (c, shift, align, shift, ORC_REG_INVALID,
+      FALSE);
+  /* idx <- (t & ~3) - align, shift <- (t & 3) * 8 */
+  orc_avx512_insn_emit_vpsrld_r_r_i (c, 2, shift, idx, ORC_REG_INVALID,
+      FALSE);
+  orc_avx512_insn_emit_vpslld_r_r_i (c, 2, idx, idx, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpsubd (c, idx, align, idx, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpslld_r_r_i (c, 30, shift, shift, ORC_REG_INVALID,
+      FALSE);
+  orc_avx512_insn_emit_vpsrld_r_r_i (c, 27, shift, shift, ORC_REG_INVALID,
+      FALSE);
+
+  orc_avx512_ldres_load_mask (c, n, mask);
+  orc_avx512_insn_emit_vpgatherdd (c, 0, src->ptr_register, idx, 0, dest,
+      mask);
+  orc_avx512_insn_emit_vpsrlvd (c, dest, shift, dest, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpandd (c, dest, low, dest, ORC_REG_INVALID, FALSE);
+}
+
+static void
+orc_avx512_rule_ldresXb (OrcCompiler *c, void *user, OrcInstruction *insn)
+{
+  /* Puts the bytes of each group back in order once packed */
+  OrcConstant order_c = ORC_CONSTANT_INIT_U512 (
+      0x0000000400000000UL,
+      0x0000000c00000008UL,
+      0x0000000500000001UL,
+      0x0000000d00000009UL,
+      0x0000000600000002UL,
+      0x0000000e0000000aUL,
+      0x0000000700000003UL,
+      0x0000000f0000000bUL
+  );
+  OrcVariable *src = ORC_SRC_VAR (c, insn, 0);
+  int dest = ORC_DEST_ARG (c, insn, 0);
+  orc_bool linear = ORC_PTR_TO_INT (user);
+  const int n = 1 << c->loop_shift;
+  int pos = orc_compiler_get_temp_reg (c);
+  int inc = orc_compiler_get_temp_reg (c);
+  int align = orc_compiler_get_temp_reg (c);
+  int idx = orc_compiler_get_temp_reg (c);
+  int shift = orc_compiler_get_temp_reg (c);
+  int next = orc_compiler_get_temp_reg (c);
+  int mask = orc_avx512_compiler_get_mask_reg (c, TRUE);
+  int groups[4];
+  int n_groups = 0;
+  int order;
+  int i;
+
+  if (n > 64) {
+    ORC_COMPILER_ERROR (c, "unsupported loop shift %d", c->loop_shift);
+    return;
+  }
+
+  orc_avx512_ldres_load_positions (c, insn, pos, inc);
+  orc_x86_emit_mov_reg_reg (c, 4, src->ptr_register, c->gp_tmpreg);
+  orc_x86_emit_and_imm_reg (c, 4, 3, c->gp_tmpreg);
+  orc_avx512_insn_emit_x86_vpbroadcastd (c, c->gp_tmpreg, align,
+      ORC_REG_INVALID, FALSE);
+
+  for (i = 0; i < n; i += 16) {
+    int g = orc_compiler_get_temp_reg (c);
+
+    if (i)
+      orc_avx512_insn_emit_vpaddd (c, pos, inc, pos, ORC_REG_INVALID, FALSE);
+    orc_avx512_ldres_gather_bytes (c, src, pos, FALSE, align,
+        MIN (n - i, 16), idx, shift, mask, g);
+    if (linear) {
+      /* a * (256 - f) + b * f = (a << 8) + (b - a) * f */
+      orc_avx512_ldres_gather_bytes (c, src, pos, TRUE, align,
+          MIN (n - i, 16), idx, shift, mask, next);
+      orc_avx512_insn_emit_vpslld_r_r_i (c, 16, pos, shift, ORC_REG_INVALID,
+          FALSE);
+      orc_avx512_insn_emit_vpsrld_r_r_i (c, 24, shift, shift,
+          ORC_REG_INVALID, FALSE);
+      orc_avx512_insn_emit_vpsubd (c, next, g, next, ORC_REG_INVALID, FALSE);
+      orc_avx512_insn_emit_vpmulld (c, next, shift, next, ORC_REG_INVALID,
+          FALSE);
+      orc_avx512_insn_emit_vpsrad_r_r_i (c, 8, next, next, ORC_REG_INVALID,
+          FALSE);
+      orc_avx512_insn_emit_vpaddd (c, g, next, g, ORC_REG_INVALID, FALSE);
+    }
+    groups[n_groups++] = g;
+  }
+
+  /* Each lane gets four bytes of every group, reordered by dwords */
+  for (i = n_groups; i < 4; i++)
+    groups[i] = groups[0];
+  orc_avx512_insn_emit_vpackusdw (c, groups[0], groups[1], idx,
+      ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpackusdw (c, groups[2], groups[3], shift,
+      ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpackuswb (c, idx, shift, idx, ORC_REG_INVALID,
+      FALSE);
+  order = orc_compiler_get_constant_full (c, &order_c);
+  orc_avx512_insn_emit_vpermd (c, order, idx, dest, ORC_REG_INVALID, FALSE);
+
+  orc_avx512_ldres_advance (c, insn);
+
+  for (i = 0; i < n_groups; i++)
+    orc_compiler_release_temp_reg (c, groups[i]);
+  orc_avx512_compiler_release_mask_reg (c, mask);
+  orc_compiler_release_temp_reg (c, next);
+  orc_compiler_release_temp_reg (c, shift);
+  orc_compiler_release_temp_reg (c, idx);
+  orc_compiler_release_temp_reg (c, align);
+  orc_compiler_release_temp_reg (c, inc);
+  orc_compiler_release_temp_reg (c, pos);
+}
+
+static void
+orc_avx512_rule_ldresnearl (OrcCompiler *c, void *user, OrcInstruction *insn)
+{
+  OrcVariable *src = ORC_SRC_VAR (c, insn, 0);
+  int dest = ORC_DEST_ARG (c, insn, 0);
+  const int n = 1 << c->loop_shift;
+  int pos = orc_compiler_get_temp_reg (c);
+  int inc = orc_compiler_get_temp_reg (c);
+  int mask = orc_avx512_compiler_get_mask_reg (c, TRUE);
+
+  if (n > 16) {
+    ORC_COMPILER_ERROR (c, "unsupported loop shift %d", c->loop_shift);
+    return;
+  }
+
+  orc_avx512_ldres_load_positions (c, insn, pos, inc);
+  orc_avx512_insn_emit_vpsrad_r_r_i (c, 16, pos, pos, ORC_REG_INVALID, FALSE);
+  orc_avx512_ldres_load_mask (c, n, mask);
+  orc_avx512_insn_emit_vpgatherdd (c, 0, src->ptr_register, pos, 2, dest,
+      mask);
+
+  orc_avx512_ldres_advance (c, insn);
+
+  orc_avx512_compiler_release_mask_reg (c, mask);
+  orc_compiler_release_temp_reg (c, inc);
+  orc_compiler_release_temp_reg (c, pos);
+}
+
+static void
+orc_avx512_rule_ldreslinl (OrcCompiler *c, void *user, OrcInstruction *insn)
+{
+  OrcVariable *src = ORC_SRC_VAR (c, insn, 0);
+  int dest = ORC_DEST_ARG (c, insn, 0);
+  const int n = 1 << c->loop_shift;
+  int pos = orc_compiler_get_temp_reg (c);
+  int inc = orc_compiler_get_temp_reg (c);
+  int idx = orc_compiler_get_temp_reg (c);
+  int a = orc_compiler_get_temp_reg (c);
+  int b = orc_compiler_get_temp_reg (c);
+  int f = orc_compiler_get_temp_reg (c);
+  int mask = orc_avx512_compiler_get_mask_reg (c, TRUE);
+  int one = orc_compiler_get_constant (c, 4, 1);
+  int low = orc_compiler_get_constant (c, 2, 0xff);
+
+  if (n > 16) {
+    ORC_COMPILER_ERROR (c, "unsupported loop shift %d", c->loop_shift);
+    return;
+  }
+
+  /* a, b <- ptr[tmp >> 16], ptr[(tmp >> 16) + 1] */
+  orc_avx512_ldres_load_positions (c, insn, pos, inc);
+  orc_avx512_insn_emit_vpsrad_r_r_i (c, 16, pos, idx, ORC_REG_INVALID, FALSE);
+  orc_avx512_ldres_load_mask (c, n, mask);
+  orc_avx512_insn_emit_vpgatherdd (c, 0, src->ptr_register, idx, 2, a, mask);
+  orc_avx512_insn_emit_vpaddd (c, idx, one, idx, ORC_REG_INVALID, FALSE);
+  orc_avx512_ldres_load_mask (c, n, mask);
+  orc_avx512_insn_emit_vpgatherdd (c, 0, src->ptr_register, idx, 2, b, mask);
+
+  /* f in both words of each pixel */
+  orc_avx512_insn_emit_vpslld_r_r_i (c, 16, pos, f, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpsrld_r_r_i (c, 24, f, f, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpslld_r_r_i (c, 16, f, inc, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpord (c, f, inc, f, ORC_REG_INVALID, FALSE);
+
+  /* a + ((b - a) * f >> 8) on the even bytes, in the low byte of each
+   * word, and then on the odd ones */
+  orc_avx512_insn_emit_vpandd (c, a, low, idx, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpandd (c, b, low, pos, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpsubw (c, pos, idx, pos, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpmullw (c, pos, f, pos, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpsrlw_r_r_i (c, 8, pos, pos, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpaddw (c, pos, idx, pos, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpandd (c, pos, low, pos, ORC_REG_INVALID, FALSE);
+
+  orc_avx512_insn_emit_vpsrlw_r_r_i (c, 8, a, a, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpsrlw_r_r_i (c, 8, b, b, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpsubw (c, b, a, b, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpmullw (c, b, f, b, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpsrlw_r_r_i (c, 8, b, b, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpaddw (c, b, a, b, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpsllw_r_r_i (c, 8, b, b, ORC_REG_INVALID, FALSE);
+  orc_avx512_insn_emit_vpord (c, pos, b, dest, ORC_REG_INVALID, FALSE);
+
+  orc_avx512_ldres_advance (c, insn);
+
+  orc_avx512_compiler_release_mask_reg (c, mask);
+  orc_compiler_release_temp_reg (c, f);
+  orc_compiler_release_temp_reg (c, b);
+  orc_compiler_release_temp_reg (c, a);
+  orc_compiler_release_temp_reg (c, idx);
+  orc_compiler_release_temp_reg (c, inc);
+  orc_compiler_release_temp_reg (c, pos);
+}
+
 /* Generic shift implementation for word/dword/qword left/right/arithmetic shifts
  * 
  * Performance note: Adaptive implementation with size-based branching (ZMM/YMM/XMM)
@@ -2957,6 +3269,49 @@ orc_avx512_rule_accsadubl (OrcCompiler *c, void *user, OrcInstruction *insn)
   orc_compiler_release_temp_reg (c, tmp);
 }
 
+/* Gets a mask of the 1 << loop_shift elements of @size bytes a partial
+ * vector holds, or ORC_REG_INVALID when the vector is full. The lanes
+ * past them are merged, and keep the value of the accumulator. */
+static int
+orc_avx512_acc_get_mask (OrcCompiler *c, int size)
+{
+  const int n = 1 << c->loop_shift;
+  int mask;
+
+  if (size * n >= 64)
+    return ORC_REG_INVALID;
+
+  mask = orc_avx512_compiler_get_mask_reg (c, TRUE);
+  orc_x86_emit_mov_imm_reg (c, 4, n == 32 ? 0xffffffff : (1U << n) - 1,
+      c->gp_tmpreg);
+  orc_avx512_insn_emit_size (c, ORC_AVX512_INSN_kmovq_k_r, 8, c->gp_tmpreg,
+      ORC_REG_INVALID, ORC_REG_INVALID, mask, ORC_REG_INVALID, FALSE);
+  return mask;
+}
+
+#define ACC_RULE(name, insn, size) \
+static void \
+orc_avx512_rule_ ## name (OrcCompiler *c, void *user, OrcInstruction *insn) \
+{ \
+  int src = ORC_SRC_ARG (c, insn, 0); \
+  int dest = ORC_DEST_ARG (c, insn, 0); \
+  int mask = orc_avx512_acc_get_mask (c, size); \
+\
+  orc_avx512_insn_emit_ ## insn (c, dest, src, dest, mask, FALSE); \
+  if (mask != ORC_REG_INVALID) \
+    orc_avx512_compiler_release_mask_reg (c, mask); \
+}
+
+ACC_RULE (accmaxub, vpmaxub, 1)
+ACC_RULE (accminub, vpminub, 1)
+ACC_RULE (accmaxsw, vpmaxsw, 2)
+ACC_RULE (accminsw, vpminsw, 2)
+ACC_RULE (accorl, vpord, 4)
+ACC_RULE (accandl, vpandd, 4)
+ACC_RULE (accq, vpaddq, 8)
+ACC_RULE (accf, vaddps, 4)
+ACC_RULE (accd, vaddpd, 8)
+
 static void
 orc_avx512_rule_avgsb (OrcCompiler *c, void *user, OrcInstruction *insn)
 {
@@ -3262,6 +3617,15 @@ orc_avx512_rules_init (OrcTarget *target)
   REGISTER_RULE (accw);
   REGISTER_RULE (accl);
   REGISTER_RULE (accsadubl);
+  REGISTER_RULE (accmaxub);
+  REGISTER_RULE (accminub);
+  REGISTER_RULE (accmaxsw);
+  REGISTER_RULE (accminsw);
+  REGISTER_RULE (accorl);
+  REGISTER_RULE (accandl);
+  REGISTER_RULE (accq);
+  REGISTER_RULE (accf);
+  REGISTER_RULE (accd);
 
   REGISTER_RULE (divluw);
 
@@ -3283,4 +3647,9 @@ orc_avx512_rules_init (OrcTarget *target)
 
   REGISTER_RULE (loadupdb);
   REGISTER_RULE (loadupib);
+
+  REGISTER_RULE_WITH_GENERIC_AND_PAYLOAD (ldresnearb, ldresXb, FALSE);
+  REGISTER_RULE (ldresnearl);
+  REGISTER_RULE_WITH_GENERIC_AND_PAYLOAD (ldreslinb, ldresXb, TRUE);
+  REGISTER_RULE (ldreslinl);
 }
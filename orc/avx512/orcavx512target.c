@@ -164,39 +164,104 @@ orc_avx512_compiler_dup_high_half (OrcCompiler *c, int half_size, int src,
   }
 }
 
-/* TODO use the proper reg size */
+/* Combines @b into @a the way the accumulator of @type does */
 static void
-orc_avx512_insn_emit_add (OrcCompiler *c, int size, int a, int b)
+orc_avx512_insn_emit_accumulate (OrcCompiler *c, OrcAccumulatorType type,
+    int size, int a, int b)
 {
-  switch (size) {
-    case 4:
-      orc_avx512_insn_emit_vpaddd (c, a, b, a, ORC_REG_INVALID, FALSE);
+  switch (type) {
+    case ORC_ACCUMULATOR_MAXU:
+      orc_avx512_insn_emit_vpmaxub (c, a, b, a, ORC_REG_INVALID, FALSE);
       break;
-
-    case 2:
-      orc_avx512_insn_emit_vpaddw (c, a, b, a, ORC_REG_INVALID, FALSE);
+    case ORC_ACCUMULATOR_MINU:
+      orc_avx512_insn_emit_vpminub (c, a, b, a, ORC_REG_INVALID, FALSE);
+      break;
+    case ORC_ACCUMULATOR_MAXS:
+      orc_avx512_insn_emit_vpmaxsw (c, a, b, a, ORC_REG_INVALID, FALSE);
+      break;
+    case ORC_ACCUMULATOR_MINS:
+      orc_avx512_insn_emit_vpminsw (c, a, b, a, ORC_REG_INVALID, FALSE);
+      break;
+    case ORC_ACCUMULATOR_OR:
+      orc_avx512_insn_emit_vpord (c, a, b, a, ORC_REG_INVALID, FALSE);
+      break;
+    case ORC_ACCUMULATOR_AND:
+      orc_avx512_insn_emit_vpandd (c, a, b, a, ORC_REG_INVALID, FALSE);
+      break;
+    case ORC_ACCUMULATOR_ADDF:
+      if (size == 8) {
+        orc_avx512_insn_emit_vaddpd (c, a, b, a, ORC_REG_INVALID, FALSE);
+      } else {
+        orc_avx512_insn_emit_vaddps (c, a, b, a, ORC_REG_INVALID, FALSE);
+      }
+      break;
+    default:
+      switch (size) {
+        case 8:
+          orc_avx512_insn_emit_vpaddq (c, a, b, a, ORC_REG_INVALID, FALSE);
+          break;
+        case 4:
+          orc_avx512_insn_emit_vpaddd (c, a, b, a, ORC_REG_INVALID, FALSE);
+          break;
+        case 2:
+          orc_avx512_insn_emit_vpaddw (c, a, b, a, ORC_REG_INVALID, FALSE);
+          break;
+      }
       break;
   }
 }
 
-/* The register needs to be reduced horizontally by adding the values
- * For that we swap halves and add
- */ 
+/* The register needs to be reduced horizontally by combining the values
+ * For that we swap halves and combine
+ */
 static void
 orc_avx512_target_reduce_accumulator (OrcCompiler *c, int i, OrcVariable *var)
 {
   int reg = var->alloc;
   int tmp = orc_compiler_get_temp_reg (c);
+  OrcAccumulatorType type = orc_accumulator_get_type (c->insns, c->n_insns,
+      i);
   int half_size;
+  int j;
+
+  /* Combine the partial accumulators of the unrolled loop first */
+  for (j = 1; j < c->n_partial_accs; j++)
+    orc_avx512_insn_emit_accumulate (c, type, var->size, reg,
+        c->partial_accs[i - ORC_VAR_A1][j]);
 
   for (half_size = 32; half_size >= var->size; half_size = half_size / 2) {
-    orc_avx512_compiler_dup_high_half (c, half_size, reg, tmp);
+    if (half_size == 1) {
+      orc_avx512_insn_emit_vpsrlw_r_r_i (c, 8, reg, tmp, ORC_REG_INVALID,
+          FALSE);
+    } else {
+      orc_avx512_compiler_dup_high_half (c, half_size, reg, tmp);
+    }
     /* Do the operation on reg, tmp -> reg */
-    orc_avx512_insn_emit_add (c, var->size, reg, tmp);
+    orc_avx512_insn_emit_accumulate (c, type, var->size, reg, tmp);
+  }
+  if (var->size == 8) {
+    /* The high half goes to params[ORC_VAR_T9 + i] */
+    orc_avx512_insn_emit_mov_reg_memoffset (c, 4, reg,
+        ORC_STRUCT_OFFSET (OrcExecutor, accumulators[i - ORC_VAR_A1]),
+        c->exec_reg, var->is_aligned, var->is_uncached);
+    orc_avx512_compiler_dup_high_half (c, 4, reg, tmp);
+    orc_avx512_insn_emit_mov_reg_memoffset (c, 4, tmp,
+        ORC_STRUCT_OFFSET (OrcExecutor, params[ORC_VAR_T9 + i - ORC_VAR_A1]),
+        c->exec_reg, var->is_aligned, var->is_uncached);
+  } else {
+    if (var->size <= 2) {
+      /* Clear the bits above the result, all 32 bits are stored */
+      orc_avx512_insn_sse_emit_vpslld_r_r_i (c, 32 - 8 * var->size,
+          ORC_AVX512_SSE_REG (reg), ORC_AVX512_SSE_REG (reg), ORC_REG_INVALID,
+          FALSE);
+      orc_avx512_insn_sse_emit_vpsrld_r_r_i (c, 32 - 8 * var->size,
+          ORC_AVX512_SSE_REG (reg), ORC_AVX512_SSE_REG (reg), ORC_REG_INVALID,
+          FALSE);
+    }
+    orc_avx512_insn_emit_mov_reg_memoffset (c, 4, reg,
+        ORC_STRUCT_OFFSET (OrcExecutor, accumulators[i - ORC_VAR_A1]),
+        c->exec_reg, var->is_aligned, var->is_uncached);
   }
-  orc_avx512_insn_emit_mov_reg_memoffset (c, var->size, reg,
-      ORC_STRUCT_OFFSET (OrcExecutor, accumulators[i - ORC_VAR_A1]),
-      c->exec_reg, var->is_aligned, var->is_uncached);
   orc_compiler_release_temp_reg (c, reg);
 }
 
@@ -360,6 +425,19 @@ orc_avx512_target_restore_mxcsr (OrcCompiler *c)
       c->exec_reg);
 }
 
+/* Sets the first @count bits of the mask, with (1 << count) - 1 */
+static void
+orc_avx512_target_load_loop_mask (OrcCompiler *c, int count, int tmp)
+{
+  orc_x86_emit_mov_imm_reg (c, 4, 0, tmp);
+  orc_x86_emit_bts_reg_reg (c, 8, count, tmp);
+  orc_x86_emit_add_imm_reg (c, 8, -1, tmp, FALSE);
+  orc_avx512_insn_emit_size (c, ORC_AVX512_INSN_kmovq_k_r, 8, tmp,
+      ORC_REG_INVALID, ORC_REG_INVALID, ORC_AVX512_LOOP_MASK, ORC_REG_INVALID,
+      FALSE);
+  c->loop_mask = ORC_AVX512_LOOP_MASK;
+}
+
 OrcTarget *
 orc_avx512_target_init (void)
 {
@@ -387,7 +465,8 @@ orc_avx512_target_init (void)
     ORC_AVX512_REG_SIZE,
     ORC_AVX512_ZMM0,
     ORC_AVX512_REG_AMOUNT,
-    16,
+    23,
+    orc_avx512_target_load_loop_mask,
   };
   /* clang-format on */
   static OrcTarget t;
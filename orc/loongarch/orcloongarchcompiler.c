@@ -60,12 +60,7 @@ orc_loongarch_compiler_add_label (OrcCompiler *c, int label)
 void
 orc_loongarch_compiler_add_fixup (OrcCompiler *c, int label, int type)
 {
-  ORC_ASSERT (c->n_fixups < ORC_N_FIXUPS);
-
-  c->fixups[c->n_fixups].ptr = c->codeptr;
-  c->fixups[c->n_fixups].label = label;
-  c->fixups[c->n_fixups].type = type;
-  c->n_fixups++;
+  orc_compiler_add_fixup (c, c->codeptr, label, type);
 }
 
 void
@@ -120,7 +115,7 @@ orc_loongarch_compiler_get_shift (orc_uint32 bytes)
 void
 orc_loongarch_compiler_add_strides (OrcCompiler *c)
 {
-  for (int i = 0; i < ORC_N_COMPILER_VARIABLES; i++) {
+  for (int i = 0; i < c->n_vars; i++) {
     if (c->vars[i].name == NULL)
       continue;
     switch (c->vars[i].vartype) {
@@ -182,7 +177,7 @@ orc_loongarch_compiler_emit_loop (OrcCompiler *c, int update)
   orc_compiler_append_code (c, "/* loop tail */\n");
 
   if (update) {
-    for (int j = 0; j < ORC_N_COMPILER_VARIABLES; j++) {
+    for (int j = 0; j < c->n_vars; j++) {
       const OrcVariable *var = c->vars + j;
 
       if (var->name == NULL) continue;
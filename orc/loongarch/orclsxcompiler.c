@@ -159,7 +159,7 @@ orc_lsx_compiler_compute_loop_shift (OrcCompiler *c)
 void
 orc_lsx_compiler_load_constants (OrcCompiler *c)
 {
-  for (int i = 0; i < ORC_N_COMPILER_VARIABLES; i++) {
+  for (int i = 0; i < c->n_vars; i++) {
     OrcVariable *var = c->vars + i;
     if (var->name == NULL)
       continue;
@@ -182,7 +182,7 @@ orc_lsx_compiler_load_constants (OrcCompiler *c)
 void
 orc_lsx_compiler_save_accumulators (OrcCompiler *c)
 {
-  for (int i = 0; i < ORC_N_COMPILER_VARIABLES; i++) {
+  for (int i = 0; i < c->n_vars; i++) {
     if (c->vars[i].vartype == ORC_VAR_TYPE_ACCUMULATOR) {
       const int reg = c->vars[i].alloc;
       const int offset = ORC_STRUCT_OFFSET (OrcExecutor, accumulators[i - ORC_VAR_A1]);
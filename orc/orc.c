@@ -31,6 +31,7 @@
 void _orc_debug_init(void);
 void _orc_once_init(void);
 void _orc_compiler_init(void);
+void _orc_compiler_init_opcodes(void);
 
 /**
  * orc_init:
@@ -52,6 +53,7 @@ orc_init (void)
       _orc_debug_init();
       _orc_compiler_init();
       orc_opcode_init();
+      _orc_compiler_init_opcodes();
       orc_c_init();
 #ifdef ENABLE_TARGET_C64X
       orc_c64x_c_init();
@@ -117,12 +117,7 @@ orc_arm_flush_cache (OrcCode *code)
 void
 orc_arm_add_fixup (OrcCompiler *compiler, int label, int type)
 {
-  ORC_ASSERT (compiler->n_fixups < ORC_N_FIXUPS);
-
-  compiler->fixups[compiler->n_fixups].ptr = compiler->codeptr;
-  compiler->fixups[compiler->n_fixups].label = label;
-  compiler->fixups[compiler->n_fixups].type = type;
-  compiler->n_fixups++;
+  orc_compiler_add_fixup (compiler, compiler->codeptr, label, type);
 }
 
 void
@@ -115,6 +115,16 @@ typedef enum {
   ORC_ARM64_MEM_LDR
 } OrcArm64Mem;
 
+/** prefetch operations, see PRFM */
+typedef enum {
+  ORC_ARM64_PLDL1KEEP = 0x00,
+  ORC_ARM64_PLDL1STRM = 0x01,
+  ORC_ARM64_PLDL2KEEP = 0x02,
+  ORC_ARM64_PLDL2STRM = 0x03,
+  ORC_ARM64_PSTL1KEEP = 0x10,
+  ORC_ARM64_PSTL1STRM = 0x11
+} OrcArm64Prefetch;
+
 typedef enum {
   ORC_ARM64_TYPE_IMM = 0,
   ORC_ARM64_TYPE_REG,
@@ -996,6 +996,35 @@ orc_arm64_emit_ret (OrcCompiler *p, int Rn)
   orc_arm_emit (p, code);
 }
 
+/** Prefetch memory, unsigned scaled offset */
+
+void
+orc_arm64_emit_prfm (OrcCompiler *p, OrcArm64Prefetch prfop, int Rn,
+    int offset)
+{
+  static const char *prfop_names[] = {
+    "pldl1keep", "pldl1strm", "pldl2keep", "pldl2strm",
+    "pstl1keep", "pstl1strm", "pstl2keep", "pstl2strm"
+  };
+  orc_uint32 code;
+
+  if (offset < 0 || offset > 32760 || (offset & 7)) {
+    ORC_COMPILER_ERROR(p, "bad prfm offset %d", offset);
+    return;
+  }
+
+  code = 0xf9800000;
+  code |= ((offset >> 3) & 0xfff) << 10;
+  code |= (Rn & 0x1f) << 5;
+  code |= prfop & 0x1f;
+
+  ORC_ASM_CODE (p, "  prfm %s, [%s, #%d]\n",
+      prfop_names[((prfop >> 2) & 0x4) | (prfop & 0x3)],
+      orc_arm64_reg_name (Rn, ORC_ARM64_REG_64), offset);
+
+  orc_arm_emit (p, code);
+}
+
 void
 orc_arm64_emit_push (OrcCompiler *compiler, int regs, orc_uint32 vregs)
 {
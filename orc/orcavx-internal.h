@@ -20,7 +20,8 @@ typedef enum _OrcAVXInsnOperandFlag {
 #define ORC_AVX_INSN_OPERAND_FLAG_LAST (ORC_SSE_INSN_OPERAND_FLAG_LAST + 6)
 
 #define ORC_AVX_INSN_TYPE_MEM_AVX (\
-  ORC_X86_INSN_OPERAND_OP1_MEM     \
+  ORC_X86_INSN_OPERAND_OP1_MEM |   \
+  ORC_X86_INSN_OPERAND_OP2_REG     \
 ), ORC_AVX_INSN_OPERAND_OP2_YMM
 
 #define ORC_AVX_INSN_TYPE_SSE_SSE_MEM (\
@@ -32,6 +33,15 @@ typedef enum _OrcAVXInsnOperandFlag {
   ORC_AVX_INSN_OPERAND_OP2_YMM         \
 )
 
+#define ORC_AVX_INSN_TYPE_AVX_MEM_AVX (\
+  ORC_X86_INSN_OPERAND_OP1_REG |       \
+  ORC_X86_INSN_OPERAND_OP2_MEM |       \
+  ORC_X86_INSN_OPERAND_OP3_REG         \
+), (                                   \
+  ORC_AVX_INSN_OPERAND_OP1_YMM |       \
+  ORC_AVX_INSN_OPERAND_OP3_YMM         \
+)
+
 #define ORC_AVX_INSN_TYPE_AVX_AVXM (\
   ORC_X86_INSN_OPERAND_REG_REGM     \
 ), (                                \
@@ -369,6 +369,9 @@ static const OrcAVXInsnOp orc_avx_ops[] = {
   { "vpmaxud"     , ORC_TARGET_AVX_AVX2, ORC_AVX_INSN_TYPE_AVX_AVX_AVXM     , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x3F },
   { "vpmulld"     , ORC_TARGET_AVX_AVX2, ORC_AVX_INSN_TYPE_AVX_AVX_AVXM     , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x40 },
   { "vpcmpgtq"    , ORC_TARGET_AVX_AVX2, ORC_AVX_INSN_TYPE_AVX_AVX_AVXM     , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x37 },
+  { "vpsrlvd"     , ORC_TARGET_AVX_AVX2, ORC_AVX_INSN_TYPE_AVX_AVX_AVXM     , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x45 },
+  { "vpgatherdd"  , ORC_TARGET_AVX_AVX2, ORC_AVX_INSN_TYPE_AVX_MEM_AVX      , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x90 },
+  { "vpgatherdq"  , ORC_TARGET_AVX_AVX2, ORC_AVX_INSN_TYPE_AVX_MEM_AVX      , ORC_X86_INSN_OPCODE_PREFIX_0X66, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F38, 0x90, 0, ORC_X86_INSN_OPCODE_FLAG_VEX_W1 },
 };
 /* clang-format on */
 
@@ -845,3 +848,41 @@ orc_vex_emit_cpuinsn_load_memindex (OrcCompiler *const p, const int index,
   xinsn->index_reg = src_index;
   xinsn->shift = shift;
 }
+
+/*
+ * Used in
+ * vpgatherdd (AVX_MEM_AVX)
+ * vpgatherdq (AVX_MEM_AVX)
+ *
+ * The index is a vector register, the mask is cleared by the instruction
+ */
+void
+orc_vex_emit_cpuinsn_gather (OrcCompiler *const p, const int index,
+    const int offset, const int src, const int src_index, const int shift,
+    const int mask, const int dest)
+{
+  OrcX86Insn *xinsn;
+  const OrcAVXInsnOp *op = orc_avx_ops + index;
+  const OrcX86InsnOperandSize size = p->is_64bit ?
+      ORC_X86_INSN_OPERAND_SIZE_64 : ORC_X86_INSN_OPERAND_SIZE_32;
+
+  /* checks */
+  if (!orc_avx_insn_validate_operands (p, index, size, dest, src, mask,
+      ORC_REG_INVALID, 0))
+    return;
+
+  if (dest == src_index || dest == mask || src_index == mask) {
+    ORC_COMPILER_ERROR (p, "The registers of %s must be different", op->name);
+    return;
+  }
+
+  xinsn = orc_x86_get_output_insn (p);
+  orc_avx_insn_from_opcode (xinsn, index, op);
+  orc_x86_insn_set_operands (xinsn, op->operands,
+      ORC_X86_INSN_OPERAND_SIZE_NONE, dest, src, mask, ORC_REG_INVALID);
+  orc_x86_insn_set_mem (xinsn, op->operands, size,
+      ORC_X86_INSN_OPERAND_TYPE_IDX, dest, src, mask, ORC_REG_INVALID);
+  xinsn->offset = offset;
+  xinsn->index_reg = src_index;
+  xinsn->shift = shift;
+}
@@ -333,6 +333,9 @@ typedef enum _OrcAVXInsnOpcodeIdx {
   ORC_AVX_pmaxud,
   ORC_AVX_pmulld,
   ORC_AVX_pcmpgtq,
+  ORC_AVX_psrlvd,
+  ORC_AVX_pgatherdd,
+  ORC_AVX_pgatherdq,
 } OrcAVXInsnOpcodeIdx;
 
 ORC_API void orc_vex_emit_cpuinsn_none (OrcCompiler *p, const int index);
@@ -353,6 +356,9 @@ ORC_API void orc_vex_emit_cpuinsn_store_memoffset (OrcCompiler *const p,
 ORC_API void orc_vex_emit_cpuinsn_load_memindex (OrcCompiler *const p,
     const int index, const int imm, const int offset, const int src,
     const int src_index, const int shift, int dest);
+ORC_API void orc_vex_emit_cpuinsn_gather (OrcCompiler *const p,
+    const int index, const int offset, const int src, const int src_index,
+    const int shift, const int mask, const int dest);
 
 #define orc_avx_sse_emit_punpcklbw(p,s1,s2,d) orc_vex_emit_cpuinsn_avx(p, ORC_AVX_SSE_punpcklbw, s1, s2, 0, d)
 #define orc_avx_emit_punpcklbw(p,s1,s2,d) orc_vex_emit_cpuinsn_avx(p, ORC_AVX_punpcklbw, s1, s2, 0, d)
@@ -510,6 +516,7 @@ ORC_API void orc_vex_emit_cpuinsn_load_memindex (OrcCompiler *const p,
 #define orc_avx_emit_pmaxud(p,s1,s2,d) orc_vex_emit_cpuinsn_avx(p, ORC_AVX_pmaxud, s1, s2, 0, d)
 #define orc_avx_sse_emit_pcmpgtq(p,s1,s2,d) orc_vex_emit_cpuinsn_avx(p, ORC_AVX_SSE_pcmpgtq, s1, s2, 0, d)
 #define orc_avx_emit_pcmpgtq(p,s1,s2,d) orc_vex_emit_cpuinsn_avx(p, ORC_AVX_pcmpgtq, s1, s2, 0, d)
+#define orc_avx_emit_psrlvd(p,s1,s2,d) orc_vex_emit_cpuinsn_avx(p, ORC_AVX_psrlvd, s1, s2, 0, d)
 
 #define orc_avx_sse_emit_addps(p,s1,s2,d) orc_vex_emit_cpuinsn_avx(p, ORC_AVX_SSE_addps, s1, s2, 0, d)
 #define orc_avx_emit_addps(p,s1,s2,d) orc_vex_emit_cpuinsn_avx(p, ORC_AVX_addps, s1, s2, 0, d)
@@ -587,6 +594,7 @@ ORC_API void orc_vex_emit_cpuinsn_load_memindex (OrcCompiler *const p,
 #define orc_avx_emit_psllq_imm(p,imm,s1,d) orc_vex_emit_cpuinsn_imm(p, ORC_AVX_psllq_imm, 0, imm, s1, 0, d)
 #define orc_avx_sse_emit_pslldq_imm(p,imm,s1,d) orc_vex_emit_cpuinsn_imm(p, ORC_AVX_SSE_pslldq_imm, 0, imm, s1, 0, d)
 #define orc_avx_emit_pslldq_imm(p,imm,s1,d) orc_vex_emit_cpuinsn_imm(p, ORC_AVX_pslldq_imm, 0, imm, s1, 0, d)
+#define orc_avx_emit_psrldq_imm(p,imm,s1,d) orc_vex_emit_cpuinsn_imm(p, ORC_AVX_psrldq_imm, 0, imm, s1, 0, d)
 #define orc_avx_sse_emit_pshufd(p,imm,s1,d) orc_vex_emit_cpuinsn_imm(p, ORC_AVX_SSE_pshufd, 0, imm, s1, 0, d)
 #define orc_avx_emit_pshufd(p,imm,s1,d) orc_vex_emit_cpuinsn_imm(p, ORC_AVX_pshufd, 0, imm, s1, 0, d)
 #define orc_avx_sse_emit_pshuflw(p,imm,s1,d) orc_vex_emit_cpuinsn_imm(p, ORC_AVX_SSE_pshuflw, 0, imm, s1, 0, d)
@@ -622,6 +630,9 @@ ORC_API void orc_vex_emit_cpuinsn_load_memindex (OrcCompiler *const p,
 #define orc_avx_sse_emit_movdqu_load_memindex(p,offset,a,a_index,shift,b) orc_vex_emit_cpuinsn_load_memindex(p, ORC_AVX_SSE_movdqu_load, 0, offset, a, a_index, shift, b)
 #define orc_avx_emit_movdqu_load_memindex(p,offset,a,a_index,shift,b) orc_vex_emit_cpuinsn_load_memindex(p, ORC_AVX_movdqu_load, 0, offset, a, a_index, shift, b)
 
+#define orc_avx_emit_pgatherdd(p,offset,a,a_index,shift,mask,b) orc_vex_emit_cpuinsn_gather(p, ORC_AVX_pgatherdd, offset, a, a_index, shift, mask, b)
+#define orc_avx_emit_pgatherdq(p,offset,a,a_index,shift,mask,b) orc_vex_emit_cpuinsn_gather(p, ORC_AVX_pgatherdq, offset, a, a_index, shift, mask, b)
+
 #define orc_avx_sse_emit_pinsrw_register(p,imm,s1,s2,d) orc_vex_emit_cpuinsn_imm(p, ORC_AVX_SSE_pinsrw, 4, imm, s1, s2, d)
 #define orc_avx_sse_emit_movd_load_register(p,a,b) orc_vex_emit_cpuinsn_size(p, ORC_AVX_SSE_movd_load, 4, a, 0, 0, b)
 
@@ -5,6 +5,7 @@
 
 #include <orc/orc.h>
 #include <orc/orcbytecode.h>
+#include <orc/orcinternal.h>
 #include <orc/orcutils-private.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -67,6 +68,10 @@ orc_bytecode_from_program (OrcProgram *p)
     bytecode_append_code (bytecode, ORC_BC_SET_N_MAXIMUM);
     bytecode_append_int (bytecode, p->n_maximum);
   }
+  if (p->unroll != 0) {
+    bytecode_append_code (bytecode, ORC_BC_SET_UNROLL);
+    bytecode_append_int (bytecode, p->unroll);
+  }
   if (p->is_2d) {
     bytecode_append_code (bytecode, ORC_BC_SET_2D);
     if (p->constant_m != 0) {
@@ -229,7 +234,7 @@ bytecode_append_code (OrcBytecode *bytecode, int code)
       "ADD_PARAMETER_DOUBLE",
       "ADD_TEMPORARY",
       "RESERVED_21",
-      "RESERVED_22",
+      "SET_UNROLL",
       "RESERVED_23",
       "RESERVED_24",
       "RESERVED_25",
@@ -414,6 +419,9 @@ orc_bytecode_parse_function (OrcProgram *program, const orc_uint8 *bytecode)
         case ORC_BC_SET_N_MAXIMUM:
           program->n_maximum = orc_bytecode_parse_get_int (parse);
           break;
+        case ORC_BC_SET_UNROLL:
+          program->unroll = orc_bytecode_parse_get_int (parse);
+          break;
         case ORC_BC_SET_2D:
           program->is_2d = TRUE;
           break;
@@ -490,7 +498,7 @@ orc_bytecode_parse_function (OrcProgram *program, const orc_uint8 *bytecode)
     } else {
       OrcInstruction *insn;
 
-      insn = program->insns + program->n_insns;
+      insn = orc_program_new_insn (program);
 
       insn->opcode = opcode_set->opcodes + (bc - 32);
       if (insn->opcode->dest_size[0] != 0) {
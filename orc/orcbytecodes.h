@@ -26,7 +26,7 @@ typedef enum {
   ORC_BC_ADD_PARAMETER_DOUBLE,
   ORC_BC_ADD_TEMPORARY,
   ORC_BC_INSTRUCTION_FLAGS,
-  ORC_BC_RESERVED_22,
+  ORC_BC_SET_UNROLL,
   ORC_BC_RESERVED_23,
   ORC_BC_RESERVED_24,
   ORC_BC_RESERVED_25,
@@ -249,6 +249,19 @@ typedef enum {
   ORC_BC_convld,
   ORC_BC_convfd,
   ORC_BC_convdf,
-  /* 226 */
+  ORC_BC_orf,
+  ORC_BC_andf,
+  ORC_BC_convwf,
+  ORC_BC_accmaxub,
+  /* 230 */
+  ORC_BC_accminub,
+  ORC_BC_accmaxsw,
+  ORC_BC_accminsw,
+  ORC_BC_accorl,
+  ORC_BC_accandl,
+  ORC_BC_accq,
+  ORC_BC_accf,
+  ORC_BC_accd,
+  /* 238 */
   ORC_BC_LAST
 } OrcBytecodes;
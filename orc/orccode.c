@@ -34,6 +34,8 @@ orc_code_free (OrcCode *code)
     free (code->vars);
     code->vars = NULL;
   }
+  orc_code_emulate_plan_free (code);
+  orc_code_stats_detach (code);
   if (code->chunk) {
 #if defined(_WIN64) && defined(ORC_SUPPORTS_BACKTRACE_FROM_JIT)
   DWORD64 dyn_base = 0;
@@ -9,6 +9,7 @@
 ORC_BEGIN_DECLS
 
 typedef struct _OrcCodeVariable OrcCodeVariable;
+typedef struct _OrcCodeStats OrcCodeStats;
 
 
 struct _OrcCodeVariable {
@@ -38,6 +39,33 @@ struct _OrcCode {
   int is_2d;
   int constant_n;
   int constant_m;
+  void *emulate_plan;
+
+  /* for ORC_CODE=stats */
+  void *stats;
+};
+
+/**
+ * OrcCodeStats:
+ * @n_calls: the number of times the code was run
+ * @n_elements: the total number of elements processed, n * m for 2D code
+ * @cycles: the total time spent running the code, in timestamp counter
+ *   ticks where the CPU has one and in nanoseconds otherwise
+ * @min_n: the smallest value of n the code was run with
+ * @max_n: the largest value of n the code was run with
+ * @min_m: the smallest value of m the code was run with, 1 for 1D code
+ * @max_m: the largest value of m the code was run with, 1 for 1D code
+ *
+ * Execution counters of an #OrcCode, see orc_code_get_stats().
+ */
+struct _OrcCodeStats {
+  orc_uint64 n_calls;
+  orc_uint64 n_elements;
+  orc_uint64 cycles;
+  int min_n;
+  int max_n;
+  int min_m;
+  int max_m;
 };
 
 
@@ -46,6 +74,13 @@ ORC_API void orc_code_allocate_codemem (OrcCode *code, int size);
 ORC_API OrcCode * orc_code_new (void);
 ORC_API void      orc_code_free (OrcCode *code);
 
+ORC_API void      orc_code_cache_set_directory (const char *path);
+ORC_API char *    orc_code_cache_get_directory (void);
+
+ORC_API orc_bool  orc_code_get_stats (OrcCode *code, OrcCodeStats *stats);
+ORC_API void      orc_code_reset_stats (OrcCode *code);
+ORC_API void      orc_code_dump_stats (void);
+
 ORC_END_DECLS
 
 #endif
@@ -0,0 +1,392 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_DLADDR
+#include <dlfcn.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <process.h>
+#include <direct.h>
+#endif
+
+#include <orc/orc.h>
+#include <orc/orcprogram.h>
+#include <orc/orccpu.h>
+#include <orc/orcdebug.h>
+#include <orc/orcinternal.h>
+#include <orc/orcutils-private.h>
+
+/**
+ * SECTION:orccodecache
+ * @title: Code cache
+ * @short_description: Persistent cache of compiled Orc code
+ *
+ * When a cache directory is set, either with orc_code_cache_set_directory()
+ * or through the ORC_CACHE_DIR environment variable, the machine code
+ * generated for a program is written to that directory once it has
+ * been compiled. Later compilations of the same program for the same
+ * target, target flags and CPU load the code from the cache instead of
+ * running the target's code generator.
+ *
+ * Entries are keyed on the program bytecode, the target name and flags,
+ * the CPU description, the Orc version and, where it can be found, the
+ * size, modification time and inode of the Orc library, so a stale entry
+ * is never picked up after an upgrade, a rebuild or on a different
+ * machine.
+ */
+
+#define ORC_CODE_CACHE_MAGIC "ORCCACHE"
+/* Must be bumped with every change to the code generated by any target,
+ * or to the layout of the entries. Builds where the library cannot be
+ * identified, see orc_code_cache_get_build_id(), only rely on this and
+ * on the Orc version to skip the entries of an older code generator */
+#define ORC_CODE_CACHE_VERSION 2
+
+typedef struct _OrcCodeCacheHeader OrcCodeCacheHeader;
+
+struct _OrcCodeCacheHeader {
+  char magic[8];
+  orc_uint32 version;
+  orc_uint32 key_len;
+  orc_uint32 code_size;
+  orc_uint32 asm_len;
+};
+
+static char *_orc_code_cache_dir;
+
+void
+_orc_code_cache_init (void)
+{
+  char *envvar;
+
+  envvar = _orc_getenv ("ORC_CACHE_DIR");
+  if (envvar != NULL) {
+    if (envvar[0] != '\0') {
+      _orc_code_cache_dir = envvar;
+    } else {
+      free (envvar);
+    }
+  }
+}
+
+/**
+ * orc_code_cache_set_directory:
+ * @path: the directory where compiled code is stored, or NULL
+ *
+ * Enables the persistent code cache, storing compiled programs in @path.
+ * Passing NULL disables the cache. This overrides the value of the
+ * ORC_CACHE_DIR environment variable.
+ */
+void
+orc_code_cache_set_directory (const char *path)
+{
+  orc_global_mutex_lock ();
+  free (_orc_code_cache_dir);
+  _orc_code_cache_dir = path ? strdup (path) : NULL;
+  orc_global_mutex_unlock ();
+}
+
+/**
+ * orc_code_cache_get_directory:
+ *
+ * Returns the directory used by the persistent code cache, or NULL if
+ * the cache is disabled. The returned string must be freed with free().
+ *
+ * Returns: a newly allocated string or NULL
+ */
+char *
+orc_code_cache_get_directory (void)
+{
+  char *path = NULL;
+
+  orc_global_mutex_lock ();
+  if (_orc_code_cache_dir)
+    path = strdup (_orc_code_cache_dir);
+  orc_global_mutex_unlock ();
+
+  return path;
+}
+
+static orc_bool
+orc_code_cache_is_usable (OrcCompiler *compiler)
+{
+  if (compiler->target == NULL || !compiler->target->executable)
+    return FALSE;
+
+  /* Debug builds keep the code around for debuggers, and randomized
+   * register allocation is only useful if code is actually generated.
+   * Unoptimized code would be stored under the same key as the
+   * optimized one */
+  if (orc_compiler_is_debug () || orc_compiler_flag_check ("randomize") ||
+      orc_compiler_flag_check ("noopt"))
+    return FALSE;
+
+  return TRUE;
+}
+
+/* Identifies the build of the code generator by the file it was loaded
+ * from, so that a rebuild without a version change, such as a git
+ * snapshot or a patched package, does not load the code of the previous
+ * build. Empty when the file cannot be found. */
+static void
+orc_code_cache_get_build_id (char *build_id, int size)
+{
+#ifdef HAVE_DLADDR
+  Dl_info info;
+  struct stat st;
+
+  if (dladdr ((void *) orc_code_cache_get_build_id, &info) &&
+      info.dli_fname && stat (info.dli_fname, &st) == 0) {
+    snprintf (build_id, size, "%" PRId64 ":%" PRId64 ":%" PRId64,
+        (orc_int64) st.st_size, (orc_int64) st.st_mtime,
+        (orc_int64) st.st_ino);
+    return;
+  }
+#endif
+  build_id[0] = '\0';
+}
+
+static orc_uint8 *
+orc_code_cache_build_key (OrcCompiler *compiler, int *key_len)
+{
+  OrcBytecode *bytecode;
+  orc_uint8 *key;
+  char header[320];
+  char build_id[64];
+  int family, model, stepping;
+  int l1, l2, l3;
+  int header_len;
+
+  orc_get_cpu_family_model_stepping (&family, &model, &stepping);
+  orc_get_data_cache_sizes (&l1, &l2, &l3);
+  orc_code_cache_get_build_id (build_id, sizeof (build_id));
+
+  header_len = snprintf (header, sizeof (header),
+      "orc-%s/%d [%s] %s %08x %s %d.%d.%d %d/%d/%d %d",
+      orc_version_string (), ORC_CODE_CACHE_VERSION, build_id,
+      compiler->target->name, compiler->target_flags,
+      orc_get_cpu_name (), family, model, stepping, l1, l2, l3,
+      (int) sizeof (void *));
+  if (header_len < 0 || header_len >= (int) sizeof (header))
+    return NULL;
+
+  bytecode = orc_bytecode_from_program (compiler->program);
+
+  *key_len = header_len + 1 + bytecode->length;
+  key = orc_malloc (*key_len);
+  memcpy (key, header, header_len + 1);
+  memcpy (key + header_len + 1, bytecode->bytecode, bytecode->length);
+
+  orc_bytecode_free (bytecode);
+
+  return key;
+}
+
+static char *
+orc_code_cache_get_filename (const char *dir, const orc_uint8 *key,
+    int key_len)
+{
+  /* 64-bit FNV-1a */
+  orc_uint64 hash = ORC_UINT64_C(0xcbf29ce484222325);
+  char *filename;
+  int i;
+
+  for (i = 0; i < key_len; i++) {
+    hash ^= key[i];
+    hash *= ORC_UINT64_C(0x100000001b3);
+  }
+
+  filename = orc_malloc (strlen (dir) + 1 + 16 + strlen (".orccache") + 1);
+  sprintf (filename, "%s/%08x%08x.orccache", dir,
+      (orc_uint32) (hash >> 32), (orc_uint32) hash);
+
+  return filename;
+}
+
+/**
+ * orc_code_cache_load:
+ * @compiler: the compiler
+ *
+ * Looks up the program being compiled in the cache. On a hit, the cached
+ * machine code is copied to compiler->code, compiler->codeptr is set
+ * to the end of it and the assembly listing is restored.
+ *
+ * Returns: TRUE if the code was found in the cache
+ */
+orc_bool
+orc_code_cache_load (OrcCompiler *compiler)
+{
+  OrcCodeCacheHeader header;
+  orc_uint8 *key = NULL;
+  orc_uint8 *stored_key = NULL;
+  char *asm_code = NULL;
+  char *filename = NULL;
+  char *dir;
+  FILE *file = NULL;
+  orc_bool ret = FALSE;
+  int key_len;
+
+  if (!orc_code_cache_is_usable (compiler))
+    return FALSE;
+
+  dir = orc_code_cache_get_directory ();
+  if (dir == NULL)
+    return FALSE;
+
+  key = orc_code_cache_build_key (compiler, &key_len);
+  if (key == NULL)
+    goto out;
+
+  filename = orc_code_cache_get_filename (dir, key, key_len);
+  file = fopen (filename, "rb");
+  if (file == NULL)
+    goto out;
+
+  if (fread (&header, sizeof (header), 1, file) != 1)
+    goto out;
+  if (memcmp (header.magic, ORC_CODE_CACHE_MAGIC, sizeof (header.magic)) != 0
+      || header.version != ORC_CODE_CACHE_VERSION
+      || header.key_len != (orc_uint32) key_len
+      || header.code_size > (orc_uint32) compiler->code_size)
+    goto out;
+
+  stored_key = orc_malloc (key_len);
+  if (fread (stored_key, key_len, 1, file) != 1
+      || memcmp (stored_key, key, key_len) != 0)
+    goto out;
+
+  if (header.code_size > 0 &&
+      fread (compiler->code, header.code_size, 1, file) != 1)
+    goto out;
+
+  /* Entries stored by compilations that did not create the assembly code
+   * have none */
+  if (header.asm_len == 0 && compiler->need_asm)
+    goto out;
+
+  if (header.asm_len > 0) {
+    asm_code = orc_malloc (header.asm_len + 1);
+    if (fread (asm_code, header.asm_len, 1, file) != 1)
+      goto out;
+    asm_code[header.asm_len] = '\0';
+  }
+
+  compiler->codeptr = compiler->code + header.code_size;
+  free (compiler->asm_code);
+  compiler->asm_code = asm_code;
+  compiler->asm_code_len = header.asm_len;
+  compiler->asm_code_alloc = asm_code ? header.asm_len + 1 : 0;
+  asm_code = NULL;
+  ret = TRUE;
+
+  ORC_INFO ("loaded program \"%s\" from code cache %s",
+      compiler->program->name, filename);
+
+out:
+  if (file)
+    fclose (file);
+  free (asm_code);
+  free (stored_key);
+  free (filename);
+  free (key);
+  free (dir);
+  return ret;
+}
+
+/**
+ * orc_code_cache_store:
+ * @compiler: the compiler
+ *
+ * Writes the code generated by the target into the cache. Must be called
+ * after the target compile step, once all fixups have been resolved.
+ * The entry is written to a temporary file first and then renamed, so
+ * concurrent readers never see a partially written entry.
+ */
+void
+orc_code_cache_store (OrcCompiler *compiler)
+{
+  OrcCodeCacheHeader header;
+  orc_uint8 *key = NULL;
+  char *filename = NULL;
+  char *tmpname = NULL;
+  char *dir;
+  FILE *file;
+  int key_len;
+  int ok;
+
+  if (!orc_code_cache_is_usable (compiler))
+    return;
+
+  dir = orc_code_cache_get_directory ();
+  if (dir == NULL)
+    return;
+
+#ifdef _WIN32
+  _mkdir (dir);
+#else
+  mkdir (dir, 0700);
+#endif
+
+  key = orc_code_cache_build_key (compiler, &key_len);
+  if (key == NULL)
+    goto out;
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, ORC_CODE_CACHE_MAGIC, sizeof (header.magic));
+  header.version = ORC_CODE_CACHE_VERSION;
+  header.key_len = key_len;
+  header.code_size = compiler->codeptr - compiler->code;
+  header.asm_len = compiler->asm_code ? compiler->asm_code_len : 0;
+
+  filename = orc_code_cache_get_filename (dir, key, key_len);
+  tmpname = orc_malloc (strlen (filename) + 16);
+#ifdef _WIN32
+  sprintf (tmpname, "%s.%d", filename, _getpid ());
+#else
+  sprintf (tmpname, "%s.%d", filename, (int) getpid ());
+#endif
+
+  file = fopen (tmpname, "wb");
+  if (file == NULL) {
+    ORC_WARNING ("failed to create code cache entry %s", tmpname);
+    goto out;
+  }
+
+  ok = fwrite (&header, sizeof (header), 1, file) == 1 &&
+      fwrite (key, key_len, 1, file) == 1;
+  if (ok && header.code_size > 0)
+    ok = fwrite (compiler->code, header.code_size, 1, file) == 1;
+  if (ok && header.asm_len > 0)
+    ok = fwrite (compiler->asm_code, header.asm_len, 1, file) == 1;
+  if (fclose (file) != 0)
+    ok = FALSE;
+
+  if (!ok || rename (tmpname, filename) != 0) {
+    ORC_WARNING ("failed to write code cache entry %s", filename);
+    remove (tmpname);
+    goto out;
+  }
+
+  ORC_INFO ("stored program \"%s\" in code cache %s",
+      compiler->program->name, filename);
+
+out:
+  free (tmpname);
+  free (filename);
+  free (key);
+  free (dir);
+}
@@ -32,7 +32,37 @@
 #include <orc/orcdebug.h>
 
 
-#define SIZE 65536
+#if defined(HAVE_THREAD_PTHREAD)
+#include <pthread.h>
+#endif
+
+/* Code memory is handed out from regions mapped executable. Regions start
+ * at ORC_CODE_REGION_MIN_SIZE and double up to ORC_CODE_REGION_MAX_SIZE,
+ * the size of a huge page on most systems, as more code is generated.
+ *
+ * Free space is kept in chunks ordered by address within each region, so
+ * that freed chunks can be merged with their neighbours, and indexed by
+ * size class in power of two bins. A region is unmapped once all its
+ * chunks have been freed, unless it is the only one left.
+ *
+ * Small allocations are made from a per-thread arena, a chunk that the
+ * thread owns and carves up without taking the global lock. An arena is
+ * retired when it is full or when its thread exits, and goes back to the
+ * bins once all the code allocated from it has been freed. */
+
+#define ORC_CODE_REGION_MIN_SIZE 65536
+#define ORC_CODE_REGION_MAX_SIZE (2 * 1024 * 1024)
+
+#define ORC_CODE_BIN_MIN_SHIFT 4
+#define ORC_CODE_N_BINS 24
+
+#if defined(HAVE_THREAD_PTHREAD)
+/* Windows aligns every allocation to a page so that its protection can be
+ * changed on its own, which leaves nothing to gain from arenas there */
+#define ORC_CODE_USE_ARENAS 1
+#define ORC_CODE_ARENA_SIZE 16384
+#define ORC_CODE_ARENA_MAX_ALLOC (ORC_CODE_ARENA_SIZE / 4)
+#endif
 
 /* See _orc_compiler_init() */
 extern int _orc_codemem_alignment;
@@ -41,8 +71,11 @@ struct _OrcCodeRegion {
   orc_uint8 *write_ptr;
   orc_uint8 *exec_ptr;
   int size;
+  /* number of chunks in use, arenas included */
+  int n_used;
 
   OrcCodeChunk *chunks;
+  OrcCodeRegion *next;
 };
 
 struct _OrcCodeChunk {
@@ -54,24 +87,81 @@ struct _OrcCodeChunk {
 
   int offset;
   int size;
+
+  /* free chunks, list of the size class bin */
+  struct _OrcCodeChunk *bin_next;
+  struct _OrcCodeChunk *bin_prev;
+
+  /* code allocated from an arena, which is not in the region list */
+  struct _OrcCodeChunk *arena;
+
+  /* arenas. The owner thread bumps arena_offset and arena_allocated
+   * without locking until the arena is retired, the other fields are
+   * protected by the global mutex */
+  int arena_offset;
+  int arena_allocated;
+  int arena_freed;
+  int arena_retired;
 };
 
 
-static int orc_code_region_allocate_codemem (OrcCodeRegion *region);
+static int orc_code_region_allocate_codemem (OrcCodeRegion *region, int size);
+static void orc_code_region_free_codemem (OrcCodeRegion *region);
 
-static OrcCodeRegion **orc_code_regions;
-static int orc_code_n_regions;
+static OrcCodeRegion *orc_code_regions;
+static OrcCodeChunk *orc_code_bins[ORC_CODE_N_BINS];
+static int orc_code_next_region_size = ORC_CODE_REGION_MIN_SIZE;
 
 
-OrcCodeRegion *
-orc_code_region_alloc (void)
+static int
+orc_code_bin_index (int size)
+{
+  int index = -ORC_CODE_BIN_MIN_SHIFT;
+
+  while (size > 1) {
+    size >>= 1;
+    index++;
+  }
+
+  return ORC_CLAMP (index, 0, ORC_CODE_N_BINS - 1);
+}
+
+static void
+orc_code_bin_insert (OrcCodeChunk *chunk)
+{
+  OrcCodeChunk **bin = orc_code_bins + orc_code_bin_index (chunk->size);
+
+  chunk->bin_prev = NULL;
+  chunk->bin_next = *bin;
+  if (*bin)
+    (*bin)->bin_prev = chunk;
+  *bin = chunk;
+}
+
+static void
+orc_code_bin_remove (OrcCodeChunk *chunk)
+{
+  if (chunk->bin_prev) {
+    chunk->bin_prev->bin_next = chunk->bin_next;
+  } else {
+    orc_code_bins[orc_code_bin_index (chunk->size)] = chunk->bin_next;
+  }
+  if (chunk->bin_next)
+    chunk->bin_next->bin_prev = chunk->bin_prev;
+
+  chunk->bin_next = NULL;
+  chunk->bin_prev = NULL;
+}
+
+static OrcCodeRegion *
+orc_code_region_alloc_size (int size)
 {
   OrcCodeRegion *region;
 
   region = orc_malloc(sizeof(OrcCodeRegion));
   memset (region, 0, sizeof(OrcCodeRegion));
 
-  if (!orc_code_region_allocate_codemem (region)) {
+  if (!orc_code_region_allocate_codemem (region, size)) {
     free(region);
     return NULL;
   }
@@ -79,18 +169,48 @@ orc_code_region_alloc (void)
   return region;
 }
 
+OrcCodeRegion *
+orc_code_region_alloc (void)
+{
+  return orc_code_region_alloc_size (ORC_CODE_REGION_MIN_SIZE);
+}
+
+void
+orc_code_region_free (OrcCodeRegion *region)
+{
+  OrcCodeChunk *chunk;
+
+  while (region->chunks) {
+    chunk = region->chunks;
+    region->chunks = chunk->next;
+    free (chunk);
+  }
+
+  orc_code_region_free_codemem (region);
+  free (region);
+}
+
+/* Must be called with orc_global_mutex_lock() */
 static OrcCodeRegion *
-orc_code_region_new (void)
+orc_code_region_new (int min_size)
 {
   OrcCodeRegion *region;
   OrcCodeChunk *chunk;
+  int size;
 
-  region = orc_code_region_alloc();
+  size = MAX (orc_code_next_region_size, min_size);
+  size = (size + ORC_CODE_REGION_MIN_SIZE - 1) & ~(ORC_CODE_REGION_MIN_SIZE - 1);
+
+  region = orc_code_region_alloc_size (size);
 
   if (!region) {
     return NULL;
   }
 
+  orc_code_next_region_size = MIN (orc_code_next_region_size * 2,
+      ORC_CODE_REGION_MAX_SIZE);
+  ORC_DEBUG ("allocated code region %p of %d bytes", region, region->size);
+
   chunk = orc_malloc(sizeof(OrcCodeChunk));
   memset (chunk, 0, sizeof(OrcCodeChunk));
 
@@ -100,10 +220,32 @@ orc_code_region_new (void)
   chunk->size = region->size;
 
   region->chunks = chunk;
+  region->next = orc_code_regions;
+  orc_code_regions = region;
+
+  orc_code_bin_insert (chunk);
 
   return region;
 }
 
+/* Must be called with orc_global_mutex_lock() */
+static void
+orc_code_region_remove (OrcCodeRegion *region)
+{
+  OrcCodeRegion **link;
+
+  for (link = &orc_code_regions; *link; link = &(*link)->next) {
+    if (*link == region) {
+      *link = region->next;
+      break;
+    }
+  }
+
+  ORC_DEBUG ("freeing code region %p of %d bytes", region, region->size);
+  orc_code_bin_remove (region->chunks);
+  orc_code_region_free (region);
+}
+
 static OrcCodeChunk *
 orc_code_chunk_split (OrcCodeChunk *chunk, int size)
 {
@@ -141,95 +283,201 @@ orc_code_chunk_merge (OrcCodeChunk *chunk)
   free(chunk2);
 }
 
-/* Must be called with orc_global_mutex_lock() */
+/* Must be called with orc_global_mutex_lock(). Returns the first chunk of
+ * the smallest size class that can hold @size bytes, creating a region if
+ * there is none */
 static OrcCodeChunk *
 orc_code_region_get_free_chunk (int size)
 {
-  int i;
-  OrcCodeRegion *region;
   OrcCodeChunk *chunk;
+  int i;
 
-  for(i=0;i<orc_code_n_regions;i++){
-    region = orc_code_regions[i];
-    for(chunk = region->chunks; chunk; chunk = chunk->next) {
-      if (!chunk->used && size <= chunk->size) {
+  for (i = orc_code_bin_index (size); i < ORC_CODE_N_BINS; i++) {
+    for (chunk = orc_code_bins[i]; chunk; chunk = chunk->bin_next) {
+      if (size <= chunk->size) {
         return chunk;
       }
     }
   }
 
-  region = orc_code_region_new ();
-  if (!region)
+  if (!orc_code_region_new (size))
     return NULL;
 
-  orc_code_regions = realloc (orc_code_regions,
-      sizeof(void *)*(orc_code_n_regions+1));
-  if (!orc_code_regions) {
-    free(region);
+  return orc_code_regions->chunks;
+}
+
+/* Must be called with orc_global_mutex_lock() */
+static OrcCodeChunk *
+orc_code_chunk_take (int size)
+{
+  OrcCodeChunk *chunk;
+
+  chunk = orc_code_region_get_free_chunk (size);
+  if (!chunk)
     return NULL;
+
+  orc_code_bin_remove (chunk);
+  if (chunk->size > size) {
+    orc_code_bin_insert (orc_code_chunk_split (chunk, size));
   }
 
-  orc_code_regions[orc_code_n_regions] = region;
-  orc_code_n_regions++;
+  chunk->used = TRUE;
+  chunk->arena_offset = 0;
+  chunk->arena_allocated = 0;
+  chunk->arena_freed = 0;
+  chunk->arena_retired = FALSE;
+  chunk->region->n_used++;
 
-  for(chunk = region->chunks; chunk; chunk = chunk->next) {
-    if (!chunk->used && size <= chunk->size){
-      return chunk;
-    }
+  return chunk;
+}
+
+/* Must be called with orc_global_mutex_lock() */
+static void
+orc_code_chunk_release (OrcCodeChunk *chunk)
+{
+  OrcCodeRegion *region = chunk->region;
+
+  chunk->used = FALSE;
+  region->n_used--;
+
+  if (chunk->next && !chunk->next->used) {
+    orc_code_bin_remove (chunk->next);
+    orc_code_chunk_merge (chunk);
+  }
+  if (chunk->prev && !chunk->prev->used) {
+    chunk = chunk->prev;
+    orc_code_bin_remove (chunk);
+    orc_code_chunk_merge (chunk);
+  }
+  orc_code_bin_insert (chunk);
+
+  /* Keep one region around for the next program */
+  if (region->n_used == 0 &&
+      (orc_code_regions != region || region->next != NULL)) {
+    orc_code_region_remove (region);
+  }
+}
+
+#ifdef ORC_CODE_USE_ARENAS
+
+static pthread_key_t orc_code_arena_key;
+static pthread_once_t orc_code_arena_once = PTHREAD_ONCE_INIT;
+
+/* Must be called with orc_global_mutex_lock() */
+static void
+orc_code_arena_retire (OrcCodeChunk *arena)
+{
+  arena->arena_retired = TRUE;
+  if (arena->arena_freed == arena->arena_allocated)
+    orc_code_chunk_release (arena);
+}
+
+static void
+orc_code_arena_thread_exit (void *data)
+{
+  orc_global_mutex_lock ();
+  orc_code_arena_retire (data);
+  orc_global_mutex_unlock ();
+}
+
+static void
+orc_code_arena_init (void)
+{
+  pthread_key_create (&orc_code_arena_key, orc_code_arena_thread_exit);
+}
+
+static OrcCodeChunk *
+orc_code_arena_allocate (int size)
+{
+  OrcCodeChunk *arena;
+  OrcCodeChunk *chunk;
+
+  pthread_once (&orc_code_arena_once, orc_code_arena_init);
+
+  arena = pthread_getspecific (orc_code_arena_key);
+  if (arena == NULL || arena->arena_offset + size > arena->size) {
+    orc_global_mutex_lock ();
+    if (arena)
+      orc_code_arena_retire (arena);
+    arena = orc_code_chunk_take (ORC_CODE_ARENA_SIZE);
+    orc_global_mutex_unlock ();
+
+    pthread_setspecific (orc_code_arena_key, arena);
+    if (arena == NULL)
+      return NULL;
   }
 
-  return NULL;
+  chunk = orc_malloc(sizeof(OrcCodeChunk));
+  memset (chunk, 0, sizeof(OrcCodeChunk));
+
+  chunk->arena = arena;
+  chunk->region = arena->region;
+  chunk->used = TRUE;
+  chunk->offset = arena->offset + arena->arena_offset;
+  chunk->size = size;
+
+  arena->arena_offset += size;
+  arena->arena_allocated++;
+
+  return chunk;
 }
 
+#endif
+
 void
 orc_code_allocate_codemem (OrcCode *code, int size)
 {
   OrcCodeRegion *region;
-  OrcCodeChunk *chunk;
+  OrcCodeChunk *chunk = NULL;
   int aligned_size =
       (MAX(1, size) + _orc_codemem_alignment) & (~_orc_codemem_alignment);
 
-  orc_global_mutex_lock ();
-  chunk = orc_code_region_get_free_chunk (aligned_size);
+#ifdef ORC_CODE_USE_ARENAS
+  if (aligned_size <= ORC_CODE_ARENA_MAX_ALLOC)
+    chunk = orc_code_arena_allocate (aligned_size);
+#endif
+
   if (!chunk) {
+    orc_global_mutex_lock ();
+    chunk = orc_code_chunk_take (aligned_size);
     orc_global_mutex_unlock ();
+  }
 
+  if (!chunk) {
     ORC_ERROR ("Failed to get free chunk memory");
     return;
   }
 
   region = chunk->region;
 
-  if (chunk->size > aligned_size) {
-    orc_code_chunk_split (chunk, aligned_size);
-  }
-
-  chunk->used = TRUE;
-
   code->chunk = chunk;
   code->code = ORC_PTR_OFFSET(region->write_ptr, chunk->offset);
   code->exec = ORC_PTR_OFFSET(region->exec_ptr, chunk->offset);
   code->code_size = size;
   /* compiler->codeptr = ORC_PTR_OFFSET(region->write_ptr, chunk->offset); */
-
-  orc_global_mutex_unlock ();
 }
 
 void
 orc_code_chunk_free (OrcCodeChunk *chunk)
 {
+  OrcCodeChunk *arena;
+
   if (orc_compiler_is_debug ()) {
     /* If debug is turned on, don't free code */
     return;
   }
 
   orc_global_mutex_lock ();
-  chunk->used = FALSE;
-  if (chunk->next && !chunk->next->used) {
-    orc_code_chunk_merge (chunk);
-  }
-  if (chunk->prev && !chunk->prev->used) {
-    orc_code_chunk_merge (chunk->prev);
+  if (chunk->arena) {
+    arena = chunk->arena;
+    free (chunk);
+
+    arena->arena_freed++;
+    /* arena_allocated no longer changes once the arena is retired */
+    if (arena->arena_retired && arena->arena_freed == arena->arena_allocated)
+      orc_code_chunk_release (arena);
+  } else {
+    orc_code_chunk_release (chunk);
   }
   orc_global_mutex_unlock ();
 }
@@ -237,7 +485,7 @@ orc_code_chunk_free (OrcCodeChunk *chunk)
 #ifdef HAVE_CODEMEM_MMAP
 static int
 orc_code_region_allocate_codemem_dual_map (OrcCodeRegion *region,
-    const char *dir, int force_unlink)
+    const char *dir, int force_unlink, int size)
 {
   int fd;
   int n;
@@ -264,7 +512,7 @@ orc_code_region_allocate_codemem_dual_map (OrcCodeRegion *region,
     unlink (filename);
   }
 
-  n = ftruncate (fd, SIZE);
+  n = ftruncate (fd, size);
   if (n < 0) {
     ORC_WARNING("failed to expand file to size");
     close (fd);
@@ -272,23 +520,23 @@ orc_code_region_allocate_codemem_dual_map (OrcCodeRegion *region,
     return FALSE;
   }
 
-  region->exec_ptr = mmap (NULL, SIZE, exec_prot, MAP_SHARED, fd, 0);
+  region->exec_ptr = mmap (NULL, size, exec_prot, MAP_SHARED, fd, 0);
   if (region->exec_ptr == MAP_FAILED) {
     ORC_WARNING("failed to create exec map '%s'. err=%i", filename, errno);
     close (fd);
     free (filename);
     return FALSE;
   }
-  region->write_ptr = mmap (NULL, SIZE, PROT_READ|PROT_WRITE,
+  region->write_ptr = mmap (NULL, size, PROT_READ|PROT_WRITE,
       MAP_SHARED, fd, 0);
   if (region->write_ptr == MAP_FAILED) {
     ORC_WARNING ("failed to create write map '%s'. err=%i", filename, errno);
     free (filename);
-    munmap (region->exec_ptr, SIZE);
+    munmap (region->exec_ptr, size);
     close (fd);
     return FALSE;
   }
-  region->size = SIZE;
+  region->size = size;
 
   free (filename);
   close (fd);
@@ -304,40 +552,54 @@ orc_code_region_allocate_codemem_dual_map (OrcCodeRegion *region,
 #endif
 
 static int
-orc_code_region_allocate_codemem_anon_map (OrcCodeRegion *region)
+orc_code_region_allocate_codemem_anon_map (OrcCodeRegion *region, int size)
 {
-  region->exec_ptr = mmap (NULL, SIZE, PROT_READ|PROT_WRITE|PROT_EXEC,
+  region->exec_ptr = mmap (NULL, size, PROT_READ|PROT_WRITE|PROT_EXEC,
       MAP_PRIVATE|MAP_ANONYMOUS|MAP_JIT, -1, 0);
   if (region->exec_ptr == MAP_FAILED) {
     ORC_WARNING("failed to create write/exec map. err=%i", errno);
     return FALSE;
   }
   region->write_ptr = region->exec_ptr;
-  region->size = SIZE;
+  region->size = size;
   return TRUE;
 }
 
-int
-orc_code_region_allocate_codemem (OrcCodeRegion *region)
+/* Regions of the size of a huge page are worth backing with one */
+static void
+orc_code_region_advise_huge_pages (OrcCodeRegion *region)
+{
+#ifdef MADV_HUGEPAGE
+  if (region->size < ORC_CODE_REGION_MAX_SIZE)
+    return;
+
+  madvise (region->exec_ptr, region->size, MADV_HUGEPAGE);
+  if (region->write_ptr != region->exec_ptr)
+    madvise (region->write_ptr, region->size, MADV_HUGEPAGE);
+#endif
+}
+
+static int
+orc_code_region_allocate_codemem_mmap (OrcCodeRegion *region, int size)
 {
   const char *tmpdir;
 
   tmpdir = getenv ("XDG_RUNTIME_DIR");
   if (tmpdir && orc_code_region_allocate_codemem_dual_map (region,
-        tmpdir, FALSE)) return TRUE;
+        tmpdir, FALSE, size)) return TRUE;
 
   tmpdir = getenv ("HOME");
   if (tmpdir && orc_code_region_allocate_codemem_dual_map (region,
-        tmpdir, FALSE)) return TRUE;
+        tmpdir, FALSE, size)) return TRUE;
 
   tmpdir = getenv ("TMPDIR");
   if (tmpdir && orc_code_region_allocate_codemem_dual_map (region,
-        tmpdir, FALSE)) return TRUE;
+        tmpdir, FALSE, size)) return TRUE;
 
   if (orc_code_region_allocate_codemem_dual_map (region,
-        "/tmp", FALSE)) return TRUE;
+        "/tmp", FALSE, size)) return TRUE;
 
-  if (orc_code_region_allocate_codemem_anon_map (region)) return TRUE;
+  if (orc_code_region_allocate_codemem_anon_map (region, size)) return TRUE;
 
 #ifdef __APPLE__
   ORC_ERROR("Failed to create write and exec mmap regions.  This "
@@ -354,48 +616,77 @@ orc_code_region_allocate_codemem (OrcCodeRegion *region)
   return FALSE;
 }
 
+static int
+orc_code_region_allocate_codemem (OrcCodeRegion *region, int size)
+{
+  if (!orc_code_region_allocate_codemem_mmap (region, size))
+    return FALSE;
+
+  orc_code_region_advise_huge_pages (region);
+  return TRUE;
+}
+
+static void
+orc_code_region_free_codemem (OrcCodeRegion *region)
+{
+  munmap (region->exec_ptr, region->size);
+  if (region->write_ptr != region->exec_ptr)
+    munmap (region->write_ptr, region->size);
+}
+
 #endif
 
 #ifdef HAVE_CODEMEM_VIRTUALALLOC
-int
-orc_code_region_allocate_codemem (OrcCodeRegion *region)
+static int
+orc_code_region_allocate_codemem (OrcCodeRegion *region, int size)
 {
   /* On UWP, we can't allocate memory as executable from the start. We can only
    * set that later after compiling and copying the code over. This is a good
    * idea in general to avoid security issues, so we do it on win32 too. */
   void *write_ptr = NULL;
   char *msg = NULL;
-  write_ptr = _virtualalloc (NULL, SIZE, MEM_COMMIT, PAGE_READWRITE);
+  write_ptr = _virtualalloc (NULL, size, MEM_COMMIT, PAGE_READWRITE);
   if (!write_ptr) {
     FormatMessageA (FORMAT_MESSAGE_ALLOCATE_BUFFER |
         FORMAT_MESSAGE_IGNORE_INSERTS | FORMAT_MESSAGE_FROM_SYSTEM,
         NULL, GetLastError(), 0, (LPTSTR)&msg, 0, NULL);
     ORC_ERROR ("Couldn't allocate mapping on %p of size %d: %s", region,
-        SIZE, msg);
+        size, msg);
     LocalFree (msg);
     return FALSE;
   }
 
   region->write_ptr = write_ptr;
   region->exec_ptr = region->write_ptr;
-  region->size = SIZE;
+  region->size = size;
   return TRUE;
 }
+
+static void
+orc_code_region_free_codemem (OrcCodeRegion *region)
+{
+  VirtualFree (region->write_ptr, 0, MEM_RELEASE);
+}
 #endif
 
 #ifdef HAVE_CODEMEM_MALLOC
-int
-orc_code_region_allocate_codemem (OrcCodeRegion *region)
+static int
+orc_code_region_allocate_codemem (OrcCodeRegion *region, int size)
 {
   void *write_ptr;
-  write_ptr = malloc(SIZE);
+  write_ptr = malloc(size);
   if (!write_ptr)
     return FALSE;
 
   region->write_ptr = write_ptr;
   region->exec_ptr = region->write_ptr;
-  region->size = SIZE;
+  region->size = size;
   return TRUE;
 }
-#endif
 
+static void
+orc_code_region_free_codemem (OrcCodeRegion *region)
+{
+  free (region->write_ptr);
+}
+#endif
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include <stdarg.h>
 
 #ifdef __APPLE__
@@ -29,6 +30,7 @@
 #endif
 
 #include <orc/orcprogram.h>
+#include <orc/orccpu.h>
 #include <orc/orcdebug.h>
 #include <orc/orcinternal.h>
 #include <orc/orcutils-private.h>
@@ -103,17 +105,38 @@ typedef struct {
 static void orc_compiler_assign_rules (OrcCompiler *compiler);
 static void orc_compiler_global_reg_alloc (OrcCompiler *compiler);
 static void orc_compiler_rewrite_insns (OrcCompiler *compiler);
+static void orc_compiler_optimize_insns (OrcCompiler *compiler);
+static void orc_compiler_free_constant_vars (OrcCompiler *compiler);
 static void orc_compiler_rewrite_vars (OrcCompiler *compiler);
-static void orc_compiler_rewrite_vars2 (OrcCompiler *compiler);
+static void orc_compiler_mark_invariants (OrcCompiler *compiler);
+static void orc_compiler_schedule (OrcCompiler *compiler);
+static void orc_compiler_linear_scan (OrcCompiler *compiler);
 static int orc_compiler_dup_temporary (OrcCompiler *compiler, int var, int j);
 static int orc_compiler_new_temporary (OrcCompiler *compiler, int size);
 static void orc_compiler_check_sizes (OrcCompiler *compiler);
+static void orc_compiler_attach_stats (OrcProgram *program);
+static orc_bool orc_compiler_spill_var (OrcCompiler *compiler,
+    OrcCompiler *saved);
+static void orc_compiler_restore (OrcCompiler *compiler,
+    const OrcCompiler *saved);
 
 static char **_orc_compiler_flag_list;
 static orc_bool _orc_compiler_flag_backup;
 static orc_bool _orc_compiler_flag_emulate;
 static orc_bool _orc_compiler_flag_debug;
 static orc_bool _orc_compiler_flag_randomize;
+static orc_bool _orc_compiler_flag_stats;
+static orc_bool _orc_compiler_flag_noopt;
+
+/* The opcodes the compiler inserts, by size, found once by
+ * _orc_compiler_init_opcodes() */
+static OrcStaticOpcode *_orc_compiler_load_opcodes[4];
+static OrcStaticOpcode *_orc_compiler_loadp_opcodes[4];
+static OrcStaticOpcode *_orc_compiler_store_opcodes[4];
+static OrcStaticOpcode *_orc_compiler_copy_opcodes[4];
+/* The opcodes of the entries of orc_opcode_sys_get_rewrites() */
+static OrcStaticOpcode **_orc_compiler_rewrite_opcodes;
+static OrcStaticOpcode **_orc_compiler_rewrite_others;
 
 /* For Windows */
 int _orc_codemem_alignment;
@@ -158,6 +181,10 @@ _orc_compiler_init (void)
   _orc_compiler_flag_emulate = orc_compiler_flag_check ("emulate");
   _orc_compiler_flag_debug = orc_compiler_flag_check ("debug");
   _orc_compiler_flag_randomize = orc_compiler_flag_check ("randomize");
+  _orc_compiler_flag_stats = orc_compiler_flag_check ("stats");
+  _orc_compiler_flag_noopt = orc_compiler_flag_check ("noopt");
+
+  _orc_code_cache_init ();
 
 #ifdef HAVE_CODEMEM_VIRTUALALLOC
   GetNativeSystemInfo(&info);
@@ -206,9 +233,7 @@ _orc_compiler_init (void)
     OrcCodeRegion *region = orc_code_region_alloc();
     if (region) {
       can_jit = TRUE;
-      // FIXME: the file descriptor should be kept somewhere
-      // Currently the underlying mmap'd pages are leaked
-      free(region);
+      orc_code_region_free (region);
     } else {
       ORC_WARNING ("Unable to allocate executable pages: using backup code or emulation");
     }
@@ -221,6 +246,37 @@ _orc_compiler_init (void)
   }
 }
 
+/* Called once the opcodes are registered */
+void
+_orc_compiler_init_opcodes (void)
+{
+  static const char *sizes = "bwlq";
+  const OrcOpcodeRewrite *rewrites = orc_opcode_sys_get_rewrites ();
+  char name[8];
+  int n;
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    sprintf (name, "load%c", sizes[i]);
+    _orc_compiler_load_opcodes[i] = orc_opcode_find_by_name (name);
+    sprintf (name, "loadp%c", sizes[i]);
+    _orc_compiler_loadp_opcodes[i] = orc_opcode_find_by_name (name);
+    sprintf (name, "store%c", sizes[i]);
+    _orc_compiler_store_opcodes[i] = orc_opcode_find_by_name (name);
+    sprintf (name, "copy%c", sizes[i]);
+    _orc_compiler_copy_opcodes[i] = orc_opcode_find_by_name (name);
+  }
+
+  for (n = 0; rewrites[n].name; n++);
+  _orc_compiler_rewrite_opcodes = orc_malloc (sizeof (OrcStaticOpcode *) * n);
+  _orc_compiler_rewrite_others = orc_malloc (sizeof (OrcStaticOpcode *) * n);
+  for (i = 0; i < n; i++) {
+    _orc_compiler_rewrite_opcodes[i] = orc_opcode_find_by_name (rewrites[i].name);
+    _orc_compiler_rewrite_others[i] = rewrites[i].other ?
+        orc_opcode_find_by_name (rewrites[i].other) : NULL;
+  }
+}
+
 orc_bool
 orc_compiler_flag_check (const char *flag)
 {
@@ -234,7 +290,20 @@ orc_compiler_flag_check (const char *flag)
   return FALSE;
 }
 
-static int
+/* With ORC_CODE=stats, routes every call of the final code of @program
+ * through the counters. Without it nothing changes, so the calls cost
+ * the same as before. */
+static void
+orc_compiler_attach_stats (OrcProgram *program)
+{
+  if (!_orc_compiler_flag_stats || program->orccode == NULL)
+    return;
+
+  orc_code_stats_attach (program->orccode, program->name);
+  program->code_exec = program->orccode->exec;
+}
+
+int
 orc_compiler_allocate_register (OrcCompiler *compiler, int data_reg)
 {
   int i;
@@ -285,10 +354,235 @@ orc_compiler_allocate_register (OrcCompiler *compiler, int data_reg)
         data_reg ? "vector" : "gp");
     compiler->result = ORC_COMPILE_RESULT_UNKNOWN_COMPILE;
   }
+  if (data_reg && !compiler->reg_overflow) {
+    compiler->reg_overflow = TRUE;
+    compiler->overflow_insn = compiler->insn_index;
+  }
 
   return 0;
 }
 
+static orc_bool
+orc_compiler_is_invariant_var (const OrcCompiler *compiler, int var)
+{
+  int i;
+
+  for (i = 0; i < compiler->n_insns; i++) {
+    const OrcInstruction *insn = compiler->insns + i;
+
+    if ((insn->flags & ORC_INSN_FLAG_INVARIANT) &&
+        insn->dest_args[0] == var)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static int
+orc_compiler_count_spilled_args (const OrcCompiler *compiler,
+    const OrcInstruction *insn)
+{
+  const OrcStaticOpcode *opcode = insn->opcode;
+  int n = 0;
+  int k;
+
+  for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+    if (opcode->src_size[k] == 0) continue;
+    if (compiler->spill_slot[insn->src_args[k]]) n++;
+  }
+  for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+    if (opcode->dest_size[k] == 0) continue;
+    if (compiler->spill_slot[insn->dest_args[k]]) n++;
+  }
+
+  return n;
+}
+
+/* Sets aside one more vector register to access spilled variables,
+ * the highest one that does not need to be saved if possible */
+static orc_bool
+orc_compiler_reserve_spill_reg (OrcCompiler *compiler)
+{
+  int offset = compiler->target->data_register_offset;
+  int reg = 0;
+  int i;
+
+  for (i = ORC_N_REGS - 1; i >= offset; i--) {
+    if (!compiler->valid_regs[i]) continue;
+    if (!compiler->save_regs[i]) {
+      reg = i;
+      break;
+    }
+    if (reg == 0)
+      reg = i;
+  }
+  if (reg == 0 || compiler->n_spill_regs == ORC_N_SPILL_REGS)
+    return FALSE;
+
+  compiler->valid_regs[reg] = 0;
+  compiler->used_regs[reg] = 1;
+  compiler->spill_regs[compiler->n_spill_regs++] = reg;
+
+  return TRUE;
+}
+
+/* Called when the compilation ran out of vector registers. Picks the
+ * temporary that is cheapest to keep in memory and records it in @saved,
+ * the state of the compiler before the register allocation, together
+ * with the registers needed to access it. Variables live where the
+ * allocation failed are preferred, and among them the ones with the
+ * fewest uses for the length of their live range. Invariants are live
+ * during the whole loop, which usually makes them the first choice. */
+static orc_bool
+orc_compiler_spill_var (OrcCompiler *compiler, OrcCompiler *saved)
+{
+  int where = compiler->overflow_insn;
+  int best = -1;
+  int best_live = FALSE;
+  int best_uses = 0;
+  int best_range = 0;
+  int n_regs;
+  int i, j, k;
+
+  for (i = 0; i < saved->n_vars; i++) {
+    OrcVariable *var = saved->vars + i;
+    int uses = 0;
+    int range;
+    int live;
+
+    if (var->name == NULL) continue;
+    if (var->vartype != ORC_VAR_TYPE_TEMP) continue;
+    if (var->first_use == -1 || var->last_use == -1) continue;
+    if (saved->spill_slot[i]) continue;
+
+    for (j = 0; j < saved->n_insns; j++) {
+      OrcInstruction *insn = saved->insns + j;
+
+      for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+        if (insn->opcode->src_size[k] && insn->src_args[k] == i) uses++;
+      }
+    }
+
+    if (orc_compiler_is_invariant_var (saved, i)) {
+      range = saved->n_insns;
+      live = TRUE;
+    } else {
+      range = var->last_use - var->first_use + 1;
+      live = (where >= var->first_use && where <= var->last_use);
+    }
+
+    if (best != -1) {
+      if (best_live && !live) continue;
+      if (best_live == live) {
+        if (uses * best_range > best_uses * range) continue;
+        if (uses * best_range == best_uses * range && range <= best_range)
+          continue;
+      }
+    }
+    best = i;
+    best_live = live;
+    best_uses = uses;
+    best_range = range;
+  }
+
+  if (best == -1)
+    return FALSE;
+
+  saved->spill_slot[best] = ++saved->n_spill_slots;
+  ORC_INFO ("spilling %s to slot %d", saved->vars[best].name,
+      saved->n_spill_slots - 1);
+
+  n_regs = 0;
+  for (j = 0; j < saved->n_insns; j++) {
+    n_regs = MAX (n_regs,
+        orc_compiler_count_spilled_args (saved, saved->insns + j));
+  }
+  while (saved->n_spill_regs < n_regs) {
+    if (!orc_compiler_reserve_spill_reg (saved))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Copies the state of the compiler before the register allocation, with
+ * its own instructions and variables */
+static OrcCompiler *
+orc_compiler_save (const OrcCompiler *compiler)
+{
+  OrcCompiler *saved;
+
+  saved = orc_malloc (sizeof (OrcCompiler));
+  memcpy (saved, compiler, sizeof (OrcCompiler));
+
+  saved->insns = orc_malloc (sizeof (OrcInstruction) *
+      compiler->n_insns_alloc);
+  memcpy (saved->insns, compiler->insns,
+      sizeof (OrcInstruction) * compiler->n_insns_alloc);
+  saved->vars = orc_malloc (sizeof (OrcVariable) * compiler->n_vars);
+  memcpy (saved->vars, compiler->vars, sizeof (OrcVariable) * compiler->n_vars);
+  saved->spill_slot = orc_malloc (sizeof (int) * compiler->n_vars);
+  memcpy (saved->spill_slot, compiler->spill_slot,
+      sizeof (int) * compiler->n_vars);
+
+  return saved;
+}
+
+static void
+orc_compiler_free_saved (OrcCompiler *saved)
+{
+  if (saved == NULL)
+    return;
+
+  free (saved->insns);
+  free (saved->vars);
+  free (saved->spill_slot);
+  free (saved);
+}
+
+/* Puts the compiler back in the state it was before the register
+ * allocation, keeping the code buffer */
+static void
+orc_compiler_restore (OrcCompiler *compiler, const OrcCompiler *saved)
+{
+  char *asm_code = compiler->asm_code;
+  char *error_msg = compiler->error_msg;
+  void *output_insns = compiler->output_insns;
+  int n_output_insns_alloc = compiler->n_output_insns_alloc;
+  OrcInstruction *insns = compiler->insns;
+  OrcVariable *vars = compiler->vars;
+  int *spill_slot = compiler->spill_slot;
+  OrcFixup *fixups = compiler->fixups;
+  int n_fixups_alloc = compiler->n_fixups_alloc;
+
+  memcpy (compiler, saved, sizeof (OrcCompiler));
+
+  /* Nothing adds instructions or variables once the registers are
+   * allocated, the sizes did not change */
+  compiler->insns = insns;
+  memcpy (compiler->insns, saved->insns,
+      sizeof (OrcInstruction) * saved->n_insns_alloc);
+  compiler->vars = vars;
+  memcpy (compiler->vars, saved->vars, sizeof (OrcVariable) * saved->n_vars);
+  compiler->spill_slot = spill_slot;
+  memcpy (compiler->spill_slot, saved->spill_slot,
+      sizeof (int) * saved->n_vars);
+  compiler->fixups = fixups;
+  compiler->n_fixups_alloc = n_fixups_alloc;
+  compiler->n_fixups = 0;
+
+  compiler->codeptr = compiler->code;
+  compiler->asm_code = NULL;
+  compiler->asm_code_len = 0;
+  compiler->asm_code_alloc = 0;
+  compiler->output_insns = output_insns;
+  compiler->n_output_insns_alloc = n_output_insns_alloc;
+  compiler->n_output_insns = 0;
+
+  free (asm_code);
+  free (error_msg);
+}
+
 #if defined(HAVE_CODEMEM_VIRTUALALLOC)
 static orc_bool
 _set_virtual_protect (void * mem, size_t size, int code_protect)
@@ -342,6 +636,7 @@ orc_compiler_compile_program (OrcCompiler *compiler, OrcProgram *program, OrcTar
     free (program->asm_code);
     program->asm_code = NULL;
   }
+  program->target = NULL;
 
   if (program->backup_func) {
     program->code_exec = program->backup_func;
@@ -353,7 +648,12 @@ orc_compiler_compile_program (OrcCompiler *compiler, OrcProgram *program, OrcTar
   compiler->target = target;
   compiler->target_flags = flags;
 
-  {
+  /* The code for the CPU is run, its assembly code is created again when
+   * it is asked for */
+  if (target == NULL || !target->executable)
+    compiler->need_asm = TRUE;
+
+  if (orc_debug_get_level () >= ORC_DEBUG_LOG) {
     ORC_LOG("Program variables");
     for(i=0;i<ORC_N_VARIABLES;i++){
       if (program->vars[i].size > 0) {
@@ -377,16 +677,29 @@ orc_compiler_compile_program (OrcCompiler *compiler, OrcProgram *program, OrcTar
     }
   }
 
+  /* orc_compiler_rewrite_insns() adds at most a load for each source and
+   * a store for each destination, no pass adds instructions after it */
+  compiler->n_insns_alloc = MAX (1, program->n_insns *
+      (1 + ORC_STATIC_OPCODE_N_SRC + ORC_STATIC_OPCODE_N_DEST));
+  compiler->insns = orc_malloc (compiler->n_insns_alloc *
+      sizeof(OrcInstruction));
+  memset (compiler->insns, 0, compiler->n_insns_alloc *
+      sizeof(OrcInstruction));
   memcpy (compiler->insns, program->insns,
       program->n_insns * sizeof(OrcInstruction));
   compiler->n_insns = program->n_insns;
 
+  compiler->n_vars = ORC_N_COMPILER_VARIABLES;
+  compiler->vars = orc_malloc (compiler->n_vars * sizeof(OrcVariable));
   memcpy (compiler->vars, program->vars,
       ORC_N_VARIABLES * sizeof(OrcVariable));
   memset (compiler->vars + ORC_N_VARIABLES, 0,
-      (ORC_N_COMPILER_VARIABLES - ORC_N_VARIABLES) * sizeof(OrcVariable));
+      (compiler->n_vars - ORC_N_VARIABLES) * sizeof(OrcVariable));
+  compiler->spill_slot = orc_malloc (compiler->n_vars * sizeof(int));
+  memset (compiler->spill_slot, 0, compiler->n_vars * sizeof(int));
   compiler->n_temp_vars = program->n_temp_vars;
   compiler->n_dup_vars = 0;
+  compiler->n_partial_accs = 1;
 
   for(i=0;i<32;i++) {
     compiler->valid_regs[i] = 1;
@@ -406,10 +719,17 @@ orc_compiler_compile_program (OrcCompiler *compiler, OrcProgram *program, OrcTar
   orc_compiler_rewrite_insns (compiler);
   if (compiler->error) goto error;
 
+  if (!_orc_compiler_flag_noopt) {
+    orc_compiler_optimize_insns (compiler);
+  }
+
   orc_compiler_rewrite_vars (compiler);
   if (compiler->error) goto error;
 
-  {
+  orc_compiler_mark_invariants (compiler);
+  orc_compiler_schedule (compiler);
+
+  if (orc_debug_get_level () >= ORC_DEBUG_LOG) {
     ORC_LOG("Compiler variables");
     for(i=0;i<ORC_N_VARIABLES;i++){
       if (compiler->vars[i].size > 0) {
@@ -446,14 +766,15 @@ orc_compiler_compile_program (OrcCompiler *compiler, OrcProgram *program, OrcTar
   memcpy (program->orccode->insns, compiler->insns,
       sizeof(OrcInstruction) * compiler->n_insns);
 
-  program->orccode->vars = orc_malloc (sizeof(OrcCodeVariable) * ORC_N_COMPILER_VARIABLES);
+  program->orccode->vars = orc_malloc (sizeof(OrcCodeVariable) * compiler->n_vars);
   memset (program->orccode->vars, 0,
-      sizeof(OrcCodeVariable) * ORC_N_COMPILER_VARIABLES);
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+      sizeof(OrcCodeVariable) * compiler->n_vars);
+  for(i=0;i<compiler->n_vars;i++){
     program->orccode->vars[i].vartype = compiler->vars[i].vartype;
     program->orccode->vars[i].size = compiler->vars[i].size;
     program->orccode->vars[i].value = compiler->vars[i].value;
   }
+  orc_code_emulate_plan_init (program->orccode);
 
   if (program->backup_func && (_orc_compiler_flag_backup || target == NULL)) {
     ORC_COMPILER_ERROR (compiler, "Compilation disabled, using backup");
@@ -469,27 +790,52 @@ orc_compiler_compile_program (OrcCompiler *compiler, OrcProgram *program, OrcTar
     goto error;
   }
 
-  if (compiler->target) {
-    orc_compiler_global_reg_alloc (compiler);
+  ORC_INFO("allocating code memory");
+  /* The loop body can be emitted a few times and unrolled */
+  compiler->code_size = MAX (65536, compiler->n_insns * 1024);
+  compiler->code = orc_malloc(compiler->code_size);
+  compiler->codeptr = compiler->code;
 
-    orc_compiler_rewrite_vars2 (compiler);
-  }
-  if (compiler->error) goto error;
+  if (orc_code_cache_load (compiler)) {
+    ORC_INFO("using cached code for target \"%s\"", compiler->target->name);
+  } else {
+    OrcCompiler *saved = NULL;
 
-  orc_compiler_assign_rules (compiler);
-  if (compiler->error) goto error;
+    /* Targets that can spill start over from here with one more variable
+     * in memory each time they run out of vector registers */
+    if (compiler->target->load_spill)
+      saved = orc_compiler_save (compiler);
 
-  ORC_INFO("allocating code memory");
-  compiler->code = orc_malloc(65536);
-  compiler->codeptr = compiler->code;
+    while (TRUE) {
+      orc_compiler_global_reg_alloc (compiler);
 
-  if (compiler->error) goto error;
+      orc_compiler_linear_scan (compiler);
 
-  ORC_INFO("compiling for target \"%s\"", compiler->target->name);
-  compiler->target->compile (compiler);
-  if (compiler->error) {
-    compiler->result = ORC_COMPILE_RESULT_UNKNOWN_COMPILE;
-    goto error;
+      if (!compiler->error)
+        orc_compiler_assign_rules (compiler);
+
+      if (!compiler->error) {
+        ORC_INFO("compiling for target \"%s\"", compiler->target->name);
+        compiler->target->compile (compiler);
+        if (compiler->error) {
+          compiler->result = ORC_COMPILE_RESULT_UNKNOWN_COMPILE;
+        }
+      }
+
+      if (!compiler->error || saved == NULL || !compiler->reg_overflow)
+        break;
+      /* The partial accumulators are given up before any variable */
+      if (saved->n_partial_accs > 1) {
+        saved->n_partial_accs = 1;
+      } else if (!orc_compiler_spill_var (compiler, saved)) {
+        break;
+      }
+      orc_compiler_restore (compiler, saved);
+    }
+    orc_compiler_free_saved (saved);
+    if (compiler->error) goto error;
+
+    orc_code_cache_store (compiler);
   }
 
 #if defined(_WIN64) && defined(ORC_SUPPORTS_BACKTRACE_FROM_JIT)
@@ -666,10 +1012,14 @@ orc_compiler_compile_program (OrcCompiler *compiler, OrcProgram *program, OrcTar
    program->orccode->exec = (void *)orc_executor_emulate;
 #endif
   program->code_exec = program->orccode->exec;
+  orc_compiler_attach_stats (program);
 
   program->asm_code = compiler->asm_code;
+  program->target = target;
+  program->target_flags = flags;
 
   result = compiler->result;
+  orc_compiler_free_constant_vars (compiler);
   for (i=0;i<compiler->n_dup_vars;i++){
     free(compiler->vars[ORC_VAR_T1 + compiler->n_temp_vars + i].name);
     compiler->vars[ORC_VAR_T1 + compiler->n_temp_vars + i].name = NULL;
@@ -677,6 +1027,10 @@ orc_compiler_compile_program (OrcCompiler *compiler, OrcProgram *program, OrcTar
   free (compiler->code);
   compiler->code = NULL;
   if (compiler->output_insns) free (compiler->output_insns);
+  free (compiler->insns);
+  free (compiler->vars);
+  free (compiler->spill_slot);
+  free (compiler->fixups);
   free (compiler);
   ORC_INFO("finished compiling (success)");
 
@@ -691,6 +1045,7 @@ error:
         program->name, compiler->result);
   }
   result = compiler->result;
+  orc_compiler_attach_stats (program);
   orc_program_set_error (program, compiler->error_msg);
   free (compiler->error_msg);
   if (result == 0) {
@@ -700,6 +1055,7 @@ error:
     free (compiler->asm_code);
     compiler->asm_code = NULL;
   }
+  orc_compiler_free_constant_vars (compiler);
   for (i=0;i<compiler->n_dup_vars;i++){
     free(compiler->vars[ORC_VAR_T1 + compiler->n_temp_vars + i].name);
     compiler->vars[ORC_VAR_T1 + compiler->n_temp_vars + i].name = NULL;
@@ -707,11 +1063,48 @@ error:
   free (compiler->code);
   compiler->code = NULL;
   if (compiler->output_insns) free (compiler->output_insns);
+  free (compiler->insns);
+  free (compiler->vars);
+  free (compiler->spill_slot);
+  free (compiler->fixups);
   free (compiler);
   ORC_INFO("finished compiling (fail)");
   return result;
 }
 
+/* Compiles a copy of @program for the target of its last compilation,
+ * only keeping the assembly code. The program itself only gets the
+ * assembly code, its code can be running in another thread. */
+void
+orc_compiler_create_asm_code (OrcProgram *program)
+{
+  OrcCompiler *compiler;
+  OrcProgram *copy;
+  char *asm_code;
+
+  copy = orc_program_dup (program);
+
+  compiler = orc_malloc (sizeof(OrcCompiler));
+  memset (compiler, 0, sizeof(OrcCompiler));
+  compiler->need_asm = TRUE;
+  orc_compiler_compile_program (compiler, copy, program->target,
+      program->target_flags);
+
+  asm_code = copy->asm_code;
+  copy->asm_code = NULL;
+  orc_program_free (copy);
+
+  /* Another thread may have created it meanwhile */
+  orc_global_mutex_lock ();
+  if (program->asm_code == NULL) {
+    program->asm_code = asm_code;
+    asm_code = NULL;
+  }
+  orc_global_mutex_unlock ();
+
+  free (asm_code);
+}
+
 static void
 orc_compiler_check_sizes (OrcCompiler *compiler)
 {
@@ -828,13 +1221,13 @@ get_load_opcode_for_size (int size)
 {
   switch (size) {
     case 1:
-      return orc_opcode_find_by_name ("loadb");
+      return _orc_compiler_load_opcodes[0];
     case 2:
-      return orc_opcode_find_by_name ("loadw");
+      return _orc_compiler_load_opcodes[1];
     case 4:
-      return orc_opcode_find_by_name ("loadl");
+      return _orc_compiler_load_opcodes[2];
     case 8:
-      return orc_opcode_find_by_name ("loadq");
+      return _orc_compiler_load_opcodes[3];
     default:
       ORC_ASSERT(0);
   }
@@ -846,13 +1239,13 @@ get_loadp_opcode_for_size (int size)
 {
   switch (size) {
     case 1:
-      return orc_opcode_find_by_name ("loadpb");
+      return _orc_compiler_loadp_opcodes[0];
     case 2:
-      return orc_opcode_find_by_name ("loadpw");
+      return _orc_compiler_loadp_opcodes[1];
     case 4:
-      return orc_opcode_find_by_name ("loadpl");
+      return _orc_compiler_loadp_opcodes[2];
     case 8:
-      return orc_opcode_find_by_name ("loadpq");
+      return _orc_compiler_loadp_opcodes[3];
     default:
       ORC_ASSERT(0);
   }
@@ -864,13 +1257,31 @@ get_store_opcode_for_size (int size)
 {
   switch (size) {
     case 1:
-      return orc_opcode_find_by_name ("storeb");
+      return _orc_compiler_store_opcodes[0];
+    case 2:
+      return _orc_compiler_store_opcodes[1];
+    case 4:
+      return _orc_compiler_store_opcodes[2];
+    case 8:
+      return _orc_compiler_store_opcodes[3];
+    default:
+      ORC_ASSERT(0);
+  }
+  return NULL;
+}
+
+static OrcStaticOpcode *
+get_copy_opcode_for_size (int size)
+{
+  switch (size) {
+    case 1:
+      return _orc_compiler_copy_opcodes[0];
     case 2:
-      return orc_opcode_find_by_name ("storew");
+      return _orc_compiler_copy_opcodes[1];
     case 4:
-      return orc_opcode_find_by_name ("storel");
+      return _orc_compiler_copy_opcodes[2];
     case 8:
-      return orc_opcode_find_by_name ("storeq");
+      return _orc_compiler_copy_opcodes[3];
     default:
       ORC_ASSERT(0);
   }
@@ -933,7 +1344,7 @@ orc_compiler_rewrite_insns (OrcCompiler *compiler)
           }
 
           loaded = -1;
-          for(l=0;l<ORC_N_COMPILER_VARIABLES;l++){
+          for(l=0;l<compiler->n_vars;l++){
             if (compiler->vars[l].name == NULL) continue;
             if (!compiler->vars[l].has_parameter) continue;
             if (compiler->vars[l].parameter != insn.src_args[i]) continue;
@@ -953,7 +1364,8 @@ orc_compiler_rewrite_insns (OrcCompiler *compiler)
           cinsn->opcode = get_loadp_opcode_for_size (opcode->src_size[i]);
           cinsn->dest_args[0] = orc_compiler_new_temporary (compiler,
               opcode->src_size[i] * multiplier);
-          if (var->vartype == ORC_VAR_TYPE_CONST) {
+          if (compiler->vars[insn.src_args[i]].vartype ==
+              ORC_VAR_TYPE_CONST) {
             compiler->vars[cinsn->dest_args[0]].flags |=
                 ORC_VAR_FLAG_VOLATILE_WORKAROUND;
           }
@@ -996,110 +1408,751 @@ orc_compiler_rewrite_insns (OrcCompiler *compiler)
   }
 }
 
-static void
-orc_compiler_assign_rules (OrcCompiler *compiler)
+typedef struct _OrcValueEntry OrcValueEntry;
+struct _OrcValueEntry {
+  OrcStaticOpcode *opcode;
+  int flags;
+  int src_args[ORC_STATIC_OPCODE_N_SRC];
+  int src_versions[ORC_STATIC_OPCODE_N_SRC];
+  int epoch;
+  int var;
+  int version;
+};
+
+typedef struct _OrcOptimizer OrcOptimizer;
+struct _OrcOptimizer {
+  /* One entry for each variable */
+  int *version;
+
+  /* The instruction that wrote a variable, valid while the version of the
+   * variable is def_version */
+  OrcInstruction *def;
+  int *def_version;
+  int *def_src_version;
+
+  int *alias;
+  int *alias_version;
+  int *alias_src_version;
+
+  /* One entry for each instruction */
+  OrcValueEntry *entries;
+  int n_entries;
+  /* Bumped by every store, loads are not merged across it */
+  int epoch;
+};
+
+static OrcOptimizer *
+orc_optimizer_new (int n_insns, int n_vars)
 {
+  OrcOptimizer *opt;
+  size_t size;
+  int *p;
   int i;
 
-  for(i=0;i<compiler->n_insns;i++) {
-    OrcInstruction *insn = compiler->insns + i;
+  size = sizeof (OrcOptimizer) + sizeof (OrcInstruction) * n_vars +
+      sizeof (OrcValueEntry) * n_insns + sizeof (int) * 6 * n_vars;
+  opt = orc_malloc (size);
+  memset (opt, 0, size);
+
+  opt->def = (OrcInstruction *) (opt + 1);
+  opt->entries = (OrcValueEntry *) (opt->def + n_vars);
+  p = (int *) (opt->entries + n_insns);
+  opt->version = p; p += n_vars;
+  opt->def_version = p; p += n_vars;
+  opt->def_src_version = p; p += n_vars;
+  opt->alias = p; p += n_vars;
+  opt->alias_version = p; p += n_vars;
+  opt->alias_src_version = p;
+
+  for (i = 0; i < n_vars; i++)
+    opt->alias[i] = -1;
+
+  return opt;
+}
 
-    insn->rule = orc_target_get_rule (compiler->target, insn->opcode,
-        compiler->target_flags);
+static orc_bool
+orc_compiler_has_rule (OrcCompiler *compiler, OrcStaticOpcode *opcode)
+{
+  OrcRule *rule;
 
-    if (insn->rule == NULL || insn->rule->emit == NULL) {
-      ORC_COMPILER_ERROR (compiler, "no code generation rule for %s on "
-          "target %s", insn->opcode->name, compiler->target->name);
-      compiler->result = ORC_COMPILE_RESULT_UNKNOWN_COMPILE;
-      return;
-    }
+  if (opcode == NULL) return FALSE;
+  if (compiler->target == NULL) return TRUE;
+
+  rule = orc_target_get_rule (compiler->target, opcode,
+      compiler->target_flags);
+  return rule != NULL && rule->emit != NULL;
+}
+
+static orc_int64
+orc_optimizer_lane_value (orc_int64 value, int size)
+{
+  switch (size) {
+    case 1:
+      return (orc_int8) value;
+    case 2:
+      return (orc_int16) value;
+    case 4:
+      return (orc_int32) value;
+    default:
+      return value;
   }
 }
 
-int
-orc_compiler_get_temp_reg (OrcCompiler *compiler)
+static void
+orc_optimizer_store_lane (orc_union64 *lane, int size, orc_int64 value)
 {
-  int j;
+  switch (size) {
+    case 1:
+      lane->x8[0] = value;
+      break;
+    case 2:
+      lane->x4[0] = value;
+      break;
+    case 4:
+      lane->x2[0] = value;
+      break;
+    default:
+      lane->i = value;
+      break;
+  }
+}
 
-  ORC_DEBUG("at insn %d %s", compiler->insn_index,
-      compiler->insns[compiler->insn_index].opcode->name);
+static orc_int64
+orc_optimizer_load_lane (const orc_union64 *lane, int size)
+{
+  switch (size) {
+    case 1:
+      return lane->x8[0];
+    case 2:
+      return lane->x4[0];
+    case 4:
+      return lane->x2[0];
+    default:
+      return lane->i;
+  }
+}
 
-  /* Mark old temp registers as unused */
-  for(j=0;j<ORC_N_REGS;j++){
-    compiler->alloc_regs[j] = compiler->temp_regs[j];
+/* Gets the value of the lanes of size @size of @var, if it is known */
+static orc_bool
+orc_optimizer_get_constant (OrcCompiler *compiler, OrcOptimizer *opt,
+    int var, int size, orc_int64 *value)
+{
+  OrcInstruction *def = opt->def + var;
+  int src;
+
+  if (compiler->vars[var].vartype == ORC_VAR_TYPE_CONST) {
+    *value = orc_optimizer_lane_value (compiler->vars[var].value.i, size);
+    return TRUE;
   }
+  if (compiler->vars[var].vartype != ORC_VAR_TYPE_TEMP ||
+      def->opcode == NULL || opt->def_version[var] != opt->version[var])
+    return FALSE;
+  if (!(def->opcode->flags & ORC_STATIC_OPCODE_INVARIANT))
+    return FALSE;
 
-  /* Mark variables using a temp register as used */
-  for(j=0;j<ORC_N_COMPILER_VARIABLES;j++){
-    if (!compiler->vars[j].alloc) continue;
+  src = def->src_args[0];
+  if (compiler->vars[src].vartype != ORC_VAR_TYPE_CONST ||
+      def->opcode->dest_size[0] != size)
+    return FALSE;
 
-    ORC_DEBUG("var %d: %d  %d %d", j, compiler->vars[j].alloc,
-        compiler->vars[j].first_use,
-        compiler->vars[j].last_use);
+  *value = orc_optimizer_lane_value (compiler->vars[src].value.i, size);
+  return TRUE;
+}
 
-    if (compiler->vars[j].first_use == -1) {
-      compiler->alloc_regs[compiler->vars[j].alloc] = 1;
-    } else if (compiler->vars[j].first_use <= compiler->insn_index &&
-        compiler->vars[j].last_use >= compiler->insn_index) {
-      compiler->alloc_regs[compiler->vars[j].alloc] = 1;
-    }
-  }
+/* Finds or adds a constant, returns -1 if all the slots are taken */
+static int
+orc_compiler_get_constant_var (OrcCompiler *compiler, int size,
+    orc_int64 value)
+{
+  int i;
 
-  /* Mark constants using a temp register as used */
-  for(j=0;j<compiler->n_constants;j++){
-    if (compiler->constants[j].alloc_reg) {
-      compiler->alloc_regs[compiler->constants[j].alloc_reg] = 1;
-    }
-  }
+  for(i=ORC_VAR_C1;i<ORC_VAR_C1+ORC_MAX_CONST_VARS;i++){
+    OrcVariable *var = compiler->vars + i;
 
-  for (j = compiler->min_temp_reg; j < ORC_N_REGS; j++) {
-    if (compiler->valid_regs[j] && !compiler->alloc_regs[j]) {
-      ORC_DEBUG("Available register %d found", j);
-      compiler->temp_regs[j] = 1;
-      return j;
-    }
+    if (var->vartype == ORC_VAR_TYPE_CONST && var->size == size &&
+        var->value.i == value)
+      return i;
   }
 
-  ORC_ERROR("No temporary register available at insn %d %s",
-      compiler->insn_index,
-      compiler->insns[compiler->insn_index].opcode->name);
-  ORC_COMPILER_ERROR (compiler, "no temporary register available");
-  compiler->result = ORC_COMPILE_RESULT_UNKNOWN_COMPILE;
+  for(i=ORC_VAR_C1;i<ORC_VAR_C1+ORC_MAX_CONST_VARS;i++){
+    OrcVariable *var = compiler->vars + i;
 
-  return 0;
-}
+    if (var->size != 0 || var->name != NULL) continue;
 
-void
-orc_compiler_release_temp_reg (OrcCompiler *compiler, int reg)
-{
-  ORC_DEBUG("Releasing register %d", reg);
-  compiler->temp_regs[reg] = 0;
+    var->vartype = ORC_VAR_TYPE_CONST;
+    var->size = size;
+    var->value.i = value;
+    var->name = orc_malloc (16);
+    sprintf (var->name, "cfold%d", i - ORC_VAR_C1 + 1);
+    return i;
+  }
+
+  return -1;
 }
 
-void
-orc_compiler_reset_temp_regs (OrcCompiler *compiler, int start)
+static void
+orc_compiler_free_constant_vars (OrcCompiler *compiler)
 {
   int i;
 
-  for (i = compiler->min_temp_reg; i < ORC_N_REGS; i++)
-    compiler->temp_regs[i] = 0;
-  compiler->min_temp_reg = start;
+  for(i=ORC_VAR_C1;i<ORC_VAR_C1+ORC_MAX_CONST_VARS;i++){
+    if (compiler->vars[i].name == compiler->program->vars[i].name) continue;
+    free (compiler->vars[i].name);
+    compiler->vars[i].name = NULL;
+  }
 }
 
-static void
-orc_compiler_rewrite_vars (OrcCompiler *compiler)
+static orc_bool
+orc_compiler_make_copy (OrcCompiler *compiler, OrcInstruction *insn, int src)
 {
-  int j;
-  int k;
-  OrcInstruction *insn;
-  OrcStaticOpcode *opcode;
-  int var;
-  int actual_var;
+  int size = compiler->vars[insn->dest_args[0]].size;
+  OrcStaticOpcode *copy;
+
+  if (compiler->vars[src].size != size) return FALSE;
+
+  copy = get_copy_opcode_for_size (size);
+  if (!orc_compiler_has_rule (compiler, copy)) return FALSE;
+
+  insn->opcode = copy;
+  insn->flags &= ~(ORC_INSTRUCTION_FLAG_X2|ORC_INSTRUCTION_FLAG_X4);
+  insn->src_args[0] = src;
+  return TRUE;
+}
+
+static orc_bool
+orc_compiler_is_pure_insn (OrcCompiler *compiler, OrcInstruction *insn)
+{
+  OrcStaticOpcode *opcode = insn->opcode;
+
+  if (opcode->flags & (ORC_STATIC_OPCODE_ACCUMULATOR |
+        ORC_STATIC_OPCODE_STORE))
+    return FALSE;
+  /* loadupdb and the resampling loads move their source pointer */
+  if ((opcode->flags & ORC_STATIC_OPCODE_LOAD) &&
+      !(opcode->flags & ORC_STATIC_OPCODE_INVARIANT) &&
+      opcode != get_load_opcode_for_size (opcode->dest_size[0]))
+    return FALSE;
+  if (opcode->dest_size[1] != 0)
+    return FALSE;
+  if (compiler->vars[insn->dest_args[0]].vartype != ORC_VAR_TYPE_TEMP)
+    return FALSE;
+
+  return TRUE;
+}
+
+/* Computes an instruction whose sources are all constants through its
+ * emulation function and turns it into a load of the result */
+static orc_bool
+orc_compiler_fold_insn (OrcCompiler *compiler, OrcOptimizer *opt,
+    OrcInstruction *insn, int j)
+{
+  OrcStaticOpcode *opcode = insn->opcode;
+  OrcStaticOpcode *loadp;
+  OrcOpcodeExecutor ex;
+  orc_union64 src[ORC_STATIC_OPCODE_N_SRC];
+  orc_union64 dest;
+  orc_int64 value;
+  int size = opcode->dest_size[0];
+  int i;
+  int var;
+
+  if (opcode->emulateN == NULL) return FALSE;
+
+  memset (&ex, 0, sizeof(ex));
+  for(i=0;i<ORC_STATIC_OPCODE_N_SRC;i++){
+    OrcVariable *v = compiler->vars + insn->src_args[i];
+
+    if (opcode->src_size[i] == 0) continue;
+
+    if (v->vartype == ORC_VAR_TYPE_CONST) {
+      /* Scalar operands are read as 64-bit values */
+      src[i].i = v->value.i;
+    } else if (orc_optimizer_get_constant (compiler, opt, insn->src_args[i],
+          opcode->src_size[i], &value)) {
+      src[i].i = 0;
+      orc_optimizer_store_lane (src + i, opcode->src_size[i], value);
+    } else {
+      return FALSE;
+    }
+    ex.src_ptrs[i] = src + i;
+  }
+
+  dest.i = 0;
+  ex.dest_ptrs[0] = &dest;
+  opcode->emulateN (&ex, 0, 1);
+  value = orc_optimizer_load_lane (&dest, size);
+
+  loadp = get_loadp_opcode_for_size (size);
+  if (!orc_compiler_has_rule (compiler, loadp)) return FALSE;
+  var = orc_compiler_get_constant_var (compiler, size, value);
+  if (var < 0) return FALSE;
+
+  ORC_LOG("insn %d %s: folded to %" PRId64, j, opcode->name, value);
+  insn->opcode = loadp;
+  insn->src_args[0] = var;
+  compiler->vars[insn->dest_args[0]].flags |= ORC_VAR_FLAG_VOLATILE_WORKAROUND;
+  return TRUE;
+}
+
+static orc_bool
+orc_compiler_rewrite_to_shift (OrcCompiler *compiler, OrcInstruction *insn,
+    const char *name, int src, int shift)
+{
+  OrcStaticOpcode *opcode = orc_opcode_find_by_name (name);
+  int var;
+
+  if (!orc_compiler_has_rule (compiler, opcode)) return FALSE;
+  var = orc_compiler_get_constant_var (compiler, opcode->src_size[1], shift);
+  if (var < 0) return FALSE;
+
+  insn->opcode = opcode;
+  insn->src_args[0] = src;
+  insn->src_args[1] = var;
+  return TRUE;
+}
+
+/* Applies the table of orc_opcode_sys_get_rewrites() */
+static orc_bool
+orc_compiler_simplify_insn (OrcCompiler *compiler, OrcOptimizer *opt,
+    OrcInstruction *insn, int j)
+{
+  const OrcOpcodeRewrite *rewrites = orc_opcode_sys_get_rewrites ();
+  const OrcOpcodeRewrite *rewrite;
+  OrcStaticOpcode *opcode = insn->opcode;
+  int flags = insn->flags & (ORC_INSTRUCTION_FLAG_X2|ORC_INSTRUCTION_FLAG_X4);
+  int n_operands;
+  int i;
+
+  if (orc_compiler_fold_insn (compiler, opt, insn, j))
+    return TRUE;
+
+  n_operands = (opcode->flags & ORC_STATIC_OPCODE_COMMUTATIVE) ? 2 : 1;
+
+  for(rewrite=rewrites;rewrite->name;rewrite++){
+    int r = rewrite - rewrites;
+
+    if (_orc_compiler_rewrite_opcodes[r] != opcode) continue;
+
+    if (rewrite->type == ORC_OPCODE_REWRITE_INVERSE) {
+      int var = insn->src_args[0];
+      OrcInstruction *def = opt->def + var;
+
+      if (def->opcode == NULL || opt->def_version[var] != opt->version[var])
+        continue;
+      if (def->opcode != _orc_compiler_rewrite_others[r]) continue;
+      if ((def->flags & (ORC_INSTRUCTION_FLAG_X2|ORC_INSTRUCTION_FLAG_X4)) !=
+          flags)
+        continue;
+      if (opt->version[def->src_args[0]] != opt->def_src_version[var])
+        continue;
+
+      if (orc_compiler_make_copy (compiler, insn, def->src_args[0])) {
+        ORC_LOG("insn %d %s: undoes %s", j, opcode->name, def->opcode->name);
+        return TRUE;
+      }
+      continue;
+    }
+
+    /* The constant is the second operand, or either one */
+    for(i=0;i<n_operands;i++){
+      int src = insn->src_args[i];
+      int bits = opcode->src_size[1 - i] * 8;
+      orc_int64 value;
+      orc_uint64 lane;
+      int k;
+
+      if (!orc_optimizer_get_constant (compiler, opt, insn->src_args[1 - i],
+            opcode->src_size[1 - i], &value))
+        continue;
+
+      if (rewrite->type == ORC_OPCODE_REWRITE_IDENTITY) {
+        if (value != orc_optimizer_lane_value (rewrite->value,
+              opcode->src_size[1 - i]))
+          continue;
+        if (orc_compiler_make_copy (compiler, insn, src)) {
+          ORC_LOG("insn %d %s: operand %d is an identity", j, opcode->name,
+              1 - i);
+          return TRUE;
+        }
+        continue;
+      }
+
+      /* Power of two, 2^k */
+      lane = value;
+      if (bits < 64) lane &= ((orc_uint64) 1 << bits) - 1;
+      for(k=1;k<bits;k++){
+        if (lane == (orc_uint64) 1 << k) break;
+      }
+      if (k == bits) continue;
+      if (rewrite->type == ORC_OPCODE_REWRITE_MULHS_SHIFT && k == bits - 1)
+        continue;
+
+      if (rewrite->type != ORC_OPCODE_REWRITE_MUL_SHIFT) {
+        k = bits - k;
+      }
+      if (orc_compiler_rewrite_to_shift (compiler, insn, rewrite->other, src,
+            k)) {
+        ORC_LOG("insn %d %s: replaced by %s %d", j, opcode->name,
+            rewrite->other, k);
+        return TRUE;
+      }
+    }
+  }
+
+  return FALSE;
+}
+
+static orc_bool
+orc_compiler_value_matches (OrcCompiler *compiler, OrcOptimizer *opt,
+    OrcValueEntry *entry, OrcInstruction *insn)
+{
+  OrcStaticOpcode *opcode = insn->opcode;
+  int flags = insn->flags & (ORC_INSTRUCTION_FLAG_X2|ORC_INSTRUCTION_FLAG_X4);
+  int i;
+
+  if (entry->opcode != opcode || entry->flags != flags) return FALSE;
+  if ((opcode->flags & ORC_STATIC_OPCODE_LOAD) &&
+      !(opcode->flags & ORC_STATIC_OPCODE_INVARIANT) &&
+      entry->epoch != opt->epoch)
+    return FALSE;
+  if (opt->version[entry->var] != entry->version) return FALSE;
+
+  for(i=0;i<ORC_STATIC_OPCODE_N_SRC;i++){
+    if (opcode->src_size[i] == 0) continue;
+    if (opt->version[entry->src_args[i]] != entry->src_versions[i])
+      return FALSE;
+  }
+
+  for(i=0;i<ORC_STATIC_OPCODE_N_SRC;i++){
+    if (opcode->src_size[i] == 0) continue;
+    if (entry->src_args[i] != insn->src_args[i]) break;
+  }
+  if (i == ORC_STATIC_OPCODE_N_SRC) return TRUE;
+
+  if ((opcode->flags & ORC_STATIC_OPCODE_COMMUTATIVE) &&
+      entry->src_args[0] == insn->src_args[1] &&
+      entry->src_args[1] == insn->src_args[0])
+    return TRUE;
+
+  return FALSE;
+}
+
+/* Removes redundant instructions from the output of
+ * orc_compiler_rewrite_insns(). Temporaries may be written several
+ * times, so every variable carries a version that is bumped on each
+ * write, and a value or a copy is only reused while the versions it was
+ * computed from are current.
+ *
+ * The forward pass replaces the sources that are copies of another
+ * variable by that variable, folds constants, applies the algebraic
+ * rewrites of orc_opcode_sys_get_rewrites(), and turns instructions that
+ * compute a value already held in a variable into copies of it. The
+ * backward pass then removes the instructions whose results are never
+ * used, which includes the copies that were propagated. */
+static void
+orc_compiler_optimize_insns (OrcCompiler *compiler)
+{
+  OrcOptimizer *opt;
+  orc_bool *live;
+  orc_bool *removed;
+  OrcStaticOpcode **orig_opcode;
+  const char **reason;
+  int i, j, k;
+
+  opt = orc_optimizer_new (compiler->n_insns, compiler->n_vars);
+  live = orc_malloc (sizeof(orc_bool) * compiler->n_vars);
+  memset (live, 0, sizeof(orc_bool) * compiler->n_vars);
+  removed = orc_malloc (sizeof(orc_bool) * compiler->n_insns);
+  orig_opcode = orc_malloc (sizeof(OrcStaticOpcode *) * compiler->n_insns);
+  reason = orc_malloc (sizeof(const char *) * compiler->n_insns);
 
-  for(j=0;j<ORC_N_COMPILER_VARIABLES;j++){
-    if (compiler->vars[j].alloc) continue;
-    compiler->vars[j].last_use = -1;
-  }
+  for(j=0;j<compiler->n_insns;j++){
+    OrcInstruction *insn = compiler->insns + j;
+    OrcStaticOpcode *opcode = insn->opcode;
+    int src_versions[ORC_STATIC_OPCODE_N_SRC];
+
+    orig_opcode[j] = opcode;
+    reason[j] = "dead";
+    removed[j] = FALSE;
+
+    for(i=0;i<ORC_STATIC_OPCODE_N_SRC;i++){
+      int var = insn->src_args[i];
+      int alias = opt->alias[var];
+
+      if (opcode->src_size[i] == 0) continue;
+      if (alias >= 0 && opt->version[var] == opt->alias_version[var] &&
+          opt->version[alias] == opt->alias_src_version[var]) {
+        ORC_LOG("insn %d %s: using %s instead of its copy %s", j,
+            opcode->name, compiler->vars[alias].name,
+            compiler->vars[var].name);
+        insn->src_args[i] = alias;
+      }
+    }
+
+    if (orc_compiler_is_pure_insn (compiler, insn) &&
+        !(opcode->flags & (ORC_STATIC_OPCODE_COPY | ORC_STATIC_OPCODE_LOAD))) {
+      if (orc_compiler_simplify_insn (compiler, opt, insn, j)) {
+        reason[j] = "simplified";
+        opcode = insn->opcode;
+      }
+    }
+
+    if (orc_compiler_is_pure_insn (compiler, insn) &&
+        !(opcode->flags & ORC_STATIC_OPCODE_COPY)) {
+      for(k=0;k<opt->n_entries;k++){
+        if (orc_compiler_value_matches (compiler, opt, opt->entries + k,
+              insn))
+          break;
+      }
+      if (k < opt->n_entries &&
+          orc_compiler_make_copy (compiler, insn, opt->entries[k].var)) {
+        ORC_LOG("insn %d %s: value already computed into %s", j,
+            opcode->name, compiler->vars[opt->entries[k].var].name);
+        reason[j] = "cse";
+      } else {
+        OrcValueEntry *entry = opt->entries + opt->n_entries;
+
+        opt->n_entries++;
+        entry->opcode = opcode;
+        entry->flags = insn->flags &
+            (ORC_INSTRUCTION_FLAG_X2|ORC_INSTRUCTION_FLAG_X4);
+        for(i=0;i<ORC_STATIC_OPCODE_N_SRC;i++){
+          entry->src_args[i] = insn->src_args[i];
+          entry->src_versions[i] = opt->version[insn->src_args[i]];
+        }
+        entry->epoch = opt->epoch;
+        entry->var = insn->dest_args[0];
+        entry->version = opt->version[insn->dest_args[0]] + 1;
+      }
+    } else if (opcode->flags & ORC_STATIC_OPCODE_COPY) {
+      reason[j] = "copy";
+    }
+    opcode = insn->opcode;
+
+    if ((opcode->flags & ORC_STATIC_OPCODE_COPY) &&
+        insn->dest_args[0] == insn->src_args[0]) {
+      /* Nothing changes, not even the version */
+      ORC_LOG("removed insn %d %s (%s)", j, orig_opcode[j]->name, reason[j]);
+      removed[j] = TRUE;
+      continue;
+    }
+
+    if (opcode->flags & ORC_STATIC_OPCODE_STORE) {
+      opt->epoch++;
+    }
+
+    for(i=0;i<ORC_STATIC_OPCODE_N_SRC;i++){
+      src_versions[i] = opt->version[insn->src_args[i]];
+    }
+    for(i=0;i<ORC_STATIC_OPCODE_N_DEST;i++){
+      int var = insn->dest_args[i];
+
+      if (opcode->dest_size[i] == 0) continue;
+      opt->version[var]++;
+      memcpy (opt->def + var, insn, sizeof(OrcInstruction));
+      opt->def_version[var] = opt->version[var];
+      opt->def_src_version[var] = src_versions[0];
+    }
+
+    if (opcode->flags & ORC_STATIC_OPCODE_COPY) {
+      int dest = insn->dest_args[0];
+      int src = insn->src_args[0];
+
+      if (compiler->vars[dest].vartype == ORC_VAR_TYPE_TEMP &&
+          compiler->vars[src].vartype == ORC_VAR_TYPE_TEMP &&
+          compiler->vars[dest].size == compiler->vars[src].size) {
+        opt->alias[dest] = src;
+        opt->alias_version[dest] = opt->version[dest];
+        opt->alias_src_version[dest] = opt->version[src];
+      }
+    }
+  }
+
+  free (opt);
+
+  k = compiler->n_insns;
+  for(j=compiler->n_insns-1;j>=0;j--){
+    OrcInstruction *insn = compiler->insns + j;
+    OrcStaticOpcode *opcode = insn->opcode;
+    orc_bool needed = FALSE;
+
+    if (removed[j]) continue;
+
+    if (opcode->flags & (ORC_STATIC_OPCODE_STORE |
+          ORC_STATIC_OPCODE_ACCUMULATOR)) {
+      needed = TRUE;
+    }
+    for(i=0;i<ORC_STATIC_OPCODE_N_DEST;i++){
+      OrcVariable *var = compiler->vars + insn->dest_args[i];
+
+      if (opcode->dest_size[i] == 0) continue;
+      if (var->vartype != ORC_VAR_TYPE_TEMP || live[insn->dest_args[i]]) {
+        needed = TRUE;
+      }
+    }
+
+    if (!needed) {
+      ORC_LOG("removed insn %d %s (%s)", j, orig_opcode[j]->name, reason[j]);
+      continue;
+    }
+
+    for(i=0;i<ORC_STATIC_OPCODE_N_DEST;i++){
+      if (opcode->dest_size[i] == 0) continue;
+      live[insn->dest_args[i]] = FALSE;
+    }
+    for(i=0;i<ORC_STATIC_OPCODE_N_SRC;i++){
+      if (opcode->src_size[i] == 0) continue;
+      live[insn->src_args[i]] = TRUE;
+    }
+
+    k--;
+    if (k != j) {
+      memcpy (compiler->insns + k, insn, sizeof(OrcInstruction));
+    }
+  }
+
+  if (k > 0) {
+    memmove (compiler->insns, compiler->insns + k,
+        (compiler->n_insns - k) * sizeof(OrcInstruction));
+    compiler->n_insns -= k;
+  }
+  free (live);
+  free (removed);
+  free (orig_opcode);
+  free (reason);
+}
+
+static void
+orc_compiler_assign_rules (OrcCompiler *compiler)
+{
+  int i;
+
+  for(i=0;i<compiler->n_insns;i++) {
+    OrcInstruction *insn = compiler->insns + i;
+
+    insn->rule = orc_target_get_rule (compiler->target, insn->opcode,
+        compiler->target_flags);
+
+    if (insn->rule == NULL || insn->rule->emit == NULL) {
+      ORC_COMPILER_ERROR (compiler, "no code generation rule for %s on "
+          "target %s", insn->opcode->name, compiler->target->name);
+      compiler->result = ORC_COMPILE_RESULT_UNKNOWN_COMPILE;
+      return;
+    }
+  }
+}
+
+/* All the partial accumulators are used for the whole loop, whichever
+ * one the alloc of the accumulator points to */
+static void
+orc_compiler_mark_partial_accs (OrcCompiler *compiler)
+{
+  int i, j;
+
+  for (i = 0; i < ORC_MAX_ACCUM_VARS; i++) {
+    if (compiler->vars[ORC_VAR_A1 + i].vartype != ORC_VAR_TYPE_ACCUMULATOR)
+      continue;
+    for (j = 0; j < compiler->n_partial_accs; j++)
+      compiler->alloc_regs[compiler->partial_accs[i][j]] = 1;
+  }
+}
+
+int
+orc_compiler_get_temp_reg (OrcCompiler *compiler)
+{
+  int j;
+
+  ORC_DEBUG("at insn %d %s", compiler->insn_index,
+      compiler->insns[compiler->insn_index].opcode->name);
+
+  /* Mark old temp registers as unused */
+  for(j=0;j<ORC_N_REGS;j++){
+    compiler->alloc_regs[j] = compiler->temp_regs[j];
+  }
+
+  /* Mark variables using a temp register as used */
+  for(j=0;j<compiler->n_vars;j++){
+    if (!compiler->vars[j].alloc) continue;
+
+    ORC_DEBUG("var %d: %d  %d %d", j, compiler->vars[j].alloc,
+        compiler->vars[j].first_use,
+        compiler->vars[j].last_use);
+
+    if (compiler->vars[j].first_use == -1) {
+      compiler->alloc_regs[compiler->vars[j].alloc] = 1;
+    } else if (compiler->vars[j].first_use <= compiler->insn_index &&
+        compiler->vars[j].last_use >= compiler->insn_index) {
+      compiler->alloc_regs[compiler->vars[j].alloc] = 1;
+    }
+  }
+
+  /* Mark constants using a temp register as used */
+  for(j=0;j<compiler->n_constants;j++){
+    if (compiler->constants[j].alloc_reg) {
+      compiler->alloc_regs[compiler->constants[j].alloc_reg] = 1;
+    }
+  }
+  orc_compiler_mark_partial_accs (compiler);
+
+  for (j = compiler->min_temp_reg; j < ORC_N_REGS; j++) {
+    if (compiler->valid_regs[j] && !compiler->alloc_regs[j]) {
+      ORC_DEBUG("Available register %d found", j);
+      compiler->temp_regs[j] = 1;
+      return j;
+    }
+  }
+
+  if (compiler->target->load_spill) {
+    /* Not fatal yet, the compilation is retried with a spilled variable */
+    ORC_DEBUG("No temporary register available at insn %d %s",
+        compiler->insn_index,
+        compiler->insns[compiler->insn_index].opcode->name);
+  } else {
+    ORC_ERROR("No temporary register available at insn %d %s",
+        compiler->insn_index,
+        compiler->insns[compiler->insn_index].opcode->name);
+  }
+  ORC_COMPILER_ERROR (compiler, "no temporary register available");
+  compiler->result = ORC_COMPILE_RESULT_UNKNOWN_COMPILE;
+  if (!compiler->reg_overflow) {
+    compiler->reg_overflow = TRUE;
+    compiler->overflow_insn = compiler->insn_index;
+  }
+
+  return 0;
+}
+
+void
+orc_compiler_release_temp_reg (OrcCompiler *compiler, int reg)
+{
+  ORC_DEBUG("Releasing register %d", reg);
+  compiler->temp_regs[reg] = 0;
+}
+
+void
+orc_compiler_reset_temp_regs (OrcCompiler *compiler, int start)
+{
+  int i;
+
+  for (i = compiler->min_temp_reg; i < ORC_N_REGS; i++)
+    compiler->temp_regs[i] = 0;
+  compiler->min_temp_reg = start;
+}
+
+static void
+orc_compiler_rewrite_vars (OrcCompiler *compiler)
+{
+  int j;
+  int k;
+  OrcInstruction *insn;
+  OrcStaticOpcode *opcode;
+  int var;
+  int actual_var;
+
+  for(j=0;j<compiler->n_vars;j++){
+    if (compiler->vars[j].alloc) continue;
+    compiler->vars[j].last_use = -1;
+  }
   for(j=0;j<compiler->n_insns;j++){
     insn = compiler->insns + j;
     opcode = insn->opcode;
@@ -1160,6 +2213,12 @@ orc_compiler_rewrite_vars (OrcCompiler *compiler)
         if (compiler->vars[var].vartype != ORC_VAR_TYPE_ACCUMULATOR) {
           ORC_COMPILER_ERROR(compiler,"accumulating opcode to non-accumulator dest at line %d", insn->line);
           compiler->result = ORC_COMPILE_RESULT_UNKNOWN_PARSE;
+        } else if (orc_opcode_get_accumulator_type (opcode) !=
+            orc_accumulator_get_type (compiler->insns, compiler->n_insns,
+                var)) {
+          /* The accumulator starts from the identity of one operation */
+          ORC_COMPILER_ERROR(compiler,"accumulating opcodes of different kinds to the same dest at line %d", insn->line);
+          compiler->result = ORC_COMPILE_RESULT_UNKNOWN_PARSE;
         }
       } else {
         if (compiler->vars[var].vartype == ORC_VAR_TYPE_ACCUMULATOR) {
@@ -1198,13 +2257,474 @@ orc_compiler_rewrite_vars (OrcCompiler *compiler)
   }
 }
 
+/* Flags the instructions whose result is the same on every iteration, so
+ * that the target emits them once before the loop and keeps their result
+ * in a register for all of it. Those are the loadp opcodes and, for the
+ * targets that can emit any rule there, the instructions that only read
+ * constants, parameters and the results of other invariant instructions.
+ * Temporaries are only written once at this point, so the chains are
+ * found in a single pass. */
 static void
-orc_compiler_global_reg_alloc (OrcCompiler *compiler)
+orc_compiler_mark_invariants (OrcCompiler *compiler)
 {
+  orc_bool *invariant;
+  int j;
+  int k;
+
+  invariant = orc_malloc (sizeof (orc_bool) * compiler->n_vars);
+  memset (invariant, 0, sizeof (orc_bool) * compiler->n_vars);
+
+  for (j = 0; j < compiler->n_insns; j++) {
+    OrcInstruction *insn = compiler->insns + j;
+    OrcStaticOpcode *opcode = insn->opcode;
+    int dest = insn->dest_args[0];
+
+    if (!(opcode->flags & ORC_STATIC_OPCODE_INVARIANT)) {
+      if (!compiler->hoist_invariants || _orc_compiler_flag_noopt)
+        continue;
+      if (opcode->flags & (ORC_STATIC_OPCODE_ACCUMULATOR |
+              ORC_STATIC_OPCODE_LOAD | ORC_STATIC_OPCODE_STORE |
+              ORC_STATIC_OPCODE_ITERATOR))
+        continue;
+      if (opcode->dest_size[1] != 0 ||
+          compiler->vars[dest].vartype != ORC_VAR_TYPE_TEMP)
+        continue;
+
+      for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+        const OrcVariable *var = compiler->vars + insn->src_args[k];
+
+        if (opcode->src_size[k] == 0) continue;
+        if (var->vartype == ORC_VAR_TYPE_CONST ||
+            var->vartype == ORC_VAR_TYPE_PARAM)
+          continue;
+        if (var->vartype == ORC_VAR_TYPE_TEMP && invariant[insn->src_args[k]])
+          continue;
+        break;
+      }
+      if (k < ORC_STATIC_OPCODE_N_SRC)
+        continue;
+
+      ORC_LOG ("hoisting insn %d %s out of the loop", j, opcode->name);
+    }
+
+    insn->flags |= ORC_INSN_FLAG_INVARIANT;
+    invariant[dest] = TRUE;
+  }
+
+  free (invariant);
+}
+
+/* Sets first_use and last_use of the temporaries and accumulators again
+ * after the instructions were moved */
+static void
+orc_compiler_update_live_ranges (OrcCompiler *compiler)
+{
+  orc_bool *seen;
+  int i, j, k;
+
+  seen = orc_malloc (sizeof (orc_bool) * compiler->n_vars);
+  memset (seen, 0, sizeof (orc_bool) * compiler->n_vars);
+
+  for (i = 0; i < compiler->n_vars; i++) {
+    OrcVariable *var = compiler->vars + i;
+
+    if (var->vartype == ORC_VAR_TYPE_TEMP ||
+        var->vartype == ORC_VAR_TYPE_ACCUMULATOR)
+      var->last_use = -1;
+  }
+
+  for (j = 0; j < compiler->n_insns; j++) {
+    OrcInstruction *insn = compiler->insns + j;
+    int args[ORC_STATIC_OPCODE_N_SRC + ORC_STATIC_OPCODE_N_DEST];
+    int n_args = 0;
+
+    for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+      if (insn->opcode->src_size[k]) args[n_args++] = insn->src_args[k];
+    }
+    for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+      if (insn->opcode->dest_size[k]) args[n_args++] = insn->dest_args[k];
+    }
+
+    for (k = 0; k < n_args; k++) {
+      OrcVariable *var = compiler->vars + args[k];
+
+      if (var->vartype != ORC_VAR_TYPE_TEMP &&
+          var->vartype != ORC_VAR_TYPE_ACCUMULATOR)
+        continue;
+      if (!seen[args[k]]) {
+        seen[args[k]] = TRUE;
+        var->first_use = j;
+      }
+      var->last_use = j;
+    }
+  }
+
+  free (seen);
+}
+
+/* Every instruction waits for at most its sources, its accumulator and
+ * one other access to the arrays, and is waited for by the next ordered
+ * access once */
+#define ORC_SCHED_MAX_EDGES(n) ((n) * (ORC_STATIC_OPCODE_N_SRC + 4))
+
+typedef struct _OrcScheduler OrcScheduler;
+struct _OrcScheduler {
+  /* One entry for each instruction */
+  int *latency;
+  /* Longest path to the end of the loop body, the priority */
+  int *height;
+  int *n_preds;
+  /* First cycle all the sources are available */
+  int *ready;
+  int *scheduled;
+  int *first_succ;
+  int *order;
+
+  /* ORC_SCHED_MAX_EDGES entries */
+  int *edge_to;
+  int *edge_next;
+  int *edge_latency;
+  int n_edges;
+
+  /* One entry for each variable */
+  int *def;
+  int *n_uses;
+  int *last_acc;
+};
+
+static OrcScheduler *
+orc_scheduler_new (int n_insns, int n_vars)
+{
+  OrcScheduler *s;
+  int n_edges = ORC_SCHED_MAX_EDGES (n_insns);
+  int size = 7 * n_insns + 3 * n_edges + 3 * n_vars;
+  int *p;
   int i;
+
+  s = orc_malloc (sizeof (OrcScheduler) + sizeof (int) * size);
+  memset (s, 0, sizeof (OrcScheduler) + sizeof (int) * size);
+  p = (int *) (s + 1);
+
+  s->latency = p; p += n_insns;
+  s->height = p; p += n_insns;
+  s->n_preds = p; p += n_insns;
+  s->ready = p; p += n_insns;
+  s->scheduled = p; p += n_insns;
+  s->first_succ = p; p += n_insns;
+  s->order = p; p += n_insns;
+  s->edge_to = p; p += n_edges;
+  s->edge_next = p; p += n_edges;
+  s->edge_latency = p; p += n_edges;
+  s->def = p; p += n_vars;
+  s->n_uses = p; p += n_vars;
+  s->last_acc = p;
+
+  for (i = 0; i < n_insns; i++)
+    s->first_succ[i] = -1;
+  for (i = 0; i < n_vars; i++) {
+    s->def[i] = -1;
+    s->last_acc[i] = -1;
+  }
+
+  return s;
+}
+
+/* The cycles until the result of @insn is available, according to
+ * @model */
+int
+orc_compiler_get_latency (const OrcSchedModel *model,
+    const OrcInstruction *insn)
+{
+  const OrcStaticOpcode *opcode = insn->opcode;
+
+  if (opcode->flags & ORC_STATIC_OPCODE_LOAD)
+    return model->load;
+  if (opcode->flags & ORC_STATIC_OPCODE_STORE)
+    return model->store;
+  if (opcode->flags & ORC_STATIC_OPCODE_FLOAT) {
+    if (strstr (opcode->name, "div") || strstr (opcode->name, "sqrt"))
+      return model->float_div;
+    return model->float_op;
+  }
+  if (strncmp (opcode->name, "mul", 3) == 0 ||
+      strncmp (opcode->name, "div", 3) == 0)
+    return model->multiply;
+  return model->simple;
+}
+
+/* How @insn accesses the arrays: 0 not at all, 1 plain reads, which can be
+ * reordered with each other, 2 anything else. The loads with an offset or
+ * a position in a register and the iterators keep their place. */
+static int
+orc_compiler_get_array_access (const OrcCompiler *compiler,
+    const OrcInstruction *insn)
+{
+  const OrcStaticOpcode *opcode = insn->opcode;
+  int access = 0;
+  int k;
+
+  if (opcode->flags & (ORC_STATIC_OPCODE_STORE | ORC_STATIC_OPCODE_ITERATOR))
+    return 2;
+  if (opcode->flags & ORC_STATIC_OPCODE_LOAD)
+    return (opcode->flags & ORC_STATIC_OPCODE_SCALAR) ? 2 : 1;
+
+  for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+    if (opcode->dest_size[k] == 0) continue;
+    if (compiler->vars[insn->dest_args[k]].vartype == ORC_VAR_TYPE_DEST)
+      return 2;
+  }
+  for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+    int vartype = compiler->vars[insn->src_args[k]].vartype;
+
+    if (opcode->src_size[k] == 0) continue;
+    if (vartype == ORC_VAR_TYPE_SRC || vartype == ORC_VAR_TYPE_DEST)
+      access = 1;
+  }
+
+  return access;
+}
+
+static void
+orc_scheduler_add_edge (OrcScheduler *s, int from, int to, int latency)
+{
+  int e;
+
+  if (from < 0)
+    return;
+
+  e = s->n_edges++;
+  s->edge_to[e] = to;
+  s->edge_latency[e] = latency;
+  s->edge_next[e] = s->first_succ[from];
+  s->first_succ[from] = e;
+  s->n_preds[to]++;
+}
+
+/* Variables that are live in the loop, the invariant ones have their own
+ * registers */
+static orc_bool
+orc_scheduler_is_live_var (const OrcCompiler *compiler, const OrcScheduler *s,
+    int var)
+{
+  return compiler->vars[var].vartype == ORC_VAR_TYPE_TEMP &&
+      s->def[var] >= 0 &&
+      !(compiler->insns[s->def[var]].flags & ORC_INSN_FLAG_INVARIANT);
+}
+
+/* Change in the number of live variables if @insn was scheduled now */
+static int
+orc_scheduler_get_pressure (const OrcCompiler *compiler,
+    const OrcScheduler *s, const OrcInstruction *insn)
+{
+  const OrcStaticOpcode *opcode = insn->opcode;
+  int delta = 0;
+  int k, l;
+
+  for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+    int var = insn->dest_args[k];
+
+    if (opcode->dest_size[k] == 0) continue;
+    if (orc_scheduler_is_live_var (compiler, s, var) && s->n_uses[var] > 0)
+      delta++;
+  }
+  for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+    int var = insn->src_args[k];
+    int n = 0;
+
+    if (opcode->src_size[k] == 0) continue;
+    if (!orc_scheduler_is_live_var (compiler, s, var)) continue;
+
+    for (l = 0; l < ORC_STATIC_OPCODE_N_SRC; l++) {
+      if (opcode->src_size[l] && insn->src_args[l] == var) {
+        if (l < k) break;
+        n++;
+      }
+    }
+    if (l == ORC_STATIC_OPCODE_N_SRC && s->n_uses[var] == n)
+      delta--;
+  }
+
+  return delta;
+}
+
+/* Reorders the instructions of the loop body with a list scheduler. The
+ * instructions form a graph through the temporaries, which are only
+ * written once at this point, the accumulators and the accesses to the
+ * arrays. Cycle by cycle, up to issue_width of the instructions whose
+ * sources are available are picked, those on the longest path to the end
+ * of the body first, so that the independent chains are interleaved and
+ * loads are started early. When more variables are live than the target
+ * has registers for, the instructions that free registers are preferred.
+ * Invariant instructions are emitted before the loop and go first. */
+static void
+orc_compiler_schedule (OrcCompiler *compiler)
+{
+  const OrcSchedModel *model = compiler->sched_model;
+  OrcScheduler *s;
+  OrcInstruction *insns;
+  int last_write = -1;
+  int n = compiler->n_insns;
+  int n_order = 0;
+  int n_regs = 0;
+  int n_live = 0;
+  int cycle;
+  int i, j, k, e;
+
+  if (model == NULL || _orc_compiler_flag_noopt || n < 3)
+    return;
+
+  s = orc_scheduler_new (n, compiler->n_vars);
+
+  for (i = compiler->target->data_register_offset; i < ORC_N_REGS; i++) {
+    if (compiler->valid_regs[i]) n_regs++;
+  }
+
+  for (j = 0; j < n; j++) {
+    OrcInstruction *insn = compiler->insns + j;
+    OrcStaticOpcode *opcode = insn->opcode;
+    int access;
+
+    if (insn->flags & ORC_INSN_FLAG_INVARIANT) {
+      n_regs--;
+      for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+        if (opcode->dest_size[k]) s->def[insn->dest_args[k]] = j;
+      }
+      continue;
+    }
+
+    s->latency[j] = orc_compiler_get_latency (model, insn);
+
+    for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+      int var = insn->src_args[k];
+
+      if (opcode->src_size[k] == 0) continue;
+      if (compiler->vars[var].vartype != ORC_VAR_TYPE_TEMP) continue;
+      if (s->def[var] < 0 ||
+          (compiler->insns[s->def[var]].flags & ORC_INSN_FLAG_INVARIANT))
+        continue;
+
+      orc_scheduler_add_edge (s, s->def[var], j, s->latency[s->def[var]]);
+      s->n_uses[var]++;
+    }
+
+    for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+      int var = insn->dest_args[k];
+
+      if (opcode->dest_size[k] == 0) continue;
+      if (compiler->vars[var].vartype == ORC_VAR_TYPE_ACCUMULATOR) {
+        if (s->last_acc[var] >= 0) {
+          orc_scheduler_add_edge (s, s->last_acc[var], j,
+              s->latency[s->last_acc[var]]);
+        }
+        s->last_acc[var] = j;
+      } else {
+        s->def[var] = j;
+      }
+    }
+
+    access = orc_compiler_get_array_access (compiler, insn);
+    if (access == 1)
+      orc_scheduler_add_edge (s, last_write, j, 1);
+    if (access == 2) {
+      /* Waits for the previous ordered access and the reads since then */
+      for (i = last_write + 1; i < j; i++) {
+        if (!(compiler->insns[i].flags & ORC_INSN_FLAG_INVARIANT) &&
+            orc_compiler_get_array_access (compiler, compiler->insns + i) == 1)
+          orc_scheduler_add_edge (s, i, j, 0);
+      }
+      orc_scheduler_add_edge (s, last_write, j, 0);
+      last_write = j;
+    }
+  }
+  n_regs = MAX (n_regs - 2, 2);
+
+  for (j = n - 1; j >= 0; j--) {
+    s->height[j] = s->latency[j];
+    for (e = s->first_succ[j]; e != -1; e = s->edge_next[e]) {
+      s->height[j] = MAX (s->height[j],
+          s->edge_latency[e] + s->height[s->edge_to[e]]);
+    }
+  }
+
+  for (j = 0; j < n; j++) {
+    if (compiler->insns[j].flags & ORC_INSN_FLAG_INVARIANT) {
+      s->scheduled[j] = TRUE;
+      s->order[n_order++] = j;
+    }
+  }
+
+  for (cycle = 0; n_order < n; cycle++) {
+    int issued;
+
+    for (issued = 0; issued < model->issue_width; issued++) {
+      OrcInstruction *insn;
+      int best = -1;
+      int best_delta = 0;
+
+      for (j = 0; j < n; j++) {
+        int delta;
+
+        if (s->scheduled[j] || s->n_preds[j] > 0 || s->ready[j] > cycle)
+          continue;
+
+        delta = 0;
+        if (n_live >= n_regs)
+          delta = orc_scheduler_get_pressure (compiler, s, compiler->insns + j);
+
+        if (best == -1 || delta < best_delta ||
+            (delta == best_delta && s->height[j] > s->height[best])) {
+          best = j;
+          best_delta = delta;
+        }
+      }
+      if (best == -1)
+        break;
+
+      insn = compiler->insns + best;
+      n_live += orc_scheduler_get_pressure (compiler, s, insn);
+      for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+        if (insn->opcode->src_size[k] == 0) continue;
+        if (orc_scheduler_is_live_var (compiler, s, insn->src_args[k]))
+          s->n_uses[insn->src_args[k]]--;
+      }
+
+      s->scheduled[best] = TRUE;
+      s->order[n_order++] = best;
+      for (e = s->first_succ[best]; e != -1; e = s->edge_next[e]) {
+        int to = s->edge_to[e];
+
+        s->n_preds[to]--;
+        s->ready[to] = MAX (s->ready[to], cycle + s->edge_latency[e]);
+      }
+    }
+  }
+
+  ORC_LOG ("scheduled %d instructions in %d cycles", n, cycle);
+
+  insns = orc_malloc (sizeof (OrcInstruction) * n);
+  for (j = 0; j < n; j++) {
+    insns[j] = compiler->insns[s->order[j]];
+    if (s->order[j] != j && !(insns[j].flags & ORC_INSN_FLAG_INVARIANT))
+      ORC_LOG ("insn %d %s moved to %d", s->order[j], insns[j].opcode->name,
+          j);
+  }
+  memcpy (compiler->insns, insns, sizeof (OrcInstruction) * n);
+  free (insns);
+  free (s);
+
+  orc_compiler_update_live_ranges (compiler);
+}
+
+static void
+orc_compiler_global_reg_alloc (OrcCompiler *compiler)
+{
+  int i, k;
   OrcVariable *var;
 
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  /* Invariants are live everywhere */
+  compiler->insn_index = -1;
+
+  for(i=0;i<compiler->n_vars;i++){
     var = compiler->vars + i;
     if (var->name == NULL) continue;
     switch (var->vartype) {
@@ -1230,6 +2750,11 @@ orc_compiler_global_reg_alloc (OrcCompiler *compiler)
         var->first_use = -1;
         var->last_use = -1;
         var->alloc = orc_compiler_allocate_register (compiler, TRUE);
+        compiler->partial_accs[i - ORC_VAR_A1][0] = var->alloc;
+        for (k = 1; k < compiler->n_partial_accs; k++) {
+          compiler->partial_accs[i - ORC_VAR_A1][k] =
+              orc_compiler_allocate_register (compiler, TRUE);
+        }
         break;
       case ORC_VAR_TYPE_TEMP:
         break;
@@ -1246,13 +2771,14 @@ orc_compiler_global_reg_alloc (OrcCompiler *compiler)
     OrcInstruction *insn = compiler->insns + i;
     OrcStaticOpcode *opcode = insn->opcode;
 
-    if (opcode->flags & ORC_STATIC_OPCODE_INVARIANT) {
+    if (insn->flags & ORC_INSN_FLAG_INVARIANT) {
       var = compiler->vars + insn->dest_args[0];
 
       var->first_use = -1;
       var->last_use = -1;
-      var->alloc = orc_compiler_allocate_register (compiler, TRUE);
-      insn->flags |= ORC_INSN_FLAG_INVARIANT;
+      if (!compiler->spill_slot[insn->dest_args[0]]) {
+        var->alloc = orc_compiler_allocate_register (compiler, TRUE);
+      }
     }
 
     if (opcode->flags & ORC_STATIC_OPCODE_ITERATOR) {
@@ -1271,76 +2797,149 @@ orc_compiler_global_reg_alloc (OrcCompiler *compiler)
   }
 }
 
+static orc_bool
+orc_compiler_is_commutative (OrcCompiler *compiler, OrcInstruction *insn)
+{
+  OrcStaticOpcode *opcode = insn->opcode;
+
+  return (opcode->flags & ORC_STATIC_OPCODE_COMMUTATIVE) &&
+      opcode->src_size[0] == opcode->src_size[1] &&
+      !(opcode->flags & ORC_STATIC_OPCODE_SCALAR);
+}
+
+/* Gives the destination of @insn the register of a source that dies at
+ * it, so that two-operand targets don't need to copy the source first.
+ * The first source is the one rules overwrite, when only the second one
+ * dies the sources of commutative opcodes are swapped. */
 static void
-orc_compiler_rewrite_vars2 (OrcCompiler *compiler)
+orc_compiler_coalesce (OrcCompiler *compiler, int j)
 {
+  OrcInstruction *insn = compiler->insns + j;
+  int src1 = insn->src_args[0];
+  int src2 = insn->src_args[1];
+  int dest;
+
+  if (insn->opcode->flags & ORC_STATIC_OPCODE_ACCUMULATOR)
+    return;
+
+  if (insn->opcode->dest_size[1] == 0)
+    dest = insn->dest_args[0];
+  else
+    dest = insn->dest_args[1];
+
+  if (compiler->vars[dest].vartype != ORC_VAR_TYPE_TEMP ||
+      compiler->vars[dest].alloc || compiler->spill_slot[dest])
+    return;
+
+  if (compiler->two_operand && orc_compiler_is_commutative (compiler, insn) &&
+      compiler->vars[src1].last_use != j &&
+      compiler->vars[src2].last_use == j &&
+      compiler->vars[src2].alloc && !compiler->spill_slot[src2]) {
+    insn->src_args[0] = src2;
+    insn->src_args[1] = src1;
+    src1 = src2;
+  }
+
+  if (compiler->vars[src1].last_use != j || compiler->spill_slot[src1])
+    return;
+
+  if (compiler->vars[src1].first_use == j) {
+    compiler->vars[src1].alloc = orc_compiler_allocate_register (compiler,
+        TRUE);
+  }
+  compiler->alloc_regs[compiler->vars[src1].alloc]++;
+  compiler->vars[dest].alloc = compiler->vars[src1].alloc;
+}
+
+/* Assigns vector registers to the temporaries. Each temporary lives from
+ * its first_use to its last_use; the intervals are visited in the order
+ * they start, those that ended give their register back before the next
+ * instruction. Registers are taken from the ones that do not need to be
+ * saved first. */
+static void
+orc_compiler_linear_scan (OrcCompiler *compiler)
+{
+  int *first_start;
+  int *first_end;
+  int *next_start;
+  int *next_end;
   int i;
   int j;
-  int k;
 
-  for(j=0;j<compiler->n_insns;j++){
-#if 1
-    /* must be true to chain src1 to dest:
-     *  - rule must handle it
-     *  - src1 must be last_use
-     *  - only one dest
-     */
-    if (compiler->insns[j].flags & ORC_INSN_FLAG_INVARIANT) continue;
+  first_start = orc_malloc (sizeof (int) *
+      (2 * compiler->n_insns + 2 * compiler->n_vars));
+  first_end = first_start + compiler->n_insns;
+  next_start = first_end + compiler->n_insns;
+  next_end = next_start + compiler->n_vars;
 
-    if (!(compiler->insns[j].opcode->flags & ORC_STATIC_OPCODE_ACCUMULATOR)) {
-      int src1 = compiler->insns[j].src_args[0];
-      int dest;
+  for (j = 0; j < compiler->n_insns; j++) {
+    first_start[j] = -1;
+    first_end[j] = -1;
+  }
+  for (i = compiler->n_vars - 1; i >= 0; i--) {
+    OrcVariable *var = compiler->vars + i;
 
-      if (compiler->insns[j].opcode->dest_size[1] == 0)
-        dest = compiler->insns[j].dest_args[0];
-      else
-        dest = compiler->insns[j].dest_args[1];
+    if (var->name == NULL) continue;
+    if (var->last_use == -1) continue;
 
-      if (compiler->vars[src1].last_use == j) {
-        if (compiler->vars[src1].first_use == j) {
-          k = orc_compiler_allocate_register (compiler, TRUE);
-          compiler->vars[src1].alloc = k;
-        }
-        compiler->alloc_regs[compiler->vars[src1].alloc]++;
-        compiler->vars[dest].alloc = compiler->vars[src1].alloc;
-      }
+    if (var->first_use >= 0) {
+      next_start[i] = first_start[var->first_use];
+      first_start[var->first_use] = i;
     }
-#endif
+    next_end[i] = first_end[var->last_use];
+    first_end[var->last_use] = i;
+  }
 
-    if (0) {
-      /* immediate operand, don't load */
-      int src2 = compiler->insns[j].src_args[1];
-      compiler->vars[src2].alloc = 1;
-    } else {
-      int src2 = compiler->insns[j].src_args[1];
-      if (src2 != -1 && compiler->vars[src2].alloc == 1) {
-        compiler->vars[src2].alloc = 0;
-      }
-    }
+  for (j = 0; j < compiler->n_insns; j++) {
+    OrcInstruction *insn = compiler->insns + j;
 
-    for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
-      if (compiler->vars[i].name == NULL) continue;
-      if (compiler->vars[i].last_use == -1) continue;
-      if (compiler->vars[i].first_use == j) {
-        if (compiler->vars[i].alloc) continue;
-        k = orc_compiler_allocate_register (compiler, TRUE);
-        compiler->vars[i].alloc = k;
-      }
+    compiler->insn_index = j;
+    if (insn->flags & ORC_INSN_FLAG_INVARIANT) continue;
+
+    orc_compiler_coalesce (compiler, j);
+
+    for (i = first_start[j]; i != -1; i = next_start[i]) {
+      if (compiler->vars[i].alloc) continue;
+      if (compiler->spill_slot[i]) continue;
+      compiler->vars[i].alloc = orc_compiler_allocate_register (compiler, TRUE);
     }
-    for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
-      if (compiler->vars[i].name == NULL) continue;
-      if (compiler->vars[i].last_use == j) {
-        compiler->alloc_regs[compiler->vars[i].alloc]--;
-      }
+
+    for (i = first_end[j]; i != -1; i = next_end[i]) {
+      compiler->alloc_regs[compiler->vars[i].alloc]--;
     }
   }
+  free (first_start);
+}
 
+/* Returns the index of the next free variable after the temporaries,
+ * the storage of the variables doubles as needed. Pointers into vars
+ * are not valid anymore after this. */
+static int
+orc_compiler_new_var (OrcCompiler *compiler)
+{
+  int i = ORC_VAR_T1 + compiler->n_temp_vars + compiler->n_dup_vars;
+  int n_vars = compiler->n_vars;
+
+  if (i < n_vars)
+    return i;
+
+  compiler->n_vars *= 2;
+  compiler->vars = orc_realloc (compiler->vars,
+      sizeof(OrcVariable) * compiler->n_vars);
+  memset (compiler->vars + n_vars, 0,
+      sizeof(OrcVariable) * (compiler->n_vars - n_vars));
+  compiler->spill_slot = orc_realloc (compiler->spill_slot,
+      sizeof(int) * compiler->n_vars);
+  memset (compiler->spill_slot + n_vars, 0,
+      sizeof(int) * (compiler->n_vars - n_vars));
+
+  return i;
 }
 
 static int
 orc_compiler_dup_temporary (OrcCompiler *compiler, int var, int j)
 {
-  int i = ORC_VAR_T1 + compiler->n_temp_vars + compiler->n_dup_vars;
+  int i = orc_compiler_new_var (compiler);
 
   compiler->vars[i].vartype = ORC_VAR_TYPE_TEMP;
   compiler->vars[i].size = compiler->vars[var].size;
@@ -1354,7 +2953,7 @@ orc_compiler_dup_temporary (OrcCompiler *compiler, int var, int j)
 static int
 orc_compiler_new_temporary (OrcCompiler *compiler, int size)
 {
-  int i = ORC_VAR_T1 + compiler->n_temp_vars + compiler->n_dup_vars;
+  int i = orc_compiler_new_var (compiler);
 
   compiler->vars[i].vartype = ORC_VAR_TYPE_TEMP;
   compiler->vars[i].size = size;
@@ -1403,18 +3002,24 @@ orc_compiler_has_float (OrcCompiler *compiler)
 void
 orc_compiler_append_code (OrcCompiler *p, const char *fmt, ...)
 {
-  char tmp[200];
   va_list varargs;
   int n;
 
+  if (!p->need_asm)
+    return;
+
+  /* Lines are at most 200 characters */
+  if (p->asm_code_len + 200 > p->asm_code_alloc) {
+    p->asm_code_alloc = MAX (4096, p->asm_code_alloc * 2);
+    p->asm_code = orc_realloc (p->asm_code, p->asm_code_alloc);
+  }
+
   va_start (varargs, fmt);
-  vsnprintf(tmp, 200 - 1, fmt, varargs);
+  n = vsnprintf (p->asm_code + p->asm_code_len, 200 - 1, fmt, varargs);
   va_end (varargs);
 
-  n = strlen (tmp);
-  p->asm_code = orc_realloc (p->asm_code, p->asm_code_len + n + 1);
-  memcpy (p->asm_code + p->asm_code_len, tmp, n + 1);
-  p->asm_code_len += n;
+  p->asm_code_len += ORC_CLAMP (n, 0, 200 - 2);
+  p->asm_code[p->asm_code_len] = '\0';
 }
 
 int
@@ -1423,6 +3028,24 @@ orc_compiler_label_new (OrcCompiler *compiler)
   return compiler->n_labels++;
 }
 
+/* Records a reference to @label at @ptr, resolved by the target once the
+ * code is complete */
+void
+orc_compiler_add_fixup (OrcCompiler *compiler, unsigned char *ptr, int label,
+    int type)
+{
+  if (compiler->n_fixups == compiler->n_fixups_alloc) {
+    compiler->n_fixups_alloc = MAX (16, compiler->n_fixups_alloc * 2);
+    compiler->fixups = orc_realloc (compiler->fixups,
+        sizeof(OrcFixup) * compiler->n_fixups_alloc);
+  }
+
+  compiler->fixups[compiler->n_fixups].ptr = ptr;
+  compiler->fixups[compiler->n_fixups].label = label;
+  compiler->fixups[compiler->n_fixups].type = type;
+  compiler->n_fixups++;
+}
+
 /* Compatibility function to be removed once the deprecated
  * APIs are removed
  */
@@ -1745,7 +3368,7 @@ orc_compiler_get_constant_reg (OrcCompiler *compiler)
   }
 
   /* Mark variables using a temp register as used */
-  for(j=0;j<ORC_N_COMPILER_VARIABLES;j++){
+  for(j=0;j<compiler->n_vars;j++){
     if (!compiler->vars[j].alloc) continue;
 
     ORC_DEBUG("var %d: %d  %d %d", j, compiler->vars[j].alloc,
@@ -1765,6 +3388,7 @@ orc_compiler_get_constant_reg (OrcCompiler *compiler)
       compiler->alloc_regs[compiler->constants[j].alloc_reg] = 1;
     }
   }
+  orc_compiler_mark_partial_accs (compiler);
 
   for (j = compiler->min_temp_reg; j < ORC_N_REGS; j++) {
     if (compiler->valid_regs[j] && !compiler->alloc_regs[j]) {
@@ -1829,6 +3453,7 @@ orc_compiler_emit_invariants (OrcCompiler *compiler)
 
     ORC_ASM_CODE(compiler,"# %d: %s\n", j, opcode->name);
 
+    compiler->insn_index = j;
     compiler->insn_shift = compiler->loop_shift;
     if (insn->flags & ORC_INSTRUCTION_FLAG_X2) {
       compiler->insn_shift += 1;
@@ -1839,7 +3464,9 @@ orc_compiler_emit_invariants (OrcCompiler *compiler)
 
     rule = insn->rule;
     if (rule && rule->emit) {
+      orc_compiler_load_spills (compiler, insn);
       rule->emit (compiler, rule->emit_user, insn);
+      orc_compiler_store_spills (compiler, insn);
     } else {
       ORC_COMPILER_ERROR (compiler, "no code generation rule for %s",
           opcode->name);
@@ -1847,10 +3474,158 @@ orc_compiler_emit_invariants (OrcCompiler *compiler)
   }
 }
 
+/**
+ * orc_compiler_load_spills:
+ * @compiler: the compiler
+ * @insn: the instruction about to be emitted
+ *
+ * Gives the spilled operands of @insn one of the registers set aside for
+ * them and loads the sources from their slots. Must be paired with
+ * orc_compiler_store_spills() after the rule of @insn.
+ */
+void
+orc_compiler_load_spills (OrcCompiler *compiler, OrcInstruction *insn)
+{
+  OrcStaticOpcode *opcode = insn->opcode;
+  int n = 0;
+  int k;
+
+  if (compiler->n_spill_slots == 0)
+    return;
+
+  for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+    OrcVariable *var = compiler->vars + insn->src_args[k];
+
+    if (opcode->src_size[k] == 0) continue;
+    if (!compiler->spill_slot[insn->src_args[k]] || var->alloc) continue;
+
+    var->alloc = compiler->spill_regs[n++];
+    compiler->target->load_spill (compiler, var->alloc,
+        compiler->spill_slot[insn->src_args[k]] - 1);
+  }
+  for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+    OrcVariable *var = compiler->vars + insn->dest_args[k];
+
+    if (opcode->dest_size[k] == 0) continue;
+    if (!compiler->spill_slot[insn->dest_args[k]] || var->alloc) continue;
+
+    var->alloc = compiler->spill_regs[n++];
+  }
+}
+
+/**
+ * orc_compiler_store_spills:
+ * @compiler: the compiler
+ * @insn: the instruction just emitted
+ *
+ * Stores the spilled destinations of @insn back to their slots.
+ */
+void
+orc_compiler_store_spills (OrcCompiler *compiler, OrcInstruction *insn)
+{
+  OrcStaticOpcode *opcode = insn->opcode;
+  int k;
+
+  if (compiler->n_spill_slots == 0)
+    return;
+
+  for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+    OrcVariable *var = compiler->vars + insn->dest_args[k];
+
+    if (opcode->dest_size[k] == 0) continue;
+    if (!compiler->spill_slot[insn->dest_args[k]]) continue;
+
+    compiler->target->store_spill (compiler, var->alloc,
+        compiler->spill_slot[insn->dest_args[k]] - 1);
+    var->alloc = 0;
+  }
+  for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+    if (opcode->src_size[k] == 0) continue;
+    if (!compiler->spill_slot[insn->src_args[k]]) continue;
+
+    compiler->vars[insn->src_args[k]].alloc = 0;
+  }
+}
+
+/* Bytes that have to be in flight to hide the latency of the next cache
+ * level, roughly the latency times the bandwidth available to one core.
+ * These are typical values, the actual cache sizes bound them below. */
+#define ORC_PREFETCH_L2_BYTES_IN_FLIGHT 512
+#define ORC_PREFETCH_MEMORY_BYTES_IN_FLIGHT 4096
+#define ORC_PREFETCH_MAX_DISTANCE 2048
+
+/**
+ * orc_compiler_get_prefetch:
+ * @compiler: the compiler
+ * @var: the array variable
+ * @size_region: 1 if the data of the call fits in L1, 2 if it fits in L2,
+ *   3 otherwise
+ * @unroll_shift: the unroll shift of the loop issuing the prefetch
+ * @prefetch: filled with the prefetch to issue
+ *
+ * Computes how far ahead of @var a loop should prefetch. The in-flight
+ * budget of the level serving the data is shared between all the arrays
+ * of the program, never goes below two iterations of the loop and is
+ * capped to a quarter of L1 so that prefetched lines are not evicted
+ * before they are used. Data beyond L2 is streamed, destinations are only
+ * prefetched in that case.
+ *
+ * Returns: TRUE if a prefetch should be issued
+ */
+orc_bool
+orc_compiler_get_prefetch (OrcCompiler *compiler, int var, int size_region,
+    int unroll_shift, OrcPrefetch *prefetch)
+{
+  const OrcVariable *v = compiler->vars + var;
+  int n_streams = 0;
+  int bytes_per_iteration;
+  int budget;
+  int distance;
+  int l1, l2, l3;
+  int i;
+
+  prefetch->hint = ORC_PREFETCH_NONE;
+  prefetch->distance = 0;
+  prefetch->write = (v->vartype == ORC_VAR_TYPE_DEST);
+
+  if (var < ORC_VAR_D1 || var > ORC_VAR_S8 || v->size == 0)
+    return FALSE;
+  if (size_region < 2 || (prefetch->write && size_region < 3))
+    return FALSE;
+
+  for (i = ORC_VAR_D1; i <= ORC_VAR_S8; i++) {
+    if (compiler->vars[i].size > 0)
+      n_streams++;
+  }
+
+  orc_get_data_cache_sizes (&l1, &l2, &l3);
+
+  budget = (size_region == 2) ? ORC_PREFETCH_L2_BYTES_IN_FLIGHT :
+      ORC_PREFETCH_MEMORY_BYTES_IN_FLIGHT;
+  if (l1 > 0)
+    budget = MIN (budget, l1 / 4);
+
+  bytes_per_iteration = v->size << (compiler->loop_shift + unroll_shift);
+  distance = budget / n_streams;
+  distance = MAX (distance, 2 * bytes_per_iteration);
+  distance = MAX (distance, 2 * ORC_CACHE_LINE_SIZE);
+  distance = MIN (distance, ORC_PREFETCH_MAX_DISTANCE);
+  distance = (distance + ORC_CACHE_LINE_SIZE - 1) & ~(ORC_CACHE_LINE_SIZE - 1);
+
+  prefetch->hint = (size_region == 2) ? ORC_PREFETCH_KEEP :
+      ORC_PREFETCH_STREAM;
+  prefetch->distance = distance;
+
+  ORC_DEBUG ("prefetch %s %d bytes ahead, hint %d, region %d",
+      v->name, distance, prefetch->hint, size_region);
+
+  return TRUE;
+}
+
 const OrcVariable *
 orc_compiler_get_variable (OrcCompiler *c, OrcVariableId idx)
 {
-  if (idx < 0 || idx >= ORC_N_COMPILER_VARIABLES)
+  if (idx < 0 || idx >= c->n_vars)
     return NULL;
   return &c->vars[idx];
 }
@@ -5456,3 +5456,218 @@ emulate_convwf (OrcOpcodeExecutor *ex, int offset, int n)
 
 }
 
+void
+emulate_accmaxub (OrcOpcodeExecutor *ex, int offset, int n)
+{
+  int i;
+  const orc_int8 * ORC_RESTRICT ptr4;
+  orc_int8 var12 = 0;
+  orc_int8 var32;
+
+  ptr4 = (orc_int8 *)ex->src_ptrs[0];
+
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadb */
+    var32 = ptr4[i];
+    /* 1: accmaxub */
+    var12 = ORC_MAX((orc_uint8)var12, (orc_uint8)var32);
+  }
+  ((orc_union32 *)ex->dest_ptrs[0])->i = ORC_MAX((orc_uint8)var12, (orc_uint8)((orc_union32 *)ex->dest_ptrs[0])->i);
+
+}
+
+void
+emulate_accminub (OrcOpcodeExecutor *ex, int offset, int n)
+{
+  int i;
+  const orc_int8 * ORC_RESTRICT ptr4;
+  orc_int8 var12 = (orc_int8)0xff;
+  orc_int8 var32;
+
+  ptr4 = (orc_int8 *)ex->src_ptrs[0];
+
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadb */
+    var32 = ptr4[i];
+    /* 1: accminub */
+    var12 = ORC_MIN((orc_uint8)var12, (orc_uint8)var32);
+  }
+  ((orc_union32 *)ex->dest_ptrs[0])->i = ORC_MIN((orc_uint8)var12, (orc_uint8)((orc_union32 *)ex->dest_ptrs[0])->i);
+
+}
+
+void
+emulate_accmaxsw (OrcOpcodeExecutor *ex, int offset, int n)
+{
+  int i;
+  const orc_union16 * ORC_RESTRICT ptr4;
+  orc_union16 var12 = { (orc_int16)0x8000 };
+  orc_union16 var32;
+
+  ptr4 = (orc_union16 *)ex->src_ptrs[0];
+
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadw */
+    var32 = ptr4[i];
+    /* 1: accmaxsw */
+    var12.i = ORC_MAX(var12.i, var32.i);
+  }
+  ((orc_union32 *)ex->dest_ptrs[0])->i = ORC_MAX((orc_int16)var12.i, (orc_int16)((orc_union32 *)ex->dest_ptrs[0])->i) & 0xffff;
+
+}
+
+void
+emulate_accminsw (OrcOpcodeExecutor *ex, int offset, int n)
+{
+  int i;
+  const orc_union16 * ORC_RESTRICT ptr4;
+  orc_union16 var12 = { (orc_int16)0x7fff };
+  orc_union16 var32;
+
+  ptr4 = (orc_union16 *)ex->src_ptrs[0];
+
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadw */
+    var32 = ptr4[i];
+    /* 1: accminsw */
+    var12.i = ORC_MIN(var12.i, var32.i);
+  }
+  ((orc_union32 *)ex->dest_ptrs[0])->i = ORC_MIN((orc_int16)var12.i, (orc_int16)((orc_union32 *)ex->dest_ptrs[0])->i) & 0xffff;
+
+}
+
+void
+emulate_accorl (OrcOpcodeExecutor *ex, int offset, int n)
+{
+  int i;
+  const orc_union32 * ORC_RESTRICT ptr4;
+  orc_union32 var12 =  { 0 };
+  orc_union32 var32;
+
+  ptr4 = (orc_union32 *)ex->src_ptrs[0];
+
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadl */
+    var32 = ptr4[i];
+    /* 1: accorl */
+    var12.i = var12.i | var32.i;
+  }
+  ((orc_union32 *)ex->dest_ptrs[0])->i |= var12.i;
+
+}
+
+void
+emulate_accandl (OrcOpcodeExecutor *ex, int offset, int n)
+{
+  int i;
+  const orc_union32 * ORC_RESTRICT ptr4;
+  orc_union32 var12 = { (orc_int32)0xffffffff };
+  orc_union32 var32;
+
+  ptr4 = (orc_union32 *)ex->src_ptrs[0];
+
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadl */
+    var32 = ptr4[i];
+    /* 1: accandl */
+    var12.i = var12.i & var32.i;
+  }
+  ((orc_union32 *)ex->dest_ptrs[0])->i &= var12.i;
+
+}
+
+void
+emulate_accq (OrcOpcodeExecutor *ex, int offset, int n)
+{
+  int i;
+  const orc_union64 * ORC_RESTRICT ptr4;
+  orc_union64 var12 =  { 0 };
+  orc_union64 var32;
+
+  ptr4 = (orc_union64 *)ex->src_ptrs[0];
+
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadq */
+    var32 = ptr4[i];
+    /* 1: accq */
+    var12.i = (orc_uint64)var12.i + (orc_uint64)var32.i;
+  }
+  ((orc_union64 *)ex->dest_ptrs[0])->i += (orc_uint64)var12.i;
+
+}
+
+void
+emulate_accf (OrcOpcodeExecutor *ex, int offset, int n)
+{
+  int i;
+  const orc_union32 * ORC_RESTRICT ptr4;
+  orc_union32 var12 =  { 0 };
+  orc_union32 var32;
+
+  ptr4 = (orc_union32 *)ex->src_ptrs[0];
+
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadl */
+    var32 = ptr4[i];
+    /* 1: accf */
+    {
+       orc_union32 _src1;
+       orc_union32 _src2;
+       orc_union32 _dest1;
+       _src1.i = ORC_DENORMAL(var12.i);
+       _src2.i = ORC_DENORMAL(var32.i);
+       _dest1.f = _src1.f + _src2.f;
+       var12.i = ORC_DENORMAL(_dest1.i);
+    }
+  }
+  {
+    orc_union32 _acc;
+    _acc.i = ((orc_union32 *)ex->dest_ptrs[0])->i;
+    _acc.f = _acc.f + var12.f;
+    ((orc_union32 *)ex->dest_ptrs[0])->i = ORC_DENORMAL(_acc.i);
+  }
+
+}
+
+void
+emulate_accd (OrcOpcodeExecutor *ex, int offset, int n)
+{
+  int i;
+  const orc_union64 * ORC_RESTRICT ptr4;
+  orc_union64 var12 =  { 0 };
+  orc_union64 var32;
+
+  ptr4 = (orc_union64 *)ex->src_ptrs[0];
+
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadq */
+    var32 = ptr4[i];
+    /* 1: accd */
+    {
+       orc_union64 _src1;
+       orc_union64 _src2;
+       orc_union64 _dest1;
+       _src1.i = ORC_DENORMAL_DOUBLE(var12.i);
+       _src2.i = ORC_DENORMAL_DOUBLE(var32.i);
+       _dest1.f = _src1.f + _src2.f;
+       var12.i = ORC_DENORMAL_DOUBLE(_dest1.i);
+    }
+  }
+  {
+    orc_union64 _acc;
+    _acc.i = ((orc_union64 *)ex->dest_ptrs[0])->i;
+    _acc.f = _acc.f + var12.f;
+    ((orc_union64 *)ex->dest_ptrs[0])->i = ORC_DENORMAL_DOUBLE(_acc.i);
+  }
+
+}
+
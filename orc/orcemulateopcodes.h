@@ -201,6 +201,15 @@ ORC_INTERNAL void emulate_convdf (OrcOpcodeExecutor *ex, int i, int n);
 ORC_INTERNAL void emulate_orf (OrcOpcodeExecutor *ex, int i, int n);
 ORC_INTERNAL void emulate_andf (OrcOpcodeExecutor *ex, int i, int n);
 ORC_INTERNAL void emulate_convwf (OrcOpcodeExecutor *ex, int i, int n);
+ORC_INTERNAL void emulate_accmaxub (OrcOpcodeExecutor *ex, int i, int n);
+ORC_INTERNAL void emulate_accminub (OrcOpcodeExecutor *ex, int i, int n);
+ORC_INTERNAL void emulate_accmaxsw (OrcOpcodeExecutor *ex, int i, int n);
+ORC_INTERNAL void emulate_accminsw (OrcOpcodeExecutor *ex, int i, int n);
+ORC_INTERNAL void emulate_accorl (OrcOpcodeExecutor *ex, int i, int n);
+ORC_INTERNAL void emulate_accandl (OrcOpcodeExecutor *ex, int i, int n);
+ORC_INTERNAL void emulate_accq (OrcOpcodeExecutor *ex, int i, int n);
+ORC_INTERNAL void emulate_accf (OrcOpcodeExecutor *ex, int i, int n);
+ORC_INTERNAL void emulate_accd (OrcOpcodeExecutor *ex, int i, int n);
 
 #endif
 
@@ -8,6 +8,7 @@
 #include <orc/orcprogram.h>
 #include <orc/orcutils-private.h>
 #include <orc/orcdebug.h>
+#include <orc/orcinternal.h>
 
 /**
  * SECTION:orcexecutor
@@ -15,13 +16,21 @@
  * @short_description: Running Orc programs
  */
 
-#define CHUNK_SIZE 16
+/* Number of elements processed by each instruction before moving to the
+ * next one. The actual chunk size is picked per program from the L1 data
+ * cache size, within these bounds */
+#define ORC_EMULATE_MIN_CHUNK_SIZE 16
+#define ORC_EMULATE_MAX_CHUNK_SIZE 1024
 
 static void
 orc_executor_dump_before (OrcExecutor *ex)
 {
   int i;
 
+  /* Runs on every call, skip the loops when nothing is printed */
+  if (orc_debug_get_level () < ORC_DEBUG_LOG)
+    return;
+
   ORC_LOG ("Executor before execution information");
   ORC_LOG ("n: %d", ex->n);
   ORC_LOG ("Executor variables:");
@@ -46,6 +55,9 @@ orc_executor_dump_before (OrcExecutor *ex)
 static void
 orc_executor_dump_after (OrcExecutor *ex)
 {
+  if (orc_debug_get_level () < ORC_DEBUG_LOG)
+    return;
+
   ORC_LOG ("Executor after execution information");
   ORC_LOG ("counter1: %d", ex->counter1);
   ORC_LOG ("counter2: %d", ex->counter2);
@@ -91,6 +103,258 @@ orc_executor_run (OrcExecutor *ex)
   }
 }
 
+/* orc_executor_run_parallel() splits the work into tiles that keep the
+ * data touched by a thread within half of L2. Tiles are never smaller
+ * than ORC_PARALLEL_MIN_TILE_BYTES so that the cost of running a tile
+ * stays small, and there are up to ORC_PARALLEL_TILES_PER_THREAD tiles per
+ * thread so that work stealing can even out the load. */
+#define ORC_PARALLEL_MIN_TILE_BYTES 16384
+#define ORC_PARALLEL_TILES_PER_THREAD 4
+/* 1D tiles start on a multiple of this number of elements, which keeps
+ * the alignment of every array */
+#define ORC_PARALLEL_TILE_ALIGN 64
+
+typedef struct _OrcParallelJob OrcParallelJob;
+
+struct _OrcParallelJob {
+  const OrcExecutor *ex;
+  OrcCode *code;
+  orc_bool split_m;
+  int total;
+  int tile_size;
+  orc_uint64 *accumulators;
+};
+
+static void
+orc_executor_run_tile (void *user_data, int task)
+{
+  OrcParallelJob *job = user_data;
+  OrcExecutor tile_ex;
+  int start = task * job->tile_size;
+  int count = MIN (job->tile_size, job->total - start);
+  int i;
+
+  memcpy (&tile_ex, job->ex, sizeof (OrcExecutor));
+
+  for (i = ORC_VAR_D1; i <= ORC_VAR_S8; i++) {
+    if (job->code->vars[i].size == 0)
+      continue;
+    if (job->split_m) {
+      tile_ex.arrays[i] = ORC_PTR_OFFSET (tile_ex.arrays[i],
+          (orc_intptr) tile_ex.params[i] * start);
+    } else {
+      tile_ex.arrays[i] = ORC_PTR_OFFSET (tile_ex.arrays[i],
+          (orc_intptr) job->code->vars[i].size * start);
+    }
+  }
+  if (job->split_m) {
+    ORC_EXECUTOR_M (&tile_ex) = count;
+  } else {
+    tile_ex.n = count;
+  }
+
+  orc_executor_run (&tile_ex);
+
+  for (i = 0; i < 4; i++) {
+    job->accumulators[4 * task + i] =
+        orc_executor_get_accumulator_int64 (&tile_ex, ORC_VAR_A1 + i);
+  }
+}
+
+static int
+orc_executor_get_tile_size (OrcCode *code, int total, int bytes_per_unit,
+    int n_threads)
+{
+  int tile_size;
+  int target;
+
+  target = _orc_data_cache_size_level2 > 0 ?
+      _orc_data_cache_size_level2 / 2 : 128 * 1024;
+  bytes_per_unit = MAX (bytes_per_unit, 1);
+
+  tile_size = MAX (target / bytes_per_unit, 1);
+  tile_size = MIN (tile_size, (total + n_threads * ORC_PARALLEL_TILES_PER_THREAD
+          - 1) / (n_threads * ORC_PARALLEL_TILES_PER_THREAD));
+  tile_size = MAX (tile_size,
+      (ORC_PARALLEL_MIN_TILE_BYTES + bytes_per_unit - 1) / bytes_per_unit);
+
+  if (!code->is_2d) {
+    tile_size = (tile_size + ORC_PARALLEL_TILE_ALIGN - 1) &
+        ~(ORC_PARALLEL_TILE_ALIGN - 1);
+  }
+
+  return MAX (tile_size, 1);
+}
+
+/* Whether a source of @code is read at an index computed from the
+ * loop index, the parameters or an offset, rather than at the loop
+ * index itself. Offsetting the arrays is not enough to run a tile of
+ * such programs. */
+static orc_bool
+orc_executor_has_indexed_loads (OrcCode *code)
+{
+  int i;
+
+  for (i = 0; i < code->n_insns; i++) {
+    OrcStaticOpcode *opcode = code->insns[i].opcode;
+
+    if (opcode->flags & ORC_STATIC_OPCODE_ITERATOR)
+      return TRUE;
+    if (strncmp (opcode->name, "ldres", 5) == 0 ||
+        strncmp (opcode->name, "loadoff", 7) == 0)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/**
+ * orc_executor_run_parallel:
+ * @ex: the OrcExecutor
+ * @n_threads: the maximum number of threads to use, or 0 to use the
+ *   number of processors (or the value of the ORC_THREADS environment
+ *   variable)
+ *
+ * Runs the program like orc_executor_run(), splitting the work between
+ * the calling thread and an internal thread pool. 2D programs are split
+ * into bands of rows, 1D programs without accumulators into ranges of
+ * elements. Each tile is sized to stay in cache and runs the same
+ * compiled code, and the accumulators of all tiles are combined at the
+ * end.
+ *
+ * Programs that cannot be split, because the dimension to split is a
+ * compile-time constant, because a 1D program has accumulators or
+ * because a source is read at another index than the destination, as
+ * with loadupdb or ldresnearl, and calls too small to be worth
+ * splitting run on the calling thread.
+ */
+void
+orc_executor_run_parallel (OrcExecutor *ex, int n_threads)
+{
+  OrcParallelJob job;
+  OrcCode *code;
+  int bytes_per_element = 0;
+  int has_accumulators = FALSE;
+  int n_tiles;
+  int i, j;
+
+  if (ex->program) {
+    code = ex->program->orccode;
+  } else {
+    code = (OrcCode *)ex->arrays[ORC_VAR_A2];
+  }
+  if (code == NULL) {
+    orc_executor_run (ex);
+    return;
+  }
+
+  if (orc_executor_has_indexed_loads (code)) {
+    orc_executor_run (ex);
+    return;
+  }
+
+  if (n_threads <= 0)
+    n_threads = orc_thread_pool_get_n_threads ();
+
+  for (i = ORC_VAR_D1; i <= ORC_VAR_S8; i++)
+    bytes_per_element += code->vars[i].size;
+  for (i = ORC_VAR_A1; i <= ORC_VAR_A4; i++) {
+    if (code->vars[i].size)
+      has_accumulators = TRUE;
+  }
+
+  memset (&job, 0, sizeof (job));
+  job.ex = ex;
+  job.code = code;
+  if (code->is_2d) {
+    if (code->constant_m) {
+      orc_executor_run (ex);
+      return;
+    }
+    job.split_m = TRUE;
+    job.total = ORC_EXECUTOR_M (ex);
+    job.tile_size = orc_executor_get_tile_size (code, job.total,
+        bytes_per_element * ex->n, n_threads);
+  } else {
+    if (code->constant_n || has_accumulators) {
+      orc_executor_run (ex);
+      return;
+    }
+    job.split_m = FALSE;
+    job.total = ex->n;
+    job.tile_size = orc_executor_get_tile_size (code, job.total,
+        bytes_per_element, n_threads);
+  }
+
+  n_tiles = (job.total + job.tile_size - 1) / job.tile_size;
+  if (n_threads <= 1 || n_tiles <= 1) {
+    orc_executor_run (ex);
+    return;
+  }
+
+  ORC_DEBUG ("running %d tiles of %d %s on up to %d threads", n_tiles,
+      job.tile_size, job.split_m ? "rows" : "elements", n_threads);
+
+  job.accumulators = orc_malloc (sizeof (orc_uint64) * 4 * n_tiles);
+  orc_thread_pool_run (n_tiles, n_threads, orc_executor_run_tile, &job);
+
+  for (i = 0; i < 4; i++) {
+    int size = code->vars[ORC_VAR_A1 + i].size;
+    OrcAccumulatorType type;
+    orc_uint64 value;
+
+    if (size == 0)
+      continue;
+    type = orc_accumulator_get_type (code->insns, code->n_insns,
+        ORC_VAR_A1 + i);
+    value = job.accumulators[i];
+    for (j = 1; j < n_tiles; j++) {
+      value = orc_accumulator_combine (type, size, value,
+          job.accumulators[4 * j + i]);
+    }
+    ex->accumulators[i] = (orc_uint32) value;
+    if (size == 8)
+      ex->params[ORC_VAR_T9 + i] = (orc_uint32) (value >> 32);
+  }
+
+  free (job.accumulators);
+}
+
+/**
+ * orc_executor_run_specialized:
+ * @ex: the OrcExecutor
+ *
+ * Runs the program like orc_executor_run(), with code compiled for the
+ * n, the m and the alignment of the arrays and strides of this call.
+ * The first call with a given combination compiles the program again
+ * for the target it was compiled for, as if it had declared them, and
+ * the following ones reuse that code.
+ *
+ * The program must have been compiled for an executable target. Calls
+ * that cannot be specialized run the generic code.
+ */
+void
+orc_executor_run_specialized (OrcExecutor *ex)
+{
+  OrcCode *code = NULL;
+
+  if (ex->program)
+    code = orc_program_get_variant (ex->program, ex);
+
+  if (code == NULL || code->exec == NULL) {
+    orc_executor_run (ex);
+    return;
+  }
+
+  /* Tells the code running through a wrapper, such as the one of
+   * ORC_CODE=stats, which code was picked */
+  ex->arrays[ORC_VAR_A3] = code;
+  orc_executor_dump_before (ex);
+  code->exec (ex);
+  orc_executor_dump_after (ex);
+  ex->arrays[ORC_VAR_A3] = NULL;
+}
+
 void
 orc_executor_run_backup (OrcExecutor *ex)
 {
@@ -121,6 +385,7 @@ orc_executor_set_program (OrcExecutor *ex, OrcProgram *program)
     ex->arrays[ORC_VAR_A1] = (void *)orc_executor_emulate;
   }
   ex->arrays[ORC_VAR_A2] = program->orccode;
+  ex->arrays[ORC_VAR_A3] = NULL;
 }
 
 void
@@ -204,6 +469,56 @@ orc_executor_get_accumulator_str (OrcExecutor *ex, const char *name)
   return -1;
 }
 
+/**
+ * orc_executor_get_accumulator_int64:
+ * @ex: the OrcExecutor
+ * @var: the accumulator, ORC_VAR_A1 to ORC_VAR_A4
+ *
+ * Gets the value of a 64-bit accumulator, as computed by accq.
+ *
+ * Returns: the value of the accumulator
+ */
+orc_int64
+orc_executor_get_accumulator_int64 (OrcExecutor *ex, int var)
+{
+  return (orc_uint32)ex->accumulators[var - ORC_VAR_A1] |
+      ((orc_uint64)(orc_uint32)ex->params[ORC_VAR_T9 + var - ORC_VAR_A1] << 32);
+}
+
+/**
+ * orc_executor_get_accumulator_float:
+ * @ex: the OrcExecutor
+ * @var: the accumulator, ORC_VAR_A1 to ORC_VAR_A4
+ *
+ * Gets the value of a float accumulator, as computed by accf.
+ *
+ * Returns: the value of the accumulator
+ */
+float
+orc_executor_get_accumulator_float (OrcExecutor *ex, int var)
+{
+  orc_union32 u;
+  u.i = ex->accumulators[var - ORC_VAR_A1];
+  return u.f;
+}
+
+/**
+ * orc_executor_get_accumulator_double:
+ * @ex: the OrcExecutor
+ * @var: the accumulator, ORC_VAR_A1 to ORC_VAR_A4
+ *
+ * Gets the value of a double accumulator, as computed by accd.
+ *
+ * Returns: the value of the accumulator
+ */
+double
+orc_executor_get_accumulator_double (OrcExecutor *ex, int var)
+{
+  orc_union64 u;
+  u.i = orc_executor_get_accumulator_int64 (ex, var);
+  return u.f;
+}
+
 void
 orc_executor_set_n (OrcExecutor *ex, int n)
 {
@@ -217,14 +532,14 @@ orc_executor_set_m (OrcExecutor *ex, int m)
 }
 
 static void
-load_constant (void *data, int size, orc_uint64 value)
+load_constant (void *data, int size, orc_uint64 value, int n)
 {
   switch (size) {
     case 1:
       {
         int l;
         orc_int8 *d = data;
-        for(l=0;l<CHUNK_SIZE;l++) {
+        for(l=0;l<n;l++) {
           d[l] = value;
         }
       }
@@ -233,7 +548,7 @@ load_constant (void *data, int size, orc_uint64 value)
       {
         int l;
         orc_int16 *d = data;
-        for(l=0;l<CHUNK_SIZE;l++) {
+        for(l=0;l<n;l++) {
           d[l] = value;
         }
       }
@@ -242,7 +557,7 @@ load_constant (void *data, int size, orc_uint64 value)
       {
         int l;
         orc_int32 *d = data;
-        for(l=0;l<CHUNK_SIZE;l++) {
+        for(l=0;l<n;l++) {
           d[l] = value;
         }
       }
@@ -251,7 +566,7 @@ load_constant (void *data, int size, orc_uint64 value)
       {
         int l;
         orc_int64 *d = data;
-        for(l=0;l<CHUNK_SIZE;l++) {
+        for(l=0;l<n;l++) {
           d[l] = value;
         }
       }
@@ -263,186 +578,519 @@ load_constant (void *data, int size, orc_uint64 value)
 }
 
 
-void
-orc_executor_emulate (OrcExecutor *ex)
-{
-  int i;
-  int j;
-  int k;
-  int m, m_index;
+/* The emulation plan is built once per OrcCode and resolves every
+ * instruction operand to either a scratch slot (temporaries, constants
+ * and parameters), an array or an accumulator. Running the plan only
+ * needs an OrcEmulateContext, which holds the opcode executors and the
+ * scratch memory and can be reused for any number of calls. */
+
+
+enum {
+  ORC_EMULATE_OPERAND_NONE = 0,
+  ORC_EMULATE_OPERAND_SLOT,
+  ORC_EMULATE_OPERAND_ARRAY,
+  ORC_EMULATE_OPERAND_ACCUMULATOR
+};
+
+typedef struct _OrcEmulateOperand OrcEmulateOperand;
+typedef struct _OrcEmulateInsn OrcEmulateInsn;
+typedef struct _OrcEmulatePlan OrcEmulatePlan;
+
+struct _OrcEmulateOperand {
+  int type;
+  int var;
+  int slot;
+};
+
+struct _OrcEmulateInsn {
+  OrcOpcodeEmulateNFunc emulateN;
+  int shift;
+  OrcEmulateOperand src[ORC_STATIC_OPCODE_N_SRC];
+  OrcEmulateOperand dest[ORC_STATIC_OPCODE_N_DEST];
+};
+
+struct _OrcEmulatePlan {
+  int n_insns;
+  OrcEmulateInsn *insns;
+
+  int chunk_size;
+  int slot_size;
+  int n_slots;
+
+  int n_consts;
+  int const_slots[ORC_N_COMPILER_VARIABLES];
+  orc_uint64 const_values[ORC_N_COMPILER_VARIABLES];
+
+  int n_params;
+  int param_slots[ORC_N_COMPILER_VARIABLES];
+  int param_vars[ORC_N_COMPILER_VARIABLES];
+  int param_sizes[ORC_N_COMPILER_VARIABLES];
+
+  int n_arrays;
+  int array_vars[ORC_N_COMPILER_VARIABLES];
+  int array_sizes[ORC_N_COMPILER_VARIABLES];
+
+  /* the value the accumulators start from, which is not 0 for min, max
+   * and and */
+  orc_uint64 acc_identities[4];
+
+  int context_size;
+};
+
+struct _OrcEmulateContext {
   OrcCode *code;
-  OrcInstruction *insn;
-  OrcStaticOpcode *opcode;
+  const OrcEmulatePlan *plan;
   OrcOpcodeExecutor *opcode_ex;
-  char name_placeholder[40];
-  const char* name = name_placeholder;
-  void *tmpspace[ORC_N_COMPILER_VARIABLES] = {0};
+  orc_uint8 *scratch;
+  orc_bool allocated;
+};
+
+#define ORC_EMULATE_ALIGN(x) (((x) + 15) & ~15)
+
+static void
+orc_emulate_plan_resolve (OrcEmulatePlan *plan, OrcCode *code,
+    OrcEmulateOperand *op, int var_index, int *var_slot, orc_bool is_dest)
+{
+  OrcCodeVariable *var = code->vars + var_index;
+  int i;
+
+  op->var = var_index;
+  switch (var->vartype) {
+    case ORC_VAR_TYPE_CONST:
+    case ORC_VAR_TYPE_PARAM:
+      if (is_dest) break;
+      /* fall through */
+    case ORC_VAR_TYPE_TEMP:
+      if (var_slot[var_index] < 0) {
+        var_slot[var_index] = plan->n_slots++;
+        if (var->vartype == ORC_VAR_TYPE_CONST) {
+          plan->const_slots[plan->n_consts] = var_slot[var_index];
+          plan->const_values[plan->n_consts] = var->value.i;
+          plan->n_consts++;
+        } else if (var->vartype == ORC_VAR_TYPE_PARAM) {
+          plan->param_slots[plan->n_params] = var_slot[var_index];
+          plan->param_vars[plan->n_params] = var_index;
+          plan->param_sizes[plan->n_params] = var->size;
+          plan->n_params++;
+        }
+      }
+      op->type = ORC_EMULATE_OPERAND_SLOT;
+      op->slot = var_slot[var_index];
+      break;
+    case ORC_VAR_TYPE_SRC:
+    case ORC_VAR_TYPE_DEST:
+      if (is_dest && var->vartype == ORC_VAR_TYPE_SRC) break;
+      op->type = ORC_EMULATE_OPERAND_ARRAY;
+      for (i = 0; i < plan->n_arrays; i++) {
+        if (plan->array_vars[i] == var_index) break;
+      }
+      if (i == plan->n_arrays) {
+        plan->array_vars[i] = var_index;
+        plan->array_sizes[i] = var->size;
+        plan->n_arrays++;
+      }
+      break;
+    case ORC_VAR_TYPE_ACCUMULATOR:
+      if (!is_dest) break;
+      op->type = ORC_EMULATE_OPERAND_ACCUMULATOR;
+      break;
+    default:
+      break;
+  }
+}
+
+/* Pick the largest chunk for which the scratch memory of all temporaries
+ * stays within a quarter of the L1 data cache, leaving room for the
+ * source and destination streams. */
+static int
+orc_emulate_get_chunk_size (int n_slots)
+{
+  int chunk_size = ORC_EMULATE_MIN_CHUNK_SIZE;
+  int budget = _orc_data_cache_size_level1 / 4;
+
+  if (n_slots < 1)
+    n_slots = 1;
+
+  while (chunk_size < ORC_EMULATE_MAX_CHUNK_SIZE &&
+      2 * chunk_size * ORC_MAX_VAR_SIZE * n_slots <= budget) {
+    chunk_size *= 2;
+  }
+
+  return chunk_size;
+}
+
+static OrcEmulatePlan *
+orc_emulate_plan_new (OrcCode *code)
+{
+  OrcEmulatePlan *plan;
+  int *var_slot;
+  int n_vars = ORC_N_VARIABLES;
+  int j, k;
+
+  plan = orc_malloc (sizeof (OrcEmulatePlan) +
+      sizeof (OrcEmulateInsn) * code->n_insns);
+  memset (plan, 0, sizeof (OrcEmulatePlan) +
+      sizeof (OrcEmulateInsn) * code->n_insns);
+  plan->insns = (OrcEmulateInsn *) (plan + 1);
+  plan->n_insns = code->n_insns;
+
+  /* The code keeps as many variables as the compiler needed, which is
+   * not recorded, only the ones the instructions use matter here */
+  for (j = 0; j < code->n_insns; j++) {
+    OrcInstruction *insn = code->insns + j;
 
-  memset(name_placeholder, '\0', sizeof(name_placeholder));
+    for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+      if (insn->opcode->src_size[k])
+        n_vars = MAX (n_vars, insn->src_args[k] + 1);
+    }
+    for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+      if (insn->opcode->dest_size[k])
+        n_vars = MAX (n_vars, insn->dest_args[k] + 1);
+    }
+  }
+  var_slot = orc_malloc (sizeof (int) * n_vars);
+  for (j = 0; j < n_vars; j++)
+    var_slot[j] = -1;
+
+  for (j = 0; j < code->n_insns; j++) {
+    OrcInstruction *insn = code->insns + j;
+    OrcStaticOpcode *opcode = insn->opcode;
+    OrcEmulateInsn *einsn = plan->insns + j;
+
+    einsn->emulateN = opcode->emulateN;
+    einsn->shift = 0;
+    if (insn->flags & ORC_INSTRUCTION_FLAG_X2) {
+      einsn->shift = 1;
+    } else if (insn->flags & ORC_INSTRUCTION_FLAG_X4) {
+      einsn->shift = 2;
+    }
+
+    for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+      if (opcode->src_size[k] == 0) continue;
+      orc_emulate_plan_resolve (plan, code, &einsn->src[k],
+          insn->src_args[k], var_slot, FALSE);
+    }
+    for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+      if (opcode->dest_size[k] == 0) continue;
+      orc_emulate_plan_resolve (plan, code, &einsn->dest[k],
+          insn->dest_args[k], var_slot, TRUE);
+    }
+  }
+
+  free (var_slot);
+
+  for (j = 0; j < 4; j++) {
+    if (code->vars[ORC_VAR_A1 + j].size == 0) continue;
+    plan->acc_identities[j] = orc_accumulator_get_identity (
+        orc_accumulator_get_type (code->insns, code->n_insns, ORC_VAR_A1 + j),
+        code->vars[ORC_VAR_A1 + j].size);
+  }
+
+  plan->chunk_size = orc_emulate_get_chunk_size (plan->n_slots);
+  plan->slot_size = ORC_MAX_VAR_SIZE * plan->chunk_size;
+  plan->context_size = ORC_EMULATE_ALIGN (sizeof (OrcEmulateContext)) +
+      ORC_EMULATE_ALIGN (sizeof (OrcOpcodeExecutor) * code->n_insns) +
+      plan->slot_size * plan->n_slots;
+
+  return plan;
+}
+
+/* The plan is stored with release semantics, a thread that loads it
+ * sees it filled in */
+void
+orc_code_emulate_plan_init (OrcCode *code)
+{
+  if (code->emulate_plan == NULL)
+    orc_atomic_store_pointer (&code->emulate_plan,
+        orc_emulate_plan_new (code));
+}
+
+static const OrcEmulatePlan *
+orc_emulate_plan_get (OrcCode *code)
+{
+  const OrcEmulatePlan *plan;
+
+  plan = orc_atomic_load_pointer (&code->emulate_plan);
+  if (ORC_LIKELY (plan != NULL))
+    return plan;
+
+  /* The plan is normally created by the compiler before the code is
+   * handed out, this only covers OrcCode set up by other means. Another
+   * thread may be creating it, so it is created with the mutex held */
+  orc_global_mutex_lock ();
+  orc_code_emulate_plan_init (code);
+  plan = code->emulate_plan;
+  orc_global_mutex_unlock ();
+
+  return plan;
+}
+
+void
+orc_code_emulate_plan_free (OrcCode *code)
+{
+  free (code->emulate_plan);
+  code->emulate_plan = NULL;
+}
+
+static OrcEmulateContext *
+orc_emulate_context_init (void *memory, OrcCode *code,
+    const OrcEmulatePlan *plan)
+{
+  OrcEmulateContext *ctx = memory;
+  int i, j, k;
+
+  ctx->code = code;
+  ctx->plan = plan;
+  ctx->allocated = FALSE;
+  ctx->opcode_ex = (OrcOpcodeExecutor *) ((orc_uint8 *) memory +
+      ORC_EMULATE_ALIGN (sizeof (OrcEmulateContext)));
+  ctx->scratch = (orc_uint8 *) ctx->opcode_ex +
+      ORC_EMULATE_ALIGN (sizeof (OrcOpcodeExecutor) * plan->n_insns);
+
+  memset (ctx->opcode_ex, 0, sizeof (OrcOpcodeExecutor) * plan->n_insns);
+
+  for (j = 0; j < plan->n_insns; j++) {
+    const OrcEmulateInsn *einsn = plan->insns + j;
+    OrcOpcodeExecutor *opcode_ex = ctx->opcode_ex + j;
+
+    opcode_ex->emulateN = einsn->emulateN;
+    opcode_ex->shift = einsn->shift;
+    for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+      if (einsn->src[k].type == ORC_EMULATE_OPERAND_SLOT)
+        opcode_ex->src_ptrs[k] =
+            ctx->scratch + einsn->src[k].slot * plan->slot_size;
+    }
+    for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+      if (einsn->dest[k].type == ORC_EMULATE_OPERAND_SLOT)
+        opcode_ex->dest_ptrs[k] =
+            ctx->scratch + einsn->dest[k].slot * plan->slot_size;
+    }
+  }
+
+  /* FIXME hack: constants are always expanded as 64-bit values */
+  for (i = 0; i < plan->n_consts; i++) {
+    load_constant (ctx->scratch + plan->const_slots[i] * plan->slot_size,
+        8, plan->const_values[i], plan->chunk_size);
+  }
+
+  return ctx;
+}
+
+/**
+ * orc_emulate_context_new:
+ * @code: the OrcCode to emulate
+ *
+ * Creates a context that can be used with orc_executor_emulate_with_context()
+ * to emulate @code repeatedly without any memory allocation per call.
+ * A context must not be used by several threads at the same time.
+ *
+ * Returns: a new OrcEmulateContext, free with orc_emulate_context_free()
+ */
+OrcEmulateContext *
+orc_emulate_context_new (OrcCode *code)
+{
+  const OrcEmulatePlan *plan;
+  OrcEmulateContext *ctx;
+
+  if (code == NULL) {
+    ORC_ERROR("attempt to emulate program that failed to compile");
+    return NULL;
+  }
+
+  plan = orc_emulate_plan_get (code);
+  ctx = orc_emulate_context_init (orc_malloc (plan->context_size), code, plan);
+  ctx->allocated = TRUE;
+
+  return ctx;
+}
 
+/**
+ * orc_emulate_context_free:
+ * @ctx: an OrcEmulateContext
+ *
+ * Frees a context created with orc_emulate_context_new().
+ */
+void
+orc_emulate_context_free (OrcEmulateContext *ctx)
+{
+  if (ctx && ctx->allocated)
+    free (ctx);
+}
+
+static void
+orc_executor_emulate_error (OrcExecutor *ex, int var)
+{
+  char name_placeholder[40];
+  const char *name = name_placeholder;
+
+  memset (name_placeholder, '\0', sizeof (name_placeholder));
   if (ex->program) {
-    code = ex->program->orccode;
     if (ex->program->name == NULL) {
-      sprintf(name_placeholder, "<unnamed program @ %p>", ex->program);
+      sprintf (name_placeholder, "<unnamed program @ %p>", ex->program);
     } else {
       name = ex->program->name;
     }
   } else {
-    code = (OrcCode *)ex->arrays[ORC_VAR_A2];
-    sprintf(name_placeholder, "<unnamed source @ %p>", ex);
+    sprintf (name_placeholder, "<unnamed source @ %p>", ex);
   }
 
-  ex->accumulators[0] = 0;
-  ex->accumulators[1] = 0;
-  ex->accumulators[2] = 0;
-  ex->accumulators[3] = 0;
-
-  ORC_DEBUG("emulating");
+  if (var >= ORC_VAR_S1) {
+    ORC_ERROR ("Unaligned array for src%d, program %s", var - ORC_VAR_S1,
+        name);
+  } else {
+    ORC_ERROR ("Unaligned array for dest%d, program %s", var - ORC_VAR_D1,
+        name);
+  }
+}
 
-  memset (&opcode_ex, 0, sizeof(opcode_ex));
+/**
+ * orc_executor_emulate_with_context:
+ * @ex: the OrcExecutor
+ * @ctx: an OrcEmulateContext created for the code of @ex
+ *
+ * Emulates the program set up in @ex like orc_executor_emulate(), using
+ * the opcode table and scratch memory of @ctx instead of allocating them.
+ */
+void
+orc_executor_emulate_with_context (OrcExecutor *ex, OrcEmulateContext *ctx)
+{
+  const OrcEmulatePlan *plan = ctx->plan;
+  OrcOpcodeExecutor *opcode_ex = ctx->opcode_ex;
+  int chunk_size = plan->chunk_size;
+  orc_union64 accumulators64[4];
+  int i, j, k;
+  int m, m_index;
 
-  if (code == NULL) {
-    ORC_ERROR("attempt to run program that failed to compile");
-    ORC_ASSERT(0);
+  /* 64-bit accumulators are split between accumulators[] and params[]
+   * at the end, the others are combined in place */
+  for (i = 0; i < 4; i++) {
+    ex->accumulators[i] = (orc_uint32) plan->acc_identities[i];
+    accumulators64[i].i = plan->acc_identities[i];
   }
 
-  if (code->is_2d) {
+  if (ctx->code->is_2d) {
     m = ORC_EXECUTOR_M(ex);
   } else {
     m = 1;
   }
 
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
-    OrcCodeVariable *var = code->vars + i;
-
-    if (var->size) {
-      tmpspace[i] = orc_malloc(ORC_MAX_VAR_SIZE * CHUNK_SIZE);
+  for (i = 0; i < plan->n_arrays; i++) {
+    int var = plan->array_vars[i];
+    if (ORC_PTR_TO_INT(ex->arrays[var]) & (plan->array_sizes[i] - 1)) {
+      orc_executor_emulate_error (ex, var);
     }
   }
 
-  opcode_ex = orc_malloc(sizeof(OrcOpcodeExecutor)*code->n_insns);
-
-  for(j=0;j<code->n_insns;j++){
-    insn = code->insns + j;
-    opcode = insn->opcode;
+  /* FIXME hack: parameters are always expanded as 64-bit values */
+  for (i = 0; i < plan->n_params; i++) {
+    int var = plan->param_vars[i];
+    orc_uint64 value;
 
-    opcode_ex[j].emulateN = opcode->emulateN;
-    opcode_ex[j].shift = 0;
-    if (insn->flags & ORC_INSTRUCTION_FLAG_X2) {
-      opcode_ex[j].shift = 1;
-    } else if (insn->flags & ORC_INSTRUCTION_FLAG_X4) {
-      opcode_ex[j].shift = 2;
+    if (plan->param_sizes[i] == 8) {
+      value = (orc_uint64)(orc_uint32)ex->params[var] |
+          (((orc_uint64)(orc_uint32)ex->params[var + (ORC_N_PARAMS)])<<32);
+    } else {
+      value = ex->params[var];
     }
+    /* Short rows only read the beginning of the slot */
+    load_constant (ctx->scratch + plan->param_slots[i] * plan->slot_size,
+        8, value, ORC_CLAMP (ex->n, ORC_EMULATE_MIN_CHUNK_SIZE, chunk_size));
+  }
 
-    for(k=0;k<ORC_STATIC_OPCODE_N_SRC;k++) {
-      OrcCodeVariable *var = code->vars + insn->src_args[k];
-      if (opcode->src_size[k] == 0) continue;
-
-      if (var->vartype == ORC_VAR_TYPE_CONST) {
-        opcode_ex[j].src_ptrs[k] = tmpspace[insn->src_args[k]];
-        /* FIXME hack */
-        load_constant (tmpspace[insn->src_args[k]], 8,
-            var->value.i);
-      } else if (var->vartype == ORC_VAR_TYPE_PARAM) {
-        opcode_ex[j].src_ptrs[k] = tmpspace[insn->src_args[k]];
-        /* FIXME hack */
-        if (var->size == 8) {
-          load_constant (tmpspace[insn->src_args[k]], 8,
-              (orc_uint64)(orc_uint32)ex->params[insn->src_args[k]] |
-              (((orc_uint64)(orc_uint32)ex->params[insn->src_args[k] +
-               (ORC_N_PARAMS)])<<32));
-        } else {
-          load_constant (tmpspace[insn->src_args[k]], 8,
-              ex->params[insn->src_args[k]]);
-        }
-      } else if (var->vartype == ORC_VAR_TYPE_TEMP) {
-        opcode_ex[j].src_ptrs[k] = tmpspace[insn->src_args[k]];
-      } else if (var->vartype == ORC_VAR_TYPE_SRC) {
-        if (ORC_PTR_TO_INT(ex->arrays[insn->src_args[k]]) & (var->size - 1)) {
-          ORC_ERROR("Unaligned array for src%d, program %s",
-              (insn->src_args[k]-ORC_VAR_S1), name);
-        }
-        opcode_ex[j].src_ptrs[k] = ex->arrays[insn->src_args[k]];
-      } else if (var->vartype == ORC_VAR_TYPE_DEST) {
-        if (ORC_PTR_TO_INT(ex->arrays[insn->src_args[k]]) & (var->size - 1)) {
-          ORC_ERROR("Unaligned array for dest%d, program %s",
-              (insn->src_args[k]-ORC_VAR_D1), name);
-        }
-        opcode_ex[j].src_ptrs[k] = ex->arrays[insn->src_args[k]];
-      }
-    }
-    for(k=0;k<ORC_STATIC_OPCODE_N_DEST;k++) {
-      OrcCodeVariable *var = code->vars + insn->dest_args[k];
-      if (opcode->dest_size[k] == 0) continue;
+  for (j = 0; j < plan->n_insns; j++) {
+    const OrcEmulateInsn *einsn = plan->insns + j;
+    for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+      int var = einsn->dest[k].var;
 
-      if (var->vartype == ORC_VAR_TYPE_TEMP) {
-        ORC_DEBUG("dest vartype tmp %d", insn->dest_args[k]);
-        opcode_ex[j].dest_ptrs[k] = tmpspace[insn->dest_args[k]];
-      } else if (var->vartype == ORC_VAR_TYPE_ACCUMULATOR) {
-        opcode_ex[j].dest_ptrs[k] =
-          &ex->accumulators[insn->dest_args[k] - ORC_VAR_A1];
-      } else if (var->vartype == ORC_VAR_TYPE_DEST) {
-        if (ORC_PTR_TO_INT(ex->arrays[insn->dest_args[k]]) & (var->size - 1)) {
-          ORC_ERROR("Unaligned array for dest%d, program %s",
-              (insn->dest_args[k]-ORC_VAR_D1), name);
-        }
-        opcode_ex[j].dest_ptrs[k] = ex->arrays[insn->dest_args[k]];
+      if (einsn->dest[k].type != ORC_EMULATE_OPERAND_ACCUMULATOR)
+        continue;
+      if (ctx->code->vars[var].size == 8) {
+        opcode_ex[j].dest_ptrs[k] = &accumulators64[var - ORC_VAR_A1];
+      } else {
+        opcode_ex[j].dest_ptrs[k] = &ex->accumulators[var - ORC_VAR_A1];
       }
     }
-    ORC_DEBUG("opcode %s %p %p %p", opcode->name,
-        opcode_ex[j].dest_ptrs[0], opcode_ex[j].src_ptrs[0],
-        opcode_ex[j].src_ptrs[1]);
   }
-  
-  ORC_DEBUG("src ptr %p stride %d", ex->arrays[ORC_VAR_S1], ex->params[ORC_VAR_S1]);
-  for(m_index=0;m_index<m;m_index++){
-    ORC_DEBUG("m_index %d m %d", m_index, m);
-
-    for(j=0;j<code->n_insns;j++){
-      insn = code->insns + j;
-      opcode = insn->opcode;
 
-      for(k=0;k<ORC_STATIC_OPCODE_N_SRC;k++) {
-        OrcCodeVariable *var = code->vars + insn->src_args[k];
-        if (opcode->src_size[k] == 0) continue;
+  for (m_index = 0; m_index < m; m_index++) {
+    for (j = 0; j < plan->n_insns; j++) {
+      const OrcEmulateInsn *einsn = plan->insns + j;
 
-        if (var->vartype == ORC_VAR_TYPE_SRC) {
+      for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+        if (einsn->src[k].type == ORC_EMULATE_OPERAND_ARRAY) {
+          int var = einsn->src[k].var;
           opcode_ex[j].src_ptrs[k] =
-            ORC_PTR_OFFSET(ex->arrays[insn->src_args[k]],
-                ex->params[insn->src_args[k]]*m_index);
-        } else if (var->vartype == ORC_VAR_TYPE_DEST) {
-          opcode_ex[j].src_ptrs[k] =
-            ORC_PTR_OFFSET(ex->arrays[insn->src_args[k]],
-                ex->params[insn->src_args[k]]*m_index);
+            ORC_PTR_OFFSET(ex->arrays[var], ex->params[var] * m_index);
         }
       }
-      for(k=0;k<ORC_STATIC_OPCODE_N_DEST;k++) {
-        OrcCodeVariable *var = code->vars + insn->dest_args[k];
-        if (opcode->dest_size[k] == 0) continue;
-
-        if (var->vartype == ORC_VAR_TYPE_DEST) {
+      for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+        if (einsn->dest[k].type == ORC_EMULATE_OPERAND_ARRAY) {
+          int var = einsn->dest[k].var;
           opcode_ex[j].dest_ptrs[k] =
-            ORC_PTR_OFFSET(ex->arrays[insn->dest_args[k]],
-                ex->params[insn->dest_args[k]]*m_index);
+            ORC_PTR_OFFSET(ex->arrays[var], ex->params[var] * m_index);
         }
       }
     }
 
-    for(i=0;i<ex->n;i+=CHUNK_SIZE){
-      for(j=0;j<code->n_insns;j++){
-        if (ex->n - i >= CHUNK_SIZE) {
-          opcode_ex[j].emulateN (opcode_ex + j, i, CHUNK_SIZE << opcode_ex[j].shift);
+    for (i = 0; i < ex->n; i += chunk_size) {
+      for (j = 0; j < plan->n_insns; j++) {
+        if (ex->n - i >= chunk_size) {
+          opcode_ex[j].emulateN (opcode_ex + j, i,
+              chunk_size << opcode_ex[j].shift);
         } else {
-          opcode_ex[j].emulateN (opcode_ex + j, i, (ex->n - i) << opcode_ex[j].shift);
+          opcode_ex[j].emulateN (opcode_ex + j, i,
+              (ex->n - i) << opcode_ex[j].shift);
         }
       }
     }
   }
 
-  free (opcode_ex);
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
-    if (tmpspace[i]) free (tmpspace[i]);
+  for (i = 0; i < 4; i++) {
+    if (ctx->code->vars[ORC_VAR_A1 + i].size != 8) continue;
+    ex->accumulators[i] = (orc_uint32) accumulators64[i].i;
+    ex->params[ORC_VAR_T9 + i] = (orc_uint32) (accumulators64[i].i >> 32);
   }
 }
 
+/* Contexts up to this size are placed on the stack by
+ * orc_executor_emulate(), which covers all but the largest programs */
+#define ORC_EMULATE_STACK_SIZE 16384
+
+void
+orc_executor_emulate (OrcExecutor *ex)
+{
+  union {
+    orc_uint64 align;
+    orc_uint8 data[ORC_EMULATE_STACK_SIZE];
+  } stack;
+  const OrcEmulatePlan *plan;
+  OrcEmulateContext *ctx;
+  OrcCode *code;
+  void *memory;
+
+  if (ex->program) {
+    code = ex->program->orccode;
+  } else {
+    code = (OrcCode *)ex->arrays[ORC_VAR_A2];
+  }
 
+  ORC_DEBUG("emulating");
+
+  if (code == NULL) {
+    ORC_ERROR("attempt to run program that failed to compile");
+    ORC_ASSERT(0);
+  }
+
+  plan = orc_emulate_plan_get (code);
+  if (plan->context_size <= ORC_EMULATE_STACK_SIZE) {
+    memory = stack.data;
+  } else {
+    memory = orc_malloc (plan->context_size);
+  }
+
+  ctx = orc_emulate_context_init (memory, code, plan);
+  orc_executor_emulate_with_context (ex, ctx);
+
+  if (memory != stack.data)
+    free (memory);
+}
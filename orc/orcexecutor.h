@@ -13,6 +13,7 @@ ORC_BEGIN_DECLS
 typedef struct _OrcOpcodeExecutor OrcOpcodeExecutor;
 typedef struct _OrcExecutor OrcExecutor;
 typedef struct _OrcExecutorAlt OrcExecutorAlt;
+typedef struct _OrcEmulateContext OrcEmulateContext;
 
 typedef void (*OrcOpcodeEmulateFunc)(OrcOpcodeExecutor *ex, void *user);
 typedef void (*OrcOpcodeEmulateNFunc)(OrcOpcodeExecutor *ex, int index, int n);
@@ -54,12 +55,14 @@ struct _OrcExecutor {
   int accumulators[4];
   /* exec pointer is stored in arrays[ORC_VAR_A1] */
   /* OrcCode pointer is stored in arrays[ORC_VAR_A2] */
+  /* the specialized OrcCode being run is stored in arrays[ORC_VAR_A3] */
   /* row pointers are stored in arrays[i+ORC_VAR_C1] */
   /* the stride for arrays[x] is stored in params[x] */
   /* m is stored in params[ORC_VAR_A1] */
   /* m_index is stored in params[ORC_VAR_A2] */
   /* elapsed time is stored in params[ORC_VAR_A3] */
   /* high half of params is stored in params[ORC_VAR_T1..] */
+  /* high half of 64-bit accumulators is stored in params[ORC_VAR_T9..] */
 };
 
 /* the alternate view of OrcExecutor */
@@ -83,7 +86,8 @@ struct _OrcExecutorAlt {
   int unused4[8];
   int params[ORC_N_PARAMS];
   int params_hi[ORC_N_PARAMS];
-  int unused3[ORC_N_VARIABLES - ORC_VAR_T9];
+  int accumulators_hi[4];
+  int unused3[ORC_N_VARIABLES - ORC_VAR_T9 - 4];
   int accumulators[4];
 };
 #define ORC_EXECUTOR_EXEC(ex) ((OrcExecutorFunc)((ex)->arrays[ORC_VAR_A1]))
@@ -120,16 +124,32 @@ ORC_API int orc_executor_get_accumulator (OrcExecutor *ex, int var);
 
 ORC_API int orc_executor_get_accumulator_str (OrcExecutor *ex, const char *name);
 
+ORC_API orc_int64 orc_executor_get_accumulator_int64 (OrcExecutor *ex, int var);
+
+ORC_API float orc_executor_get_accumulator_float (OrcExecutor *ex, int var);
+
+ORC_API double orc_executor_get_accumulator_double (OrcExecutor *ex, int var);
+
 ORC_API void orc_executor_set_n (OrcExecutor *ex, int n);
 
 ORC_API void orc_executor_set_m (OrcExecutor *ex, int m);
 
 ORC_API void orc_executor_emulate (OrcExecutor *ex);
 
+ORC_API OrcEmulateContext * orc_emulate_context_new (OrcCode *code);
+
+ORC_API void orc_emulate_context_free (OrcEmulateContext *ctx);
+
+ORC_API void orc_executor_emulate_with_context (OrcExecutor *ex, OrcEmulateContext *ctx);
+
 ORC_API void orc_executor_run (OrcExecutor *ex);
 
 ORC_API void orc_executor_run_backup (OrcExecutor *ex);
 
+ORC_API void orc_executor_run_parallel (OrcExecutor *ex, int n_threads);
+
+ORC_API void orc_executor_run_specialized (OrcExecutor *ex);
+
 
 ORC_END_DECLS
 
@@ -0,0 +1,337 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <orc/orcprogram.h>
+#include <orc/orcdebug.h>
+#include <orc/orcinternal.h>
+#include <orc/orcutils-private.h>
+
+/**
+ * SECTION:orcfuse
+ * @title: Program fusion
+ * @short_description: Combining programs into a single pass
+ *
+ * Processing that is split into several programs, each one reading the
+ * arrays the previous one wrote, goes through memory once per program.
+ * orc_program_fuse() builds one program that does the work of two of
+ * them in a single loop, the arrays passed from one to the other
+ * becoming temporaries. Longer chains are built by fusing the result
+ * with the next program.
+ */
+
+typedef struct _OrcFuseAccess OrcFuseAccess;
+
+struct _OrcFuseAccess {
+  const char *load_or_store;
+  const char *copy;
+};
+
+/* Plain loads and stores of a linked array are turned into copies */
+static const OrcFuseAccess orc_fuse_accesses[] = {
+  { "loadb", "copyb" },
+  { "loadw", "copyw" },
+  { "loadl", "copyl" },
+  { "loadq", "copyq" },
+  { "storeb", "copyb" },
+  { "storew", "copyw" },
+  { "storel", "copyl" },
+  { "storeq", "copyq" },
+};
+
+static OrcStaticOpcode *
+orc_fuse_get_copy_opcode (OrcStaticOpcode *opcode)
+{
+  int i;
+
+  for (i = 0; i < ARRAY_SIZE (orc_fuse_accesses); i++) {
+    if (strcmp (opcode->name, orc_fuse_accesses[i].load_or_store) == 0)
+      return orc_opcode_find_by_name (orc_fuse_accesses[i].copy);
+  }
+
+  return NULL;
+}
+
+/* Checks how @program uses the array @var that is turned into a
+ * temporary. Destinations have to be written before they are read. */
+static orc_bool
+orc_fuse_check_linked_var (OrcProgram *program, int var, orc_bool is_dest)
+{
+  orc_bool written = !is_dest;
+  int j, k;
+
+  for (j = 0; j < program->n_insns; j++) {
+    OrcInstruction *insn = program->insns + j;
+    OrcStaticOpcode *opcode = insn->opcode;
+    orc_bool access = FALSE;
+
+    for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+      if (opcode->src_size[k] == 0 || insn->src_args[k] != var) continue;
+      if (!written) return FALSE;
+      access = TRUE;
+    }
+    for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+      if (opcode->dest_size[k] == 0 || insn->dest_args[k] != var) continue;
+      written = TRUE;
+      access = TRUE;
+    }
+    if (access && (opcode->flags & (ORC_STATIC_OPCODE_LOAD |
+              ORC_STATIC_OPCODE_STORE)) &&
+        orc_fuse_get_copy_opcode (opcode) == NULL)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Variables keep their name, those of the second program that are taken
+ * get a number appended */
+static char *
+orc_fuse_get_var_name (OrcProgram *fused, const char *name)
+{
+  char *s;
+  int i;
+
+  if (orc_program_find_var_by_name (fused, name) == -1)
+    return strdup (name);
+
+  s = orc_malloc (strlen (name) + 16);
+  for (i = 2;; i++) {
+    sprintf (s, "%s_%d", name, i);
+    if (orc_program_find_var_by_name (fused, s) == -1)
+      break;
+  }
+
+  return s;
+}
+
+static int
+orc_fuse_add_var (OrcProgram *fused, const OrcVariable *var)
+{
+  char *name = orc_fuse_get_var_name (fused, var->name);
+  int i = -1;
+
+  switch (var->vartype) {
+    case ORC_VAR_TYPE_SRC:
+      i = orc_program_add_source_full (fused, var->size, name,
+          var->type_name, var->alignment);
+      break;
+    case ORC_VAR_TYPE_DEST:
+      i = orc_program_add_destination_full (fused, var->size, name,
+          var->type_name, var->alignment);
+      break;
+    case ORC_VAR_TYPE_CONST:
+      for (i = ORC_VAR_C1; i < ORC_VAR_C1 + fused->n_const_vars; i++) {
+        if (fused->vars[i].size == var->size &&
+            fused->vars[i].value.i == var->value.i)
+          break;
+      }
+      if (i == ORC_VAR_C1 + fused->n_const_vars)
+        i = orc_program_add_constant_int64 (fused, var->size, var->value.i,
+            name);
+      break;
+    case ORC_VAR_TYPE_PARAM:
+      i = orc_program_add_parameter (fused, var->size, name);
+      if (i == ORC_VAR_P1 + fused->n_param_vars - 1)
+        fused->vars[i].param_type = var->param_type;
+      break;
+    case ORC_VAR_TYPE_ACCUMULATOR:
+      i = orc_program_add_accumulator (fused, var->size, name);
+      break;
+    case ORC_VAR_TYPE_TEMP:
+      i = orc_program_add_temporary (fused, var->size, name);
+      break;
+    default:
+      ORC_ASSERT (0);
+      break;
+  }
+  free (name);
+
+  return i;
+}
+
+static void
+orc_fuse_append_insns (OrcProgram *fused, OrcProgram *program,
+    const int *map, const orc_bool *linked)
+{
+  int j, k;
+
+  for (j = 0; j < program->n_insns; j++) {
+    OrcInstruction *insn = orc_program_new_insn (fused);
+    orc_bool is_linked = FALSE;
+
+    memcpy (insn, program->insns + j, sizeof (OrcInstruction));
+    for (k = 0; k < ORC_STATIC_OPCODE_N_SRC; k++) {
+      if (insn->opcode->src_size[k] == 0) continue;
+      is_linked |= linked[insn->src_args[k]];
+      insn->src_args[k] = map[insn->src_args[k]];
+    }
+    for (k = 0; k < ORC_STATIC_OPCODE_N_DEST; k++) {
+      if (insn->opcode->dest_size[k] == 0) continue;
+      is_linked |= linked[insn->dest_args[k]];
+      insn->dest_args[k] = map[insn->dest_args[k]];
+    }
+    if (is_linked && (insn->opcode->flags & (ORC_STATIC_OPCODE_LOAD |
+              ORC_STATIC_OPCODE_STORE)))
+      insn->opcode = orc_fuse_get_copy_opcode (insn->opcode);
+
+    fused->n_insns++;
+  }
+}
+
+/**
+ * orc_program_fuse:
+ * @first: the program that runs first
+ * @second: the program that reads the arrays written by @first
+ * @n_links: the number of arrays passed from @first to @second
+ * @dests: the destinations of @first that are passed to @second
+ * @srcs: the sources of @second that read them, in the same order
+ *
+ * Creates a program that does the work of @first and then @second in a
+ * single loop. Each destination in @dests becomes a temporary that
+ * @second reads instead of its source in @srcs, so the array in between
+ * is never written to memory. All the other variables of both programs
+ * are kept, in the order of @first and then @second. Constants with the
+ * same value are shared. Variables of @second whose name is used by
+ * @first get a number appended, such as "s1_2", and are found with
+ * orc_program_find_var_by_name(). Temporaries of @second take over the
+ * temporaries of @first of the same size when possible, since the ones
+ * of @first are not used anymore once @second starts.
+ *
+ * Linked destinations must be written before @first reads them, and
+ * both programs must access the linked arrays element by element, with
+ * no offsets or resampling. The programs must both be 2D or both be 1D.
+ *
+ * The programs are not modified. When they cannot be fused, the
+ * returned program has an error set, see orc_program_get_error().
+ *
+ * Returns: a new program, to be freed with orc_program_free()
+ */
+OrcProgram *
+orc_program_fuse (OrcProgram *first, OrcProgram *second, int n_links,
+    const int *dests, const int *srcs)
+{
+  OrcProgram *fused;
+  int map1[ORC_N_VARIABLES];
+  int map2[ORC_N_VARIABLES];
+  orc_bool linked1[ORC_N_VARIABLES] = { 0 };
+  orc_bool linked2[ORC_N_VARIABLES] = { 0 };
+  orc_bool taken[ORC_N_VARIABLES] = { 0 };
+  char *name;
+  int i, k;
+
+  fused = orc_program_new ();
+  name = orc_malloc (strlen (first->name) + strlen (second->name) + 2);
+  sprintf (name, "%s_%s", first->name, second->name);
+  orc_program_set_name (fused, name);
+  free (name);
+
+  if (first->is_2d != second->is_2d) {
+    orc_program_set_error (fused, "cannot fuse 1D and 2D programs");
+    return fused;
+  }
+  if (first->constant_n && second->constant_n &&
+      first->constant_n != second->constant_n) {
+    orc_program_set_error (fused, "programs have different constant n");
+    return fused;
+  }
+  if (first->constant_m && second->constant_m &&
+      first->constant_m != second->constant_m) {
+    orc_program_set_error (fused, "programs have different constant m");
+    return fused;
+  }
+
+  for (k = 0; k < n_links; k++) {
+    int d = dests[k];
+    int s = srcs[k];
+
+    if (d < ORC_VAR_D1 || d >= ORC_VAR_D1 + ORC_MAX_DEST_VARS ||
+        first->vars[d].vartype != ORC_VAR_TYPE_DEST ||
+        s < ORC_VAR_S1 || s >= ORC_VAR_S1 + ORC_MAX_SRC_VARS ||
+        second->vars[s].vartype != ORC_VAR_TYPE_SRC ||
+        first->vars[d].size == 0 || second->vars[s].size == 0) {
+      orc_program_set_error (fused, "link is not from a destination to a source");
+      return fused;
+    }
+    if (first->vars[d].size != second->vars[s].size) {
+      orc_program_set_error (fused, "linked arrays have different sizes");
+      return fused;
+    }
+    if (linked1[d] || linked2[s]) {
+      orc_program_set_error (fused, "array is linked more than once");
+      return fused;
+    }
+    if (!orc_fuse_check_linked_var (first, d, TRUE) ||
+        !orc_fuse_check_linked_var (second, s, FALSE)) {
+      orc_program_set_error (fused, "linked array is not accessed element by element");
+      return fused;
+    }
+    linked1[d] = TRUE;
+    linked2[s] = TRUE;
+  }
+
+  for (i = 0; i < ORC_N_VARIABLES; i++) {
+    map1[i] = -1;
+    map2[i] = -1;
+  }
+
+  /* Arrays, constants, parameters and accumulators, in the order of the
+   * variable indices so that @first keeps its own */
+  for (i = 0; i < ORC_VAR_T1; i++) {
+    if (first->vars[i].size && !linked1[i])
+      map1[i] = orc_fuse_add_var (fused, first->vars + i);
+    if (second->vars[i].size && !linked2[i])
+      map2[i] = orc_fuse_add_var (fused, second->vars + i);
+  }
+
+  for (i = ORC_VAR_T1; i < ORC_VAR_T1 + first->n_temp_vars; i++)
+    map1[i] = orc_fuse_add_var (fused, first->vars + i);
+  for (k = 0; k < n_links; k++) {
+    OrcVariable var = first->vars[dests[k]];
+
+    var.vartype = ORC_VAR_TYPE_TEMP;
+    map1[dests[k]] = orc_fuse_add_var (fused, &var);
+    map2[srcs[k]] = map1[dests[k]];
+    taken[map1[dests[k]]] = TRUE;
+  }
+  for (i = ORC_VAR_T1; i < ORC_VAR_T1 + second->n_temp_vars; i++) {
+    int j;
+
+    for (j = ORC_VAR_T1; j < ORC_VAR_T1 + first->n_temp_vars; j++) {
+      if (!taken[map1[j]] &&
+          fused->vars[map1[j]].size == second->vars[i].size)
+        break;
+    }
+    if (j < ORC_VAR_T1 + first->n_temp_vars) {
+      map2[i] = map1[j];
+    } else {
+      map2[i] = orc_fuse_add_var (fused, second->vars + i);
+    }
+    taken[map2[i]] = TRUE;
+  }
+
+  /* The limits on the number of each kind of variable were hit */
+  if (orc_program_get_error (fused)[0] != '\0')
+    return fused;
+
+  fused->n_multiple = MAX (first->n_multiple, second->n_multiple);
+  fused->n_minimum = MAX (first->n_minimum, second->n_minimum);
+  if (first->n_maximum && second->n_maximum) {
+    fused->n_maximum = MIN (first->n_maximum, second->n_maximum);
+  } else {
+    fused->n_maximum = MAX (first->n_maximum, second->n_maximum);
+  }
+  fused->constant_n = MAX (first->constant_n, second->constant_n);
+  fused->constant_m = MAX (first->constant_m, second->constant_m);
+  fused->is_2d = first->is_2d;
+  /* Unrolled as asked only when both agree */
+  if (first->unroll == second->unroll)
+    fused->unroll = first->unroll;
+
+  orc_fuse_append_insns (fused, first, map1, linked1);
+  orc_fuse_append_insns (fused, second, map2, linked2);
+
+  return fused;
+}
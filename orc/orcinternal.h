@@ -13,6 +13,36 @@ ORC_BEGIN_DECLS
 /* orccompiler.c */
 typedef struct _OrcFixup OrcFixup;
 
+/* Maximum number of vector registers set aside to access spilled
+ * variables, one per operand of an instruction */
+#define ORC_N_SPILL_REGS (ORC_STATIC_OPCODE_N_SRC + ORC_STATIC_OPCODE_N_DEST)
+
+/* Maximum number of registers an accumulator is split into, one per copy
+ * of an unrolled loop body */
+#define ORC_N_PARTIAL_ACCS 8
+
+typedef struct _OrcSchedModel OrcSchedModel;
+
+/* Costs of the instruction classes of a target, in cycles, used by
+ * orc_compiler_schedule() */
+struct _OrcSchedModel {
+  /* Vector instructions that can start in the same cycle */
+  int issue_width;
+  int load;
+  int store;
+  /* Integer arithmetic, logic, shifts and shuffles */
+  int simple;
+  /* Integer multiplies and divisions */
+  int multiply;
+  /* Float arithmetic and conversions */
+  int float_op;
+  /* Float divisions and square roots */
+  int float_div;
+};
+
+ORC_INTERNAL int orc_compiler_get_latency (const OrcSchedModel *model,
+    const OrcInstruction *insn);
+
 /**
  * OrcFixup:
  *
@@ -37,21 +67,27 @@ struct _OrcCompiler {
 
   unsigned int target_flags;
 
-  OrcInstruction insns[ORC_N_INSNS];
+  OrcInstruction *insns;
   int n_insns;
+  int n_insns_alloc;
 
-  OrcVariable vars[ORC_N_COMPILER_VARIABLES];
+  /* At least ORC_N_COMPILER_VARIABLES entries, grows when temporaries are
+   * added, see orc_compiler_new_var() */
+  OrcVariable *vars;
+  int n_vars;
   int n_temp_vars;
   int n_dup_vars;
 
   unsigned char *code;
   unsigned char *codeptr;
+  int code_size; /* allocated size of code */
   
   OrcConstant constants[ORC_N_CONSTANTS];
   int n_constants;
 
-  OrcFixup fixups[ORC_N_FIXUPS];
+  OrcFixup *fixups;
   int n_fixups;
+  int n_fixups_alloc;
   unsigned char *labels[ORC_N_LABELS];
   int labels_int[ORC_N_LABELS];
   int n_labels;
@@ -72,6 +108,10 @@ struct _OrcCompiler {
 
   char *asm_code;
   int asm_code_len;
+  int asm_code_alloc;
+  /* The assembly code is only created when it can be read, see
+   * orc_program_get_asm_code() */
+  int need_asm;
 
   int is_64bit;
   int tmpreg;
@@ -102,6 +142,35 @@ struct _OrcCompiler {
   int n_output_insns;
   int n_output_insns_alloc;
   int temp_regs[ORC_N_REGS];
+
+  /* Register spilling, see orc_compiler_spill_var() */
+  int reg_overflow;
+  int overflow_insn;
+  int *spill_slot; /* n_vars entries, slot + 1, 0 if not spilled */
+  int n_spill_slots;
+  int spill_regs[ORC_N_SPILL_REGS];
+  int n_spill_regs;
+
+  /* Rules overwrite their first source, see orc_compiler_coalesce() */
+  int two_operand;
+
+  /* The target emits any invariant instruction before the loop, not only
+   * loadp, see orc_compiler_mark_invariants() */
+  int hoist_invariants;
+
+  /* Instructions are reordered for this model, see orc_compiler_schedule() */
+  const OrcSchedModel *sched_model;
+
+  /* Mask register that limits the loads and stores of the iteration
+   * being emitted to the elements left, ORC_REG_INVALID for whole
+   * vectors */
+  int loop_mask;
+
+  /* Each accumulator is summed in n_partial_accs registers, the first
+   * one being its alloc, so that the copies of an unrolled loop body don't
+   * wait for each other. The target adds them up when reducing it. */
+  int n_partial_accs;
+  int partial_accs[ORC_MAX_ACCUM_VARS][ORC_N_PARTIAL_ACCS];
 };
 
 /* This is to differentiate between the case of code that has access
@@ -165,6 +234,10 @@ struct _OrcTarget {
   void *padding[4];
   /* Until here is for ABI compatibility for 0.4.41 */
   int register_size;
+  /* Moves a vector register from/to a spill slot, targets without them
+   * fail the compilation when running out of vector registers */
+  void (*load_spill)(OrcCompiler *compiler, int reg, int slot);
+  void (*store_spill)(OrcCompiler *compiler, int reg, int slot);
 };
 
 /* The function prototypes need to be visible to orc.c */
@@ -188,10 +261,31 @@ typedef struct _OrcCodeChunk OrcCodeChunk;
 /* This is internal API, nothing in the public headers returns an OrcCodeChunk
  */
 OrcCodeRegion * orc_code_region_alloc (void);
+void orc_code_region_free (OrcCodeRegion *region);
 void orc_code_chunk_free (OrcCodeChunk *chunk);
 
 ORC_INTERNAL orc_bool orc_compiler_is_debug ();
 
+/* orcexecutor.c */
+ORC_INTERNAL void orc_code_emulate_plan_init (OrcCode *code);
+ORC_INTERNAL void orc_code_emulate_plan_free (OrcCode *code);
+
+/* orcthreadpool.c */
+typedef void (*OrcThreadPoolFunc) (void *user_data, int task);
+
+ORC_INTERNAL int orc_thread_pool_get_n_threads (void);
+ORC_INTERNAL void orc_thread_pool_run (int n_tasks, int n_threads,
+    OrcThreadPoolFunc func, void *user_data);
+
+/* orcstats.c */
+ORC_INTERNAL void orc_code_stats_attach (OrcCode *code, const char *name);
+ORC_INTERNAL void orc_code_stats_detach (OrcCode *code);
+
+/* orccodecache.c */
+ORC_INTERNAL void _orc_code_cache_init (void);
+ORC_INTERNAL orc_bool orc_code_cache_load (OrcCompiler *compiler);
+ORC_INTERNAL void orc_code_cache_store (OrcCompiler *compiler);
+
 ORC_INTERNAL extern int _orc_data_cache_size_level1;
 ORC_INTERNAL extern int _orc_data_cache_size_level2;
 ORC_INTERNAL extern int _orc_data_cache_size_level3;
@@ -201,11 +295,115 @@ ORC_INTERNAL extern int _orc_cpu_stepping;
 ORC_INTERNAL extern const char *_orc_cpu_name;
 
 ORC_INTERNAL void orc_compiler_emit_invariants (OrcCompiler *compiler);
+ORC_INTERNAL void orc_compiler_load_spills (OrcCompiler *compiler,
+    OrcInstruction *insn);
+ORC_INTERNAL void orc_compiler_store_spills (OrcCompiler *compiler,
+    OrcInstruction *insn);
 ORC_INTERNAL int orc_compiler_has_float (OrcCompiler *compiler);
+ORC_INTERNAL int orc_compiler_allocate_register (OrcCompiler *compiler,
+    int data_reg);
+ORC_INTERNAL void orc_compiler_add_fixup (OrcCompiler *compiler,
+    unsigned char *ptr, int label, int type);
+ORC_INTERNAL void orc_compiler_create_asm_code (OrcProgram *program);
+
+/* orcprogram.c */
+ORC_INTERNAL OrcInstruction *orc_program_new_insn (OrcProgram *program);
+ORC_INTERNAL OrcProgram *orc_program_dup (OrcProgram *program);
+
+/* orcspecialize.c */
+#define ORC_N_CODE_VARIANTS 8
+
+typedef struct _OrcCodeVariant OrcCodeVariant;
+
+/* Code compiled for the calls with these n, m and alignment, see
+ * orc_executor_run_specialized(). A NULL code means the compilation
+ * failed and the calls run the generic code. */
+struct _OrcCodeVariant {
+  int n;
+  int m;
+  int alignment;
+  OrcCode *code;
+};
+
+ORC_INTERNAL OrcCode *orc_program_get_variant (OrcProgram *program,
+    OrcExecutor *ex);
+ORC_INTERNAL orc_bool orc_program_has_variant_code (OrcProgram *program,
+    const void *code);
+ORC_INTERNAL void orc_program_free_variants (OrcProgram *program);
+
+#define ORC_CACHE_LINE_SIZE 64
+
+typedef enum {
+  ORC_PREFETCH_NONE,
+  /* The data is reused soon, bring it close to the core */
+  ORC_PREFETCH_KEEP,
+  /* The data is touched once, avoid polluting the caches */
+  ORC_PREFETCH_STREAM,
+} OrcPrefetchHint;
+
+typedef struct _OrcPrefetch OrcPrefetch;
+
+struct _OrcPrefetch {
+  OrcPrefetchHint hint;
+  /* Bytes ahead of the current pointer */
+  int distance;
+  orc_bool write;
+};
+
+ORC_INTERNAL orc_bool orc_compiler_get_prefetch (OrcCompiler *compiler,
+    int var, int size_region, int unroll_shift, OrcPrefetch *prefetch);
 
 ORC_INTERNAL char* _orc_getenv (const char *var);
 ORC_INTERNAL void orc_opcode_sys_init (void);
 
+typedef enum {
+  /* x op c and, for commutative opcodes, c op x is x */
+  ORC_OPCODE_REWRITE_IDENTITY,
+  /* x op 2^k is x shifted left by k */
+  ORC_OPCODE_REWRITE_MUL_SHIFT,
+  /* The high half of x op 2^k is x shifted right by the lane bits - k */
+  ORC_OPCODE_REWRITE_MULHS_SHIFT,
+  ORC_OPCODE_REWRITE_MULHU_SHIFT,
+  /* op x is y when x was computed as other y */
+  ORC_OPCODE_REWRITE_INVERSE,
+} OrcOpcodeRewriteType;
+
+typedef struct _OrcOpcodeRewrite OrcOpcodeRewrite;
+
+struct _OrcOpcodeRewrite {
+  const char *name;
+  OrcOpcodeRewriteType type;
+  /* The constant of ORC_OPCODE_REWRITE_IDENTITY */
+  int value;
+  /* The shift opcode, or the opcode that is undone */
+  const char *other;
+};
+
+ORC_INTERNAL const OrcOpcodeRewrite *orc_opcode_sys_get_rewrites (void);
+
+/* How the accumulating opcodes combine their source into the accumulator */
+typedef enum {
+  /* The wrapping sum, of all the opcodes that are not listed otherwise */
+  ORC_ACCUMULATOR_ADD,
+  ORC_ACCUMULATOR_MAXU,
+  ORC_ACCUMULATOR_MINU,
+  ORC_ACCUMULATOR_MAXS,
+  ORC_ACCUMULATOR_MINS,
+  ORC_ACCUMULATOR_OR,
+  ORC_ACCUMULATOR_AND,
+  /* The sum of floats or doubles */
+  ORC_ACCUMULATOR_ADDF,
+} OrcAccumulatorType;
+
+ORC_INTERNAL OrcAccumulatorType orc_accumulator_get_type (
+    const OrcInstruction *insns, int n_insns, int var);
+ORC_INTERNAL OrcAccumulatorType orc_opcode_get_accumulator_type (
+    const OrcStaticOpcode *opcode);
+ORC_INTERNAL orc_uint64 orc_accumulator_get_identity (OrcAccumulatorType type,
+    int size);
+ORC_INTERNAL orc_uint64 orc_accumulator_combine (OrcAccumulatorType type,
+    int size, orc_uint64 a, orc_uint64 b);
+
 ORC_END_DECLS
 
 #endif
@@ -99,12 +99,7 @@ orc_mips_emit_label (OrcCompiler *compiler, unsigned int label)
 static void
 orc_mips_add_fixup (OrcCompiler *compiler, int label, int type)
 {
-  ORC_ASSERT (compiler->n_fixups < ORC_N_FIXUPS);
-
-  compiler->fixups[compiler->n_fixups].ptr = compiler->codeptr;
-  compiler->fixups[compiler->n_fixups].label = label;
-  compiler->fixups[compiler->n_fixups].type = type;
-  compiler->n_fixups++;
+  orc_compiler_add_fixup (compiler, compiler->codeptr, label, type);
 }
 
 void
@@ -38,6 +38,7 @@ enum RegionFlags {
 };
 
 #define ORC_NEON_ALIGNED_DEST_CUTOFF 64
+#define ORC_NEON_MAX_NEXT_ROW_PREFETCH (4 * ORC_CACHE_LINE_SIZE)
 
 ORC_INTERNAL void orc_neon_emit_loop_common (OrcCompiler *compiler, int unroll_index);
 ORC_INTERNAL void orc_neon_compiler_init_common (OrcCompiler *compiler);
@@ -35,6 +35,7 @@ struct _OrcOpcodeSet {
 #define ORC_STATIC_OPCODE_INVARIANT (1<<6)
 #define ORC_STATIC_OPCODE_ITERATOR (1<<7)
 #define ORC_STATIC_OPCODE_COPY (1<<8)
+#define ORC_STATIC_OPCODE_COMMUTATIVE (1<<9)
 
 
 struct _OrcStaticOpcode {
@@ -1,5 +1,7 @@
 #include "config.h"
 
+#include <string.h>
+
 #include <orc/orcprogram.h>
 #include <orc/orcdebug.h>
 #include <orc/orcinternal.h>
@@ -10,14 +12,14 @@ static OrcStaticOpcode opcodes[] = {
 
   /* byte ops */
   { "absb", 0, { 1 }, { 1 }, emulate_absb },
-  { "addb", 0, { 1 }, { 1, 1 }, emulate_addb },
-  { "addssb", 0, { 1 }, { 1, 1 }, emulate_addssb },
-  { "addusb", 0, { 1 }, { 1, 1 }, emulate_addusb },
-  { "andb", 0, { 1 }, { 1, 1 }, emulate_andb },
+  { "addb", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_addb },
+  { "addssb", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_addssb },
+  { "addusb", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_addusb },
+  { "andb", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_andb },
   { "andnb", 0, { 1 }, { 1, 1 }, emulate_andnb },
-  { "avgsb", 0, { 1 }, { 1, 1 }, emulate_avgsb },
-  { "avgub", 0, { 1 }, { 1, 1 }, emulate_avgub },
-  { "cmpeqb", 0, { 1 }, { 1, 1 }, emulate_cmpeqb },
+  { "avgsb", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_avgsb },
+  { "avgub", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_avgub },
+  { "cmpeqb", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_cmpeqb },
   { "cmpgtsb", 0, { 1 }, { 1, 1 }, emulate_cmpgtsb },
   { "copyb", ORC_STATIC_OPCODE_COPY, { 1 }, { 1 }, emulate_copyb },
   { "loadb", ORC_STATIC_OPCODE_LOAD, { 1 }, { 1 }, emulate_loadb },
@@ -29,14 +31,14 @@ static OrcStaticOpcode opcodes[] = {
   { "ldresnearl", ORC_STATIC_OPCODE_LOAD|ORC_STATIC_OPCODE_SCALAR, { 4 }, { 4, 4, 4 }, emulate_ldresnearl },
   { "ldreslinb", ORC_STATIC_OPCODE_LOAD|ORC_STATIC_OPCODE_SCALAR, { 1 }, { 1, 4, 4 }, emulate_ldreslinb },
   { "ldreslinl", ORC_STATIC_OPCODE_LOAD|ORC_STATIC_OPCODE_SCALAR, { 4 }, { 4, 4, 4 }, emulate_ldreslinl },
-  { "maxsb", 0, { 1 }, { 1, 1 }, emulate_maxsb },
-  { "maxub", 0, { 1 }, { 1, 1 }, emulate_maxub },
-  { "minsb", 0, { 1 }, { 1, 1 }, emulate_minsb },
-  { "minub", 0, { 1 }, { 1, 1 }, emulate_minub },
-  { "mullb", 0, { 1 }, { 1, 1 }, emulate_mullb },
-  { "mulhsb", 0, { 1 }, { 1, 1 }, emulate_mulhsb },
-  { "mulhub", 0, { 1 }, { 1, 1 }, emulate_mulhub },
-  { "orb", 0, { 1 }, { 1, 1 }, emulate_orb },
+  { "maxsb", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_maxsb },
+  { "maxub", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_maxub },
+  { "minsb", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_minsb },
+  { "minub", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_minub },
+  { "mullb", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_mullb },
+  { "mulhsb", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_mulhsb },
+  { "mulhub", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_mulhub },
+  { "orb", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_orb },
   { "shlb", ORC_STATIC_OPCODE_SCALAR, { 1 }, { 1, 1 }, emulate_shlb },
   { "shrsb", ORC_STATIC_OPCODE_SCALAR, { 1 }, { 1, 1 }, emulate_shrsb },
   { "shrub", ORC_STATIC_OPCODE_SCALAR, { 1 }, { 1, 1 }, emulate_shrub },
@@ -45,18 +47,18 @@ static OrcStaticOpcode opcodes[] = {
   { "subb", 0, { 1 }, { 1, 1 }, emulate_subb },
   { "subssb", 0, { 1 }, { 1, 1 }, emulate_subssb },
   { "subusb", 0, { 1 }, { 1, 1 }, emulate_subusb },
-  { "xorb", 0, { 1 }, { 1, 1 }, emulate_xorb },
+  { "xorb", ORC_STATIC_OPCODE_COMMUTATIVE, { 1 }, { 1, 1 }, emulate_xorb },
 
   /* word ops */
   { "absw", 0, { 2 }, { 2 }, emulate_absw },
-  { "addw", 0, { 2 }, { 2, 2 }, emulate_addw },
-  { "addssw", 0, { 2 }, { 2, 2 }, emulate_addssw },
-  { "addusw", 0, { 2 }, { 2, 2 }, emulate_addusw },
-  { "andw", 0, { 2 }, { 2, 2 }, emulate_andw },
+  { "addw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_addw },
+  { "addssw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_addssw },
+  { "addusw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_addusw },
+  { "andw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_andw },
   { "andnw", 0, { 2 }, { 2, 2 }, emulate_andnw },
-  { "avgsw", 0, { 2 }, { 2, 2 }, emulate_avgsw },
-  { "avguw", 0, { 2 }, { 2, 2 }, emulate_avguw },
-  { "cmpeqw", 0, { 2 }, { 2, 2 }, emulate_cmpeqw },
+  { "avgsw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_avgsw },
+  { "avguw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_avguw },
+  { "cmpeqw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_cmpeqw },
   { "cmpgtsw", 0, { 2 }, { 2, 2 }, emulate_cmpgtsw },
   { "copyw", ORC_STATIC_OPCODE_COPY, { 2 }, { 2 }, emulate_copyw },
   { "div255w", 0, { 2 }, { 2 }, emulate_div255w },
@@ -64,14 +66,14 @@ static OrcStaticOpcode opcodes[] = {
   { "loadw", ORC_STATIC_OPCODE_LOAD, { 2 }, { 2 }, emulate_loadw },
   { "loadoffw", ORC_STATIC_OPCODE_LOAD|ORC_STATIC_OPCODE_SCALAR, { 2 }, { 2, 4 }, emulate_loadoffw },
   { "loadpw", ORC_STATIC_OPCODE_LOAD|ORC_STATIC_OPCODE_SCALAR|ORC_STATIC_OPCODE_INVARIANT, { 2 }, { 2 }, emulate_loadpw },
-  { "maxsw", 0, { 2 }, { 2, 2 }, emulate_maxsw },
-  { "maxuw", 0, { 2 }, { 2, 2 }, emulate_maxuw },
-  { "minsw", 0, { 2 }, { 2, 2 }, emulate_minsw },
-  { "minuw", 0, { 2 }, { 2, 2 }, emulate_minuw },
-  { "mullw", 0, { 2 }, { 2, 2 }, emulate_mullw },
-  { "mulhsw", 0, { 2 }, { 2, 2 }, emulate_mulhsw },
-  { "mulhuw", 0, { 2 }, { 2, 2 }, emulate_mulhuw },
-  { "orw", 0, { 2 }, { 2, 2 }, emulate_orw },
+  { "maxsw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_maxsw },
+  { "maxuw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_maxuw },
+  { "minsw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_minsw },
+  { "minuw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_minuw },
+  { "mullw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_mullw },
+  { "mulhsw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_mulhsw },
+  { "mulhuw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_mulhuw },
+  { "orw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_orw },
   { "shlw", ORC_STATIC_OPCODE_SCALAR, { 2 }, { 2, 2 }, emulate_shlw },
   { "shrsw", ORC_STATIC_OPCODE_SCALAR, { 2 }, { 2, 2 }, emulate_shrsw },
   { "shruw", ORC_STATIC_OPCODE_SCALAR, { 2 }, { 2, 2 }, emulate_shruw },
@@ -80,31 +82,31 @@ static OrcStaticOpcode opcodes[] = {
   { "subw", 0, { 2 }, { 2, 2 }, emulate_subw },
   { "subssw", 0, { 2 }, { 2, 2 }, emulate_subssw },
   { "subusw", 0, { 2 }, { 2, 2 }, emulate_subusw },
-  { "xorw", 0, { 2 }, { 2, 2 }, emulate_xorw },
+  { "xorw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 2, 2 }, emulate_xorw },
 
   /* long ops */
   { "absl", 0, { 4 }, { 4 }, emulate_absl },
-  { "addl", 0, { 4 }, { 4, 4 }, emulate_addl },
-  { "addssl", 0, { 4 }, { 4, 4 }, emulate_addssl },
-  { "addusl", 0, { 4 }, { 4, 4 }, emulate_addusl },
-  { "andl", 0, { 4 }, { 4, 4 }, emulate_andl },
+  { "addl", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_addl },
+  { "addssl", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_addssl },
+  { "addusl", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_addusl },
+  { "andl", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_andl },
   { "andnl", 0, { 4 }, { 4, 4 }, emulate_andnl },
-  { "avgsl", 0, { 4 }, { 4, 4 }, emulate_avgsl },
-  { "avgul", 0, { 4 }, { 4, 4 }, emulate_avgul },
-  { "cmpeql", 0, { 4 }, { 4, 4 }, emulate_cmpeql },
+  { "avgsl", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_avgsl },
+  { "avgul", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_avgul },
+  { "cmpeql", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_cmpeql },
   { "cmpgtsl", 0, { 4 }, { 4, 4 }, emulate_cmpgtsl },
   { "copyl", ORC_STATIC_OPCODE_COPY, { 4 }, { 4 }, emulate_copyl },
   { "loadl", ORC_STATIC_OPCODE_LOAD, { 4 }, { 4 }, emulate_loadl },
   { "loadoffl", ORC_STATIC_OPCODE_LOAD|ORC_STATIC_OPCODE_SCALAR, { 4 }, { 4, 4 }, emulate_loadoffl },
   { "loadpl", ORC_STATIC_OPCODE_LOAD|ORC_STATIC_OPCODE_SCALAR|ORC_STATIC_OPCODE_INVARIANT, { 4 }, { 4 }, emulate_loadpl },
-  { "maxsl", 0, { 4 }, { 4, 4 }, emulate_maxsl },
-  { "maxul", 0, { 4 }, { 4, 4 }, emulate_maxul },
-  { "minsl", 0, { 4 }, { 4, 4 }, emulate_minsl },
-  { "minul", 0, { 4 }, { 4, 4 }, emulate_minul },
-  { "mulll", 0, { 4 }, { 4, 4 }, emulate_mulll },
-  { "mulhsl", 0, { 4 }, { 4, 4 }, emulate_mulhsl },
-  { "mulhul", 0, { 4 }, { 4, 4 }, emulate_mulhul },
-  { "orl", 0, { 4 }, { 4, 4 }, emulate_orl },
+  { "maxsl", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_maxsl },
+  { "maxul", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_maxul },
+  { "minsl", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_minsl },
+  { "minul", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_minul },
+  { "mulll", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_mulll },
+  { "mulhsl", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_mulhsl },
+  { "mulhul", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_mulhul },
+  { "orl", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_orl },
   { "shll", ORC_STATIC_OPCODE_SCALAR, { 4 }, { 4, 4 }, emulate_shll },
   { "shrsl", ORC_STATIC_OPCODE_SCALAR, { 4 }, { 4, 4 }, emulate_shrsl },
   { "shrul", ORC_STATIC_OPCODE_SCALAR, { 4 }, { 4, 4 }, emulate_shrul },
@@ -113,20 +115,20 @@ static OrcStaticOpcode opcodes[] = {
   { "subl", 0, { 4 }, { 4, 4 }, emulate_subl },
   { "subssl", 0, { 4 }, { 4, 4 }, emulate_subssl },
   { "subusl", 0, { 4 }, { 4, 4 }, emulate_subusl },
-  { "xorl", 0, { 4 }, { 4, 4 }, emulate_xorl },
+  { "xorl", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 4, 4 }, emulate_xorl },
 
   { "loadq", ORC_STATIC_OPCODE_LOAD, { 8 }, { 8 }, emulate_loadq },
   { "loadpq", ORC_STATIC_OPCODE_LOAD|ORC_STATIC_OPCODE_SCALAR|ORC_STATIC_OPCODE_INVARIANT, { 8 }, { 8 }, emulate_loadpq },
   { "storeq", ORC_STATIC_OPCODE_STORE, { 8 }, { 8 }, emulate_storeq },
   { "splatw3q", 0, { 8 }, { 8 }, emulate_splatw3q },
   { "copyq", ORC_STATIC_OPCODE_COPY, { 8 }, { 8 }, emulate_copyq },
-  { "cmpeqq", 0, { 8 }, { 8, 8 }, emulate_cmpeqq },
+  { "cmpeqq", ORC_STATIC_OPCODE_COMMUTATIVE, { 8 }, { 8, 8 }, emulate_cmpeqq },
   { "cmpgtsq", 0, { 8 }, { 8, 8 }, emulate_cmpgtsq },
-  { "andq", 0, { 8 }, { 8, 8 }, emulate_andq },
+  { "andq", ORC_STATIC_OPCODE_COMMUTATIVE, { 8 }, { 8, 8 }, emulate_andq },
   { "andnq", 0, { 8 }, { 8, 8 }, emulate_andnq },
-  { "orq", 0, { 8 }, { 8, 8 }, emulate_orq },
-  { "xorq", 0, { 8 }, { 8, 8 }, emulate_xorq },
-  { "addq", 0, { 8 }, { 8, 8 }, emulate_addq },
+  { "orq", ORC_STATIC_OPCODE_COMMUTATIVE, { 8 }, { 8, 8 }, emulate_orq },
+  { "xorq", ORC_STATIC_OPCODE_COMMUTATIVE, { 8 }, { 8, 8 }, emulate_xorq },
+  { "addq", ORC_STATIC_OPCODE_COMMUTATIVE, { 8 }, { 8, 8 }, emulate_addq },
   { "subq", 0, { 8 }, { 8, 8 }, emulate_subq },
   { "shlq", ORC_STATIC_OPCODE_SCALAR, { 8 }, { 8, 8 }, emulate_shlq },
   { "shrsq", ORC_STATIC_OPCODE_SCALAR, { 8 }, { 8, 8 }, emulate_shrsq },
@@ -162,12 +164,12 @@ static OrcStaticOpcode opcodes[] = {
   { "convussql", 0, { 4 }, { 8 }, emulate_convussql },
   { "convuusql", 0, { 4 }, { 8 }, emulate_convuusql },
 
-  { "mulsbw", 0, { 2 }, { 1, 1 }, emulate_mulsbw },
-  { "mulubw", 0, { 2 }, { 1, 1 }, emulate_mulubw },
-  { "mulswl", 0, { 4 }, { 2, 2 }, emulate_mulswl },
-  { "muluwl", 0, { 4 }, { 2, 2 }, emulate_muluwl },
-  { "mulslq", 0, { 8 }, { 4, 4 }, emulate_mulslq },
-  { "mululq", 0, { 8 }, { 4, 4 }, emulate_mululq },
+  { "mulsbw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 1, 1 }, emulate_mulsbw },
+  { "mulubw", ORC_STATIC_OPCODE_COMMUTATIVE, { 2 }, { 1, 1 }, emulate_mulubw },
+  { "mulswl", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 2, 2 }, emulate_mulswl },
+  { "muluwl", ORC_STATIC_OPCODE_COMMUTATIVE, { 4 }, { 2, 2 }, emulate_muluwl },
+  { "mulslq", ORC_STATIC_OPCODE_COMMUTATIVE, { 8 }, { 4, 4 }, emulate_mulslq },
+  { "mululq", ORC_STATIC_OPCODE_COMMUTATIVE, { 8 }, { 4, 4 }, emulate_mululq },
 
   /* accumulators */
   { "accw", ORC_STATIC_OPCODE_ACCUMULATOR, { 2 }, { 2 }, emulate_accw },
@@ -225,11 +227,290 @@ static OrcStaticOpcode opcodes[] = {
   { "orf", ORC_STATIC_OPCODE_FLOAT, { 4 }, { 4, 4 }, emulate_orf },
   { "andf", ORC_STATIC_OPCODE_FLOAT, { 4 }, { 4, 4 }, emulate_andf },
   { "convwf", ORC_STATIC_OPCODE_FLOAT_DEST, { 4 }, { 2 }, emulate_convwf },
+
+  /* accumulators other than sums */
+  { "accmaxub", ORC_STATIC_OPCODE_ACCUMULATOR, { 1 }, { 1 }, emulate_accmaxub },
+  { "accminub", ORC_STATIC_OPCODE_ACCUMULATOR, { 1 }, { 1 }, emulate_accminub },
+  { "accmaxsw", ORC_STATIC_OPCODE_ACCUMULATOR, { 2 }, { 2 }, emulate_accmaxsw },
+  { "accminsw", ORC_STATIC_OPCODE_ACCUMULATOR, { 2 }, { 2 }, emulate_accminsw },
+  { "accorl", ORC_STATIC_OPCODE_ACCUMULATOR, { 4 }, { 4 }, emulate_accorl },
+  { "accandl", ORC_STATIC_OPCODE_ACCUMULATOR, { 4 }, { 4 }, emulate_accandl },
+  { "accq", ORC_STATIC_OPCODE_ACCUMULATOR, { 8 }, { 8 }, emulate_accq },
+  { "accf", ORC_STATIC_OPCODE_ACCUMULATOR|ORC_STATIC_OPCODE_FLOAT, { 4 }, { 4 }, emulate_accf },
+  { "accd", ORC_STATIC_OPCODE_ACCUMULATOR|ORC_STATIC_OPCODE_FLOAT, { 8 }, { 8 }, emulate_accd },
   { "" }
 };
 
+/* The accumulating opcodes that do not sum their source */
+static const struct {
+  const char *name;
+  OrcAccumulatorType type;
+} accumulator_types[] = {
+  { "accmaxub", ORC_ACCUMULATOR_MAXU },
+  { "accminub", ORC_ACCUMULATOR_MINU },
+  { "accmaxsw", ORC_ACCUMULATOR_MAXS },
+  { "accminsw", ORC_ACCUMULATOR_MINS },
+  { "accorl", ORC_ACCUMULATOR_OR },
+  { "accandl", ORC_ACCUMULATOR_AND },
+  { "accf", ORC_ACCUMULATOR_ADDF },
+  { "accd", ORC_ACCUMULATOR_ADDF },
+};
+
+/* Rewrites done by the optimizer of the compiler. Instructions whose
+ * sources are all constants are folded through their emulation function
+ * and do not need an entry here */
+static const OrcOpcodeRewrite rewrites[] = {
+  /* x op 0 */
+  { "addb", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "addssb", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "addusb", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "orb", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "shlb", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "shrsb", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "shrub", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "subb", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "subssb", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "subusb", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "xorb", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "addw", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "addssw", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "addusw", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "orw", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "shlw", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "shrsw", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "shruw", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "subw", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "subssw", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "subusw", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "xorw", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "addl", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "addssl", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "addusl", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "orl", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "shll", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "shrsl", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "shrul", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "subl", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "subssl", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "subusl", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "xorl", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "addq", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "orq", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "shlq", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "shrsq", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "shruq", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "subq", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+  { "xorq", ORC_OPCODE_REWRITE_IDENTITY, 0 },
+
+  /* x & ~0, x * 1 */
+  { "andb", ORC_OPCODE_REWRITE_IDENTITY, -1 },
+  { "andw", ORC_OPCODE_REWRITE_IDENTITY, -1 },
+  { "andl", ORC_OPCODE_REWRITE_IDENTITY, -1 },
+  { "andq", ORC_OPCODE_REWRITE_IDENTITY, -1 },
+  { "mullb", ORC_OPCODE_REWRITE_IDENTITY, 1 },
+  { "mullw", ORC_OPCODE_REWRITE_IDENTITY, 1 },
+  { "mulll", ORC_OPCODE_REWRITE_IDENTITY, 1 },
+
+  /* Multiplies by a power of two */
+  { "mullb", ORC_OPCODE_REWRITE_MUL_SHIFT, 0, "shlb" },
+  { "mullw", ORC_OPCODE_REWRITE_MUL_SHIFT, 0, "shlw" },
+  { "mulll", ORC_OPCODE_REWRITE_MUL_SHIFT, 0, "shll" },
+  { "mulhsb", ORC_OPCODE_REWRITE_MULHS_SHIFT, 0, "shrsb" },
+  { "mulhub", ORC_OPCODE_REWRITE_MULHU_SHIFT, 0, "shrub" },
+  { "mulhsw", ORC_OPCODE_REWRITE_MULHS_SHIFT, 0, "shrsw" },
+  { "mulhuw", ORC_OPCODE_REWRITE_MULHU_SHIFT, 0, "shruw" },
+  { "mulhsl", ORC_OPCODE_REWRITE_MULHS_SHIFT, 0, "shrsl" },
+  { "mulhul", ORC_OPCODE_REWRITE_MULHU_SHIFT, 0, "shrul" },
+
+  /* Narrowing what was just widened */
+  { "convwb", ORC_OPCODE_REWRITE_INVERSE, 0, "convsbw" },
+  { "convwb", ORC_OPCODE_REWRITE_INVERSE, 0, "convubw" },
+  { "convssswb", ORC_OPCODE_REWRITE_INVERSE, 0, "convsbw" },
+  { "convsuswb", ORC_OPCODE_REWRITE_INVERSE, 0, "convubw" },
+  { "convuuswb", ORC_OPCODE_REWRITE_INVERSE, 0, "convubw" },
+  { "convlw", ORC_OPCODE_REWRITE_INVERSE, 0, "convswl" },
+  { "convlw", ORC_OPCODE_REWRITE_INVERSE, 0, "convuwl" },
+  { "convssslw", ORC_OPCODE_REWRITE_INVERSE, 0, "convswl" },
+  { "convsuslw", ORC_OPCODE_REWRITE_INVERSE, 0, "convuwl" },
+  { "convuuslw", ORC_OPCODE_REWRITE_INVERSE, 0, "convuwl" },
+  { "convql", ORC_OPCODE_REWRITE_INVERSE, 0, "convslq" },
+  { "convql", ORC_OPCODE_REWRITE_INVERSE, 0, "convulq" },
+  { "convsssql", ORC_OPCODE_REWRITE_INVERSE, 0, "convslq" },
+  { "convsusql", ORC_OPCODE_REWRITE_INVERSE, 0, "convulq" },
+  { "convuusql", ORC_OPCODE_REWRITE_INVERSE, 0, "convulq" },
+
+  /* Byte swaps */
+  { "swapw", ORC_OPCODE_REWRITE_INVERSE, 0, "swapw" },
+  { "swapl", ORC_OPCODE_REWRITE_INVERSE, 0, "swapl" },
+  { "swapwl", ORC_OPCODE_REWRITE_INVERSE, 0, "swapwl" },
+  { "swapq", ORC_OPCODE_REWRITE_INVERSE, 0, "swapq" },
+  { "swaplq", ORC_OPCODE_REWRITE_INVERSE, 0, "swaplq" },
+  { NULL }
+};
+
 void
 orc_opcode_sys_init (void)
 {
   orc_opcode_register_static (opcodes, "sys");
 }
+
+/**
+ * orc_opcode_sys_get_rewrites:
+ *
+ * Returns the algebraic rewrites of the system opcodes, terminated by an
+ * entry with a NULL name.
+ *
+ * Returns: the table of rewrites
+ */
+const OrcOpcodeRewrite *
+orc_opcode_sys_get_rewrites (void)
+{
+  return rewrites;
+}
+
+/**
+ * orc_opcode_get_accumulator_type:
+ * @opcode: an accumulating opcode
+ *
+ * Returns: how @opcode combines its source into the accumulator
+ */
+OrcAccumulatorType
+orc_opcode_get_accumulator_type (const OrcStaticOpcode *opcode)
+{
+  int i;
+
+  for (i = 0; i < ARRAY_SIZE (accumulator_types); i++) {
+    if (strcmp (opcode->name, accumulator_types[i].name) == 0)
+      return accumulator_types[i].type;
+  }
+
+  return ORC_ACCUMULATOR_ADD;
+}
+
+/**
+ * orc_accumulator_get_type:
+ * @insns: the instructions of a program
+ * @n_insns: the number of instructions
+ * @var: an accumulator variable
+ *
+ * Returns: how the first instruction writing @var combines its source into
+ * the accumulator, the compiler refuses programs mixing types
+ */
+OrcAccumulatorType
+orc_accumulator_get_type (const OrcInstruction *insns, int n_insns, int var)
+{
+  int i;
+
+  for (i = 0; i < n_insns; i++) {
+    if (insns[i].dest_args[0] == var &&
+        (insns[i].opcode->flags & ORC_STATIC_OPCODE_ACCUMULATOR))
+      return orc_opcode_get_accumulator_type (insns[i].opcode);
+  }
+
+  return ORC_ACCUMULATOR_ADD;
+}
+
+/**
+ * orc_accumulator_get_identity:
+ * @type: the type of the accumulator
+ * @size: the size of the accumulator
+ *
+ * Returns: the value the accumulator starts with, which leaves any element
+ * unchanged when combined with it
+ */
+orc_uint64
+orc_accumulator_get_identity (OrcAccumulatorType type, int size)
+{
+  const orc_uint64 mask = size == 8 ? ORC_UINT64_C (0xffffffffffffffff) :
+      (ORC_UINT64_C (1) << (size * 8)) - 1;
+  const orc_uint64 sign = ORC_UINT64_C (1) << (size * 8 - 1);
+
+  switch (type) {
+    case ORC_ACCUMULATOR_MINU:
+    case ORC_ACCUMULATOR_AND:
+      return mask;
+    case ORC_ACCUMULATOR_MAXS:
+      return sign;
+    case ORC_ACCUMULATOR_MINS:
+      return sign - 1;
+    default:
+      return 0;
+  }
+}
+
+static orc_int64
+orc_accumulator_sign_extend (int size, orc_uint64 a)
+{
+  const orc_uint64 sign = ORC_UINT64_C (1) << (size * 8 - 1);
+
+  if (size == 8)
+    return (orc_int64) a;
+  return (orc_int64) ((a ^ sign) - sign);
+}
+
+/**
+ * orc_accumulator_combine:
+ * @type: the type of the accumulator
+ * @size: the size of the accumulator
+ * @a: the value of the accumulator on some elements
+ * @b: the value of the accumulator on other elements
+ *
+ * Returns: the value of the accumulator on all the elements, masked to
+ * @size like the values the executor returns
+ */
+orc_uint64
+orc_accumulator_combine (OrcAccumulatorType type, int size, orc_uint64 a,
+    orc_uint64 b)
+{
+  const orc_uint64 mask = size == 8 ? ORC_UINT64_C (0xffffffffffffffff) :
+      (ORC_UINT64_C (1) << (size * 8)) - 1;
+  orc_uint64 r;
+
+  a &= mask;
+  b &= mask;
+
+  switch (type) {
+    case ORC_ACCUMULATOR_MAXU:
+      r = MAX (a, b);
+      break;
+    case ORC_ACCUMULATOR_MINU:
+      r = MIN (a, b);
+      break;
+    case ORC_ACCUMULATOR_MAXS:
+      r = orc_accumulator_sign_extend (size, a) >
+          orc_accumulator_sign_extend (size, b) ? a : b;
+      break;
+    case ORC_ACCUMULATOR_MINS:
+      r = orc_accumulator_sign_extend (size, a) <
+          orc_accumulator_sign_extend (size, b) ? a : b;
+      break;
+    case ORC_ACCUMULATOR_OR:
+      r = a | b;
+      break;
+    case ORC_ACCUMULATOR_AND:
+      r = a & b;
+      break;
+    case ORC_ACCUMULATOR_ADDF:
+      if (size == 8) {
+        orc_union64 x, y;
+
+        x.i = a;
+        y.i = b;
+        x.f = x.f + y.f;
+        r = x.i;
+      } else {
+        orc_union32 x, y;
+
+        x.i = a;
+        y.i = b;
+        x.f = x.f + y.f;
+        r = (orc_uint32) x.i;
+      }
+      break;
+    default:
+      r = a + b;
+      break;
+  }
+
+  return r & mask;
+}
@@ -521,6 +521,22 @@ orc_parse_handle_flags (OrcParser *parser, const OrcLine *line)
   for (i=1;i<line->n_tokens;i++) {
     if (!strcmp (line->tokens[i], "2d")) {
       orc_program_set_2d (parser->program);
+    } else if (!strcmp (line->tokens[i], "unroll")) {
+      int unroll;
+
+      if (i == line->n_tokens - 1) {
+        orc_parse_add_error (parser, ".flags unroll requires a value");
+        break;
+      }
+      unroll = strtol (line->tokens[i+1], NULL, 0);
+      if (unroll < 1 || unroll > 8 || (unroll & (unroll - 1)) != 0) {
+        orc_parse_add_error (parser,
+            ".flags unroll must be 1, 2, 4 or 8, not '%s'",
+            line->tokens[i+1]);
+      } else {
+        orc_program_set_unroll (parser->program, unroll);
+      }
+      i++;
     }
   }
   return 1;
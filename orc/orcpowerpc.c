@@ -693,13 +693,7 @@ void powerpc_emit_ret (OrcCompiler *compiler)
 void
 powerpc_add_fixup (OrcCompiler *compiler, int type, unsigned char *ptr, int label)
 {
-  compiler->fixups[compiler->n_fixups].ptr = ptr;
-  compiler->fixups[compiler->n_fixups].label = label;
-  compiler->fixups[compiler->n_fixups].type = type;
-  compiler->n_fixups++;
-  if (compiler->n_fixups >= ORC_N_FIXUPS) {
-    ORC_ERROR("too many fixups");
-  }
+  orc_compiler_add_fixup (compiler, ptr, label, type);
 }
 
 void
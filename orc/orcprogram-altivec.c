@@ -181,7 +181,7 @@ static void
 powerpc_load_constants_outer (OrcCompiler *compiler)
 {
   int i;
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     if (compiler->vars[i].name == NULL) continue;
     switch (compiler->vars[i].vartype) {
       case ORC_VAR_TYPE_CONST:
@@ -227,7 +227,7 @@ powerpc_load_inner_constants (OrcCompiler *compiler)
   int i;
 
   ORC_ASM_CODE(compiler,"# load inner constants\n");
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     if (compiler->vars[i].name == NULL) continue;
     switch (compiler->vars[i].vartype) {
       case ORC_VAR_TYPE_SRC:
@@ -287,7 +287,7 @@ orc_powerpc_emit_loop (OrcCompiler* compiler, int update)
   }
 
   if (update) {
-    for(k=0;k<ORC_N_COMPILER_VARIABLES;k++){
+    for(k=0;k<compiler->n_vars;k++){
       if (compiler->vars[k].name == NULL) continue;
       if (compiler->vars[k].vartype == ORC_VAR_TYPE_SRC ||
           compiler->vars[k].vartype == ORC_VAR_TYPE_DEST) {
@@ -333,6 +333,7 @@ orc_compiler_powerpc_assemble (OrcCompiler *compiler)
     free (compiler->asm_code);
     compiler->asm_code = NULL;
     compiler->asm_code_len = 0;
+    compiler->asm_code_alloc = 0;
     memset (compiler->labels, 0, sizeof (compiler->labels));
     memset (compiler->labels_int, 0, sizeof (compiler->labels_int));
     compiler->n_fixups = 0;
@@ -401,7 +402,7 @@ orc_compiler_powerpc_assemble (OrcCompiler *compiler)
     powerpc_emit_stw (compiler, POWERPC_R0, POWERPC_R3,
         (int)ORC_STRUCT_OFFSET(OrcExecutorAlt, m_index));
 
-    for(k=0;k<ORC_N_COMPILER_VARIABLES;k++){
+    for(k=0;k<compiler->n_vars;k++){
       if (compiler->vars[k].name == NULL) continue;
       if (compiler->vars[k].vartype == ORC_VAR_TYPE_SRC ||
           compiler->vars[k].vartype == ORC_VAR_TYPE_DEST) {
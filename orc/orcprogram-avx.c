@@ -146,60 +146,122 @@ avx_init_accumulator (OrcCompiler *compiler, OrcVariable *var)
   orc_avx_emit_pxor (compiler, var->alloc, var->alloc, var->alloc);
 }
 
+/* Combines the lanes of @src into @dest the way the accumulator of @type
+ * does, on the whole registers or on their low 128 bits */
 static void
-avx_reduce_accumulator (OrcCompiler *compiler, int i, OrcVariable *var)
+avx_emit_accumulate (OrcCompiler *compiler, OrcAccumulatorType type,
+    int size, orc_bool wide, int src, int dest)
 {
-  const int src = var->alloc;
-  const int tmp = orc_compiler_get_temp_reg (compiler);
+  int opcode;
 
-  // duplicate the high lane
-  orc_avx_emit_extractf128_si256 (compiler, 1, src, ORC_AVX_SSE_REG (tmp));
+  switch (type) {
+    case ORC_ACCUMULATOR_MAXU:
+      opcode = wide ? ORC_AVX_pmaxub : ORC_AVX_SSE_pmaxub;
+      break;
+    case ORC_ACCUMULATOR_MINU:
+      opcode = wide ? ORC_AVX_pminub : ORC_AVX_SSE_pminub;
+      break;
+    case ORC_ACCUMULATOR_MAXS:
+      opcode = wide ? ORC_AVX_pmaxsw : ORC_AVX_SSE_pmaxsw;
+      break;
+    case ORC_ACCUMULATOR_MINS:
+      opcode = wide ? ORC_AVX_pminsw : ORC_AVX_SSE_pminsw;
+      break;
+    case ORC_ACCUMULATOR_OR:
+      opcode = wide ? ORC_AVX_por : ORC_AVX_SSE_por;
+      break;
+    case ORC_ACCUMULATOR_AND:
+      opcode = wide ? ORC_AVX_pand : ORC_AVX_SSE_pand;
+      break;
+    case ORC_ACCUMULATOR_ADDF:
+      if (size == 8) {
+        opcode = wide ? ORC_AVX_addpd : ORC_AVX_SSE_addpd;
+      } else {
+        opcode = wide ? ORC_AVX_addps : ORC_AVX_SSE_addps;
+      }
+      break;
+    default:
+      if (size == 2) {
+        opcode = wide ? ORC_AVX_paddw : ORC_AVX_SSE_paddw;
+      } else if (size == 8) {
+        opcode = wide ? ORC_AVX_paddq : ORC_AVX_SSE_paddq;
+      } else {
+        opcode = wide ? ORC_AVX_paddd : ORC_AVX_SSE_paddd;
+      }
+      break;
+  }
 
-  // Pairwise summation
-  if (var->size == 2) {
-    orc_avx_sse_emit_paddw (compiler, ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (src));
+  if (wide) {
+    orc_vex_emit_cpuinsn_avx (compiler, opcode, dest, src, 0, dest);
   } else {
-    orc_avx_sse_emit_paddd (compiler, ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (src));
+    orc_vex_emit_cpuinsn_avx (compiler, opcode, ORC_AVX_SSE_REG (dest),
+        ORC_AVX_SSE_REG (src), 0, ORC_AVX_SSE_REG (dest));
   }
+}
 
-  // Duplicate the high half now
-  orc_avx_sse_emit_pshufd (compiler, ORC_AVX_SSE_SHUF (3, 2, 3, 2), ORC_AVX_SSE_REG (src),
-      ORC_AVX_SSE_REG (tmp));
+static void
+avx_reduce_accumulator (OrcCompiler *compiler, int i, OrcVariable *var)
+{
+  const int src = var->alloc;
+  const int tmp = orc_compiler_get_temp_reg (compiler);
+  const OrcAccumulatorType type = orc_accumulator_get_type (compiler->insns,
+      compiler->n_insns, i);
+  int half_size;
+  int j;
 
-  // Pairwise summation
-  if (var->size == 2) {
-    orc_avx_sse_emit_paddw (compiler, ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (src));
-  } else {
-    orc_avx_sse_emit_paddd (compiler, ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (src));
-  }
+  // Combine the partial accumulators of the unrolled loop first
+  for (j = 1; j < compiler->n_partial_accs; j++) {
+    const int partial = compiler->partial_accs[i - ORC_VAR_A1][j];
 
-  // Combine the remaining two pairs in the low half
-  orc_avx_sse_emit_pshufd (compiler, ORC_AVX_SSE_SHUF (1, 1, 1, 1), ORC_AVX_SSE_REG (src),
-      ORC_AVX_SSE_REG (tmp));
+    avx_emit_accumulate (compiler, type, var->size, TRUE, partial, src);
+  }
 
-  // Pairwise summation
-  if (var->size == 2) {
-    orc_avx_sse_emit_paddw (compiler, ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (src));
-  } else {
-    orc_avx_sse_emit_paddd (compiler, ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (src));
+  // Fold the high half onto the low half until one element is left
+  for (half_size = 16; half_size >= var->size; half_size /= 2) {
+    switch (half_size) {
+      case 16:
+        orc_avx_emit_extractf128_si256 (compiler, 1, src,
+            ORC_AVX_SSE_REG (tmp));
+        break;
+      case 8:
+        orc_avx_sse_emit_pshufd (compiler, ORC_AVX_SSE_SHUF (3, 2, 3, 2),
+            ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (tmp));
+        break;
+      case 4:
+        orc_avx_sse_emit_pshufd (compiler, ORC_AVX_SSE_SHUF (1, 1, 1, 1),
+            ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (tmp));
+        break;
+      case 2:
+        orc_avx_sse_emit_pshuflw (compiler, ORC_AVX_SSE_SHUF (1, 1, 1, 1),
+            ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (tmp));
+        break;
+      default:
+        orc_avx_sse_emit_psrlw_imm (compiler, 8, ORC_AVX_SSE_REG (src),
+            ORC_AVX_SSE_REG (tmp));
+        break;
+    }
+    avx_emit_accumulate (compiler, type, var->size, FALSE, tmp, src);
   }
 
-  // Reduce the last pair if it's 16-bit
-  if (var->size == 2) {
-    orc_avx_sse_emit_pshuflw (compiler, ORC_AVX_SSE_SHUF (1, 1, 1, 1),
-        ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (tmp));
-    orc_avx_sse_emit_paddw (compiler, ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (src));
+  // Clear the bits above a 8 or 16-bit result, all 32 bits are stored
+  if (var->size <= 2) {
+    orc_avx_sse_emit_pslld_imm (compiler, 32 - 8 * var->size,
+        ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (src));
+    orc_avx_sse_emit_psrld_imm (compiler, 32 - 8 * var->size,
+        ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (src));
   }
 
-  if (var->size == 2) {
-    orc_avx_sse_emit_pextrw_memoffset (compiler, 0,
-        (int)ORC_STRUCT_OFFSET (OrcExecutor,
-            accumulators[i - ORC_VAR_A1]),
-        ORC_AVX_SSE_REG (src), compiler->exec_reg);
-  } else {
-    orc_x86_emit_mov_avx_memoffset (compiler, 4, src,
+  orc_x86_emit_mov_avx_memoffset (compiler, 4, src,
+      (int)ORC_STRUCT_OFFSET (OrcExecutor,
+          accumulators[i - ORC_VAR_A1]),
+      compiler->exec_reg, var->is_aligned, var->is_uncached);
+  if (var->size == 8) {
+    // The high half goes to params[ORC_VAR_T9 + i]
+    orc_avx_sse_emit_pshufd (compiler, ORC_AVX_SSE_SHUF (1, 1, 1, 1),
+        ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (tmp));
+    orc_x86_emit_mov_avx_memoffset (compiler, 4, tmp,
         (int)ORC_STRUCT_OFFSET (OrcExecutor,
-            accumulators[i - ORC_VAR_A1]),
+            params[ORC_VAR_T9 + i - ORC_VAR_A1]),
         compiler->exec_reg, var->is_aligned, var->is_uncached);
   }
 }
@@ -480,7 +542,7 @@ orc_avx_init (void)
     ORC_AVX_REG_SIZE,
     X86_YMM0,
     ORC_AVX_REG_AMOUNT,
-    16,
+    23,
   };
   // clang-format on
   static OrcTarget t;
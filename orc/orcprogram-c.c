@@ -25,6 +25,7 @@ orc_compiler_c_init (OrcCompiler *compiler)
     compiler->valid_regs[i] = 1;
   }
   compiler->loop_shift = 0;
+  compiler->hoist_invariants = TRUE;
 }
 
 const char *
@@ -192,6 +193,57 @@ get_varname_stride (char *s, OrcCompiler *compiler, int var)
   }
 }
 
+/* Combines the accumulator @var of a chunk of the emulation with the value
+ * of the previous chunks, which starts as the identity of @type */
+static void
+c_emit_accumulator_combine (OrcCompiler *compiler, OrcAccumulatorType type,
+    int var)
+{
+  const int size = compiler->vars[var].size;
+  const int k = var - ORC_VAR_A1;
+  char varname[40];
+
+  c_get_name_int (varname, compiler, NULL, var);
+
+  switch (type) {
+    case ORC_ACCUMULATOR_MAXU:
+    case ORC_ACCUMULATOR_MINU:
+      ORC_ASM_CODE(compiler,"  ((orc_union32 *)ex->dest_ptrs[%d])->i = "
+          "ORC_%s((orc_uint%d)%s, (orc_uint%d)((orc_union32 *)ex->dest_ptrs[%d])->i);\n",
+          k, type == ORC_ACCUMULATOR_MAXU ? "MAX" : "MIN", size * 8, varname,
+          size * 8, k);
+      break;
+    case ORC_ACCUMULATOR_MAXS:
+    case ORC_ACCUMULATOR_MINS:
+      ORC_ASM_CODE(compiler,"  ((orc_union32 *)ex->dest_ptrs[%d])->i = "
+          "ORC_%s((orc_int%d)%s, (orc_int%d)((orc_union32 *)ex->dest_ptrs[%d])->i) & 0x%x;\n",
+          k, type == ORC_ACCUMULATOR_MAXS ? "MAX" : "MIN", size * 8, varname,
+          size * 8, k, (1 << (size * 8)) - 1);
+      break;
+    case ORC_ACCUMULATOR_OR:
+      ORC_ASM_CODE(compiler,"  ((orc_union32 *)ex->dest_ptrs[%d])->i |= %s;\n",
+          k, varname);
+      break;
+    case ORC_ACCUMULATOR_AND:
+      ORC_ASM_CODE(compiler,"  ((orc_union32 *)ex->dest_ptrs[%d])->i &= %s;\n",
+          k, varname);
+      break;
+    case ORC_ACCUMULATOR_ADDF:
+      ORC_ASM_CODE(compiler,"  {\n");
+      ORC_ASM_CODE(compiler,"    orc_union%d _acc;\n", size * 8);
+      ORC_ASM_CODE(compiler,"    _acc.i = ((orc_union%d *)ex->dest_ptrs[%d])->i;\n",
+          size * 8, k);
+      ORC_ASM_CODE(compiler,"    _acc.f = _acc.f + var%d.f;\n", var);
+      ORC_ASM_CODE(compiler,"    ((orc_union%d *)ex->dest_ptrs[%d])->i = %s(_acc.i);\n",
+          size * 8, k, size == 8 ? "ORC_DENORMAL_DOUBLE" : "ORC_DENORMAL");
+      ORC_ASM_CODE(compiler,"  }\n");
+      break;
+    default:
+      ORC_COMPILER_ERROR(compiler, "unhandled accumulator type %d", type);
+      break;
+  }
+}
+
 static void
 orc_compiler_c_assemble (OrcCompiler *compiler)
 {
@@ -200,6 +252,7 @@ orc_compiler_c_assemble (OrcCompiler *compiler)
   OrcInstruction *insn;
   OrcStaticOpcode *opcode;
   OrcRule *rule;
+  OrcAccumulatorType type;
   int prefix = 0;
 
   if (!(compiler->target_flags & ORC_TARGET_C_BARE)) {
@@ -230,7 +283,7 @@ orc_compiler_c_assemble (OrcCompiler *compiler)
     }
   }
 
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     OrcVariable *var = compiler->vars + i;
     if (var->name == NULL) continue;
     switch (var->vartype) {
@@ -263,14 +316,29 @@ orc_compiler_c_assemble (OrcCompiler *compiler)
             i);
         break;
       case ORC_VAR_TYPE_ACCUMULATOR:
-        if (var->size >= 2) {
-          ORC_ASM_CODE(compiler,"  %s var%d =  { 0 };\n",
-              c_get_type_name (var->size),
-              i);
-        } else {
-          ORC_ASM_CODE(compiler,"  %s var%d = 0;\n",
-              c_get_type_name (var->size),
-              i);
+        {
+          OrcVariable identity = { 0 };
+          char lit[40];
+
+          identity.size = var->size;
+          identity.value.i = orc_accumulator_get_identity (
+              orc_accumulator_get_type (compiler->insns, compiler->n_insns, i),
+              var->size);
+          if (identity.value.i != 0) {
+            c_get_const_var_literal (compiler, &identity, lit);
+            ORC_ASM_CODE(compiler,"  %s var%d = %s(orc_int%d)%s%s;\n",
+                c_get_type_name (var->size), i,
+                var->size >= 2 ? "{ " : "", var->size * 8, lit,
+                var->size >= 2 ? " }" : "");
+          } else if (var->size >= 2) {
+            ORC_ASM_CODE(compiler,"  %s var%d =  { 0 };\n",
+                c_get_type_name (var->size),
+                i);
+          } else {
+            ORC_ASM_CODE(compiler,"  %s var%d = 0;\n",
+                c_get_type_name (var->size),
+                i);
+          }
         }
         break;
       case ORC_VAR_TYPE_PARAM:
@@ -286,7 +354,7 @@ orc_compiler_c_assemble (OrcCompiler *compiler)
     ORC_ASM_CODE(compiler,"  for (j = 0; j < m; j++) {\n");
     prefix = 2;
 
-    for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+    for(i=0;i<compiler->n_vars;i++){
       OrcVariable *var = compiler->vars + i;
       if (var->name == NULL) continue;
       switch (var->vartype) {
@@ -315,7 +383,7 @@ orc_compiler_c_assemble (OrcCompiler *compiler)
       }
     }
   } else {
-    for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+    for(i=0;i<compiler->n_vars;i++){
       OrcVariable *var = compiler->vars + i;
       char s[40];
       if (var->name == NULL) continue;
@@ -412,14 +480,33 @@ orc_compiler_c_assemble (OrcCompiler *compiler)
     ORC_ASM_CODE(compiler,"  }\n");
   }
 
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     char varname[40];
     OrcVariable *var = compiler->vars + i;
     if (var->name == NULL) continue;
     switch (var->vartype) {
       case ORC_VAR_TYPE_ACCUMULATOR:
         c_get_name_int (varname, compiler, NULL, i);
-        if (var->size == 2) {
+        type = orc_accumulator_get_type (compiler->insns, compiler->n_insns,
+            i);
+        if (compiler->target_flags & ORC_TARGET_C_NOEXEC && var->type_name &&
+            (strcmp (var->type_name, "float") == 0 ||
+             strcmp (var->type_name, "double") == 0)) {
+          /* float and double pointers get the value, not its bits */
+          sprintf (varname, "var%d.f", i);
+        }
+        if (compiler->target_flags & ORC_TARGET_C_OPCODE &&
+            type != ORC_ACCUMULATOR_ADD) {
+          c_emit_accumulator_combine (compiler, type, i);
+        } else if (var->size == 1) {
+          if (compiler->target_flags & ORC_TARGET_C_NOEXEC) {
+            ORC_ASM_CODE(compiler,"  *%s = %s;\n",
+                orc_variable_id_get_name (i), varname);
+          } else {
+            ORC_ASM_CODE(compiler,"  ex->accumulators[%d] = (%s & 0xff);\n",
+                i - ORC_VAR_A1, varname);
+          }
+        } else if (var->size == 2) {
           if (compiler->target_flags & ORC_TARGET_C_NOEXEC) {
             ORC_ASM_CODE(compiler,"  *%s = (%s & 0xffff);\n",
                 orc_variable_id_get_name (i), varname);
@@ -431,6 +518,20 @@ orc_compiler_c_assemble (OrcCompiler *compiler)
             ORC_ASM_CODE(compiler,"  ex->accumulators[%d] = (%s & 0xffff);\n",
                 i - ORC_VAR_A1, varname);
           }
+        } else if (var->size == 8) {
+          if (compiler->target_flags & ORC_TARGET_C_NOEXEC) {
+            ORC_ASM_CODE(compiler,"  *%s = %s;\n",
+                orc_variable_id_get_name (i), varname);
+          } else if (compiler->target_flags & ORC_TARGET_C_OPCODE) {
+            ORC_ASM_CODE(compiler,"  ((orc_union64 *)ex->dest_ptrs[%d])->i += (orc_uint64)%s;\n",
+                i - ORC_VAR_A1, varname);
+          } else {
+            /* The high half goes to params[ORC_VAR_T9 + i] */
+            ORC_ASM_CODE(compiler,"  ex->accumulators[%d] = (orc_uint32)%s;\n",
+                i - ORC_VAR_A1, varname);
+            ORC_ASM_CODE(compiler,"  ex->params[%d] = (orc_uint32)((orc_uint64)%s >> 32);\n",
+                ORC_VAR_T9 + i - ORC_VAR_A1, varname);
+          }
         } else {
           if (compiler->target_flags & ORC_TARGET_C_NOEXEC) {
             ORC_ASM_CODE(compiler,"  *%s = %s;\n",
@@ -1034,6 +1135,64 @@ c_rule_accsadubl (OrcCompiler *p, void *user, OrcInstruction *insn)
       dest, dest, src1, src2);
 }
 
+#define ACC(name,op) \
+static void \
+c_rule_ ## name (OrcCompiler *p, void *user, OrcInstruction *insn) \
+{ \
+  char dest[40], src1[40]; \
+\
+  c_get_name_int (dest, p, insn, insn->dest_args[0]); \
+  c_get_name_int (src1, p, insn, insn->src_args[0]); \
+ \
+  ORC_ASM_CODE(p,"    %s = " op ";\n", dest, dest, src1); \
+}
+
+ACC(accmaxub, "ORC_MAX((orc_uint8)%s, (orc_uint8)%s)")
+ACC(accminub, "ORC_MIN((orc_uint8)%s, (orc_uint8)%s)")
+ACC(accmaxsw, "ORC_MAX(%s, %s)")
+ACC(accminsw, "ORC_MIN(%s, %s)")
+ACC(accorl, "%s | %s")
+ACC(accandl, "%s & %s")
+ACC(accq, "(orc_uint64)%s + (orc_uint64)%s")
+
+static void
+c_rule_accf (OrcCompiler *p, void *user, OrcInstruction *insn)
+{
+  char dest[40], src1[40];
+
+  c_get_name_int (dest, p, insn, insn->dest_args[0]);
+  c_get_name_int (src1, p, insn, insn->src_args[0]);
+
+  ORC_ASM_CODE(p, "    {\n");
+  ORC_ASM_CODE(p,"       orc_union32 _src1;\n");
+  ORC_ASM_CODE(p,"       orc_union32 _src2;\n");
+  ORC_ASM_CODE(p,"       orc_union32 _dest1;\n");
+  ORC_ASM_CODE(p,"       _src1.i = ORC_DENORMAL(%s);\n", dest);
+  ORC_ASM_CODE(p,"       _src2.i = ORC_DENORMAL(%s);\n", src1);
+  ORC_ASM_CODE(p,"       _dest1.f = _src1.f + _src2.f;\n");
+  ORC_ASM_CODE(p,"       %s = ORC_DENORMAL(_dest1.i);\n", dest);
+  ORC_ASM_CODE(p, "    }\n");
+}
+
+static void
+c_rule_accd (OrcCompiler *p, void *user, OrcInstruction *insn)
+{
+  char dest[40], src1[40];
+
+  c_get_name_int (dest, p, insn, insn->dest_args[0]);
+  c_get_name_int (src1, p, insn, insn->src_args[0]);
+
+  ORC_ASM_CODE(p, "    {\n");
+  ORC_ASM_CODE(p,"       orc_union64 _src1;\n");
+  ORC_ASM_CODE(p,"       orc_union64 _src2;\n");
+  ORC_ASM_CODE(p,"       orc_union64 _dest1;\n");
+  ORC_ASM_CODE(p,"       _src1.i = ORC_DENORMAL_DOUBLE(%s);\n", dest);
+  ORC_ASM_CODE(p,"       _src2.i = ORC_DENORMAL_DOUBLE(%s);\n", src1);
+  ORC_ASM_CODE(p,"       _dest1.f = _src1.f + _src2.f;\n");
+  ORC_ASM_CODE(p,"       %s = ORC_DENORMAL_DOUBLE(_dest1.i);\n", dest);
+  ORC_ASM_CODE(p, "    }\n");
+}
+
 static void
 c_rule_splitql (OrcCompiler *p, void *user, OrcInstruction *insn)
 {
@@ -1587,6 +1746,15 @@ orc_c_init (void)
   orc_rule_register (rule_set, "accw", c_rule_accw, NULL);
   orc_rule_register (rule_set, "accl", c_rule_accl, NULL);
   orc_rule_register (rule_set, "accsadubl", c_rule_accsadubl, NULL);
+  orc_rule_register (rule_set, "accmaxub", c_rule_accmaxub, NULL);
+  orc_rule_register (rule_set, "accminub", c_rule_accminub, NULL);
+  orc_rule_register (rule_set, "accmaxsw", c_rule_accmaxsw, NULL);
+  orc_rule_register (rule_set, "accminsw", c_rule_accminsw, NULL);
+  orc_rule_register (rule_set, "accorl", c_rule_accorl, NULL);
+  orc_rule_register (rule_set, "accandl", c_rule_accandl, NULL);
+  orc_rule_register (rule_set, "accq", c_rule_accq, NULL);
+  orc_rule_register (rule_set, "accf", c_rule_accf, NULL);
+  orc_rule_register (rule_set, "accd", c_rule_accd, NULL);
   orc_rule_register (rule_set, "splitql", c_rule_splitql, NULL);
   orc_rule_register (rule_set, "splitlw", c_rule_splitlw, NULL);
   orc_rule_register (rule_set, "splitwb", c_rule_splitwb, NULL);
@@ -224,7 +224,7 @@ orc_compiler_c64x_c_assemble (OrcCompiler *compiler)
     ORC_ASM_CODE(compiler,"  int j;\n");
   }
 
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     OrcVariable *var = compiler->vars + i;
     if (var->name == NULL) continue;
     switch (var->vartype) {
@@ -298,7 +298,7 @@ orc_compiler_c64x_c_assemble (OrcCompiler *compiler)
     }
     prefix = 2;
 
-    for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+    for(i=0;i<compiler->n_vars;i++){
       OrcVariable *var = compiler->vars + i;
       if (var->name == NULL) continue;
       switch (var->vartype) {
@@ -325,7 +325,7 @@ orc_compiler_c64x_c_assemble (OrcCompiler *compiler)
       }
     }
   } else {
-    for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+    for(i=0;i<compiler->n_vars;i++){
       OrcVariable *var = compiler->vars + i;
       if (var->name == NULL) continue;
       switch (var->vartype) {
@@ -395,7 +395,7 @@ orc_compiler_c64x_c_assemble (OrcCompiler *compiler)
     ORC_ASM_CODE(compiler,"  }\n");
   }
 
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     OrcVariable *var = compiler->vars + i;
     if (var->name == NULL) continue;
     switch (var->vartype) {
@@ -456,7 +456,7 @@ emit_loop (OrcCompiler *compiler, int prefix)
     }
   }
   ORC_ASM_CODE(compiler,"\n");
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     OrcVariable *var = compiler->vars + i;
     if (var->name == NULL) continue;
     switch (var->vartype) {
@@ -276,7 +276,7 @@ static void
 orc_mips_load_constants_inner (OrcCompiler *compiler)
 {
   int i;
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     OrcVariable *var = compiler->vars + i;
     if (var->name == NULL) continue;
     switch (var->vartype) {
@@ -310,7 +310,7 @@ orc_mips_emit_var_pref (OrcCompiler *compiler, int iter_offset, int total_shift)
   int i, j;
   int offset = 0;
   /* prefetch stuff into cache */
-  for (i=0; i<ORC_N_COMPILER_VARIABLES; i++) {
+  for (i=0; i<compiler->n_vars; i++) {
     OrcVariable *var = compiler->vars + i;
 
     if (var->name == NULL) continue;
@@ -480,7 +480,7 @@ orc_mips_emit_loop (OrcCompiler *compiler, int unroll)
 
   compiler->unroll_index = 0;
 
-  for (j=0; j<ORC_N_COMPILER_VARIABLES; j++) {
+  for (j=0; j<compiler->n_vars; j++) {
     OrcVariable *var = compiler->vars + j;
 
     if (var->name == NULL) continue;
@@ -598,7 +598,7 @@ orc_mips_add_strides (OrcCompiler *compiler, int var_size_shift)
   orc_mips_emit_sll (compiler, ORC_MIPS_T1, ORC_MIPS_T1, var_size_shift);
   /* $t1 now contains the number of bytes that we treated (and that the var
    * pointer registers advanced) */
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     if (compiler->vars[i].name == NULL) continue;
     switch (compiler->vars[i].vartype) {
       case ORC_VAR_TYPE_CONST:
@@ -648,7 +648,7 @@ orc_compiler_orc_mips_assemble (OrcCompiler *compiler)
 
   /* FIXME: load constants and params */
 #if 0
-  for (i=0; i<ORC_N_COMPILER_VARIABLES; i++) {
+  for (i=0; i<compiler->n_vars; i++) {
     if (compiler->vars[i].name == NULL)
       ORC_PROGRAM_ERROR (compiler, "unimplemented");
   }
@@ -57,7 +57,7 @@ mmx_get_flag_name (int shift)
     "sse42",
     "frame_pointer",
     "short_jumps",
-    "64bit"
+    "64bit",
     "sse2",
     "sse3",
   };
@@ -153,6 +153,18 @@ mmx_reduce_accumulator (OrcCompiler *compiler, int i, OrcVariable *var)
 {
   const int src = var->alloc;
   const int tmp = orc_compiler_get_temp_reg (compiler);
+  int j;
+
+  /* Add up the partial accumulators of the unrolled loop first */
+  for (j = 1; j < compiler->n_partial_accs; j++) {
+    const int partial = compiler->partial_accs[i - ORC_VAR_A1][j];
+
+    if (var->size == 2) {
+      orc_mmx_emit_paddw (compiler, partial, src);
+    } else {
+      orc_mmx_emit_paddd (compiler, partial, src);
+    }
+  }
 
   orc_mmx_emit_pshufw (compiler, ORC_MMX_SHUF(3,2,3,2), src, tmp);
 
@@ -399,7 +411,7 @@ orc_mmx_init (void)
     8,
     X86_MM0,
     ORC_REG_SIZE,
-    13,
+    23,
   };
   // clang-format on
   static OrcTarget t;
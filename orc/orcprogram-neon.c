@@ -273,16 +273,11 @@ orc_neon_emit_load_src (OrcCompiler *compiler, OrcVariable *var, int unroll_inde
   }
   
   if (unroll_index == 0) {
-  switch (compiler->size_region) {
-    case 0:
-    case 1:
-      orc_neon_preload (compiler, var, FALSE, 208);
-      break;
-    case 2:
-    case 3:
-      orc_neon_preload (compiler, var, FALSE, 208);
-      break;
-  }
+    OrcPrefetch prefetch;
+
+    if (orc_compiler_get_prefetch (compiler, var - compiler->vars,
+            compiler->size_region, compiler->unroll_shift, &prefetch))
+      orc_neon_preload (compiler, var, FALSE, prefetch.distance);
   }
 }
 
@@ -29,6 +29,7 @@ static void orc_neon32_emit_epilogue (OrcCompiler *compiler);
 static void orc_neon32_emit_inc_pointers (OrcCompiler *compiler);
 static void orc_neon32_load_constants_inner (OrcCompiler *compiler);
 static void orc_neon32_load_constants_outer (OrcCompiler *compiler);
+static void orc_neon32_emit_prefetch (OrcCompiler *compiler);
 
 #define NEON_BINARY(code,a,b,c) \
   ((code) | \
@@ -241,6 +242,7 @@ orc_neon32_compile (OrcCompiler *compiler)
   /* N is larger than L2 cache size */
   compiler->size_region = 3;
   orc_arm_emit_label (compiler, LABEL_REGION2_LOOP_LARGE);
+  orc_neon32_emit_prefetch (compiler);
   for(i=0;i<(1<<compiler->unroll_shift);i++){
     orc_neon32_emit_loop (compiler, i);
   }
@@ -257,6 +259,7 @@ orc_neon32_compile (OrcCompiler *compiler)
   /* N is smaller than L2 cache size */
   compiler->size_region = 2;
   orc_arm_emit_label (compiler, LABEL_REGION2_LOOP_MEDIUM);
+  orc_neon32_emit_prefetch (compiler);
   for(i=0;i<(1<<compiler->unroll_shift);i++){
     orc_neon32_emit_loop (compiler, i);
   }
@@ -349,7 +352,7 @@ orc_neon32_save_accumulators (OrcCompiler *compiler)
   int src;
   unsigned int code;
 
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     OrcVariable *var = compiler->vars + i;
 
     if (compiler->vars[i].name == NULL) continue;
@@ -426,7 +429,7 @@ orc_neon32_add_strides (OrcCompiler *compiler)
 {
   int i;
 
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     if (compiler->vars[i].name == NULL) continue;
     switch (compiler->vars[i].vartype) {
       case ORC_VAR_TYPE_CONST:
@@ -482,10 +485,37 @@ orc_neon32_emit_epilogue (OrcCompiler *compiler)
   orc_arm_emit_bx_lr (compiler);
 }
 
+/* Issues the software prefetches of the sources for one iteration of the
+ * region 2 loop, one per cache line consumed by the iteration. PLD has no
+ * streaming or write hint here, so only the distance depends on the
+ * region. */
+static void
+orc_neon32_emit_prefetch (OrcCompiler *compiler)
+{
+  OrcPrefetch prefetch;
+  int bytes;
+  int i, j;
+
+  for (i = ORC_VAR_S1; i <= ORC_VAR_S8; i++) {
+    OrcVariable *var = compiler->vars + i;
+
+    if (var->size == 0 || !var->ptr_register || var->ptr_offset)
+      continue;
+    if (!orc_compiler_get_prefetch (compiler, i, compiler->size_region,
+            compiler->unroll_shift, &prefetch))
+      continue;
+
+    bytes = var->size << (compiler->loop_shift + compiler->unroll_shift);
+    for (j = 0; j < bytes; j += ORC_CACHE_LINE_SIZE) {
+      orc_neon_preload (compiler, var, FALSE, prefetch.distance + j);
+    }
+  }
+}
+
 static void
 orc_neon32_emit_inc_pointers (OrcCompiler *compiler)
 {
-  for(int k=0;k<ORC_N_COMPILER_VARIABLES;k++){
+  for(int k=0;k<compiler->n_vars;k++){
     if (compiler->vars[k].name == NULL) continue;
     if (compiler->vars[k].vartype == ORC_VAR_TYPE_SRC ||
         compiler->vars[k].vartype == ORC_VAR_TYPE_DEST) {
@@ -508,7 +538,7 @@ static void
 orc_neon32_load_constants_inner (OrcCompiler *compiler)
 {
   int i;
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     if (compiler->vars[i].name == NULL) continue;
 
     switch (compiler->vars[i].vartype) {
@@ -541,7 +571,7 @@ orc_neon32_load_constants_inner (OrcCompiler *compiler)
 static void
 orc_neon32_load_constants_outer (OrcCompiler *compiler)
 {
-  for(int i = 0; i < ORC_N_COMPILER_VARIABLES; i++) {
+  for(int i = 0; i < compiler->n_vars; i++) {
     if (compiler->vars[i].name == NULL) continue;
     if (compiler->vars[i].vartype != ORC_VAR_TYPE_ACCUMULATOR) continue;
 
@@ -32,9 +32,22 @@ static void orc_neon64_set_region_counters (OrcCompiler *compiler);
 static void orc_neon64_loop_caches (OrcCompiler *compiler);
 static void orc_neon64_emit_inc_pointers (OrcCompiler *compiler);
 static void orc_neon64_load_constants_outer (OrcCompiler *compiler);
+static void orc_neon64_emit_prefetch (OrcCompiler *compiler);
+static void orc_neon64_emit_prefetch_next_row (OrcCompiler *compiler);
 
 #define ORC_NEON_LONG_PROGRAM_CUTOFF 5
 
+/* Typical of the Cortex-A7x cores, two vector pipelines */
+static const OrcSchedModel orc_neon64_sched_model = {
+  2, /* issue_width */
+  5, /* load */
+  1, /* store */
+  2, /* simple */
+  4, /* multiply */
+  3, /* float_op */
+  10, /* float_div */
+};
+
 #define orc_neon64_loop_shift_remainder(compiler,counter,label_loop,label_skip) \
 { \
   int save_loop_shift = compiler->loop_shift; \
@@ -87,6 +100,7 @@ orc_neon64_compiler_init (OrcCompiler *compiler)
 
   compiler->tmpreg = ORC_VEC_REG_BASE + 0;
   compiler->tmpreg2 = ORC_VEC_REG_BASE + 1;
+  compiler->sched_model = &orc_neon64_sched_model;
 
   orc_neon_compiler_init_common (compiler);
 }
@@ -164,6 +178,7 @@ orc_neon64_compile (OrcCompiler *compiler)
     orc_neon64_set_region_counters (compiler);
 
     orc_neon64_load_constants_inner (compiler);
+    orc_neon64_emit_prefetch_next_row (compiler);
 
     orc_neon64_loop_shift_remainder (compiler, counter1,
         LABEL_REGION1_LOOP, LABEL_REGION1_SKIP);
@@ -179,6 +194,7 @@ orc_neon64_compile (OrcCompiler *compiler)
         LABEL_REGION3_LOOP, LABEL_REGION3_SKIP);
   } else {
     orc_neon64_load_constants_inner (compiler);
+    orc_neon64_emit_prefetch_next_row (compiler);
 
     orc_arm64_emit_load_reg (compiler, 32, ORC_ARM64_IP0, compiler->exec_reg,
         (int)ORC_STRUCT_OFFSET(OrcExecutor,n));
@@ -270,7 +286,7 @@ orc_neon64_save_accumulators (OrcCompiler *compiler)
   int src;
   unsigned int code;
 
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     OrcVariable *var = compiler->vars + i;
 
     if (compiler->vars[i].name == NULL) continue;
@@ -338,7 +354,7 @@ orc_neon64_add_strides (OrcCompiler *compiler)
 {
   int i;
 
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     if (compiler->vars[i].name == NULL) continue;
     switch (compiler->vars[i].vartype) {
       case ORC_VAR_TYPE_CONST:
@@ -398,7 +414,7 @@ static void
 orc_neon64_load_constants_inner (OrcCompiler *compiler)
 {
   int i;
-  for(i=0;i<ORC_N_COMPILER_VARIABLES;i++){
+  for(i=0;i<compiler->n_vars;i++){
     if (compiler->vars[i].name == NULL) continue;
 
     switch (compiler->vars[i].vartype) {
@@ -526,6 +542,7 @@ orc_neon64_loop_caches (OrcCompiler *compiler)
   compiler->size_region = 3;
   orc_arm_emit_label (compiler, LABEL_REGION2_LOOP_LARGE);
   orc_arm64_emit_subs_imm (compiler, 32, ORC_ARM64_IP0, ORC_ARM64_IP0, 1);
+  orc_neon64_emit_prefetch (compiler);
   for(i=0;i<(1<<compiler->unroll_shift);i++){
     orc_neon64_emit_loop (compiler, i);
   }
@@ -543,6 +560,7 @@ orc_neon64_loop_caches (OrcCompiler *compiler)
   compiler->size_region = 2;
   orc_arm_emit_label (compiler, LABEL_REGION2_LOOP_MEDIUM);
   orc_arm64_emit_subs_imm (compiler, 32, ORC_ARM64_IP0, ORC_ARM64_IP0, 1);
+  orc_neon64_emit_prefetch (compiler);
   for(i=0;i<(1<<compiler->unroll_shift);i++){
     orc_neon64_emit_loop (compiler, i);
   }
@@ -562,10 +580,78 @@ orc_neon64_loop_caches (OrcCompiler *compiler)
   orc_arm_emit_label (compiler, LABEL_REGION2_SKIP);
 }
 
+/* Issues the software prefetches of the arrays for one iteration of the
+ * region 2 loop, one per cache line consumed by the iteration. PRFM does
+ * not change the flags set by the loop counter. */
+static void
+orc_neon64_emit_prefetch (OrcCompiler *compiler)
+{
+  OrcPrefetch prefetch;
+  OrcArm64Prefetch prfop;
+  int bytes;
+  int i, j;
+
+  for (i = ORC_VAR_D1; i <= ORC_VAR_S8; i++) {
+    OrcVariable *var = compiler->vars + i;
+
+    if (var->size == 0 || !var->ptr_register || var->ptr_offset)
+      continue;
+    if (!orc_compiler_get_prefetch (compiler, i, compiler->size_region,
+            compiler->unroll_shift, &prefetch))
+      continue;
+
+    if (prefetch.write) {
+      prfop = ORC_ARM64_PSTL1STRM;
+    } else if (prefetch.hint == ORC_PREFETCH_STREAM) {
+      prfop = ORC_ARM64_PLDL2STRM;
+    } else {
+      prfop = ORC_ARM64_PLDL1KEEP;
+    }
+
+    bytes = var->size << (compiler->loop_shift + compiler->unroll_shift);
+    for (j = 0; j < bytes; j += ORC_CACHE_LINE_SIZE) {
+      orc_arm64_emit_prfm (compiler, prfop, var->ptr_register,
+          prefetch.distance + j);
+    }
+  }
+}
+
+/* For 2D programs, prefetch the beginning of the next row of every source
+ * while the current one is processed. */
+static void
+orc_neon64_emit_prefetch_next_row (OrcCompiler *compiler)
+{
+  OrcPrefetch prefetch;
+  int i, j;
+
+  if (!compiler->program->is_2d || compiler->program->constant_m == 1)
+    return;
+
+  for (i = ORC_VAR_S1; i <= ORC_VAR_S8; i++) {
+    OrcVariable *var = compiler->vars + i;
+
+    if (var->size == 0 || !var->ptr_register)
+      continue;
+    if (!orc_compiler_get_prefetch (compiler, i, 3, compiler->unroll_shift,
+            &prefetch))
+      continue;
+
+    orc_arm64_emit_load_reg (compiler, 32, compiler->gp_tmpreg,
+        compiler->exec_reg, (int)ORC_STRUCT_OFFSET (OrcExecutor, params[i]));
+    orc_arm64_emit_add_sxtw (compiler, 64, compiler->gp_tmpreg,
+        var->ptr_register, compiler->gp_tmpreg, 0);
+    for (j = 0; j < MIN (prefetch.distance, ORC_NEON_MAX_NEXT_ROW_PREFETCH);
+        j += ORC_CACHE_LINE_SIZE) {
+      orc_arm64_emit_prfm (compiler, ORC_ARM64_PLDL1KEEP,
+          compiler->gp_tmpreg, j);
+    }
+  }
+}
+
 static void
 orc_neon64_emit_inc_pointers (OrcCompiler *compiler)
 {
-  for(int k=0;k<ORC_N_COMPILER_VARIABLES;k++){
+  for(int k=0;k<compiler->n_vars;k++){
     if (compiler->vars[k].name == NULL) continue;
     if (compiler->vars[k].vartype == ORC_VAR_TYPE_SRC ||
         compiler->vars[k].vartype == ORC_VAR_TYPE_DEST) {
@@ -587,7 +673,7 @@ orc_neon64_emit_inc_pointers (OrcCompiler *compiler)
 static void
 orc_neon64_load_constants_outer (OrcCompiler *compiler)
 {
-  for(int i = 0; i < ORC_N_COMPILER_VARIABLES; i++) {
+  for(int i = 0; i < compiler->n_vars; i++) {
     if (compiler->vars[i].name == NULL) continue;
     if (compiler->vars[i].vartype != ORC_VAR_TYPE_ACCUMULATOR) continue;
 
@@ -56,7 +56,7 @@ sse_get_flag_name (int shift)
     "sse5",
     "frame_pointer",
     "short_jumps",
-    "64bit"
+    "64bit",
     /* To keep backwards compatibility */
     "",
     "",
@@ -149,43 +149,108 @@ sse_init_accumulator (OrcCompiler *compiler, OrcVariable *var)
   orc_sse_emit_pxor (compiler, var->alloc, var->alloc);
 }
 
+/* Combines the lanes of @src into @dest the way the accumulator of @type
+ * does */
 static void
-sse_reduce_accumulator (OrcCompiler *compiler, int i, OrcVariable *var) {
+sse_emit_accumulate (OrcCompiler *compiler, OrcAccumulatorType type,
+    int size, int src, int dest)
+{
+  switch (type) {
+    case ORC_ACCUMULATOR_MAXU:
+      orc_sse_emit_pmaxub (compiler, src, dest);
+      break;
+    case ORC_ACCUMULATOR_MINU:
+      orc_sse_emit_pminub (compiler, src, dest);
+      break;
+    case ORC_ACCUMULATOR_MAXS:
+      orc_sse_emit_pmaxsw (compiler, src, dest);
+      break;
+    case ORC_ACCUMULATOR_MINS:
+      orc_sse_emit_pminsw (compiler, src, dest);
+      break;
+    case ORC_ACCUMULATOR_OR:
+      orc_sse_emit_por (compiler, src, dest);
+      break;
+    case ORC_ACCUMULATOR_AND:
+      orc_sse_emit_pand (compiler, src, dest);
+      break;
+    case ORC_ACCUMULATOR_ADDF:
+      if (size == 8) {
+        orc_sse_emit_addpd (compiler, src, dest);
+      } else {
+        orc_sse_emit_addps (compiler, src, dest);
+      }
+      break;
+    default:
+      if (size == 2) {
+        orc_sse_emit_paddw (compiler, src, dest);
+      } else if (size == 8) {
+        orc_sse_emit_paddq (compiler, src, dest);
+      } else {
+        orc_sse_emit_paddd (compiler, src, dest);
+      }
+      break;
+  }
+}
+
+static void
+sse_reduce_accumulator (OrcCompiler *compiler, int i, OrcVariable *var)
+{
   const int src = var->alloc;
   const int tmp = orc_compiler_get_temp_reg (compiler);
+  const OrcAccumulatorType type = orc_accumulator_get_type (compiler->insns,
+      compiler->n_insns, i);
+  int half_size;
+  int j;
 
-        orc_sse_emit_pshufd (compiler, ORC_SSE_SHUF(3,2,3,2), src, tmp);
-        if (var->size == 2) {
-          orc_sse_emit_paddw (compiler, tmp, src);
-        } else {
-          orc_sse_emit_paddd (compiler, tmp, src);
-        }
+  /* Combine the partial accumulators of the unrolled loop first */
+  for (j = 1; j < compiler->n_partial_accs; j++) {
+    const int partial = compiler->partial_accs[i - ORC_VAR_A1][j];
+
+    sse_emit_accumulate (compiler, type, var->size, partial, src);
+  }
 
+  /* Then fold the high half of what is left onto the low half */
+  for (half_size = 8; half_size >= var->size; half_size /= 2) {
+    switch (half_size) {
+      case 8:
+        orc_sse_emit_pshufd (compiler, ORC_SSE_SHUF(3,2,3,2), src, tmp);
+        break;
+      case 4:
         orc_sse_emit_pshufd (compiler, ORC_SSE_SHUF(1,1,1,1), src, tmp);
+        break;
+      case 2:
+        orc_sse_emit_pshuflw (compiler, ORC_SSE_SHUF(1,1,1,1), src, tmp);
+        break;
+      default:
+        orc_sse_emit_movdqa (compiler, src, tmp);
+        orc_sse_emit_psrlw_imm (compiler, 8, tmp);
+        break;
+    }
+    sse_emit_accumulate (compiler, type, var->size, tmp, src);
+  }
 
-        if (var->size == 2) {
-          orc_sse_emit_paddw (compiler, tmp, src);
-        } else {
-          orc_sse_emit_paddd (compiler, tmp, src);
-        }
-
-        if (var->size == 2) {
-          orc_sse_emit_pshuflw (compiler, ORC_SSE_SHUF(1,1,1,1), src, tmp);
-          orc_sse_emit_paddw (compiler, tmp, src);
-        }
-
-        if (var->size == 2) {
-          orc_sse_emit_movd_store_register (compiler, src, compiler->gp_tmpreg);
-          orc_x86_emit_and_imm_reg (compiler, 4, 0xffff, compiler->gp_tmpreg);
-          orc_x86_emit_mov_reg_memoffset (compiler, 4, compiler->gp_tmpreg,
-              (int)ORC_STRUCT_OFFSET(OrcExecutor, accumulators[i-ORC_VAR_A1]),
-              compiler->exec_reg);
-        } else {
-          orc_x86_emit_mov_sse_memoffset (compiler, 4, src,
-              (int)ORC_STRUCT_OFFSET(OrcExecutor, accumulators[i-ORC_VAR_A1]),
-              compiler->exec_reg,
-              var->is_aligned, var->is_uncached);
-        }
+  if (var->size <= 2) {
+    orc_sse_emit_movd_store_register (compiler, src, compiler->gp_tmpreg);
+    orc_x86_emit_and_imm_reg (compiler, 4, var->size == 1 ? 0xff : 0xffff,
+        compiler->gp_tmpreg);
+    orc_x86_emit_mov_reg_memoffset (compiler, 4, compiler->gp_tmpreg,
+        (int)ORC_STRUCT_OFFSET(OrcExecutor, accumulators[i-ORC_VAR_A1]),
+        compiler->exec_reg);
+  } else {
+    orc_x86_emit_mov_sse_memoffset (compiler, 4, src,
+        (int)ORC_STRUCT_OFFSET(OrcExecutor, accumulators[i-ORC_VAR_A1]),
+        compiler->exec_reg,
+        var->is_aligned, var->is_uncached);
+    if (var->size == 8) {
+      /* The high half goes to params[ORC_VAR_T9 + i] */
+      orc_sse_emit_pshufd (compiler, ORC_SSE_SHUF(1,1,1,1), src, tmp);
+      orc_x86_emit_mov_sse_memoffset (compiler, 4, tmp,
+          (int)ORC_STRUCT_OFFSET(OrcExecutor,
+              params[ORC_VAR_T9 + i - ORC_VAR_A1]),
+          compiler->exec_reg, var->is_aligned, var->is_uncached);
+    }
+  }
 }
 
 static void
@@ -494,7 +559,7 @@ orc_sse_init (void)
     16,
     X86_XMM0,
     16,
-    13,
+    23,
   };
   // clang-format on
   static OrcTarget t;
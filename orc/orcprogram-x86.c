@@ -27,10 +27,58 @@
 #define LABEL_REGION2_SKIP 3
 #define LABEL_OUTER_LOOP 4
 #define LABEL_OUTER_LOOP_SKIP 5
-// XXX: For AVX-512 onwards, check that this range doesn't overlap
-// with the region 1 labels (LABEL_STEP_UP)
+/* Region 3 takes up to loop_shift + unroll_shift labels from here, that
+ * is 8 + 6 + 3 - 1 for bytes on AVX-512 unrolled 8 times, below the
+ * region 1 labels (LABEL_STEP_UP) */
 #define LABEL_STEP_DOWN(x) (8 + (x))
 #define LABEL_STEP_UP(x) (t->label_step_up + (x))
+#define LABEL_INNER_LOOP_START_UNCACHED 30
+#define LABEL_REGION2_CACHED 31
+#define LABEL_REGION2_MEDIUM 32
+#define LABEL_REGION2_SMALL 33
+#define LABEL_INNER_LOOP_START_LARGE 34
+#define LABEL_INNER_LOOP_START_MEDIUM 35
+#define LABEL_REGION2_TAIL_LARGE 36
+#define LABEL_REGION2_TAIL_MEDIUM 37
+
+#define ORC_X86_MAX_NEXT_ROW_PREFETCH (4 * ORC_CACHE_LINE_SIZE)
+#define ORC_X86_MAX_UNROLL_SHIFT 3
+/* Limits of the unrolling chosen by orc_x86_compiler_get_unroll_shift():
+ * the instructions of the unrolled body, so that it stays in the decoded
+ * instruction cache, and the bytes processed by each array per iteration,
+ * as the elements left by the unrolled loop go through region 3 */
+#define ORC_X86_UNROLL_MAX_INSNS 48
+#define ORC_X86_UNROLL_MAX_BYTES 128
+/* Unroll until the loop overhead is a quarter of the body at most */
+#define ORC_X86_UNROLL_OVERHEAD_RATIO 4
+
+enum {
+  ORC_X86_REGION2_SMALL,
+  ORC_X86_REGION2_MEDIUM,
+  ORC_X86_REGION2_LARGE,
+};
+
+/* Typical of the cores since Haswell. The 256-bit loads and float
+ * divisions take longer than the 128-bit ones. */
+static const OrcSchedModel orc_x86_sse_sched_model = {
+  3, /* issue_width */
+  5, /* load */
+  1, /* store */
+  1, /* simple */
+  5, /* multiply */
+  4, /* float_op */
+  11, /* float_div */
+};
+
+static const OrcSchedModel orc_x86_avx_sched_model = {
+  3, /* issue_width */
+  7, /* load */
+  1, /* store */
+  1, /* simple */
+  5, /* multiply */
+  4, /* float_op */
+  13, /* float_div */
+};
 
 static void
 orc_x86_validate_registers (OrcX86Target *t, OrcCompiler *c)
@@ -72,6 +120,158 @@ orc_x86_compiler_max_loop_shift (OrcX86Target *t, OrcCompiler *c)
   }
 }
 
+/* Estimates the instructions of a copy of the loop body and those of the
+ * loop overhead, that is the pointer updates, the counter and the branch */
+static void
+orc_x86_get_loop_size (OrcCompiler *c, int *body, int *overhead)
+{
+  int n_arrays = 0;
+  int i;
+
+  for (i = ORC_VAR_D1; i <= ORC_VAR_S8; i++) {
+    if (c->program->vars[i].size > 0)
+      n_arrays++;
+  }
+
+  /* Plus the loads and stores of orc_compiler_rewrite_insns() */
+  *body = c->program->n_insns + n_arrays;
+  *overhead = n_arrays + 2;
+}
+
+/* Counts the vector registers taken by the variables of the program, the
+ * invariants as well as they are hoisted out of the loop, and the ones
+ * available */
+static void
+orc_x86_get_register_pressure (OrcX86Target *t, OrcCompiler *c,
+    int *n_values, int *n_regs)
+{
+  int i;
+
+  *n_values = 0;
+  for (i = 0; i < ORC_N_VARIABLES; i++) {
+    if (c->program->vars[i].size > 0)
+      (*n_values)++;
+  }
+  *n_regs = 0;
+  for (i = 0; i < t->n_registers; i++) {
+    if (c->valid_regs[t->register_start + i])
+      (*n_regs)++;
+  }
+}
+
+/* The unroll shift beyond which the loop gets larger without getting
+ * faster. Some large functions even run slightly slower when unrolled
+ * (ginger Core2 6,15,6). */
+static int
+orc_x86_get_max_unroll_shift (OrcX86Target *t, OrcCompiler *c)
+{
+  int shift = ORC_X86_MAX_UNROLL_SHIFT;
+  int body, overhead;
+  int n_values, n_regs;
+
+  orc_x86_get_loop_size (c, &body, &overhead);
+  while (shift > 0 && (body << shift) > ORC_X86_UNROLL_MAX_INSNS)
+    shift--;
+  while (shift > 0 && (t->register_size << shift) > ORC_X86_UNROLL_MAX_BYTES)
+    shift--;
+
+  orc_x86_get_register_pressure (t, c, &n_values, &n_regs);
+  if (n_values > n_regs) {
+    /* Every copy of the body would load and store the spilled variables */
+    shift = 0;
+  } else if (4 * n_values > 3 * n_regs) {
+    /* The constants of the rules may still push it over */
+    shift = MIN (shift, 1);
+  }
+
+  return shift;
+}
+
+/* The log2 of the number of registers each accumulator is split into for
+ * 1 << @shift copies of the loop body: one per copy, as long as a quarter
+ * of the registers is left for the constants and the temporaries of the
+ * rules */
+static int
+orc_x86_get_partial_accs_shift (OrcX86Target *t, OrcCompiler *c, int shift)
+{
+  int n_values, n_regs;
+  int n_accs = 0;
+  int i;
+
+  for (i = ORC_VAR_A1; i < ORC_VAR_A1 + ORC_MAX_ACCUM_VARS; i++) {
+    if (c->program->vars[i].size > 0)
+      n_accs++;
+  }
+
+  orc_x86_get_register_pressure (t, c, &n_values, &n_regs);
+  while (shift > 0 &&
+      4 * (n_values + n_accs * ((1 << shift) - 1)) > 3 * n_regs)
+    shift--;
+
+  return shift;
+}
+
+/* Chooses how many copies of the loop body the region 2 loop runs per
+ * iteration, as a shift: enough to amortize the loop overhead, or to hide
+ * the latency of the accumulators, within the limits of
+ * orc_x86_get_max_unroll_shift(). A program can ask for a given unrolling
+ * with orc_program_set_unroll(). */
+static int
+orc_x86_compiler_get_unroll_shift (OrcX86Target *t, OrcCompiler *c)
+{
+  const OrcSchedModel *model = c->sched_model;
+  int max_shift, shift;
+  int body, overhead;
+  int latency = 0;
+  int i;
+
+  /* Don't enable unrolling with loop_shift == 0, this enables double
+   * reading in the hot loop. The short jumps may not reach over the
+   * copies either. */
+  if (c->loop_shift == 0 || !c->long_jumps)
+    return 0;
+
+  if (c->program->unroll > 0) {
+    for (shift = 0; shift < ORC_X86_MAX_UNROLL_SHIFT; shift++) {
+      if ((2 << shift) > c->program->unroll)
+        break;
+    }
+    return shift;
+  }
+
+  if (model == NULL)
+    model = &orc_x86_sse_sched_model;
+
+  /* The longest chain of additions to an accumulator */
+  for (i = 0; i < c->program->n_insns; i++) {
+    OrcInstruction *insn = c->program->insns + i;
+
+    if (c->program->vars[insn->dest_args[0]].vartype ==
+        ORC_VAR_TYPE_ACCUMULATOR)
+      latency = MAX (latency, orc_compiler_get_latency (model, insn));
+  }
+
+  max_shift = orc_x86_get_max_unroll_shift (t, c);
+  orc_x86_get_loop_size (c, &body, &overhead);
+  for (shift = 0; shift < max_shift; shift++) {
+    /* The copies sharing a partial accumulator wait for each other */
+    const int chain = latency <<
+        (shift - orc_x86_get_partial_accs_shift (t, c, shift));
+
+    if (chain * model->issue_width >= (body << shift) + overhead) {
+      /* Bound by the accumulators, one more copy only helps if it gets
+       * registers of its own */
+      if (orc_x86_get_partial_accs_shift (t, c, shift + 1) == shift + 1)
+        continue;
+      break;
+    }
+    if ((body << shift) >= ORC_X86_UNROLL_OVERHEAD_RATIO * overhead)
+      break;
+  }
+
+  return shift;
+}
+
 static void
 orc_x86_compiler_init (OrcCompiler *c)
 {
@@ -148,19 +348,20 @@ orc_x86_compiler_init (OrcCompiler *c)
 
   orc_x86_compiler_max_loop_shift (t, c);
 
-  /* This limit is arbitrary, but some large functions run slightly
-     slower when unrolled (ginger Core2 6,15,6), and only some small
-     functions run faster when unrolled.  Most are the same speed. */
-  /* Also don't enable unrolling with loop_shift == 0, this enables
-     double reading in the hot loop. */
-  if (c->n_insns <= 10 && c->loop_shift > 0) {
-    c->unroll_shift = 1;
-  }
-  if (!c->long_jumps) {
-    c->unroll_shift = 0;
-  }
   c->alloc_loop_counter = TRUE;
   c->allow_gp_on_stack = TRUE;
+  /* The VEX forms of AVX and the EVEX forms of AVX-512 have three
+   * operands */
+  c->two_operand = strncmp (t->name, "avx", 3) != 0;
+  c->hoist_invariants = TRUE;
+  if (strcmp (t->name, "sse") == 0) {
+    c->sched_model = &orc_x86_sse_sched_model;
+  } else if (strcmp (t->name, "avx") == 0) {
+    c->sched_model = &orc_x86_avx_sched_model;
+  }
+  c->unroll_shift = orc_x86_compiler_get_unroll_shift (t, c);
+  c->n_partial_accs =
+      1 << orc_x86_get_partial_accs_shift (t, c, c->unroll_shift);
 
   /* FIXME ldreslinb, ldreslinl, ldresnearb, ldresnearl
    * are special opcodes that require more initialization
@@ -187,7 +388,7 @@ orc_x86_save_accumulators (OrcX86Target *t, OrcCompiler *c)
 {
   int i;
 
-  for (i = 0; i < ORC_N_COMPILER_VARIABLES; i++) {
+  for (i = 0; i < c->n_vars; i++) {
     OrcVariable *var = c->vars + i;
 
     if (var->name == NULL)
@@ -203,10 +404,11 @@ orc_x86_save_accumulators (OrcX86Target *t, OrcCompiler *c)
 static void
 orc_x86_init_accumulators (OrcX86Target *t, OrcCompiler *c)
 {
-  int i;
+  int i, j;
 
-  for (i = 0; i < ORC_N_COMPILER_VARIABLES; i++) {
+  for (i = 0; i < c->n_vars; i++) {
     OrcVariable *var = c->vars + i;
+    orc_uint64 identity;
 
     if (var->name == NULL)
       continue;
@@ -214,7 +416,36 @@ orc_x86_init_accumulators (OrcX86Target *t, OrcCompiler *c)
     if (var->vartype != ORC_VAR_TYPE_ACCUMULATOR)
       continue;
 
-    t->init_accumulator (c, var);
+    /* Min, max and and do not start from 0 */
+    identity = orc_accumulator_get_identity (
+        orc_accumulator_get_type (c->insns, c->n_insns, i), var->size);
+    for (j = 0; j < c->n_partial_accs; j++) {
+      var->alloc = c->partial_accs[i - ORC_VAR_A1][j];
+      if (identity != 0) {
+        orc_compiler_load_constant_from_size_and_value (c, var->alloc,
+            var->size, identity);
+      } else {
+        t->init_accumulator (c, var);
+      }
+    }
+    var->alloc = c->partial_accs[i - ORC_VAR_A1][0];
+  }
+}
+
+/* Makes the accumulators of the copy @index of the loop body point to
+ * their partial registers */
+static void
+orc_x86_use_partial_accumulators (OrcCompiler *c, int index)
+{
+  int i;
+
+  for (i = ORC_VAR_A1; i < ORC_VAR_A1 + ORC_MAX_ACCUM_VARS; i++) {
+    OrcVariable *var = c->vars + i;
+
+    if (var->name == NULL || var->vartype != ORC_VAR_TYPE_ACCUMULATOR)
+      continue;
+
+    var->alloc = c->partial_accs[i - ORC_VAR_A1][index % c->n_partial_accs];
   }
 }
 
@@ -246,33 +477,48 @@ orc_x86_load_constants_outer (OrcX86Target *t, OrcCompiler *c)
   orc_x86_init_accumulators (t, c);
   orc_compiler_emit_invariants (c);
   orc_x86_init_constants (t, c);
+}
 
-  /* FIXME ldreslinb, ldreslinl, ldresnearb, ldresnearl
-   * are special opcodes that require more initialization
-   * but their flags are shared among more opcodes. These
-   * opcodes should have specific flags to proceed accordingly
-   */
+/* FIXME ldreslinb, ldreslinl, ldresnearb, ldresnearl
+ * are special opcodes that require more initialization
+ * but their flags are shared among more opcodes. These
+ * opcodes should have specific flags to proceed accordingly
+ */
+static void
+orc_x86_load_resample_offsets (OrcCompiler *c)
+{
+  int i;
 
-  {
-    for (int i = 0; i < c->n_insns; i++) {
-      OrcInstruction *insn = c->insns + i;
-      OrcStaticOpcode *opcode = insn->opcode;
+  for (i = 0; i < c->n_insns; i++) {
+    OrcInstruction *insn = c->insns + i;
+    OrcStaticOpcode *opcode = insn->opcode;
+    OrcVariable *src;
+    int shift;
 
-      if (strcmp (opcode->name, "ldreslinb") == 0
-          || strcmp (opcode->name, "ldreslinl") == 0
-          || strcmp (opcode->name, "ldresnearb") == 0
-          || strcmp (opcode->name, "ldresnearl") == 0) {
-        if (c->vars[insn->src_args[1]].vartype == ORC_VAR_TYPE_PARAM) {
-          orc_x86_emit_mov_memoffset_reg (c, 4,
-              (int)ORC_STRUCT_OFFSET (OrcExecutor, params[insn->src_args[1]]),
-              c->exec_reg, c->vars[insn->src_args[0]].ptr_offset);
-        } else {
-          orc_x86_emit_mov_imm_reg (c, 4,
-              c->vars[insn->src_args[1]].value.i,
-              c->vars[insn->src_args[0]].ptr_offset);
-        }
-      }
+    if (strcmp (opcode->name, "ldreslinb") != 0
+        && strcmp (opcode->name, "ldreslinl") != 0
+        && strcmp (opcode->name, "ldresnearb") != 0
+        && strcmp (opcode->name, "ldresnearl") != 0)
+      continue;
+
+    src = c->vars + insn->src_args[0];
+    if (c->vars[insn->src_args[1]].vartype == ORC_VAR_TYPE_PARAM) {
+      orc_x86_emit_mov_memoffset_reg (c, 4,
+          (int)ORC_STRUCT_OFFSET (OrcExecutor, params[insn->src_args[1]]),
+          c->exec_reg, src->ptr_offset);
+    } else {
+      orc_x86_emit_mov_imm_reg (c, 4,
+          c->vars[insn->src_args[1]].value.i, src->ptr_offset);
     }
+
+    /* The rules expect the integer part of the position in the pointer
+     * and only the fraction in the offset register */
+    orc_x86_emit_mov_reg_reg (c, 4, src->ptr_offset, c->gp_tmpreg);
+    orc_x86_emit_sar_imm_reg (c, 4, 16, c->gp_tmpreg);
+    orc_variable_get_shift (src, &shift);
+    orc_x86_emit_add_reg_reg_shift (c, c->is_64bit ? 8 : 4, c->gp_tmpreg,
+        src->ptr_register, shift);
+    orc_x86_emit_and_imm_reg (c, 4, 0xffff, src->ptr_offset);
   }
 }
 
@@ -281,7 +527,7 @@ orc_x86_load_constants_inner (OrcCompiler *c)
 {
   int i;
 
-  for (i = 0; i < ORC_N_COMPILER_VARIABLES; i++) {
+  for (i = 0; i < c->n_vars; i++) {
     if (c->vars[i].name == NULL)
       continue;
     switch (c->vars[i].vartype) {
@@ -303,6 +549,8 @@ orc_x86_load_constants_inner (OrcCompiler *c)
         break;
     }
   }
+
+  orc_x86_load_resample_offsets (c);
 }
 
 static void
@@ -310,7 +558,7 @@ orc_x86_add_strides (OrcCompiler *c)
 {
   int i;
 
-  for (i = 0; i < ORC_N_COMPILER_VARIABLES; i++) {
+  for (i = 0; i < c->n_vars; i++) {
     if (c->vars[i].name == NULL)
       continue;
     switch (c->vars[i].vartype) {
@@ -341,8 +589,8 @@ orc_x86_add_strides (OrcCompiler *c)
   }
 }
 
-static void
-orc_x86_save_registers (OrcX86Target *t, OrcCompiler *c)
+static int
+orc_x86_get_n_saved_registers (OrcX86Target *t, OrcCompiler *c)
 {
   int i;
   int saved = 0;
@@ -353,8 +601,39 @@ orc_x86_save_registers (OrcX86Target *t, OrcCompiler *c)
     }
   }
 
-  if (saved > 0) {
-    orc_x86_emit_mov_imm_reg (c, 4, t->register_size * saved, c->gp_tmpreg);
+  return saved;
+}
+
+/* The spill slots follow the saved registers on the stack */
+static void
+orc_x86_load_spill (OrcCompiler *c, int reg, int slot)
+{
+  OrcX86Target *t = c->target->target_data;
+  int offset = (orc_x86_get_n_saved_registers (t, c) + slot) * t->register_size;
+
+  t->move_memoffset_to_register (c, t->register_size, offset, X86_ESP, reg,
+      FALSE);
+}
+
+static void
+orc_x86_store_spill (OrcCompiler *c, int reg, int slot)
+{
+  OrcX86Target *t = c->target->target_data;
+  int offset = (orc_x86_get_n_saved_registers (t, c) + slot) * t->register_size;
+
+  t->move_register_to_memoffset (c, t->register_size, reg, offset, X86_ESP,
+      FALSE, FALSE);
+}
+
+static void
+orc_x86_save_registers (OrcX86Target *t, OrcCompiler *c)
+{
+  int i;
+  int saved = orc_x86_get_n_saved_registers (t, c);
+
+  if (saved + c->n_spill_slots > 0) {
+    orc_x86_emit_mov_imm_reg (c, 4,
+        t->register_size * (saved + c->n_spill_slots), c->gp_tmpreg);
     orc_x86_emit_sub_reg_reg (c, c->is_64bit ? 8 : 4,
         c->gp_tmpreg, X86_ESP);
     saved = 0;
@@ -381,8 +660,9 @@ orc_x86_restore_registers (OrcX86Target *t, OrcCompiler *c)
       ++saved;
     }
   }
-  if (saved > 0) {
-    orc_x86_emit_mov_imm_reg (c, 4, t->register_size * saved, c->gp_tmpreg);
+  if (saved + c->n_spill_slots > 0) {
+    orc_x86_emit_mov_imm_reg (c, 4,
+        t->register_size * (saved + c->n_spill_slots), c->gp_tmpreg);
     orc_x86_emit_add_reg_reg (c, c->is_64bit ? 8 : 4,
         c->gp_tmpreg, X86_ESP);
   }
@@ -509,6 +789,20 @@ orc_x86_emit_split_2_regions (OrcX86Target *t, OrcCompiler *compiler)
   orc_variable_get_shift (&compiler->vars[align_var], &var_size_shift);
   align_shift = var_size_shift + compiler->loop_shift;
 
+  if (compiler->program->constant_n > 0) {
+    int n = compiler->program->constant_n;
+    int shift = compiler->loop_shift + compiler->unroll_shift;
+
+    orc_x86_emit_mov_imm_reg (compiler, 4, n >> shift, compiler->gp_tmpreg);
+    orc_x86_emit_mov_reg_memoffset (compiler, 4, compiler->gp_tmpreg,
+        (int)ORC_STRUCT_OFFSET (OrcExecutor, counter2), compiler->exec_reg);
+    orc_x86_emit_mov_imm_reg (compiler, 4, n & ((1 << shift) - 1),
+        compiler->gp_tmpreg);
+    orc_x86_emit_mov_reg_memoffset (compiler, 4, compiler->gp_tmpreg,
+        (int)ORC_STRUCT_OFFSET (OrcExecutor, counter3), compiler->exec_reg);
+    return;
+  }
+
   /* Calculate n2 */
   orc_x86_emit_mov_memoffset_reg (compiler, 4,
       (int)ORC_STRUCT_OFFSET (OrcExecutor, n), compiler->exec_reg,
@@ -526,151 +820,6 @@ orc_x86_emit_split_2_regions (OrcX86Target *t, OrcCompiler *compiler)
       (int)ORC_STRUCT_OFFSET (OrcExecutor, counter3), compiler->exec_reg);
 }
 
-/*
- * The following code was ported from the MIPS backend,
- * and extended to allow for store reordering and the
- * multi-operand VEX syntax.
- */
-static int
-uses_in_destination_register (const OrcCompiler *const compiler,
-               const OrcInstruction *const insn,
-               int reg)
-{
-  for (int i=0; i<ORC_STATIC_OPCODE_N_DEST; i++) {
-    const OrcVariable *const var = compiler->vars + insn->dest_args[i];
-    if (var->alloc == reg || var->ptr_register == reg)
-      return TRUE;
-  }
-
-  return FALSE;
-}
-
-static int uses_in_source_register(const OrcCompiler *const compiler,
-               const OrcInstruction *const insn,
-               int reg) {
-  for (int i=0; i<ORC_STATIC_OPCODE_N_SRC; i++) {
-    const OrcVariable *const var = compiler->vars + insn->src_args[i];
-    if (var->alloc == reg || var->ptr_register == reg)
-      return TRUE;
-  }
-
-  return FALSE;
-}
-
-static void
-do_swap (int *tab, int i, int j)
-{
-  int tmp = tab[i];
-  tab[i] = tab[j];
-  tab[j] = tmp;
-}
-
-/* Assumes that the instruction at indexes[i] is a load instruction */
-static int
-can_raise (const OrcCompiler *const compiler, const int *const indexes, int i)
-{
-  if (i==0)
-    return FALSE;
-
-  const OrcInstruction *const insn = compiler->insns + indexes[i];
-  const OrcInstruction *const previous_insn = compiler->insns + indexes[i-1];
-
-  /* Register where the load operation will put the data */
-  const int reg = compiler->vars[insn->dest_args[0]].alloc;
-  if (uses_in_source_register(compiler, previous_insn, reg) || uses_in_destination_register(compiler, previous_insn, reg)) {
-    return FALSE;
-  }
-
-  for (int j = 0; j < ORC_STATIC_OPCODE_N_SRC; j++) {
-    const OrcVariable *const var = compiler->vars + insn->src_args[j];
-    // If the previous instruction touches anything RIP
-    if (uses_in_destination_register(compiler, previous_insn, var->alloc) || uses_in_destination_register(compiler, previous_insn, var->ptr_register))
-      return FALSE;
-  }
-
-  return TRUE;
-}
-
-/* Recursive. */
-static void
-try_raise (OrcCompiler *compiler, int *indexes, int i)
-{
-  if (can_raise (compiler, indexes, i)) {
-    do_swap (indexes, i-1, i);
-    try_raise (compiler, indexes, i-1);
-  }
-}
-
-
-/* Assumes that the instruction at indexes[i] is a load instruction */
-static int
-can_lower (const OrcCompiler *const compiler, const int *const indexes, int i)
-{
-  if (i >= compiler->n_insns - 1)
-    return FALSE;
-
-  const OrcInstruction *const insn = compiler->insns + indexes[i];
-  const OrcInstruction *const next_insn = compiler->insns + indexes[i+1];
-
-  /* Register where the store operation will put the data */
-  const int reg = compiler->vars[insn->dest_args[0]].ptr_register;
-  if (uses_in_source_register(compiler, next_insn, reg)) {
-    return FALSE;
-  }
-
-  for (int j = 0; j < ORC_STATIC_OPCODE_N_SRC; j++) {
-    const OrcVariable *const var = compiler->vars + insn->src_args[j];
-    // If the next instruction touches anything RIP
-    if (uses_in_destination_register(compiler, next_insn, var->alloc) || uses_in_destination_register(compiler, next_insn, var->ptr_register))
-      return FALSE;
-  }
-
-  return TRUE;
-}
-
-static void
-try_lower (OrcCompiler *compiler, int *indexes, int i)
-{
-  if (can_lower (compiler, indexes, i)) {
-    do_swap (indexes, i-1, i);
-    try_lower (compiler, indexes, i+1);
-  }
-}
-
-/*
- * Do a kind of bubble sort, though it might not exactly be a sort. It only
- * moves load instructions up until they reach an operation above which they
- * cannot go.
- */
-static void
-optimise_order (OrcCompiler *compiler, int *const indexes)
-{
-  for (int i=0; i<compiler->n_insns; i++) {
-    const OrcInstruction *const insn = compiler->insns + indexes[i];
-    if (insn->opcode->flags & ORC_STATIC_OPCODE_LOAD) {
-      try_raise(compiler, indexes, i);
-    }
-    else if (insn->opcode->flags & ORC_STATIC_OPCODE_STORE) {
-      try_lower(compiler, indexes, i);
-    }
-  }
-}
-
-static int *
-get_optimised_instruction_order (OrcCompiler *compiler)
-{
-  if (compiler->n_insns == 0)
-    return NULL;
-
-  int *const instruction_idx = orc_malloc (compiler->n_insns * sizeof(int));
-  for (int i=0; i<compiler->n_insns; i++)
-    instruction_idx[i] = i;
-
-  optimise_order (compiler, instruction_idx);
-
-  return instruction_idx;
-}
-
 static void
 orc_x86_emit_loop (OrcX86Target *t, OrcCompiler *compiler, int update)
 {
@@ -679,14 +828,17 @@ orc_x86_emit_loop (OrcX86Target *t, OrcCompiler *compiler, int update)
   OrcRule *rule;
   int j;
   int k;
-  int *const insn_idx = get_optimised_instruction_order (compiler);
 
   for (j = 0; j < compiler->n_insns; j++) {
-    insn = compiler->insns + insn_idx[j];
+    insn = compiler->insns + j;
     opcode = insn->opcode;
 
     compiler->insn_index = j;
 
+    /* Nothing valid can be emitted after an error */
+    if (compiler->error)
+      break;
+
     if (insn->flags & ORC_INSN_FLAG_INVARIANT)
       continue;
 
@@ -703,7 +855,9 @@ orc_x86_emit_loop (OrcX86Target *t, OrcCompiler *compiler, int update)
 
     rule = insn->rule;
     if (rule && rule->emit) {
+      orc_compiler_load_spills (compiler, insn);
       rule->emit (compiler, rule->emit_user, insn);
+      orc_compiler_store_spills (compiler, insn);
     } else {
       ORC_COMPILER_ERROR (compiler, "no code generation rule for %s",
           opcode->name);
@@ -711,7 +865,7 @@ orc_x86_emit_loop (OrcX86Target *t, OrcCompiler *compiler, int update)
   }
 
   if (update) {
-    for (k = 0; k < ORC_N_COMPILER_VARIABLES; k++) {
+    for (k = 0; k < compiler->n_vars; k++) {
       OrcVariable *var = compiler->vars + k;
 
       if (var->name == NULL)
@@ -741,8 +895,78 @@ orc_x86_emit_loop (OrcX86Target *t, OrcCompiler *compiler, int update)
       }
     }
   }
+}
+
+/* The elements that do not fill a vector, before and after region 2, can
+ * be run in a single iteration with masked loads and stores when the
+ * target supports them. The arrays must only be accessed element by
+ * element, and no accumulator must see the masked out elements. */
+static orc_bool
+orc_x86_can_mask_loop (OrcX86Target *t, OrcCompiler *compiler)
+{
+  int i;
+
+  if (t->load_loop_mask == NULL || !compiler->is_64bit)
+    return FALSE;
+
+  for (i = 0; i < compiler->n_insns; i++) {
+    OrcStaticOpcode *opcode = compiler->insns[i].opcode;
+
+    if (opcode->flags & ORC_STATIC_OPCODE_ACCUMULATOR)
+      return FALSE;
+    if ((opcode->flags & ORC_STATIC_OPCODE_LOAD) &&
+        !(opcode->flags & ORC_STATIC_OPCODE_INVARIANT) &&
+        (opcode->flags & (ORC_STATIC_OPCODE_SCALAR |
+            ORC_STATIC_OPCODE_ITERATOR)))
+      return FALSE;
+  }
+
+  for (i = 0; i < compiler->n_vars; i++) {
+    OrcVariable *var = compiler->vars + i;
+
+    if (var->name == NULL)
+      continue;
+    if ((var->vartype == ORC_VAR_TYPE_SRC ||
+        var->vartype == ORC_VAR_TYPE_DEST) && !var->ptr_register)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Emits one iteration of the loop for the number of elements in the
+ * register @count, below 1 << loop_shift. With @update the pointers are
+ * moved past these elements. */
+static void
+orc_x86_emit_masked_loop (OrcX86Target *t, OrcCompiler *compiler, int count,
+    int update)
+{
+  int k;
+
+  orc_x86_emit_cpuinsn_comment (compiler, "# MASKED LOOP SHIFT %d",
+      compiler->loop_shift);
+  t->load_loop_mask (compiler, count, compiler->gp_tmpreg);
+  orc_x86_emit_loop (t, compiler, 0);
+  compiler->loop_mask = ORC_REG_INVALID;
+
+  if (!update)
+    return;
 
-  free (insn_idx);
+  for (k = 0; k < compiler->n_vars; k++) {
+    OrcVariable *var = compiler->vars + k;
+    int shift;
+
+    if (var->name == NULL)
+      continue;
+    if (var->vartype != ORC_VAR_TYPE_SRC && var->vartype != ORC_VAR_TYPE_DEST)
+      continue;
+    if (var->update_type == 0)
+      continue;
+
+    orc_variable_get_shift (var, &shift);
+    orc_x86_emit_add_reg_reg_shift (compiler, 8, count, var->ptr_register,
+        shift);
+  }
 }
 
 static void
@@ -881,6 +1105,11 @@ orc_x86_do_fixups (OrcCompiler *compiler)
 {
   int i;
   for(i=0;i<compiler->n_fixups;i++){
+    if (compiler->labels[compiler->fixups[i].label] == NULL) {
+      ORC_COMPILER_ERROR (compiler, "jump to label %d that was not emitted",
+          compiler->fixups[i].label);
+      continue;
+    }
     if (compiler->fixups[i].type == 0) {
       unsigned char *label = compiler->labels[compiler->fixups[i].label];
       unsigned char *ptr = compiler->fixups[i].ptr;
@@ -953,6 +1182,401 @@ orc_x86_assemble_copy (OrcCompiler *compiler)
   orc_x86_do_fixups (compiler);
 }
 
+/* Returns the number of bytes accessed in the arrays first..last per
+ * iteration of the region 2 loop */
+static int
+orc_x86_get_bytes_per_iteration (OrcCompiler *compiler, int first, int last)
+{
+  int bytes = 0;
+  int i;
+
+  for (i = first; i <= last; i++) {
+    if (compiler->vars[i].size == 0)
+      continue;
+    bytes += compiler->vars[i].size <<
+        (compiler->loop_shift + compiler->unroll_shift);
+  }
+
+  return bytes;
+}
+
+/* Returns the number of region 2 iterations, for the whole call, after
+ * which @bytes_per_iteration bytes per iteration no longer fit in a
+ * cache of @cache_size bytes */
+static int
+orc_x86_get_cache_threshold (OrcCompiler *compiler, int bytes_per_iteration,
+    int cache_size)
+{
+  int threshold;
+
+  if (bytes_per_iteration == 0 || cache_size <= 0)
+    return 0;
+
+  threshold = cache_size / bytes_per_iteration;
+  if (compiler->program->is_2d && compiler->program->constant_m > 1)
+    threshold /= compiler->program->constant_m;
+
+  return MAX (threshold, 1);
+}
+
+static orc_bool
+orc_x86_use_region2_variants (OrcX86Target *t, OrcCompiler *compiler)
+{
+  /* MMX has no use for this, the aligned stores are never that large */
+  if (t->register_size < 16 || compiler->loop_shift == 0)
+    return FALSE;
+
+  /* The variants easily push the jumps over the short jump range */
+  if (!compiler->long_jumps)
+    return FALSE;
+
+  return TRUE;
+}
+
+/* Returns the number of region 2 iterations above which the destinations
+ * are written with non-temporal stores, or 0 if the uncached loop should
+ * not be emitted at all. The destination is considered too large to be
+ * worth caching once it exceeds half of the last level cache. */
+static int
+orc_x86_get_uncached_threshold (OrcX86Target *t, OrcCompiler *compiler)
+{
+  int l1, l2, l3;
+
+  if (!orc_x86_use_region2_variants (t, compiler))
+    return 0;
+
+  orc_get_data_cache_sizes (&l1, &l2, &l3);
+
+  return orc_x86_get_cache_threshold (compiler,
+      orc_x86_get_bytes_per_iteration (compiler, ORC_VAR_D1, ORC_VAR_D4),
+      l3 > 0 ? l3 / 2 : l2);
+}
+
+static void
+orc_x86_set_dest_uncached (OrcCompiler *compiler, int uncached)
+{
+  int i;
+
+  for (i = ORC_VAR_D1; i <= ORC_VAR_D4; i++) {
+    if (compiler->vars[i].size == 0)
+      continue;
+    compiler->vars[i].is_uncached = uncached;
+  }
+}
+
+static void
+orc_x86_emit_prefetch_lines (OrcCompiler *compiler, const OrcPrefetch *prefetch,
+    int offset, int bytes, int ptr_reg)
+{
+  int i;
+
+  for (i = 0; i < bytes; i += ORC_CACHE_LINE_SIZE) {
+    if (prefetch->hint == ORC_PREFETCH_STREAM) {
+      orc_x86_emit_prefetchnta_memoffset (compiler, offset + i, ptr_reg);
+    } else {
+      orc_x86_emit_prefetcht0_memoffset (compiler, offset + i, ptr_reg);
+    }
+  }
+}
+
+/* Returns the register holding the pointer of array @var, loading it in
+ * gp_tmpreg if it lives in the executor */
+static int
+orc_x86_get_ptr_reg (OrcCompiler *compiler, int var)
+{
+  if (compiler->vars[var].ptr_register)
+    return compiler->vars[var].ptr_register;
+
+  orc_x86_emit_mov_memoffset_reg (compiler, compiler->is_64bit ? 8 : 4,
+      (int)ORC_STRUCT_OFFSET (OrcExecutor, arrays[var]),
+      compiler->exec_reg, compiler->gp_tmpreg);
+  return compiler->gp_tmpreg;
+}
+
+/* Issues the software prefetches of the source arrays for one iteration
+ * of a region 2 loop, one per cache line consumed by the iteration. There
+ * is no prefetch for writing in the x86 baseline, the destinations are
+ * left to the non-temporal loop. */
+static void
+orc_x86_emit_prefetch (OrcCompiler *compiler, int size_region,
+    int unroll_shift)
+{
+  OrcPrefetch prefetch;
+  int i;
+
+  for (i = ORC_VAR_S1; i <= ORC_VAR_S8; i++) {
+    OrcVariable *var = compiler->vars + i;
+
+    if (var->size == 0 || var->update_type == 0)
+      continue;
+    if (!orc_compiler_get_prefetch (compiler, i, size_region, unroll_shift,
+            &prefetch))
+      continue;
+
+    orc_x86_emit_prefetch_lines (compiler, &prefetch, prefetch.distance,
+        var->size << (compiler->loop_shift + unroll_shift),
+        orc_x86_get_ptr_reg (compiler, i));
+  }
+}
+
+/* For 2D programs, prefetch the beginning of the next row of every source
+ * while the current one is processed. The prefetches issued inside the
+ * row run past its end into the padding, so they never cover it. */
+static void
+orc_x86_emit_prefetch_next_row (OrcX86Target *t, OrcCompiler *compiler)
+{
+  OrcPrefetch prefetch;
+  int i;
+
+  if (!compiler->program->is_2d || compiler->program->constant_m == 1)
+    return;
+  if (!orc_x86_use_region2_variants (t, compiler))
+    return;
+
+  for (i = ORC_VAR_S1; i <= ORC_VAR_S8; i++) {
+    if (compiler->vars[i].size == 0)
+      continue;
+    if (!orc_compiler_get_prefetch (compiler, i, 3, compiler->unroll_shift,
+            &prefetch))
+      continue;
+
+    orc_x86_emit_cpuinsn_comment (compiler, "# PREFETCH NEXT ROW %s",
+        compiler->vars[i].name);
+    orc_x86_emit_mov_memoffset_reg (compiler, 4,
+        (int)ORC_STRUCT_OFFSET (OrcExecutor, params[i]), compiler->exec_reg,
+        compiler->gp_tmpreg);
+    if (compiler->vars[i].ptr_register) {
+      orc_x86_emit_add_reg_reg (compiler, compiler->is_64bit ? 8 : 4,
+          compiler->vars[i].ptr_register, compiler->gp_tmpreg);
+    } else {
+      orc_x86_emit_add_memoffset_reg (compiler, compiler->is_64bit ? 8 : 4,
+          (int)ORC_STRUCT_OFFSET (OrcExecutor, arrays[i]),
+          compiler->exec_reg, compiler->gp_tmpreg);
+    }
+    /* The next row is needed soon, keep it whatever the row size */
+    prefetch.hint = ORC_PREFETCH_KEEP;
+    orc_x86_emit_prefetch_lines (compiler, &prefetch, 0,
+        MIN (prefetch.distance, ORC_X86_MAX_NEXT_ROW_PREFETCH),
+        compiler->gp_tmpreg);
+  }
+}
+
+static void
+orc_x86_emit_loop_counter_add (OrcCompiler *compiler, int value)
+{
+  if (compiler->loop_counter != ORC_REG_INVALID) {
+    orc_x86_emit_add_imm_reg (compiler, 4, value, compiler->loop_counter,
+        TRUE);
+  } else if (value == -1) {
+    orc_x86_emit_dec_memoffset (compiler, 4,
+        (int)ORC_STRUCT_OFFSET (OrcExecutor, counter2), compiler->exec_reg);
+  } else {
+    orc_x86_emit_add_imm_memoffset (compiler, 4, value,
+        (int)ORC_STRUCT_OFFSET (OrcExecutor, counter2), compiler->exec_reg);
+  }
+}
+
+static void
+orc_x86_emit_loop_counter_cmp (OrcCompiler *compiler, int value)
+{
+  if (compiler->loop_counter != ORC_REG_INVALID) {
+    orc_x86_emit_cmp_imm_reg (compiler, 4, value, compiler->loop_counter);
+  } else {
+    orc_x86_emit_cmp_imm_memoffset (compiler, 4, value,
+        (int)ORC_STRUCT_OFFSET (OrcExecutor, counter2), compiler->exec_reg);
+  }
+}
+
+/* Emits a region 2 loop starting at @label. The loop counter counts
+ * blocks of 1 << (loop_shift + unroll_shift) elements; with an
+ * @extra_unroll_shift the body handles 1 << extra_unroll_shift of those
+ * blocks per iteration and the leftover blocks are handed over to the
+ * regular loop at LABEL_INNER_LOOP_START, through @tail_label. The
+ * sources are prefetched according to @size_region. */
+static void
+orc_x86_emit_inner_loop (OrcX86Target *t, OrcCompiler *compiler, int label,
+    int extra_unroll_shift, int size_region, int tail_label)
+{
+  const int unroll_shift = compiler->unroll_shift + extra_unroll_shift;
+  const int blocks = 1 << extra_unroll_shift;
+  int ui, ui_max;
+
+  if (extra_unroll_shift > 0) {
+    orc_x86_emit_loop_counter_cmp (compiler, blocks - 1);
+    orc_x86_emit_jle (compiler, tail_label);
+  }
+
+  orc_x86_emit_cpuinsn_comment (compiler, "# LOOP SHIFT %d", compiler->loop_shift);
+  // Instruction fetch windows are 16-byte aligned
+  // https://easyperf.net/blog/2018/01/18/Code_alignment_issues
+  orc_x86_emit_align (compiler, 4);
+  orc_x86_emit_label (compiler, label);
+  orc_x86_emit_prefetch (compiler, size_region, unroll_shift);
+  ui_max = 1 << unroll_shift;
+  for (ui = 0; ui < ui_max; ui++) {
+    compiler->offset = ui << compiler->loop_shift;
+    orc_x86_use_partial_accumulators (compiler, ui);
+    orc_x86_emit_loop (t, compiler,
+        (ui == ui_max - 1)
+            << (compiler->loop_shift + unroll_shift));
+  }
+  compiler->offset = 0;
+  orc_x86_use_partial_accumulators (compiler, 0);
+  orc_x86_emit_loop_counter_add (compiler, -blocks);
+
+  if (extra_unroll_shift > 0) {
+    orc_x86_emit_loop_counter_cmp (compiler, blocks - 1);
+    orc_x86_emit_jg (compiler, label);
+
+    orc_x86_emit_label (compiler, tail_label);
+    orc_x86_emit_loop_counter_cmp (compiler, 0);
+    orc_x86_emit_jne (compiler, LABEL_INNER_LOOP_START);
+  } else {
+    orc_x86_emit_jne (compiler, label);
+  }
+}
+
+/* Per tier settings of the region 2 loop. The unroll shift is added to
+ * the one chosen in compiler_init(), the size region drives the
+ * prefetches, see orc_compiler_get_prefetch() */
+static const struct {
+  int extra_unroll_shift;
+  int size_region;
+} orc_x86_region2_tiers[] = {
+  /* Working set fits in L1: the regular loop */
+  { 0, 1 },
+  /* Fits in L2 */
+  { 1, 2 },
+  /* Larger than L2, bound by memory latency */
+  { 1, 3 },
+};
+
+static void
+orc_x86_emit_region2_tier (OrcX86Target *t, OrcCompiler *compiler, int tier,
+    int label, int tail_label)
+{
+  int extra_unroll_shift = orc_x86_region2_tiers[tier].extra_unroll_shift;
+
+  /* Same limits as the regular unrolling in compiler_init(), a program
+   * asking for a given unrolling gets just that */
+  if (compiler->program->unroll > 0) {
+    extra_unroll_shift = 0;
+  }
+  extra_unroll_shift = MIN (extra_unroll_shift,
+      orc_x86_get_max_unroll_shift (t, compiler) - compiler->unroll_shift);
+  extra_unroll_shift = MAX (extra_unroll_shift, 0);
+
+  orc_x86_emit_cpuinsn_comment (compiler, "# REGION 2 TIER %d", tier);
+  orc_x86_emit_inner_loop (t, compiler, label, extra_unroll_shift,
+      orc_x86_region2_tiers[tier].size_region, tail_label);
+  orc_x86_emit_jmp (compiler, LABEL_REGION2_SKIP);
+}
+
+static void
+orc_x86_emit_region2_uncached (OrcX86Target *t, OrcCompiler *compiler)
+{
+  orc_x86_set_dest_uncached (compiler, TRUE);
+  orc_x86_emit_inner_loop (t, compiler, LABEL_INNER_LOOP_START_UNCACHED,
+      0, 3, 0);
+  orc_x86_set_dest_uncached (compiler, FALSE);
+  /* Non-temporal stores are weakly ordered */
+  orc_x86_emit_sfence (compiler);
+  orc_x86_emit_jmp (compiler, LABEL_REGION2_SKIP);
+}
+
+/* Like orc_neon64_loop_caches(), choose at runtime between several
+ * versions of the region 2 loop depending on how much data the call
+ * processes compared to the data cache sizes: the regular loop when it
+ * fits in L1, more unrolled and prefetching loops when it fits in L2 or
+ * goes beyond, and a loop that writes the destinations with non-temporal
+ * stores once they would not fit in the last level cache anyway, so that
+ * converting very large images does not evict the working set of
+ * whatever runs next. When @n_iterations, the count of region 2, is
+ * known at compile time, only the version it picks is emitted. */
+static void
+orc_x86_emit_region2 (OrcX86Target *t, OrcCompiler *compiler,
+    int n_iterations)
+{
+  int uncached_threshold;
+  int l1_threshold = 0;
+  int l2_threshold = 0;
+
+  uncached_threshold = orc_x86_get_uncached_threshold (t, compiler);
+  if (orc_x86_use_region2_variants (t, compiler)) {
+    int bytes_per_iteration;
+    int l1, l2, l3;
+
+    orc_get_data_cache_sizes (&l1, &l2, &l3);
+    bytes_per_iteration = orc_x86_get_bytes_per_iteration (compiler,
+        ORC_VAR_D1, ORC_VAR_S8);
+    l1_threshold = orc_x86_get_cache_threshold (compiler,
+        bytes_per_iteration, l1);
+    l2_threshold = orc_x86_get_cache_threshold (compiler,
+        bytes_per_iteration, l2);
+    if (l2_threshold <= l1_threshold) {
+      l1_threshold = 0;
+      l2_threshold = 0;
+    }
+  }
+
+  if (n_iterations >= 0) {
+    if (uncached_threshold > 0 && n_iterations > uncached_threshold) {
+      orc_x86_emit_region2_uncached (t, compiler);
+      return;
+    }
+    /* The tiers hand the blocks left by their unrolling over to the
+     * regular loop, which follows them */
+    if (l1_threshold > 0 && n_iterations > l2_threshold) {
+      orc_x86_emit_region2_tier (t, compiler, ORC_X86_REGION2_LARGE,
+          LABEL_INNER_LOOP_START_LARGE, LABEL_REGION2_TAIL_LARGE);
+    } else if (l1_threshold > 0 && n_iterations > l1_threshold) {
+      orc_x86_emit_region2_tier (t, compiler, ORC_X86_REGION2_MEDIUM,
+          LABEL_INNER_LOOP_START_MEDIUM, LABEL_REGION2_TAIL_MEDIUM);
+    }
+    orc_x86_emit_inner_loop (t, compiler, LABEL_INNER_LOOP_START, 0, 1, 0);
+    return;
+  }
+
+  if (uncached_threshold > 0 || l1_threshold > 0) {
+    orc_x86_emit_mov_memoffset_reg (compiler, 4,
+        (int)ORC_STRUCT_OFFSET (OrcExecutor, counter2), compiler->exec_reg,
+        compiler->gp_tmpreg);
+    if (compiler->program->is_2d && compiler->program->constant_m == 0) {
+      orc_x86_emit_imul_memoffset_reg (compiler, 4,
+          (int)ORC_STRUCT_OFFSET (OrcExecutor, params[ORC_VAR_A1]),
+          compiler->exec_reg, compiler->gp_tmpreg);
+    }
+  }
+
+  if (uncached_threshold > 0) {
+    orc_x86_emit_cmp_imm_reg (compiler, 4, uncached_threshold,
+        compiler->gp_tmpreg);
+    orc_x86_emit_jle (compiler, LABEL_REGION2_CACHED);
+
+    orc_x86_emit_region2_uncached (t, compiler);
+
+    orc_x86_emit_label (compiler, LABEL_REGION2_CACHED);
+  }
+
+  if (l1_threshold > 0) {
+    orc_x86_emit_cmp_imm_reg (compiler, 4, l1_threshold, compiler->gp_tmpreg);
+    orc_x86_emit_jle (compiler, LABEL_REGION2_SMALL);
+    orc_x86_emit_cmp_imm_reg (compiler, 4, l2_threshold, compiler->gp_tmpreg);
+    orc_x86_emit_jle (compiler, LABEL_REGION2_MEDIUM);
+
+    orc_x86_emit_region2_tier (t, compiler, ORC_X86_REGION2_LARGE,
+        LABEL_INNER_LOOP_START_LARGE, LABEL_REGION2_TAIL_LARGE);
+
+    orc_x86_emit_label (compiler, LABEL_REGION2_MEDIUM);
+    orc_x86_emit_region2_tier (t, compiler, ORC_X86_REGION2_MEDIUM,
+        LABEL_INNER_LOOP_START_MEDIUM, LABEL_REGION2_TAIL_MEDIUM);
+
+    orc_x86_emit_label (compiler, LABEL_REGION2_SMALL);
+  }
+
+  orc_x86_emit_inner_loop (t, compiler, LABEL_INNER_LOOP_START, 0, 1, 0);
+}
+
 static void
 orc_x86_compile (OrcCompiler *compiler)
 {
@@ -960,6 +1584,8 @@ orc_x86_compile (OrcCompiler *compiler)
   int set_mxcsr = FALSE;
   int align_var;
   int is_aligned;
+  /* Holds the count of the masked iterations, when the target has them */
+  int mask_count = ORC_REG_INVALID;
 
   t = compiler->target->target_data;
   align_var = orc_x86_get_max_alignment_var (t, compiler);
@@ -972,6 +1598,12 @@ orc_x86_compile (OrcCompiler *compiler)
   orc_x86_adjust_alignment (t, compiler);
 
   is_aligned = compiler->vars[align_var].is_aligned;
+
+  /* Before the rules run, they reset the allocation of the registers */
+  if (compiler->loop_shift > 0 && orc_x86_can_mask_loop (t, compiler)) {
+    mask_count = orc_compiler_allocate_register (compiler, FALSE);
+  }
+
   {
     orc_x86_emit_loop (t, compiler, 0);
 
@@ -979,6 +1611,7 @@ orc_x86_compile (OrcCompiler *compiler)
     free (compiler->asm_code);
     compiler->asm_code = NULL;
     compiler->asm_code_len = 0;
+    compiler->asm_code_alloc = 0;
     memset (compiler->labels, 0, sizeof (compiler->labels));
     memset (compiler->labels_int, 0, sizeof (compiler->labels_int));
     compiler->n_fixups = 0;
@@ -1032,9 +1665,14 @@ orc_x86_compile (OrcCompiler *compiler)
     }
   } else {
     /* loop shift is 0, no need to split */
-    orc_x86_emit_mov_memoffset_reg (compiler, 4,
-        (int)ORC_STRUCT_OFFSET (OrcExecutor, n), compiler->exec_reg,
-        compiler->gp_tmpreg);
+    if (compiler->program->constant_n > 0) {
+      orc_x86_emit_mov_imm_reg (compiler, 4, compiler->program->constant_n,
+          compiler->gp_tmpreg);
+    } else {
+      orc_x86_emit_mov_memoffset_reg (compiler, 4,
+          (int)ORC_STRUCT_OFFSET (OrcExecutor, n), compiler->exec_reg,
+          compiler->gp_tmpreg);
+    }
     orc_x86_emit_mov_reg_memoffset (compiler, 4, compiler->gp_tmpreg,
         (int)ORC_STRUCT_OFFSET (OrcExecutor, counter2), compiler->exec_reg);
   }
@@ -1057,6 +1695,11 @@ orc_x86_compile (OrcCompiler *compiler)
       n_left -= 1 << compiler->loop_shift;
       compiler->offset += 1 << compiler->loop_shift;
     }
+    if (mask_count && n_left > 0) {
+      orc_x86_emit_mov_imm_reg (compiler, 4, n_left, mask_count);
+      orc_x86_emit_masked_loop (t, compiler, mask_count, FALSE);
+      n_left = 0;
+    }
     for (loop_shift = compiler->loop_shift - 1; loop_shift >= 0; loop_shift--) {
       if (n_left >= (1 << loop_shift)) {
         compiler->loop_shift = loop_shift;
@@ -1069,9 +1712,10 @@ orc_x86_compile (OrcCompiler *compiler)
     compiler->loop_shift = save_loop_shift;
 
   } else {
-    int ui, ui_max;
     int emit_region1 = TRUE;
     int emit_region3 = TRUE;
+    /* The count of region 2, when known at compile time */
+    int n_iterations = -1;
 
     if (compiler->has_iterator_opcode || is_aligned) {
       emit_region1 = FALSE;
@@ -1080,6 +1724,26 @@ orc_x86_compile (OrcCompiler *compiler)
       emit_region1 = FALSE;
       emit_region3 = FALSE;
     }
+    /* Without region 1, a constant n tells how many elements go to
+     * region 2 and region 3 */
+    if (!emit_region1 && compiler->program->constant_n > 0) {
+      int n = compiler->program->constant_n;
+      int shift = compiler->loop_shift + compiler->unroll_shift;
+
+      if (compiler->loop_shift == 0) {
+        n_iterations = n;
+      } else {
+        n_iterations = n >> shift;
+        if ((n & ((1 << shift) - 1)) == 0)
+          emit_region3 = FALSE;
+      }
+      /* The thresholds of region 2 are compared with the count of all
+       * the rows */
+      if (compiler->program->is_2d && compiler->program->constant_m == 0)
+        n_iterations = -1;
+    }
+
+    orc_x86_emit_prefetch_next_row (t, compiler);
 
     if (emit_region1) {
       int save_loop_shift;
@@ -1088,15 +1752,26 @@ orc_x86_compile (OrcCompiler *compiler)
       save_loop_shift = compiler->loop_shift;
       compiler->vars[align_var].is_aligned = FALSE;
 
-      for (l = 0; l < save_loop_shift; l++) {
-        compiler->loop_shift = l;
-        orc_x86_emit_cpuinsn_comment (compiler, "# LOOP SHIFT %d", compiler->loop_shift);
-
-        orc_x86_emit_test_imm_memoffset (compiler, 4, 1 << compiler->loop_shift,
-            (int)ORC_STRUCT_OFFSET (OrcExecutor, counter1), compiler->exec_reg);
-        orc_x86_emit_je (compiler, LABEL_STEP_UP (compiler->loop_shift));
-        orc_x86_emit_loop (t, compiler, 1 << compiler->loop_shift);
-        orc_x86_emit_label (compiler, LABEL_STEP_UP (compiler->loop_shift));
+      if (mask_count) {
+        /* counter1 is below 1 << loop_shift */
+        orc_x86_emit_mov_memoffset_reg (compiler, 4,
+            (int)ORC_STRUCT_OFFSET (OrcExecutor, counter1), compiler->exec_reg,
+            mask_count);
+        orc_x86_emit_test_reg_reg (compiler, 4, mask_count, mask_count);
+        orc_x86_emit_je (compiler, LABEL_STEP_UP (0));
+        orc_x86_emit_masked_loop (t, compiler, mask_count, TRUE);
+        orc_x86_emit_label (compiler, LABEL_STEP_UP (0));
+      } else {
+        for (l = 0; l < save_loop_shift; l++) {
+          compiler->loop_shift = l;
+          orc_x86_emit_cpuinsn_comment (compiler, "# LOOP SHIFT %d", compiler->loop_shift);
+
+          orc_x86_emit_test_imm_memoffset (compiler, 4, 1 << compiler->loop_shift,
+              (int)ORC_STRUCT_OFFSET (OrcExecutor, counter1), compiler->exec_reg);
+          orc_x86_emit_je (compiler, LABEL_STEP_UP (compiler->loop_shift));
+          orc_x86_emit_loop (t, compiler, 1 << compiler->loop_shift);
+          orc_x86_emit_label (compiler, LABEL_STEP_UP (compiler->loop_shift));
+        }
       }
 
       compiler->loop_shift = save_loop_shift;
@@ -1106,57 +1781,66 @@ orc_x86_compile (OrcCompiler *compiler)
 
     orc_x86_emit_label (compiler, LABEL_REGION1_SKIP);
 
-    orc_x86_emit_cmp_imm_memoffset (compiler, 4, 0,
-        (int)ORC_STRUCT_OFFSET (OrcExecutor, counter2), compiler->exec_reg);
-    orc_x86_emit_je (compiler, LABEL_REGION2_SKIP);
-
-    if (compiler->loop_counter != ORC_REG_INVALID) {
-      orc_x86_emit_mov_memoffset_reg (compiler, 4,
-          (int)ORC_STRUCT_OFFSET (OrcExecutor, counter2), compiler->exec_reg,
-          compiler->loop_counter);
+    if (n_iterations < 0) {
+      orc_x86_emit_cmp_imm_memoffset (compiler, 4, 0,
+          (int)ORC_STRUCT_OFFSET (OrcExecutor, counter2), compiler->exec_reg);
+      orc_x86_emit_je (compiler, LABEL_REGION2_SKIP);
     }
 
-    orc_x86_emit_cpuinsn_comment (compiler, "# LOOP SHIFT %d", compiler->loop_shift);
-    // Instruction fetch windows are 16-byte aligned
-    // https://easyperf.net/blog/2018/01/18/Code_alignment_issues
-    orc_x86_emit_align (compiler, 4);
-    orc_x86_emit_label (compiler, LABEL_INNER_LOOP_START);
-    ui_max = 1 << compiler->unroll_shift;
-    for (ui = 0; ui < ui_max; ui++) {
-      compiler->offset = ui << compiler->loop_shift;
-      orc_x86_emit_loop (t, compiler,
-          (ui == ui_max - 1)
-              << (compiler->loop_shift + compiler->unroll_shift));
-    }
-    compiler->offset = 0;
-    if (compiler->loop_counter != ORC_REG_INVALID) {
-      orc_x86_emit_add_imm_reg (compiler, 4, -1, compiler->loop_counter, TRUE);
-    } else {
-      orc_x86_emit_dec_memoffset (compiler, 4,
-          (int)ORC_STRUCT_OFFSET (OrcExecutor, counter2), compiler->exec_reg);
+    if (n_iterations != 0) {
+      if (compiler->loop_counter != ORC_REG_INVALID) {
+        orc_x86_emit_mov_memoffset_reg (compiler, 4,
+            (int)ORC_STRUCT_OFFSET (OrcExecutor, counter2), compiler->exec_reg,
+            compiler->loop_counter);
+      }
+
+      orc_x86_emit_region2 (t, compiler, n_iterations);
     }
-    orc_x86_emit_jne (compiler, LABEL_INNER_LOOP_START);
     orc_x86_emit_label (compiler, LABEL_REGION2_SKIP);
 
     if (emit_region3) {
+      int loop_shift = compiler->loop_shift;
       int save_loop_shift;
       int l;
 
       save_loop_shift = compiler->loop_shift + compiler->unroll_shift;
       compiler->vars[align_var].is_aligned = FALSE;
 
-      for (l = save_loop_shift - 1; l >= 0; l--) {
-        compiler->loop_shift = l;
-        orc_x86_emit_cpuinsn_comment (compiler, "# LOOP SHIFT %d", compiler->loop_shift);
+      /* Whole vectors left by the unrolling, then the rest at once */
+      for (l = save_loop_shift - 1; l >= (mask_count ? loop_shift : 0); l--) {
+        /* More than a vector is a copy of the body per vector */
+        const int copies = 1 << MAX (0, l - loop_shift);
+        int ui;
+
+        compiler->loop_shift = MIN (l, loop_shift);
+        orc_x86_emit_cpuinsn_comment (compiler, "# LOOP SHIFT %d", l);
 
-        orc_x86_emit_test_imm_memoffset (compiler, 4, 1 << compiler->loop_shift,
+        orc_x86_emit_test_imm_memoffset (compiler, 4, 1 << l,
             (int)ORC_STRUCT_OFFSET (OrcExecutor, counter3), compiler->exec_reg);
-        orc_x86_emit_je (compiler, LABEL_STEP_DOWN (compiler->loop_shift));
-        orc_x86_emit_loop (t, compiler, 1 << compiler->loop_shift);
-        orc_x86_emit_label (compiler, LABEL_STEP_DOWN (compiler->loop_shift));
+        orc_x86_emit_je (compiler, LABEL_STEP_DOWN (l));
+        for (ui = 0; ui < copies; ui++) {
+          compiler->offset = ui << compiler->loop_shift;
+          orc_x86_use_partial_accumulators (compiler, ui);
+          orc_x86_emit_loop (t, compiler, (ui == copies - 1) << l);
+        }
+        compiler->offset = 0;
+        orc_x86_use_partial_accumulators (compiler, 0);
+        orc_x86_emit_label (compiler, LABEL_STEP_DOWN (l));
+      }
+      if (mask_count) {
+        compiler->loop_shift = loop_shift;
+        orc_x86_emit_mov_memoffset_reg (compiler, 4,
+            (int)ORC_STRUCT_OFFSET (OrcExecutor, counter3), compiler->exec_reg,
+            mask_count);
+        orc_x86_emit_and_imm_reg (compiler, 4, (1 << loop_shift) - 1,
+            mask_count);
+        orc_x86_emit_je (compiler, LABEL_STEP_DOWN (0));
+        /* The pointers are reloaded for the next row */
+        orc_x86_emit_masked_loop (t, compiler, mask_count, FALSE);
+        orc_x86_emit_label (compiler, LABEL_STEP_DOWN (0));
       }
 
-      compiler->loop_shift = save_loop_shift;
+      compiler->loop_shift = loop_shift;
     }
   }
 
@@ -1231,5 +1915,7 @@ orc_x86_register_extension (OrcTarget *t, OrcX86Target *x86t)
   t->flush_cache = orc_x86_flush_cache;
   t->target_data = x86t;
   t->register_size = x86t->register_size;
+  t->load_spill = orc_x86_load_spill;
+  t->store_spill = orc_x86_store_spill;
   orc_target_register (t);
 }
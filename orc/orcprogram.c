@@ -180,6 +180,7 @@ orc_program_free (OrcProgram *program)
     orc_code_free (program->orccode);
     program->orccode = NULL;
   }
+  orc_program_free_variants (program);
   if (program->init_function) {
     free (program->init_function);
     program->init_function = NULL;
@@ -196,9 +197,45 @@ orc_program_free (OrcProgram *program)
     free (program->error_msg);
     program->error_msg = NULL;
   }
+  free (program->insns);
   free (program);
 }
 
+/* A copy of @program without any compiled code, to compile it again
+ * without touching the code that other threads may be running */
+OrcProgram *
+orc_program_dup (OrcProgram *program)
+{
+  OrcProgram *p;
+  int i;
+
+  p = orc_malloc (sizeof (OrcProgram));
+  memcpy (p, program, sizeof (OrcProgram));
+
+  p->name = program->name ? strdup (program->name) : NULL;
+  for (i = 0; i < ORC_N_VARIABLES; i++) {
+    if (program->vars[i].name)
+      p->vars[i].name = strdup (program->vars[i].name);
+    if (program->vars[i].type_name)
+      p->vars[i].type_name = strdup (program->vars[i].type_name);
+  }
+  p->insns = orc_malloc (sizeof (OrcInstruction) * MAX (program->n_insns, 1));
+  memcpy (p->insns, program->insns, sizeof (OrcInstruction) * program->n_insns);
+  p->n_insns_alloc = MAX (program->n_insns, 1);
+
+  p->asm_code = NULL;
+  p->code_exec = NULL;
+  p->orccode = NULL;
+  p->backup_name = NULL;
+  p->init_function = NULL;
+  p->error_msg = NULL;
+  p->target = NULL;
+  p->variants = NULL;
+  p->n_variants = 0;
+
+  return p;
+}
+
 /**
  * orc_program_set_name:
  * @program: a pointer to an OrcProgram structure
@@ -267,6 +304,39 @@ void orc_program_set_constant_m (OrcProgram *program, int m)
   program->constant_m = m;
 }
 
+/**
+ * orc_program_set_unroll:
+ * @program: a pointer to an OrcProgram structure
+ * @unroll: the number of times the loop body is emitted, or 0
+ *
+ * Sets how many times the compiled code emits the loop body per
+ * iteration of its main loop, overriding the choice of the target.
+ * @unroll must be 0, which restores the automatic choice, or a power of
+ * two up to 8. The targets that do not unroll ignore it, the others may
+ * use a smaller factor when unrolling is not possible.
+ */
+void
+orc_program_set_unroll (OrcProgram *program, int unroll)
+{
+  ORC_ASSERT (unroll >= 0 && unroll <= 8 && (unroll & (unroll - 1)) == 0);
+
+  program->unroll = unroll;
+}
+
+/**
+ * orc_program_get_unroll:
+ * @program: a pointer to an OrcProgram structure
+ *
+ * Returns the unroll factor set with orc_program_set_unroll().
+ *
+ * Returns: the unroll factor, or 0 if the target chooses it
+ */
+int
+orc_program_get_unroll (OrcProgram *program)
+{
+  return program->unroll;
+}
+
 /**
  * orc_program_set_backup_function:
  * @program: a pointer to an OrcProgram structure
@@ -749,6 +819,26 @@ orc_program_set_sampling_type (OrcProgram *program, int var,
   /* This doesn't do anything yet */
 }
 
+/* Returns the cleared slot after the last instruction, the caller counts
+ * it once it is filled in. Programs have no limit on the number of
+ * instructions, the storage doubles as needed. */
+OrcInstruction *
+orc_program_new_insn (OrcProgram *program)
+{
+  OrcInstruction *insn;
+
+  if (program->n_insns == program->n_insns_alloc) {
+    program->n_insns_alloc = MAX (16, program->n_insns_alloc * 2);
+    program->insns = orc_realloc (program->insns,
+        sizeof (OrcInstruction) * program->n_insns_alloc);
+  }
+
+  insn = program->insns + program->n_insns;
+  memset (insn, 0, sizeof (OrcInstruction));
+
+  return insn;
+}
+
 /**
  * orc_program_append_ds:
  * @program: a pointer to an OrcProgram structure
@@ -765,7 +855,7 @@ orc_program_append_ds (OrcProgram *program, const char *name, int arg0,
 {
   OrcInstruction *insn;
 
-  insn = program->insns + program->n_insns;
+  insn = orc_program_new_insn (program);
 
   insn->opcode = orc_opcode_find_by_name (name);
   if (!insn->opcode) {
@@ -796,7 +886,7 @@ orc_program_append (OrcProgram *program, const char *name, int arg0,
 {
   OrcInstruction *insn;
 
-  insn = program->insns + program->n_insns;
+  insn = orc_program_new_insn (program);
 
   insn->opcode = orc_opcode_find_by_name (name);
   if (!insn->opcode) {
@@ -831,7 +921,7 @@ orc_program_append_2 (OrcProgram *program, const char *name, unsigned int flags,
   int args[4];
   int i;
 
-  insn = program->insns + program->n_insns;
+  insn = orc_program_new_insn (program);
 
   insn->opcode = orc_opcode_find_by_name (name);
   if (!insn->opcode) {
@@ -986,7 +1076,7 @@ orc_program_append_str_n (OrcProgram *program, const char *name,
   int i;
   int expected_args = 0;
 
-  insn = program->insns + program->n_insns;
+  insn = orc_program_new_insn (program);
 
   insn->line = program->current_line;
   insn->opcode = orc_opcode_find_by_name (name);
@@ -1064,7 +1154,7 @@ orc_program_append_ds_str (OrcProgram *program, const char *name,
 {
   OrcInstruction *insn;
 
-  insn = program->insns + program->n_insns;
+  insn = orc_program_new_insn (program);
 
   insn->opcode = orc_opcode_find_by_name (name);
   if (!insn->opcode) {
@@ -1084,7 +1174,7 @@ orc_program_append_dds_str (OrcProgram *program, const char *name,
 {
   OrcInstruction *insn;
 
-  insn = program->insns + program->n_insns;
+  insn = orc_program_new_insn (program);
 
   insn->opcode = orc_opcode_find_by_name (name);
   if (!insn->opcode) {
@@ -1112,7 +1202,20 @@ orc_program_append_dds_str (OrcProgram *program, const char *name,
 const char *
 orc_program_get_asm_code (OrcProgram *program)
 {
-  return program->asm_code;
+  char *asm_code;
+
+  /* Compiling for the CPU only creates the machine code */
+  orc_global_mutex_lock ();
+  asm_code = program->asm_code;
+  orc_global_mutex_unlock ();
+  if (asm_code == NULL && program->target) {
+    orc_compiler_create_asm_code (program);
+    orc_global_mutex_lock ();
+    asm_code = program->asm_code;
+    orc_global_mutex_unlock ();
+  }
+
+  return asm_code;
 }
 
 /**
@@ -1214,6 +1317,8 @@ orc_program_reset (OrcProgram *program)
     free(program->asm_code);
     program->asm_code = NULL;
   }
+  program->target = NULL;
+  orc_program_free_variants (program);
   if (program->error_msg) {
     free(program->error_msg);
     program->error_msg = NULL;
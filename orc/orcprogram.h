@@ -76,7 +76,9 @@ struct _OrcProgram {
   /* The offset of code_exec in this structure is part of the ABI */
   void *code_exec;
 
-  OrcInstruction insns[ORC_N_INSNS];
+  /* Grows as instructions are appended, see orc_program_new_insn() */
+  OrcInstruction *insns;
+  int n_insns_alloc;
   OrcVariable vars[ORC_N_VARIABLES];
 
   void *backup_func;
@@ -94,6 +96,22 @@ struct _OrcProgram {
   char *init_function;
   char *error_msg;
   unsigned int current_line;
+
+  /* The target of the last successful compilation. The assembly code,
+   * when it was not created, and specialized code are compiled for it,
+   * see orc_program_get_asm_code() and orc_executor_run_specialized() */
+  OrcTarget *target;
+  unsigned int target_flags;
+
+  /* The specialized code compiled so far, up to
+   * ORC_N_CODE_VARIANTS of them. Appended with the global mutex held,
+   * looked up without it, see orc_program_get_variant() */
+  struct _OrcCodeVariant *variants;
+  int n_variants;
+
+  /* Times the loop body is emitted per iteration, 0 lets the target
+   * choose, see orc_program_set_unroll() */
+  int unroll;
 };
 
 ORC_API OrcProgram * orc_program_new (void);
@@ -112,6 +130,8 @@ ORC_API void orc_program_set_n_multiple (OrcProgram *ex, int n);
 ORC_API void orc_program_set_n_minimum (OrcProgram *ex, int n);
 ORC_API void orc_program_set_n_maximum (OrcProgram *ex, int n);
 ORC_API void orc_program_set_constant_m (OrcProgram *program, int m);
+ORC_API void orc_program_set_unroll (OrcProgram *program, int unroll);
+ORC_API int orc_program_get_unroll (OrcProgram *program);
 
 ORC_API void orc_program_append (OrcProgram *p, const char *opcode, int arg0, int arg1, int arg2);
 ORC_API void orc_program_append_2 (OrcProgram *program, const char *name,
@@ -137,6 +157,8 @@ ORC_API OrcCompileResult orc_program_compile_full (OrcProgram *p, OrcTarget *tar
 ORC_API void orc_program_set_backup_function (OrcProgram *p, OrcExecutorFunc func);
 ORC_API void orc_program_set_backup_name (OrcProgram *p, const char *name);
 ORC_API void orc_program_free (OrcProgram *program);
+ORC_API OrcProgram * orc_program_fuse (OrcProgram *first, OrcProgram *second,
+    int n_links, const int *dests, const int *srcs);
 
 ORC_API int orc_program_find_var_by_name (OrcProgram *program, const char *name);
 
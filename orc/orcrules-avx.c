@@ -274,316 +274,333 @@ avx_rule_storeX (OrcCompiler *compiler, void *user, OrcInstruction *insn)
   dest->update_type = 2;
 }
 
-ORC_GNUC_UNUSED static void
-// load, nearest neighbor resampled
-avx_rule_ldresnearl_avx2 (OrcCompiler *compiler, void *user,
-    OrcInstruction *insn)
+/* The resampling loads read the source at 16.16 fixed point positions.
+ * The integer part of the position is kept in the pointer and the
+ * fraction in src->ptr_offset, see orc_x86_load_resample_offsets(). This
+ * leaves in @pos the positions of the first eight elements and in @inc
+ * the increment of four elements */
+static void
+avx_ldres_load_positions (OrcCompiler *compiler, OrcInstruction *insn,
+    int pos, int inc, int tmp)
 {
-  OrcVariable *const src = compiler->vars + insn->src_args[0];
+  const OrcVariable *const src = compiler->vars + insn->src_args[0];
   const int increment_var = insn->src_args[2];
-  const OrcVariable *const dest = compiler->vars + insn->dest_args[0];
-  const int tmp = orc_compiler_get_temp_reg (compiler);
+  const int iota = orc_compiler_get_constant_long (compiler, 0, 1, 2, 3);
 
-  for (int i = 0; i < (1 << compiler->loop_shift); i++) {
-    if (i == 0) {
-      orc_x86_emit_mov_memoffset_avx (compiler, 4, 0, src->ptr_register,
-          dest->alloc, FALSE);
-    } else {
-      orc_x86_emit_mov_memindex_avx (compiler, 4, 0, src->ptr_register,
-          compiler->gp_tmpreg, 2, tmp, FALSE);
-      /* orc_mmx_emit_punpckldq (compiler, tmp, dest->alloc); */
-      int shift_in_dwords = i;
-      if (shift_in_dwords >= 4) {
-        shift_in_dwords -= 4;
-        // Permute: zero out low lane, copy x0 to high lane
-        orc_avx_emit_permute2i128 (compiler,
-            ORC_AVX_PERMUTE (0, ORC_AVX_ZERO_LANE), tmp, tmp, tmp);
-
-        if (shift_in_dwords) {
-          orc_avx_emit_pslldq_imm (compiler, 4 * shift_in_dwords, tmp, tmp);
-        }
-
-        orc_avx_emit_por (compiler, tmp, dest->alloc, dest->alloc);
-      } else {
-        orc_avx_sse_emit_pslldq_imm (compiler, 4 * shift_in_dwords,
-            ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (tmp));
-        orc_avx_sse_emit_por (compiler, ORC_AVX_SSE_REG (tmp),
-            ORC_AVX_SSE_REG (dest->alloc), ORC_AVX_SSE_REG (dest->alloc));
-      }
-    }
+  if (compiler->vars[increment_var].vartype == ORC_VAR_TYPE_PARAM) {
+    orc_x86_emit_mov_memoffset_reg (compiler, 4,
+        (int)ORC_STRUCT_OFFSET (OrcExecutor, params[increment_var]),
+        compiler->exec_reg, compiler->gp_tmpreg);
+  } else {
+    orc_x86_emit_mov_imm_reg (compiler, 4,
+        compiler->vars[increment_var].value.i, compiler->gp_tmpreg);
+  }
+  orc_avx_sse_emit_movd_load_register (compiler, compiler->gp_tmpreg,
+      ORC_AVX_SSE_REG (inc));
+  orc_avx_emit_broadcast (compiler, inc, inc, 4);
 
-    if (compiler->vars[increment_var].vartype == ORC_VAR_TYPE_PARAM) {
-      orc_x86_emit_add_memoffset_reg (compiler, 4,
-          (int)ORC_STRUCT_OFFSET (OrcExecutor, params[increment_var]),
-          compiler->exec_reg, src->ptr_offset);
-    } else {
-      orc_x86_emit_add_imm_reg (compiler, 4,
-          compiler->vars[increment_var].value.i, src->ptr_offset, FALSE);
-    }
+  // pos <- (0, i, 2i, 3i, 4i, 5i, 6i, 7i)
+  orc_avx_emit_pmulld (compiler, inc, iota, pos);
+  orc_avx_emit_pslld_imm (compiler, 2, inc, inc);
+  orc_avx_emit_permute2i128 (compiler, ORC_AVX_PERMUTE (0, ORC_AVX_ZERO_LANE),
+      inc, inc, tmp);
+  orc_avx_emit_paddd (compiler, pos, tmp, pos);
 
-    orc_x86_emit_mov_reg_reg (compiler, 4, src->ptr_offset,
-        compiler->gp_tmpreg);
-    orc_x86_emit_sar_imm_reg (compiler, 4, 16, compiler->gp_tmpreg);
+  // pos <- pos + offset
+  orc_avx_sse_emit_movd_load_register (compiler, src->ptr_offset,
+      ORC_AVX_SSE_REG (tmp));
+  orc_avx_emit_broadcast (compiler, tmp, tmp, 4);
+  orc_avx_emit_paddd (compiler, pos, tmp, pos);
+}
+
+/* The mask of a gather for the first @n elements of @size bytes */
+static void
+avx_ldres_load_mask (OrcCompiler *compiler, int n, int size, int mask)
+{
+  const int bytes = n * size;
+
+  if (bytes >= 32) {
+    orc_avx_emit_pcmpeqd (compiler, mask, mask, mask);
+  } else {
+    orc_avx_sse_emit_pcmpeqd (compiler, ORC_AVX_SSE_REG (mask),
+        ORC_AVX_SSE_REG (mask), ORC_AVX_SSE_REG (mask));
+    if (bytes < 16)
+      orc_avx_emit_psrldq_imm (compiler, 16 - bytes, mask, mask);
   }
+}
 
-  orc_x86_emit_add_reg_reg_shift (compiler, compiler->is_64bit ? 8 : 4,
-      compiler->gp_tmpreg, src->ptr_register, 2);
+/* Moves the pointer and the fraction to the position of the next
+ * iteration */
+static void
+avx_ldres_advance (OrcCompiler *compiler, OrcInstruction *insn)
+{
+  OrcVariable *const src = compiler->vars + insn->src_args[0];
+  const int increment_var = insn->src_args[2];
+  const int regsize = compiler->is_64bit ? 8 : 4;
+  int shift;
+
+  if (compiler->vars[increment_var].vartype == ORC_VAR_TYPE_PARAM) {
+    orc_x86_emit_mov_imm_reg (compiler, 4, 1 << compiler->loop_shift,
+        compiler->gp_tmpreg);
+    orc_x86_emit_imul_memoffset_reg (compiler, 4,
+        (int)ORC_STRUCT_OFFSET (OrcExecutor, params[increment_var]),
+        compiler->exec_reg, compiler->gp_tmpreg);
+    orc_x86_emit_add_reg_reg (compiler, 4, compiler->gp_tmpreg,
+        src->ptr_offset);
+  } else {
+    orc_x86_emit_add_imm_reg (compiler, 4,
+        compiler->vars[increment_var].value.i << compiler->loop_shift,
+        src->ptr_offset, FALSE);
+  }
+
+  // ptr += (offset >> 16) << shift, keeping only the fraction
+  orc_x86_emit_mov_reg_reg (compiler, 4, src->ptr_offset,
+      compiler->gp_tmpreg);
+  orc_x86_emit_sar_imm_reg (compiler, 4, 16, compiler->gp_tmpreg);
+  orc_variable_get_shift (src, &shift);
+  orc_x86_emit_add_reg_reg_shift (compiler, regsize, compiler->gp_tmpreg,
+      src->ptr_register, shift);
   orc_x86_emit_and_imm_reg (compiler, 4, 0xffff, src->ptr_offset);
 
   src->update_type = 0;
 }
 
-ORC_GNUC_UNUSED static void
-// load, bilinear resampled
-avx_rule_ldreslinl_avx2 (OrcCompiler *compiler, void *user,
+/* Gathers the first @n bytes at the positions of @pos, plus @delta, into
+ * the low byte of each dword of @dest. The dwords are read from aligned
+ * addresses, @align being the misalignment of the pointer, so no page
+ * after the last byte is touched */
+static void
+avx_ldres_gather_bytes (OrcCompiler *compiler, const OrcVariable *src,
+    int pos, int delta, int align, int n, int idx, int shift, int mask,
+    int dest)
+{
+  // t <- (pos >> 16) + delta + align
+  orc_avx_emit_psrad_imm (compiler, 16, pos, shift);
+  if (delta) {
+    orc_avx_emit_pcmpeqd (compiler, mask, mask, mask);
+    orc_avx_emit_psubd (compiler, shift, mask, shift);
+  }
+  orc_avx_emit_paddd (compiler, shift, align, shift);
+  // idx <- (t & ~3) - align
+  orc_avx_emit_psrld_imm (compiler, 2, shift, idx);
+  orc_avx_emit_pslld_imm (compiler, 2, idx, idx);
+  orc_avx_emit_psubd (compiler, idx, align, idx);
+  // shift <- (t & 3) * 8
+  orc_avx_emit_pslld_imm (compiler, 30, shift, shift);
+  orc_avx_emit_psrld_imm (compiler, 27, shift, shift);
+
+  avx_ldres_load_mask (compiler, n, 4, mask);
+  orc_avx_emit_pgatherdd (compiler, 0, src->ptr_register, idx, 0, mask,
+      dest);
+  orc_avx_emit_psrlvd (compiler, dest, shift, dest);
+  orc_avx_emit_pslld_imm (compiler, 24, dest, dest);
+  orc_avx_emit_psrld_imm (compiler, 24, dest, dest);
+}
+
+/* Packs the eight dwords of @src into bytes of the @i-th quad of @dest */
+static void
+avx_ldres_store_bytes (OrcCompiler *compiler, int i, int src, int dest)
+{
+  orc_avx_emit_packusdw (compiler, src, src, src);
+  orc_avx_emit_permute4x64_imm (compiler, ORC_AVX_SSE_SHUF (3, 1, 2, 0), src,
+      src);
+  if (i == 0) {
+    orc_avx_sse_emit_packuswb (compiler, ORC_AVX_SSE_REG (src),
+        ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (dest));
+  } else {
+    orc_avx_sse_emit_packuswb (compiler, ORC_AVX_SSE_REG (src),
+        ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (src));
+    orc_avx_emit_broadcast (compiler, src, src, 8);
+    orc_avx_emit_pblendd (compiler, 0x3 << (2 * i), dest, src, dest);
+  }
+}
+
+static void
+avx_ldres_load_align (OrcCompiler *compiler, const OrcVariable *src,
+    int align)
+{
+  orc_x86_emit_mov_reg_reg (compiler, 4, src->ptr_register,
+      compiler->gp_tmpreg);
+  orc_x86_emit_and_imm_reg (compiler, 4, 3, compiler->gp_tmpreg);
+  orc_avx_sse_emit_movd_load_register (compiler, compiler->gp_tmpreg,
+      ORC_AVX_SSE_REG (align));
+  orc_avx_emit_broadcast (compiler, align, align, 4);
+}
+
+static void
+// load, nearest neighbor resampled
+avx_rule_ldresnearb_avx2 (OrcCompiler *compiler, void *user,
     OrcInstruction *insn)
 {
-  OrcVariable *const src = compiler->vars + insn->src_args[0];
-  const int increment_var = insn->src_args[2];
-  const OrcVariable *const dest = compiler->vars + insn->dest_args[0];
+  const OrcVariable *const src = compiler->vars + insn->src_args[0];
+  const int dest = compiler->vars[insn->dest_args[0]].alloc;
+  const int n = 1 << compiler->loop_shift;
+  const int pos = orc_compiler_get_temp_reg (compiler);
+  const int inc = orc_compiler_get_temp_reg (compiler);
+  const int align = orc_compiler_get_temp_reg (compiler);
+  const int idx = orc_compiler_get_temp_reg (compiler);
+  const int shift = orc_compiler_get_temp_reg (compiler);
+  const int mask = orc_compiler_get_temp_reg (compiler);
   const int tmp = orc_compiler_get_temp_reg (compiler);
-  const int tmp2 = orc_compiler_get_temp_reg (compiler);
-  const int regsize = compiler->is_64bit ? 8 : 4;
+  int i;
 
-  if (compiler->loop_shift == 0) {
-    // a, b <- ptr4[tmp>>16, (tmp>>16)+1];
-    // (tmp == 0 since we have no other pixels)
-    orc_x86_emit_mov_memoffset_avx (compiler, 8, 0, src->ptr_register, tmp,
-        FALSE);
-
-    // Unsigned extend a and b to 16 bits (see below)
-    orc_avx_sse_emit_pxor (compiler, ORC_AVX_SSE_REG (tmp2),
-        ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (tmp2));
-    orc_avx_sse_emit_punpcklbw (compiler, ORC_AVX_SSE_REG (tmp),
-        ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (tmp));
-    // Key insight here: a * (256 - i) + b * i
-    // = a * 256 - a * i + b * i
-    // = (a * 256) + (b - a) * i
-    // === tmp2 <- (b - a)
-    // with b in tmp2, a in tmp
-    orc_avx_sse_emit_pshufd (compiler, ORC_AVX_SSE_SHUF (3, 2, 3, 2),
-        ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (tmp2));
-    // only the low quad is active as per src->ptr_register above
-    orc_avx_sse_emit_psubw (compiler, ORC_AVX_SSE_REG (tmp2),
-        ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (tmp2));
-
-    // Load offset -- time to calculate tmp
-    orc_avx_sse_emit_movd_load_register (compiler, src->ptr_offset,
-        ORC_AVX_SSE_REG (tmp));
-    // tmp is i32 in the emulator
-    // but when using it we only care about the low 24 bits
-    // due to & 0xFF windowing we only care about 0.24 -> 8..15
-    // hence why only the low word is used
-    orc_avx_sse_emit_pshuflw (compiler, ORC_AVX_SSE_SHUF (0, 0, 0, 0),
-        ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (tmp));
-    // i <-tmp >> 8
-    orc_avx_sse_emit_psrlw_imm (compiler, 8, ORC_AVX_SSE_REG (tmp),
-        ORC_AVX_SSE_REG (tmp));
-    // (...) <- (-a + b) * i
-    orc_avx_sse_emit_pmullw (compiler, ORC_AVX_SSE_REG (tmp),
-        ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (tmp));
-    // (...) <- (...) >> 8
-    orc_avx_sse_emit_psraw_imm (compiler, 8, ORC_AVX_SSE_REG (tmp),
-        ORC_AVX_SSE_REG (tmp));
-    // var32.x4 <- (orc_uint8) (...)
-    orc_avx_sse_emit_pxor (compiler, ORC_AVX_SSE_REG (tmp2),
-        ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (tmp2));
-    orc_avx_sse_emit_packsswb (compiler, ORC_AVX_SSE_REG (tmp),
-        ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (tmp));
-
-    // Insert into the destination
-    orc_x86_emit_mov_memoffset_avx (compiler, 4, 0, src->ptr_register,
-        dest->alloc, FALSE);
-    orc_avx_sse_emit_paddb (compiler, ORC_AVX_SSE_REG (tmp),
-      ORC_AVX_SSE_REG (dest->alloc), ORC_AVX_SSE_REG (dest->alloc));
-
-    // offset <- offset + i
-    if (compiler->vars[increment_var].vartype == ORC_VAR_TYPE_PARAM) {
-      orc_x86_emit_add_memoffset_reg (compiler, 4,
-          ORC_STRUCT_OFFSET (OrcExecutor, params[increment_var]),
-          compiler->exec_reg, src->ptr_offset);
-    } else {
-      orc_x86_emit_add_imm_reg (compiler, regsize,
-          compiler->vars[increment_var].value.i, src->ptr_offset, FALSE);
-    }
+  avx_ldres_load_positions (compiler, insn, pos, inc, tmp);
+  avx_ldres_load_align (compiler, src, align);
+  if (n > 8)
+    orc_avx_emit_pslld_imm (compiler, 1, inc, inc);
 
-    // offset (tmp) >> 16
-    orc_x86_emit_mov_reg_reg (compiler, 4, src->ptr_offset,
-        compiler->gp_tmpreg);
-    orc_x86_emit_sar_imm_reg (compiler, 4, 16, compiler->gp_tmpreg);
-
-    // (unsure why they keep the exponent in unshifted form -- prolly because
-    // of the offset + i step?)
-    // ptr += offset << 2
-    // 000000fd  lea     qword ptr [%r8+%rdx*4], %r8
-    // keeping only the exponent for the remaining ops
-    orc_x86_emit_add_reg_reg_shift (compiler, regsize, compiler->gp_tmpreg,
-        src->ptr_register, 2);
-    orc_x86_emit_and_imm_reg (compiler, 4, 0xffff, src->ptr_offset);
-  } else {
-    // Interpolate 2 pixels or higher
-    const int tmp3 = orc_compiler_get_temp_reg (compiler);
-    const int offset = orc_compiler_get_temp_reg (compiler);
-
-    const int boundary = 1 << compiler->loop_shift;
-
-    for (int i = 0; i < boundary; i += 2) {
-      // a, b <- ptr4[tmp>>16, (tmp>>16)+1];
-      orc_x86_emit_mov_memoffset_avx (compiler, 8, 0, src->ptr_register, tmp,
-          FALSE);
-      // (unlike the zeroth case, this loop is pre increment)
-      // Load offset -- time to calculate tmp
-      orc_avx_sse_emit_movd_load_register (compiler, src->ptr_offset, offset);
-
-      // offset <- offset + i
-      if (compiler->vars[increment_var].vartype == ORC_VAR_TYPE_PARAM) {
-        orc_x86_emit_add_memoffset_reg (compiler, 4,
-            (int)ORC_STRUCT_OFFSET (OrcExecutor, params[increment_var]),
-            compiler->exec_reg, src->ptr_offset);
-      } else {
-        orc_x86_emit_add_imm_reg (compiler, 4,
-            compiler->vars[increment_var].value.i, src->ptr_offset, FALSE);
-      }
+  for (i = 0; i < n; i += 8) {
+    if (i)
+      orc_avx_emit_paddd (compiler, pos, inc, pos);
+    avx_ldres_gather_bytes (compiler, src, pos, 0, align, MIN (n - i, 8),
+        idx, shift, mask, tmp);
+    avx_ldres_store_bytes (compiler, i / 8, tmp, dest);
+  }
 
-      // offset (tmp) >> 16
-      orc_x86_emit_mov_reg_reg (compiler, 4, src->ptr_offset,
-          compiler->gp_tmpreg);
-      orc_x86_emit_sar_imm_reg (compiler, 4, 16, compiler->gp_tmpreg);
-      // (unsure why they keep the exponent in unshifted form -- prolly because
-      // of the offset + i step?)
-      // c, d <- ptr4[updated offset >>16, (updated offset >>16)+1];
-      orc_x86_emit_mov_memindex_avx (compiler, 8, 0, src->ptr_register,
-          compiler->gp_tmpreg, 2, tmp2, FALSE);
-
-      // tmp2 contains at this moment the correct odd interpolated pixels
-      // interleave ab with cd
-      orc_avx_sse_emit_punpckldq (compiler, ORC_AVX_SSE_REG (tmp),
-          ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (tmp));
-      // copy tmp to tmp2
-      orc_avx_sse_emit_movdqa (compiler, ORC_AVX_SSE_REG (tmp),
-          ORC_AVX_SSE_REG (tmp2));
-      // Insert the pixels in place
-      switch (i) {
-        case 0:
-          // dest <- tmp[0..64]
-          orc_avx_sse_emit_movdqa (compiler, ORC_AVX_SSE_REG (tmp),
-              ORC_AVX_SSE_REG (dest->alloc));
-          break;
-        case 2:
-          // dest <- tmp[0..64] dest[0..64]
-          orc_avx_sse_emit_punpcklqdq (compiler, ORC_AVX_SSE_REG (dest->alloc),
-              ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (dest->alloc));
-          break;
-        case 4:
-          // dest <- dest[255...192] tmp[0..64] dest[0..127]
-          orc_avx_emit_broadcast (compiler, tmp, tmp3, 8);
-          orc_avx_emit_permute4x64_imm (compiler, ORC_AVX_SSE_SHUF (2, 2, 1, 0), dest->alloc, dest->alloc);
-          // Copy the 3rd quad from tmp3
-          orc_avx_emit_pblendd (compiler, ORC_AVX_SSE_SHUF(0, 3, 0, 0), dest->alloc, tmp3, dest->alloc);
-          break;
-        case 6:
-          // dest <- tmp[0..64] dest[128..191] dest[0..127]
-          orc_avx_emit_broadcast (compiler, tmp, tmp3, 8);
-          // Copy the 4th quad from tmp3
-          orc_avx_emit_pblendd (compiler, ORC_AVX_SSE_SHUF(3, 0, 0, 0), dest->alloc, tmp3, dest->alloc);
-          break;
-        default:
-          ORC_COMPILER_ERROR (compiler, "Invalid shift value for masking");
-          ORC_ASSERT (0);
-          break;
-      }
+  avx_ldres_advance (compiler, insn);
+}
 
-      orc_avx_sse_emit_pxor (compiler, ORC_AVX_SSE_REG (tmp3), ORC_AVX_SSE_REG (tmp3), ORC_AVX_SSE_REG (tmp3));
-      // Unsigned extend ac to 16 bits
-      orc_avx_sse_emit_punpcklbw (compiler, ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (tmp3), ORC_AVX_SSE_REG (tmp));
-      // Unsigned extend bd to 16 bits
-      orc_avx_sse_emit_punpckhbw (compiler, ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (tmp3), ORC_AVX_SSE_REG (tmp2));
-
-      // tmp2 <- (b - a, d - c)
-      orc_avx_sse_emit_psubw (compiler, ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (tmp2));
-
-      // tmp4 now has the (offset + i, offset + i + 1)
-      // (from the previous iteration, from the earlier addition)
-      orc_avx_sse_emit_pinsrw_register (compiler, 1, ORC_AVX_SSE_REG (offset), src->ptr_offset,
-          ORC_AVX_SSE_REG (offset));
-
-      // (offset+i, offset+i, offset+i+1, offset+i+1, 0, 0, 0, 0)
-      orc_avx_sse_emit_pshuflw (compiler, ORC_AVX_SSE_SHUF (1, 1, 0, 0), ORC_AVX_SSE_REG (offset),
-          offset);
-      // (o+i, o+i, o+i, o+i, o+i+1, o+i+1, o+i+1, o+i+1)
-      orc_avx_sse_emit_pshufd (compiler, ORC_AVX_SSE_SHUF (1, 1, 0, 0), ORC_AVX_SSE_REG (offset),
-          offset);
-
-      // i <-tmp >> 8
-      orc_avx_sse_emit_psrlw_imm (compiler, 8, ORC_AVX_SSE_REG (offset), ORC_AVX_SSE_REG (offset));
-      // (...) <- (b - a, d - c) * i
-      orc_avx_sse_emit_pmullw (compiler, ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (offset), ORC_AVX_SSE_REG (tmp2));
-      // (...) <- (...) >> 8
-      orc_avx_sse_emit_psraw_imm (compiler, 8, ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (tmp2));
-      // var32.x4 <- (orc_uint8) (...)
-      orc_avx_emit_pxor (compiler, tmp, tmp, tmp);
-      orc_avx_sse_emit_packsswb (compiler, ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (tmp), ORC_AVX_SSE_REG (tmp2));
-      orc_avx_sse_emit_punpcklqdq (compiler, ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (tmp2));
-
-      // store the next two pixels
-      // interpolant goes in the middle
-      switch (i) {
-        case 0:
-          break;
-        case 2:
-          orc_avx_sse_emit_pslldq_imm (compiler, 8, ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (tmp2));
-          break;
-        case 4:
-          orc_avx_emit_permute4x64_imm (compiler, ORC_AVX_SSE_SHUF(2, 1, 3, 3), tmp2, tmp2);
-          break;
-        case 6:
-          orc_avx_emit_permute4x64_imm (compiler, ORC_AVX_SSE_SHUF(1, 2, 3, 3), tmp2, tmp2);
-          break;
-        default:
-          ORC_COMPILER_ERROR (compiler, "Invalid shift value for masking");
-          ORC_ASSERT (0);
-          break;
-      }
+static void
+// load, bilinear resampled
+avx_rule_ldreslinb_avx2 (OrcCompiler *compiler, void *user,
+    OrcInstruction *insn)
+{
+  const OrcVariable *const src = compiler->vars + insn->src_args[0];
+  const int dest = compiler->vars[insn->dest_args[0]].alloc;
+  const int n = 1 << compiler->loop_shift;
+  const int pos = orc_compiler_get_temp_reg (compiler);
+  const int inc = orc_compiler_get_temp_reg (compiler);
+  const int align = orc_compiler_get_temp_reg (compiler);
+  const int idx = orc_compiler_get_temp_reg (compiler);
+  const int shift = orc_compiler_get_temp_reg (compiler);
+  const int mask = orc_compiler_get_temp_reg (compiler);
+  const int a = orc_compiler_get_temp_reg (compiler);
+  const int b = orc_compiler_get_temp_reg (compiler);
+  int i;
+
+  avx_ldres_load_positions (compiler, insn, pos, inc, a);
+  avx_ldres_load_align (compiler, src, align);
+  if (n > 8)
+    orc_avx_emit_pslld_imm (compiler, 1, inc, inc);
+
+  for (i = 0; i < n; i += 8) {
+    if (i)
+      orc_avx_emit_paddd (compiler, pos, inc, pos);
+    // a, b <- ptr[tmp >> 16], ptr[(tmp >> 16) + 1]
+    avx_ldres_gather_bytes (compiler, src, pos, 0, align, MIN (n - i, 8),
+        idx, shift, mask, a);
+    avx_ldres_gather_bytes (compiler, src, pos, 1, align, MIN (n - i, 8),
+        idx, shift, mask, b);
+    // a * (256 - f) + b * f = (a << 8) + (b - a) * f
+    orc_avx_emit_pslld_imm (compiler, 16, pos, shift);
+    orc_avx_emit_psrld_imm (compiler, 24, shift, shift);
+    orc_avx_emit_psubd (compiler, b, a, b);
+    orc_avx_emit_pmulld (compiler, b, shift, b);
+    orc_avx_emit_psrad_imm (compiler, 8, b, b);
+    orc_avx_emit_paddd (compiler, a, b, a);
+    avx_ldres_store_bytes (compiler, i / 8, a, dest);
+  }
+
+  avx_ldres_advance (compiler, insn);
+}
 
-      if (i >= 4) {
-        // ptr0[i] = var32;
-        // (note: this means the space making happens elsewhere -- somewhere with
-        // lqdq ;) )
-        orc_avx_emit_por (compiler, tmp2, dest->alloc, dest->alloc);
-      } else {
-        // ptr0[i] = var32;
-        // (note: this means the space making happens elsewhere -- somewhere with
-        // lqdq ;) )
-        orc_avx_sse_emit_por (compiler, ORC_AVX_SSE_REG (tmp2), ORC_AVX_SSE_REG (dest->alloc), ORC_AVX_SSE_REG (dest->alloc));
-      }
+static void
+// load, nearest neighbor resampled
+avx_rule_ldresnearl_avx2 (OrcCompiler *compiler, void *user,
+    OrcInstruction *insn)
+{
+  const OrcVariable *const src = compiler->vars + insn->src_args[0];
+  const int dest = compiler->vars[insn->dest_args[0]].alloc;
+  const int n = 1 << compiler->loop_shift;
+  const int pos = orc_compiler_get_temp_reg (compiler);
+  const int inc = orc_compiler_get_temp_reg (compiler);
+  const int mask = orc_compiler_get_temp_reg (compiler);
+
+  if (n > 8) {
+    ORC_COMPILER_ERROR (compiler, "unsupported loop shift %d",
+        compiler->loop_shift);
+    return;
+  }
 
-      // offset <- offset + i
-      if (compiler->vars[increment_var].vartype == ORC_VAR_TYPE_PARAM) {
-        orc_x86_emit_add_memoffset_reg (compiler, 4,
-            (int)ORC_STRUCT_OFFSET (OrcExecutor, params[increment_var]),
-            compiler->exec_reg, src->ptr_offset);
-      } else {
-        orc_x86_emit_add_imm_reg (compiler, 4,
-            compiler->vars[increment_var].value.i, src->ptr_offset, FALSE);
-      }
+  avx_ldres_load_positions (compiler, insn, pos, inc, mask);
+  orc_avx_emit_psrad_imm (compiler, 16, pos, pos);
+  avx_ldres_load_mask (compiler, n, 4, mask);
+  orc_avx_emit_pgatherdd (compiler, 0, src->ptr_register, pos, 2, mask,
+      dest);
+
+  avx_ldres_advance (compiler, insn);
+}
+
+static void
+// load, bilinear resampled
+avx_rule_ldreslinl_avx2 (OrcCompiler *compiler, void *user,
+    OrcInstruction *insn)
+{
+  const OrcVariable *const src = compiler->vars + insn->src_args[0];
+  const int dest = compiler->vars[insn->dest_args[0]].alloc;
+  const int n = 1 << compiler->loop_shift;
+  const int pos = orc_compiler_get_temp_reg (compiler);
+  const int inc = orc_compiler_get_temp_reg (compiler);
+  const int idx = orc_compiler_get_temp_reg (compiler);
+  const int mask = orc_compiler_get_temp_reg (compiler);
+  const int ab = orc_compiler_get_temp_reg (compiler);
+  const int tmp = orc_compiler_get_temp_reg (compiler);
+  int i;
+
+  if (n > 8) {
+    ORC_COMPILER_ERROR (compiler, "unsupported loop shift %d",
+        compiler->loop_shift);
+    return;
+  }
 
-      // offset (tmp) >> 16
-      orc_x86_emit_mov_reg_reg (compiler, 4, src->ptr_offset,
-          compiler->gp_tmpreg);
-      orc_x86_emit_sar_imm_reg (compiler, 4, 16, compiler->gp_tmpreg);
-
-      // (unsure why they keep the exponent in unshifted form -- prolly because
-      // of the offset + i step?)
-      // ptr += offset << 2
-      // 000000fd  lea     qword ptr [%r8+%rdx*4], %r8
-      // keeping only the exponent for the remaining ops
-      orc_x86_emit_add_reg_reg_shift (compiler, 8, compiler->gp_tmpreg,
-          src->ptr_register, 2);
-      orc_x86_emit_and_imm_reg (compiler, 4, 0xffff, src->ptr_offset);
+  avx_ldres_load_positions (compiler, insn, pos, inc, tmp);
+
+  for (i = 0; i < n; i += 4) {
+    if (i)
+      orc_avx_emit_paddd (compiler, pos, inc, pos);
+    // (a, b) <- ptr4[tmp >> 16], ptr4[(tmp >> 16) + 1] for four pixels
+    orc_avx_emit_psrad_imm (compiler, 16, pos, idx);
+    avx_ldres_load_mask (compiler, MIN (n - i, 4), 8, mask);
+    orc_avx_emit_pgatherdq (compiler, 0, src->ptr_register,
+        ORC_AVX_SSE_REG (idx), 2, mask, ab);
+    // ab <- (a0 a1 a2 a3 b0 b1 b2 b3)
+    orc_avx_emit_pshufd (compiler, ORC_AVX_SSE_SHUF (3, 1, 2, 0), ab, ab);
+    orc_avx_emit_permute4x64_imm (compiler, ORC_AVX_SSE_SHUF (3, 1, 2, 0),
+        ab, ab);
+
+    // Unsigned extend a and b to 16 bits, tmp <- b - a
+    orc_avx_emit_extractf128_si256 (compiler, 1, ab, ORC_AVX_SSE_REG (tmp));
+    orc_avx_emit_pmovzxbw (compiler, ORC_AVX_SSE_REG (tmp), tmp);
+    orc_avx_emit_pmovzxbw (compiler, ORC_AVX_SSE_REG (ab), idx);
+    orc_avx_emit_psubw (compiler, tmp, idx, tmp);
+
+    // mask <- f of each pixel in its four words
+    orc_avx_emit_pslld_imm (compiler, 16, pos, mask);
+    orc_avx_emit_psrld_imm (compiler, 24, mask, mask);
+    orc_avx_emit_pmovzxdq (compiler, ORC_AVX_SSE_REG (mask), mask);
+    orc_avx_emit_pshuflw (compiler, ORC_AVX_SSE_SHUF (0, 0, 0, 0), mask,
+        mask);
+    orc_avx_emit_pshufhw (compiler, ORC_AVX_SSE_SHUF (0, 0, 0, 0), mask,
+        mask);
+
+    // a + ((b - a) * f >> 8), only the low byte of each word matters
+    orc_avx_emit_pmullw (compiler, tmp, mask, tmp);
+    orc_avx_emit_psrlw_imm (compiler, 8, tmp, tmp);
+    orc_avx_emit_packuswb (compiler, tmp, tmp, tmp);
+    orc_avx_emit_permute4x64_imm (compiler, ORC_AVX_SSE_SHUF (3, 1, 2, 0),
+        tmp, tmp);
+    if (i == 0) {
+      orc_avx_sse_emit_paddb (compiler, ORC_AVX_SSE_REG (tmp),
+          ORC_AVX_SSE_REG (ab), ORC_AVX_SSE_REG (dest));
+    } else {
+      orc_avx_sse_emit_paddb (compiler, ORC_AVX_SSE_REG (tmp),
+          ORC_AVX_SSE_REG (ab), ORC_AVX_SSE_REG (tmp));
+      orc_avx_emit_permute2i128 (compiler, ORC_AVX_PERMUTE (2, 0), dest, tmp,
+          dest);
     }
   }
 
-  src->update_type = 0;
+  avx_ldres_advance (compiler, insn);
 }
 
 static void
@@ -856,6 +873,82 @@ avx_rule_accsadubl (OrcCompiler *p, void *user, OrcInstruction *insn)
   }
 }
 
+// Copies the 1 << loop_shift elements of src over the rest of a
+// temporary, which max, min, or and and see as the same elements again
+static int
+avx_emit_acc_repeat (OrcCompiler *p, int src, int size)
+{
+  const int bytes = size << p->loop_shift;
+  int tmp;
+
+  if (bytes >= 32)
+    return src;
+
+  tmp = orc_compiler_get_temp_reg (p);
+  switch (bytes) {
+    case 1:
+      orc_avx_emit_pbroadcastb (p, ORC_AVX_SSE_REG (src), tmp);
+      break;
+    case 2:
+      orc_avx_emit_pbroadcastw (p, ORC_AVX_SSE_REG (src), tmp);
+      break;
+    case 4:
+      orc_avx_emit_pbroadcastd (p, ORC_AVX_SSE_REG (src), tmp);
+      break;
+    case 8:
+      orc_avx_emit_pbroadcastq (p, ORC_AVX_SSE_REG (src), tmp);
+      break;
+    default:
+      orc_avx_emit_permute2i128 (p, ORC_AVX_PERMUTE (0, 0), src, src, tmp);
+      break;
+  }
+
+  return tmp;
+}
+
+// Copies the 1 << loop_shift elements of src to a temporary with the rest
+// cleared, for the sums. The 128-bit forms clear the high lane.
+static int
+avx_emit_acc_clear (OrcCompiler *p, int src, int size)
+{
+  const int bytes = size << p->loop_shift;
+  int tmp;
+
+  if (bytes >= 32)
+    return src;
+
+  tmp = orc_compiler_get_temp_reg (p);
+  if (bytes == 16) {
+    orc_avx_sse_emit_movdqa (p, ORC_AVX_SSE_REG (src), ORC_AVX_SSE_REG (tmp));
+  } else {
+    orc_avx_sse_emit_pslldq_imm (p, 16 - bytes, ORC_AVX_SSE_REG (src),
+        ORC_AVX_SSE_REG (tmp));
+  }
+
+  return tmp;
+}
+
+#define ACC_RULE(name, opcode, size, fill) \
+static void \
+avx_rule_ ## name (OrcCompiler *p, void *user, OrcInstruction *insn) \
+{ \
+  const int src = avx_emit_acc_ ## fill (p, \
+      p->vars[insn->src_args[0]].alloc, size); \
+  const int dest = p->vars[insn->dest_args[0]].alloc; \
+\
+  orc_avx_emit_ ## opcode (p, dest, src, dest); \
+}
+
+ACC_RULE (accmaxub, pmaxub, 1, repeat)
+ACC_RULE (accminub, pminub, 1, repeat)
+ACC_RULE (accmaxsw, pmaxsw, 2, repeat)
+ACC_RULE (accminsw, pminsw, 2, repeat)
+ACC_RULE (accorl, por, 4, repeat)
+ACC_RULE (accandl, pand, 4, repeat)
+ACC_RULE (accq, paddq, 8, clear)
+ACC_RULE (accf, addps, 4, clear)
+ACC_RULE (accd, addpd, 8, clear)
+
 static void
 avx_rule_signX_avx2 (OrcCompiler *p, void *user, OrcInstruction *insn)
 {
@@ -3429,6 +3522,16 @@ orc_compiler_avx_register_rules (OrcTarget *target)
   rule_set = orc_rule_set_new (orc_opcode_set_get ("sys"), target,
       ORC_TARGET_AVX_AVX | ORC_TARGET_AVX_AVX2);
 
+  REGISTER_RULE (accmaxub);
+  REGISTER_RULE (accminub);
+  REGISTER_RULE (accmaxsw);
+  REGISTER_RULE (accminsw);
+  REGISTER_RULE (accorl);
+  REGISTER_RULE (accandl);
+  REGISTER_RULE (accq);
+  REGISTER_RULE (accf);
+  REGISTER_RULE (accd);
+
   REGISTER_RULE_WITH_GENERIC (addb, addb_avx2);
   REGISTER_RULE_WITH_GENERIC (addssb, addssb_avx2);
   REGISTER_RULE_WITH_GENERIC (addusb, addusb_avx2);
@@ -3526,8 +3629,8 @@ orc_compiler_avx_register_rules (OrcTarget *target)
   // These rules require dropping into SSE to be implemented in straight AVX
   REGISTER_RULE_WITH_GENERIC (loadupdb, loadupdb_avx2);
   REGISTER_RULE_WITH_GENERIC (loadupib, loadupib_avx2);
-  // The following rules need optimization -- they're more than twice slower
-  // than their SSE counterparts, and even more wrt the scalar implementation
-  // REGISTER_RULE_WITH_GENERIC (ldresnearl, ldresnearl_avx2);
-  // REGISTER_RULE_WITH_GENERIC (ldreslinl, ldreslinl_avx2);
+  REGISTER_RULE_WITH_GENERIC (ldresnearb, ldresnearb_avx2);
+  REGISTER_RULE_WITH_GENERIC (ldresnearl, ldresnearl_avx2);
+  REGISTER_RULE_WITH_GENERIC (ldreslinb, ldreslinb_avx2);
+  REGISTER_RULE_WITH_GENERIC (ldreslinl, ldreslinl_avx2);
 }
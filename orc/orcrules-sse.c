@@ -765,6 +765,90 @@ sse_rule_accsadubl (OrcCompiler *p, void *user, OrcInstruction *insn)
   orc_sse_emit_paddd (p, tmp, dest);
 }
 
+/* Copies the 1 << loop_shift elements of @src over the rest of a temporary,
+ * which max, min, or and and see as the same elements again */
+static int
+sse_emit_acc_repeat (OrcCompiler *p, int src, int size)
+{
+  const int bytes = size << p->loop_shift;
+  int tmp;
+
+  if (bytes >= 16)
+    return src;
+
+  tmp = orc_compiler_get_temp_reg (p);
+  switch (bytes) {
+    case 1:
+      orc_sse_emit_movdqa (p, src, tmp);
+      orc_sse_emit_punpcklbw (p, tmp, tmp);
+      orc_sse_emit_pshuflw (p, ORC_SSE_SHUF(0,0,0,0), tmp, tmp);
+      orc_sse_emit_pshufd (p, ORC_SSE_SHUF(0,0,0,0), tmp, tmp);
+      break;
+    case 2:
+      orc_sse_emit_pshuflw (p, ORC_SSE_SHUF(0,0,0,0), src, tmp);
+      orc_sse_emit_pshufd (p, ORC_SSE_SHUF(0,0,0,0), tmp, tmp);
+      break;
+    case 4:
+      orc_sse_emit_pshufd (p, ORC_SSE_SHUF(0,0,0,0), src, tmp);
+      break;
+    default:
+      orc_sse_emit_pshufd (p, ORC_SSE_SHUF(1,0,1,0), src, tmp);
+      break;
+  }
+
+  return tmp;
+}
+
+/* Copies the 1 << loop_shift elements of @src to a temporary with the
+ * rest cleared, for the sums */
+static int
+sse_emit_acc_clear (OrcCompiler *p, int src, int size)
+{
+  const int bytes = size << p->loop_shift;
+  int tmp;
+
+  if (bytes >= 16)
+    return src;
+
+  tmp = orc_compiler_get_temp_reg (p);
+  orc_sse_emit_movdqa (p, src, tmp);
+  orc_sse_emit_pslldq_imm (p, 16 - bytes, tmp);
+
+  return tmp;
+}
+
+#define ACC_REPEAT(name,opcode,size) \
+static void \
+sse_rule_ ## name (OrcCompiler *p, void *user, OrcInstruction *insn) \
+{ \
+  const int src = sse_emit_acc_repeat (p, \
+      p->vars[insn->src_args[0]].alloc, size); \
+  const int dest = p->vars[insn->dest_args[0]].alloc; \
+\
+  orc_sse_emit_ ## opcode (p, src, dest); \
+}
+
+#define ACC_CLEAR(name,opcode,size) \
+static void \
+sse_rule_ ## name (OrcCompiler *p, void *user, OrcInstruction *insn) \
+{ \
+  const int src = sse_emit_acc_clear (p, \
+      p->vars[insn->src_args[0]].alloc, size); \
+  const int dest = p->vars[insn->dest_args[0]].alloc; \
+\
+  orc_sse_emit_ ## opcode (p, src, dest); \
+}
+
+ACC_REPEAT(accmaxub, pmaxub, 1)
+ACC_REPEAT(accminub, pminub, 1)
+ACC_REPEAT(accmaxsw, pmaxsw, 2)
+ACC_REPEAT(accminsw, pminsw, 2)
+ACC_REPEAT(accorl, por, 4)
+ACC_REPEAT(accandl, pand, 4)
+ACC_CLEAR(accq, paddq, 8)
+ACC_CLEAR(accf, addps, 4)
+ACC_CLEAR(accd, addpd, 8)
+
 static void
 sse_rule_signX_ssse3 (OrcCompiler *p, void *user, OrcInstruction *insn)
 {
@@ -3238,6 +3322,15 @@ orc_compiler_sse_register_rules (OrcTarget *target)
   orc_rule_register (rule_set, "accw", sse_rule_accw, NULL);
   orc_rule_register (rule_set, "accl", sse_rule_accl, NULL);
   orc_rule_register (rule_set, "accsadubl", sse_rule_accsadubl, NULL);
+  orc_rule_register (rule_set, "accmaxub", sse_rule_accmaxub, NULL);
+  orc_rule_register (rule_set, "accminub", sse_rule_accminub, NULL);
+  orc_rule_register (rule_set, "accmaxsw", sse_rule_accmaxsw, NULL);
+  orc_rule_register (rule_set, "accminsw", sse_rule_accminsw, NULL);
+  orc_rule_register (rule_set, "accorl", sse_rule_accorl, NULL);
+  orc_rule_register (rule_set, "accandl", sse_rule_accandl, NULL);
+  orc_rule_register (rule_set, "accq", sse_rule_accq, NULL);
+  orc_rule_register (rule_set, "accf", sse_rule_accf, NULL);
+  orc_rule_register (rule_set, "accd", sse_rule_accd, NULL);
 
   /* These require the SSE2 flag, although could be used with MMX.
      That flag is not yet handled. */
@@ -0,0 +1,219 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <orc/orcprogram.h>
+#include <orc/orcdebug.h>
+#include <orc/orconce.h>
+#include <orc/orcinternal.h>
+#include <orc/orcutils-private.h>
+
+/**
+ * SECTION:orcspecialize
+ * @title: Specialized code
+ * @short_description: Code compiled for the arguments seen at run time
+ *
+ * The code compiled for a program works for any number of elements and
+ * any alignment of the arrays, which costs loops before and after the
+ * main one to reach an aligned pointer and to handle the elements left.
+ * Many callers always pass the same n, such as the width of a video
+ * frame, and arrays from an aligned allocator.
+ *
+ * orc_executor_run_specialized() compiles, the first time it sees them,
+ * a version of the program for the n, the m and the alignment of the
+ * arrays and strides of the call, as if the program had declared them
+ * with .n, .m and the alignment of its variables. Small n are fully
+ * unrolled, aligned arrays skip the loop that aligns the pointers and a
+ * n that is a multiple of the number of elements of the main loop
+ * skips the loop for the elements left. Up to ORC_N_CODE_VARIANTS
+ * versions are kept for each program, calls with other arguments run
+ * the generic code.
+ */
+
+/* Alignments below this one do not change the code of any target */
+#define ORC_SPECIALIZE_MIN_ALIGNMENT 16
+#define ORC_SPECIALIZE_MAX_ALIGNMENT 64
+
+/* The alignment of all the arrays, and of the strides of 2D programs,
+ * or 0 when it is not worth specializing on */
+static int
+orc_specialize_get_alignment (OrcProgram *program, OrcExecutor *ex)
+{
+  orc_intptr bits = ORC_SPECIALIZE_MAX_ALIGNMENT;
+  int i;
+
+  /* This runs on every call, the arrays are numbered from the first
+   * one of each kind */
+  for (i = 0; i < program->n_dest_vars; i++)
+    bits |= (orc_intptr) ex->arrays[ORC_VAR_D1 + i];
+  for (i = 0; i < program->n_src_vars; i++)
+    bits |= (orc_intptr) ex->arrays[ORC_VAR_S1 + i];
+  if (program->is_2d) {
+    for (i = 0; i < program->n_dest_vars; i++)
+      bits |= ex->params[ORC_VAR_D1 + i];
+    for (i = 0; i < program->n_src_vars; i++)
+      bits |= ex->params[ORC_VAR_S1 + i];
+  }
+  bits &= -bits;
+
+  if (bits < ORC_SPECIALIZE_MIN_ALIGNMENT)
+    return 0;
+  return bits;
+}
+
+static OrcCode *
+orc_specialize_compile (OrcProgram *program, int n, int m, int alignment)
+{
+  OrcProgram *p;
+  OrcCompileResult result;
+  OrcCode *code = NULL;
+  int i;
+
+  p = orc_program_dup (program);
+  p->constant_n = n;
+  if (p->is_2d)
+    p->constant_m = m;
+  for (i = ORC_VAR_D1; i <= ORC_VAR_S8; i++) {
+    if (p->vars[i].size)
+      p->vars[i].alignment = MAX (p->vars[i].alignment, alignment);
+  }
+
+  result = orc_program_compile_full (p, program->target,
+      program->target_flags);
+  if (ORC_COMPILE_RESULT_IS_SUCCESSFUL (result)) {
+    ORC_INFO ("compiled %s for n %d, m %d and alignment %d", program->name,
+        n, m, alignment);
+    code = orc_program_take_code (p);
+  } else {
+    ORC_WARNING ("could not specialize %s for n %d, m %d and alignment %d",
+        program->name, n, m, alignment);
+  }
+  orc_program_free (p);
+
+  return code;
+}
+
+/* Looks among the first @n_variants variants of @program. The variants
+ * below the count loaded with orc_atomic_load_int() are never modified,
+ * so they are read without the mutex. */
+static OrcCodeVariant *
+orc_specialize_find_variant (OrcProgram *program, int n_variants, int n,
+    int m, int alignment)
+{
+  int i;
+
+  for (i = 0; i < n_variants; i++) {
+    OrcCodeVariant *variant = program->variants + i;
+
+    if (variant->n == n && variant->m == m &&
+        variant->alignment == alignment)
+      return variant;
+  }
+
+  return NULL;
+}
+
+/* Returns the code of @program specialized for the call described by
+ * @ex, compiling it the first time, or NULL when the generic code has to
+ * be used. The code stays valid until the program is reset or freed.
+ *
+ * A variant is filled in before the count of variants is stored with
+ * release semantics, so looking up an existing variant takes no lock.
+ * The mutex is only taken to append a new one. */
+OrcCode *
+orc_program_get_variant (OrcProgram *program, OrcExecutor *ex)
+{
+  OrcCodeVariant *variant;
+  OrcCode *code, *unused;
+  int n_variants;
+  int n, m, alignment;
+
+  n = program->constant_n ? program->constant_n : ex->n;
+  m = 0;
+  if (program->is_2d)
+    m = program->constant_m ? program->constant_m : ORC_EXECUTOR_M (ex);
+  if (n <= 0 || (program->is_2d && m <= 0))
+    return NULL;
+  alignment = orc_specialize_get_alignment (program, ex);
+
+  n_variants = orc_atomic_load_int (&program->n_variants);
+  variant = orc_specialize_find_variant (program, n_variants, n, m,
+      alignment);
+  if (variant) {
+    /* A failed compile is kept as a variant without code, so that it is
+     * not tried again */
+    return variant->code;
+  }
+
+  if (n_variants == ORC_N_CODE_VARIANTS || program->orccode == NULL ||
+      program->target == NULL ||
+      !orc_target_is_executable (program->target))
+    return NULL;
+
+  /* Compiling takes the global mutex */
+  code = orc_specialize_compile (program, n, m, alignment);
+
+  orc_global_mutex_lock ();
+  /* Another thread may have compiled it meanwhile */
+  n_variants = program->n_variants;
+  variant = orc_specialize_find_variant (program, n_variants, n, m,
+      alignment);
+  if (variant == NULL && n_variants < ORC_N_CODE_VARIANTS) {
+    if (program->variants == NULL) {
+      program->variants = orc_malloc (sizeof (OrcCodeVariant) *
+          ORC_N_CODE_VARIANTS);
+    }
+    variant = program->variants + n_variants;
+    variant->n = n;
+    variant->m = m;
+    variant->alignment = alignment;
+    variant->code = code;
+    orc_atomic_store_int (&program->n_variants, n_variants + 1);
+    code = NULL;
+  }
+  unused = code;
+  code = variant ? variant->code : NULL;
+  orc_global_mutex_unlock ();
+
+  /* Freeing the code takes the global mutex */
+  if (unused)
+    orc_code_free (unused);
+
+  return code;
+}
+
+/* Whether @code, which may be any pointer, is the code of one of the
+ * variants of @program. Takes no lock, see orc_program_get_variant() */
+orc_bool
+orc_program_has_variant_code (OrcProgram *program, const void *code)
+{
+  int n_variants;
+  int i;
+
+  if (code == NULL)
+    return FALSE;
+
+  n_variants = orc_atomic_load_int (&program->n_variants);
+  for (i = 0; i < n_variants; i++) {
+    if (program->variants[i].code == code)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+void
+orc_program_free_variants (OrcProgram *program)
+{
+  int i;
+
+  for (i = 0; i < program->n_variants; i++) {
+    if (program->variants[i].code)
+      orc_code_free (program->variants[i].code);
+  }
+  free (program->variants);
+  program->variants = NULL;
+  program->n_variants = 0;
+}
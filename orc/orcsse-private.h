@@ -17,7 +17,8 @@ typedef enum _OrcSSEInsnOperandFlag {
 #define ORC_SSE_INSN_OPERAND_FLAG_LAST (ORC_MMX_INSN_OPERAND_FLAG_LAST + 2)
 
 #define ORC_SSE_INSN_TYPE_MEM_SSE (\
-  ORC_X86_INSN_OPERAND_OP1_MEM     \
+  ORC_X86_INSN_OPERAND_OP1_MEM |   \
+  ORC_X86_INSN_OPERAND_OP2_REG     \
 ), ORC_SSE_INSN_OPERAND_OP2_XMM
 
 #define ORC_SSE_INSN_TYPE_SSE_REG32M8_IMM8 (\
@@ -0,0 +1,287 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+
+#include <orc/orcprogram.h>
+#include <orc/orcdebug.h>
+#include <orc/orcinternal.h>
+#include <orc/orcutils-private.h>
+
+/**
+ * SECTION:orcstats
+ * @title: Execution statistics
+ * @short_description: Per-program execution counters
+ *
+ * When the ORC_CODE environment variable contains "stats", the code of
+ * every compiled program is wrapped so that each call records the values
+ * of n and m and the time spent running. This covers orc_executor_run()
+ * as well as the functions generated by orcc, and is done when the
+ * program is compiled, so nothing is added to the calls when the flag is
+ * not set.
+ *
+ * The counters of a program can be read with orc_code_get_stats() and
+ * the counters of all programs are printed when the process exits, or
+ * on demand with orc_code_dump_stats().
+ */
+
+typedef struct _OrcCodeStatsRecord OrcCodeStatsRecord;
+
+struct _OrcCodeStatsRecord {
+  OrcCodeStatsRecord *next;
+  char *name;
+  OrcExecutorFunc exec;
+  int is_2d;
+  OrcCodeStats stats;
+};
+
+/* Records outlive their code so that programs freed before exit still
+ * show up in the dump */
+static OrcCodeStatsRecord *orc_code_stats_records;
+static orc_bool orc_code_stats_dump_registered;
+
+static orc_uint64
+orc_code_stats_stamp (void)
+{
+#if defined(__GNUC__) && (defined(HAVE_I386) || defined(HAVE_AMD64))
+  orc_uint32 lo, hi;
+
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((orc_uint64) hi << 32) | lo;
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+  return __rdtsc ();
+#elif defined(__GNUC__) && defined(HAVE_AARCH64)
+  orc_uint64 ts;
+
+  __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (ts));
+  return ts;
+#elif defined(_WIN32)
+  LARGE_INTEGER pc;
+
+  QueryPerformanceCounter (&pc);
+  return pc.QuadPart;
+#elif defined(HAVE_CLOCK_GETTIME) && defined(HAVE_MONOTONIC_CLOCK)
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (orc_uint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+static void
+orc_code_stats_exec (OrcExecutor *ex)
+{
+  OrcCodeStatsRecord *record;
+  OrcCodeStats *stats;
+  OrcCode *code;
+  orc_uint64 start, end;
+  int n = ex->n;
+  int m;
+
+  /* orc_executor_run_specialized() passes the variant it picked, other
+   * callers may leave anything there. Programs that gave away their code
+   * still have it in the executor */
+  if (ex->program &&
+      orc_program_has_variant_code (ex->program, ex->arrays[ORC_VAR_A3])) {
+    code = (OrcCode *)ex->arrays[ORC_VAR_A3];
+  } else if (ex->program && ex->program->orccode) {
+    code = ex->program->orccode;
+  } else {
+    code = (OrcCode *)ex->arrays[ORC_VAR_A2];
+  }
+  record = code->stats;
+  m = record->is_2d ? ORC_EXECUTOR_M (ex) : 1;
+
+  start = orc_code_stats_stamp ();
+  record->exec (ex);
+  end = orc_code_stats_stamp ();
+
+  stats = &record->stats;
+  orc_global_mutex_lock ();
+  if (stats->n_calls == 0) {
+    stats->min_n = stats->max_n = n;
+    stats->min_m = stats->max_m = m;
+  } else {
+    stats->min_n = MIN (stats->min_n, n);
+    stats->max_n = MAX (stats->max_n, n);
+    stats->min_m = MIN (stats->min_m, m);
+    stats->max_m = MAX (stats->max_m, m);
+  }
+  stats->n_calls++;
+  stats->n_elements += (orc_uint64) n * m;
+  stats->cycles += end - start;
+  orc_global_mutex_unlock ();
+}
+
+static void
+orc_code_stats_dump_at_exit (void)
+{
+  orc_code_dump_stats ();
+}
+
+/**
+ * orc_code_stats_attach:
+ * @code: the compiled code
+ * @name: the name of the program
+ *
+ * Wraps the function of @code so that its calls are counted. Must be
+ * called once the function of @code is final.
+ */
+void
+orc_code_stats_attach (OrcCode *code, const char *name)
+{
+  OrcCodeStatsRecord *record;
+
+  if (code->exec == NULL || code->stats != NULL)
+    return;
+
+  record = orc_malloc (sizeof (OrcCodeStatsRecord));
+  memset (record, 0, sizeof (OrcCodeStatsRecord));
+  record->name = strdup (name ? name : "(unnamed)");
+  record->exec = code->exec;
+  record->is_2d = code->is_2d;
+
+  code->stats = record;
+  code->exec = orc_code_stats_exec;
+
+  orc_global_mutex_lock ();
+  record->next = orc_code_stats_records;
+  orc_code_stats_records = record;
+  if (!orc_code_stats_dump_registered) {
+    atexit (orc_code_stats_dump_at_exit);
+    orc_code_stats_dump_registered = TRUE;
+  }
+  orc_global_mutex_unlock ();
+}
+
+/**
+ * orc_code_stats_detach:
+ * @code: the code being freed
+ *
+ * Unlinks @code from its counters. The counters are kept so that they are
+ * still part of the dump at exit.
+ */
+void
+orc_code_stats_detach (OrcCode *code)
+{
+  OrcCodeStatsRecord *record = code->stats;
+
+  if (record == NULL)
+    return;
+
+  record->exec = NULL;
+  code->stats = NULL;
+}
+
+/**
+ * orc_code_get_stats:
+ * @code: an OrcCode
+ * @stats: filled with the counters of @code
+ *
+ * Reads the execution counters of @code. Counters are only kept when the
+ * ORC_CODE environment variable contains "stats".
+ *
+ * Returns: TRUE if @code has counters
+ */
+orc_bool
+orc_code_get_stats (OrcCode *code, OrcCodeStats *stats)
+{
+  OrcCodeStatsRecord *record;
+
+  memset (stats, 0, sizeof (OrcCodeStats));
+  if (code == NULL || code->stats == NULL)
+    return FALSE;
+
+  record = code->stats;
+  orc_global_mutex_lock ();
+  *stats = record->stats;
+  orc_global_mutex_unlock ();
+
+  return TRUE;
+}
+
+/**
+ * orc_code_reset_stats:
+ * @code: an OrcCode
+ *
+ * Sets the execution counters of @code back to zero.
+ */
+void
+orc_code_reset_stats (OrcCode *code)
+{
+  OrcCodeStatsRecord *record;
+
+  if (code == NULL || code->stats == NULL)
+    return;
+
+  record = code->stats;
+  orc_global_mutex_lock ();
+  memset (&record->stats, 0, sizeof (OrcCodeStats));
+  orc_global_mutex_unlock ();
+}
+
+/**
+ * orc_code_dump_stats:
+ *
+ * Prints the execution counters of all the programs compiled so far to
+ * stderr, ordered by the total time spent in each of them. This is done
+ * automatically at exit when the counters are enabled.
+ */
+void
+orc_code_dump_stats (void)
+{
+  OrcCodeStatsRecord **records;
+  OrcCodeStatsRecord *record;
+  int n_records = 0;
+  int i, j;
+
+  orc_global_mutex_lock ();
+  for (record = orc_code_stats_records; record; record = record->next)
+    n_records++;
+
+  records = orc_malloc (sizeof (OrcCodeStatsRecord *) * (n_records + 1));
+  i = 0;
+  for (record = orc_code_stats_records; record; record = record->next)
+    records[i++] = record;
+
+  /* Insertion sort, most expensive first */
+  for (i = 1; i < n_records; i++) {
+    record = records[i];
+    for (j = i; j > 0 && records[j - 1]->stats.cycles < record->stats.cycles;
+        j--) {
+      records[j] = records[j - 1];
+    }
+    records[j] = record;
+  }
+
+  fprintf (stderr, "ORC: %-32s %12s %16s %18s %10s %8s %8s %8s %8s\n",
+      "program", "calls", "elements", "cycles", "cyc/elem",
+      "min n", "max n", "min m", "max m");
+  for (i = 0; i < n_records; i++) {
+    const OrcCodeStats *stats = &records[i]->stats;
+
+    if (stats->n_calls == 0)
+      continue;
+
+    fprintf (stderr, "ORC: %-32s %12" PRIu64 " %16" PRIu64 " %18" PRIu64
+        " %10.2f %8d %8d %8d %8d\n",
+        records[i]->name, stats->n_calls, stats->n_elements, stats->cycles,
+        stats->n_elements ? (double) stats->cycles / stats->n_elements : 0.0,
+        stats->min_n, stats->max_n, stats->min_m, stats->max_m);
+  }
+  orc_global_mutex_unlock ();
+
+  free (records);
+}
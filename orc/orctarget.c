@@ -144,10 +144,8 @@ orc_target_get_rule (OrcTarget *target, OrcStaticOpcode *opcode,
   int i;
   int j;
 
-
-  /* FIXME yes, we are iterating twice */
   opcode_set = orc_opcode_set_find_by_opcode (opcode);
-  j = orc_opcode_set_find_by_name (opcode_set, opcode->name);
+  j = opcode - opcode_set->opcodes;
 
   for (i = target->n_rule_sets - 1; i >= 0; i--) {
     if (target->rule_sets[i].opcode_major != opcode_set->opcode_major) continue;
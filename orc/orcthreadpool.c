@@ -0,0 +1,356 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <orc/orcutils.h>
+#include <orc/orcdebug.h>
+#include <orc/orcinternal.h>
+#include <orc/orcutils-private.h>
+
+/* Work-stealing thread pool used by orc_executor_run_parallel().
+ *
+ * Each participating thread owns a range of task indices. It takes tasks
+ * from the front of its own range and, once it is empty, steals the back
+ * half of the range of another thread. The calling thread always takes
+ * part as thread 0, pool threads are created on first use and then wait
+ * for the next job. Only one job runs at a time, callers that find the
+ * pool busy run their tasks serially. */
+
+#define ORC_THREAD_POOL_MAX_THREADS 64
+
+#if defined(HAVE_THREAD_PTHREAD)
+
+#include <pthread.h>
+
+typedef pthread_mutex_t OrcThreadMutex;
+typedef pthread_cond_t OrcThreadCond;
+
+#define ORC_THREAD_MUTEX_INIT(m) pthread_mutex_init (m, NULL)
+#define ORC_THREAD_MUTEX_LOCK(m) pthread_mutex_lock (m)
+#define ORC_THREAD_MUTEX_TRYLOCK(m) (pthread_mutex_trylock (m) == 0)
+#define ORC_THREAD_MUTEX_UNLOCK(m) pthread_mutex_unlock (m)
+#define ORC_THREAD_COND_INIT(c) pthread_cond_init (c, NULL)
+#define ORC_THREAD_COND_WAIT(c,m) pthread_cond_wait (c, m)
+#define ORC_THREAD_COND_SIGNAL(c) pthread_cond_signal (c)
+#define ORC_THREAD_COND_BROADCAST(c) pthread_cond_broadcast (c)
+
+#define ORC_THREAD_POOL_ENABLED 1
+
+#elif defined(HAVE_THREAD_WIN32)
+
+#include <windows.h>
+
+typedef SRWLOCK OrcThreadMutex;
+typedef CONDITION_VARIABLE OrcThreadCond;
+
+#define ORC_THREAD_MUTEX_INIT(m) InitializeSRWLock (m)
+#define ORC_THREAD_MUTEX_LOCK(m) AcquireSRWLockExclusive (m)
+#define ORC_THREAD_MUTEX_TRYLOCK(m) TryAcquireSRWLockExclusive (m)
+#define ORC_THREAD_MUTEX_UNLOCK(m) ReleaseSRWLockExclusive (m)
+#define ORC_THREAD_COND_INIT(c) InitializeConditionVariable (c)
+#define ORC_THREAD_COND_WAIT(c,m) SleepConditionVariableSRW (c, m, INFINITE, 0)
+#define ORC_THREAD_COND_SIGNAL(c) WakeConditionVariable (c)
+#define ORC_THREAD_COND_BROADCAST(c) WakeAllConditionVariable (c)
+
+#define ORC_THREAD_POOL_ENABLED 1
+
+#endif
+
+#ifdef ORC_THREAD_POOL_ENABLED
+
+typedef struct _OrcThreadPoolQueue OrcThreadPoolQueue;
+typedef struct _OrcThreadPool OrcThreadPool;
+
+struct _OrcThreadPoolQueue {
+  OrcThreadMutex mutex;
+  int begin;
+  int end;
+  /* Last job seen by the thread when it was created */
+  int generation;
+};
+
+struct _OrcThreadPool {
+  /* Held by the caller for the duration of a job */
+  OrcThreadMutex job_mutex;
+
+  /* Protects everything below */
+  OrcThreadMutex mutex;
+  OrcThreadCond work_cond;
+  OrcThreadCond done_cond;
+  int n_workers;
+  int generation;
+  int n_participants;
+  int n_done;
+
+  OrcThreadPoolFunc func;
+  void *user_data;
+
+  OrcThreadPoolQueue queues[ORC_THREAD_POOL_MAX_THREADS];
+};
+
+static OrcThreadPool *_orc_thread_pool;
+
+static orc_bool
+orc_thread_pool_pop (OrcThreadPoolQueue *queue, int *task)
+{
+  orc_bool ret = FALSE;
+
+  ORC_THREAD_MUTEX_LOCK (&queue->mutex);
+  if (queue->begin < queue->end) {
+    *task = queue->begin++;
+    ret = TRUE;
+  }
+  ORC_THREAD_MUTEX_UNLOCK (&queue->mutex);
+
+  return ret;
+}
+
+static orc_bool
+orc_thread_pool_steal (OrcThreadPool *pool, int index, int n_threads)
+{
+  OrcThreadPoolQueue *queue = pool->queues + index;
+  int i;
+
+  for (i = 1; i < n_threads; i++) {
+    OrcThreadPoolQueue *victim = pool->queues + (index + i) % n_threads;
+    int begin = 0, end = 0;
+
+    ORC_THREAD_MUTEX_LOCK (&victim->mutex);
+    if (victim->begin < victim->end) {
+      end = victim->end;
+      begin = end - (victim->end - victim->begin + 1) / 2;
+      victim->end = begin;
+    }
+    ORC_THREAD_MUTEX_UNLOCK (&victim->mutex);
+
+    if (begin < end) {
+      ORC_THREAD_MUTEX_LOCK (&queue->mutex);
+      queue->begin = begin;
+      queue->end = end;
+      ORC_THREAD_MUTEX_UNLOCK (&queue->mutex);
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static void
+orc_thread_pool_work (OrcThreadPool *pool, int index, int n_threads)
+{
+  int task;
+
+  do {
+    while (orc_thread_pool_pop (pool->queues + index, &task))
+      pool->func (pool->user_data, task);
+  } while (orc_thread_pool_steal (pool, index, n_threads));
+}
+
+#if defined(HAVE_THREAD_PTHREAD)
+static void *
+#else
+static DWORD WINAPI
+#endif
+orc_thread_pool_thread (void *data)
+{
+  OrcThreadPool *pool = _orc_thread_pool;
+  int index = ORC_PTR_TO_INT (data);
+  int generation;
+  int n_threads;
+
+  ORC_THREAD_MUTEX_LOCK (&pool->mutex);
+  generation = pool->queues[index].generation;
+  while (1) {
+    while (pool->generation == generation)
+      ORC_THREAD_COND_WAIT (&pool->work_cond, &pool->mutex);
+    generation = pool->generation;
+
+    n_threads = pool->n_participants;
+    if (index >= n_threads)
+      continue;
+    ORC_THREAD_MUTEX_UNLOCK (&pool->mutex);
+
+    orc_thread_pool_work (pool, index, n_threads);
+
+    ORC_THREAD_MUTEX_LOCK (&pool->mutex);
+    pool->n_done++;
+    if (pool->n_done == n_threads - 1)
+      ORC_THREAD_COND_SIGNAL (&pool->done_cond);
+  }
+
+  return 0;
+}
+
+static OrcThreadPool *
+orc_thread_pool_get (void)
+{
+  OrcThreadPool *pool;
+  int i;
+
+  orc_global_mutex_lock ();
+  if (_orc_thread_pool == NULL) {
+    pool = orc_malloc (sizeof (OrcThreadPool));
+    memset (pool, 0, sizeof (OrcThreadPool));
+    ORC_THREAD_MUTEX_INIT (&pool->job_mutex);
+    ORC_THREAD_MUTEX_INIT (&pool->mutex);
+    ORC_THREAD_COND_INIT (&pool->work_cond);
+    ORC_THREAD_COND_INIT (&pool->done_cond);
+    for (i = 0; i < ORC_THREAD_POOL_MAX_THREADS; i++)
+      ORC_THREAD_MUTEX_INIT (&pool->queues[i].mutex);
+    /* The calling thread is always thread 0 */
+    pool->n_workers = 1;
+    _orc_thread_pool = pool;
+  }
+  orc_global_mutex_unlock ();
+
+  return _orc_thread_pool;
+}
+
+/* Called with the job mutex held. Returns the number of threads that
+ * can take part in a job, which is lower than @n_threads if creating
+ * a thread failed */
+static int
+orc_thread_pool_spawn (OrcThreadPool *pool, int n_threads)
+{
+  while (pool->n_workers < n_threads) {
+    void *data = (void *) (orc_intptr) pool->n_workers;
+
+    /* The thread may only start waiting after the job is posted */
+    pool->queues[pool->n_workers].generation = pool->generation;
+#if defined(HAVE_THREAD_PTHREAD)
+    pthread_t thread;
+
+    if (pthread_create (&thread, NULL, orc_thread_pool_thread, data) != 0)
+      break;
+    pthread_detach (thread);
+#else
+    HANDLE thread;
+
+    thread = CreateThread (NULL, 0, orc_thread_pool_thread, data, 0, NULL);
+    if (thread == NULL)
+      break;
+    CloseHandle (thread);
+#endif
+    pool->n_workers++;
+  }
+
+  if (pool->n_workers < n_threads) {
+    ORC_WARNING ("could only start %d of %d threads", pool->n_workers,
+        n_threads);
+  }
+
+  return MIN (n_threads, pool->n_workers);
+}
+
+#endif
+
+/**
+ * orc_thread_pool_get_n_threads:
+ *
+ * Returns the number of threads orc_thread_pool_run() uses by default:
+ * the value of the ORC_THREADS environment variable if set, otherwise
+ * the number of online processors.
+ *
+ * Returns: the default number of threads, at least 1
+ */
+int
+orc_thread_pool_get_n_threads (void)
+{
+  static int n_threads = 0;
+  int n = 0;
+  char *envvar;
+
+  if (n_threads > 0)
+    return n_threads;
+
+  envvar = _orc_getenv ("ORC_THREADS");
+  if (envvar != NULL) {
+    n = strtol (envvar, NULL, 0);
+    free (envvar);
+  }
+
+  if (n <= 0) {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+
+    GetSystemInfo (&info);
+    n = info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    n = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+  }
+
+  n_threads = ORC_CLAMP (n, 1, ORC_THREAD_POOL_MAX_THREADS);
+  return n_threads;
+}
+
+/**
+ * orc_thread_pool_run:
+ * @n_tasks: the number of tasks
+ * @n_threads: the maximum number of threads to use, 0 for the default
+ * @func: called once for every task index in [0, @n_tasks)
+ * @user_data: passed to @func
+ *
+ * Runs @n_tasks tasks on the calling thread and on up to @n_threads - 1
+ * pool threads, and returns once all of them have finished. Tasks may run
+ * in any order and on any thread.
+ */
+void
+orc_thread_pool_run (int n_tasks, int n_threads, OrcThreadPoolFunc func,
+    void *user_data)
+{
+#ifdef ORC_THREAD_POOL_ENABLED
+  OrcThreadPool *pool;
+  int i;
+#endif
+  int task;
+
+  if (n_threads <= 0)
+    n_threads = orc_thread_pool_get_n_threads ();
+  n_threads = MIN (n_threads, n_tasks);
+  n_threads = MIN (n_threads, ORC_THREAD_POOL_MAX_THREADS);
+
+#ifdef ORC_THREAD_POOL_ENABLED
+  if (n_threads > 1) {
+    pool = orc_thread_pool_get ();
+
+    /* Nested or concurrent jobs run on their calling thread */
+    if (ORC_THREAD_MUTEX_TRYLOCK (&pool->job_mutex)) {
+      n_threads = orc_thread_pool_spawn (pool, n_threads);
+
+      for (i = 0; i < n_threads; i++) {
+        pool->queues[i].begin = (int) ((orc_int64) n_tasks * i / n_threads);
+        pool->queues[i].end = (int) ((orc_int64) n_tasks * (i + 1) / n_threads);
+      }
+
+      ORC_THREAD_MUTEX_LOCK (&pool->mutex);
+      pool->func = func;
+      pool->user_data = user_data;
+      pool->n_participants = n_threads;
+      pool->n_done = 0;
+      pool->generation++;
+      ORC_THREAD_COND_BROADCAST (&pool->work_cond);
+      ORC_THREAD_MUTEX_UNLOCK (&pool->mutex);
+
+      orc_thread_pool_work (pool, 0, n_threads);
+
+      ORC_THREAD_MUTEX_LOCK (&pool->mutex);
+      while (pool->n_done < n_threads - 1)
+        ORC_THREAD_COND_WAIT (&pool->done_cond, &pool->mutex);
+      ORC_THREAD_MUTEX_UNLOCK (&pool->mutex);
+
+      ORC_THREAD_MUTEX_UNLOCK (&pool->job_mutex);
+      return;
+    }
+  }
+#endif
+
+  for (task = 0; task < n_tasks; task++)
+    func (user_data, task);
+}
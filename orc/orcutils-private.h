@@ -74,6 +74,82 @@ orc_count_ones (unsigned int v)
   return (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
 }
 
+/* Loads with acquire and stores with release semantics, for the values
+ * that are written with the global mutex held and read without it. The
+ * writes made before a store are seen by the thread that loads the
+ * stored value. */
+#if ORC_GNUC_PREREQ(4, 7) || ORC_CLANG_PREREQ(3, 1)
+
+#define orc_atomic_load_int(p) __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+#define orc_atomic_store_int(p, v) \
+    __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+#define orc_atomic_load_pointer(p) __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+#define orc_atomic_store_pointer(p, v) \
+    __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+
+#elif ORC_GNUC_PREREQ(4, 1)
+
+static inline int
+orc_atomic_load_int (int *p)
+{
+  int v = *(volatile int *) p;
+  __sync_synchronize ();
+  return v;
+}
+
+static inline void
+orc_atomic_store_int (int *p, int v)
+{
+  __sync_synchronize ();
+  *(volatile int *) p = v;
+}
+
+static inline void *
+orc_atomic_load_pointer (void **p)
+{
+  void *v = *(void * volatile *) p;
+  __sync_synchronize ();
+  return v;
+}
+
+static inline void
+orc_atomic_store_pointer (void **p, void *v)
+{
+  __sync_synchronize ();
+  *(void * volatile *) p = v;
+}
+
+#elif defined(_MSC_VER)
+
+long _InterlockedCompareExchange (long volatile *p, long v, long cmp);
+long _InterlockedExchange (long volatile *p, long v);
+void *_InterlockedCompareExchangePointer (void * volatile *p, void *v,
+    void *cmp);
+void *_InterlockedExchangePointer (void * volatile *p, void *v);
+#pragma intrinsic(_InterlockedCompareExchange, _InterlockedExchange)
+#pragma intrinsic(_InterlockedCompareExchangePointer)
+#pragma intrinsic(_InterlockedExchangePointer)
+
+#define orc_atomic_load_int(p) \
+    ((int) _InterlockedCompareExchange ((long volatile *) (p), 0, 0))
+#define orc_atomic_store_int(p, v) \
+    ((void) _InterlockedExchange ((long volatile *) (p), (v)))
+#define orc_atomic_load_pointer(p) \
+    _InterlockedCompareExchangePointer ((void * volatile *) (p), NULL, NULL)
+#define orc_atomic_store_pointer(p, v) \
+    ((void) _InterlockedExchangePointer ((void * volatile *) (p), (v)))
+
+#else
+#warning No atomic operations available
+
+#define orc_atomic_load_int(p) (*(volatile int *) (p))
+#define orc_atomic_store_int(p, v) ((void) (*(volatile int *) (p) = (v)))
+#define orc_atomic_load_pointer(p) (*(void * volatile *) (p))
+#define orc_atomic_store_pointer(p, v) \
+    ((void) (*(void * volatile *) (p) = (v)))
+
+#endif
+
 ORC_END_DECLS
 
 #endif /* _ORC_UTILS_PRIVATE_H_ */
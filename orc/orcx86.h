@@ -45,6 +45,10 @@ typedef struct _OrcX86Target
   int register_start;
   int n_registers;
   int label_step_up;
+  /* Sets c->loop_mask to a mask of the first @count elements, @count being
+   * below the number of elements of a loop iteration. NULL when the
+   * loads and stores can not be masked */
+  void (*load_loop_mask)(OrcCompiler *c, int count, int tmp);
 } OrcX86Target;
 
 enum {
@@ -140,17 +140,17 @@ static OrcX86InsnOpcode orc_x86_opcodes[] = {
   { "endbr32"  , ORC_X86_INSN_OPCODE_TYPE_OTHER , ORC_X86_INSN_OPERAND_NONE       , ORC_X86_INSN_OPCODE_PREFIX_0XF3, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F, 0x1efb },
   /* 80 */
   { "mov"      , ORC_X86_INSN_OPCODE_TYPE_OTHER , ORC_X86_INSN_TYPE_REG64_IMM64   , ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_NONE, 0xb8 },
+  { "sfence"   , ORC_X86_INSN_OPCODE_TYPE_OTHER , ORC_X86_INSN_OPERAND_NONE       , ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F, 0xaef8 },
+  { "prefetchnta", ORC_X86_INSN_OPCODE_TYPE_OTHER, ORC_X86_INSN_TYPE_MEM8       , ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F, 0x18, 0 },
+  { "prefetcht0", ORC_X86_INSN_OPCODE_TYPE_OTHER, ORC_X86_INSN_TYPE_MEM8        , ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F, 0x18, 1 },
+  { "bts"      , ORC_X86_INSN_OPCODE_TYPE_OTHER , ORC_X86_INSN_TYPE_REGM16TO64_REG16TO64, ORC_X86_INSN_OPCODE_PREFIX_NONE, ORC_X86_INSN_OPCODE_ESCAPE_SEQUENCE_0X0F, 0xab },
 };
 /* clang-format on */
 
-/* FIXME this is common to all targets. Move to the compiler */
 static void
 x86_add_fixup (OrcCompiler *compiler, unsigned char *ptr, int label, int type)
 {
-  compiler->fixups[compiler->n_fixups].ptr = ptr;
-  compiler->fixups[compiler->n_fixups].label = label;
-  compiler->fixups[compiler->n_fixups].type = type;
-  compiler->n_fixups++;
+  orc_compiler_add_fixup (compiler, ptr, label, type);
 }
 
 /* FIXME this is common to all targets. Move to the compiler */
@@ -289,6 +289,10 @@ static void
 orc_x86_emit_modrm_memindex2 (OrcCompiler *compiler, OrcX86InsnDispType disp,
     int offset, int src, int src_index, int shift, int dest)
 {
+  /* A SIB base of ebp or r13 without displacement means no base */
+  if (disp == ORC_X86_INSN_DISP_TYPE_0 && (src == X86_EBP || src == X86_R13))
+    disp = ORC_X86_INSN_DISP_TYPE_8;
+
   switch (disp) {
     /* Mode [SIB] */
     case ORC_X86_INSN_DISP_TYPE_0:
@@ -351,11 +355,27 @@ orc_x86_insn_need_rex_w (const OrcX86Insn *xinsn)
   return FALSE;
 }
 
+/* The index register of a memory operand, 0 if there is none */
+static int
+orc_x86_insn_get_index_reg (const OrcX86Insn *xinsn)
+{
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    if (xinsn->operands[i].type == ORC_X86_INSN_OPERAND_TYPE_IDX)
+      return xinsn->index_reg;
+  }
+  return 0;
+}
+
 static orc_bool
 orc_x86_insn_need_rex_rxb (const OrcX86Insn *xinsn)
 {
   int i;
 
+  if (orc_x86_insn_get_index_reg (xinsn) & 8)
+    return TRUE;
+
   /* If any of the registers is a extended register REX.RXB */
   for (i = 0; i < 4; i++) {
     const OrcX86InsnOperand *op = &xinsn->operands[i];
@@ -382,8 +402,9 @@ orc_x86_insn_need_rex (OrcCompiler *c, const OrcX86Insn *xinsn)
   if (!orc_x86_insn_need_rex_w (xinsn) && !orc_x86_insn_need_rex_rxb (xinsn))
     return FALSE;
 
-  /* Disable REX for M encoding or push/pop */
-  if (xinsn->encoding == ORC_X86_INSN_ENCODING_M ||
+  /* Disable REX for register M encoding or push/pop */
+  if ((xinsn->encoding == ORC_X86_INSN_ENCODING_M &&
+          xinsn->operands[0].type != ORC_X86_INSN_OPERAND_TYPE_OFF) ||
       xinsn->opcode_type == ORC_X86_INSN_OPCODE_TYPE_STACK) {
     return FALSE;
   }
@@ -432,10 +453,17 @@ orc_x86_insn_output_opcode_other_stack_asm (OrcCompiler *p, OrcX86Insn *xinsn)
         break;
 
       case ORC_X86_INSN_OPERAND_TYPE_IDX:
-        sprintf(op_str, "%d(%%%s,%%%s,%d)", xinsn->offset,
-            orc_x86_get_regname_ptr (p, op->reg),
-            orc_x86_get_regname_ptr (p, xinsn->index_reg),
-            1 << xinsn->shift);
+        /* The gathers use a vector register for the index */
+        if (xinsn->index_reg >= X86_EAX && xinsn->index_reg < X86_EAX + 16)
+          sprintf(op_str, "%d(%%%s,%%%s,%d)", xinsn->offset,
+              orc_x86_get_regname_ptr (p, op->reg),
+              orc_x86_get_regname_ptr (p, xinsn->index_reg),
+              1 << xinsn->shift);
+        else
+          sprintf(op_str, "%d(%%%s,%%%s,%d)", xinsn->offset,
+              orc_x86_get_regname_ptr (p, op->reg),
+              orc_x86_get_simd_regname (xinsn, p, xinsn->index_reg, i),
+              1 << xinsn->shift);
         break;
 
       case ORC_X86_INSN_OPERAND_TYPE_OFF:
@@ -560,15 +588,16 @@ orc_x86_insn_output_rex (OrcCompiler *p, const OrcX86Insn *xinsn)
   switch (xinsn->encoding) {
     case ORC_X86_INSN_ENCODING_RM:
     case ORC_X86_INSN_ENCODING_RMI:
-      *p->codeptr++ = orc_x86_insn_get_rex (p, needs_rexw, xinsn->operands[0].reg, 0, xinsn->operands[1].reg);
+      *p->codeptr++ = orc_x86_insn_get_rex (p, needs_rexw, xinsn->operands[0].reg, orc_x86_insn_get_index_reg (xinsn), xinsn->operands[1].reg);
       break;
 
     case ORC_X86_INSN_ENCODING_MI:
     case ORC_X86_INSN_ENCODING_MR:
     case ORC_X86_INSN_ENCODING_MRI:
-      *p->codeptr++ = orc_x86_insn_get_rex (p, needs_rexw, xinsn->operands[1].reg, 0, xinsn->operands[0].reg);
+      *p->codeptr++ = orc_x86_insn_get_rex (p, needs_rexw, xinsn->operands[1].reg, orc_x86_insn_get_index_reg (xinsn), xinsn->operands[0].reg);
       break;
 
+    case ORC_X86_INSN_ENCODING_M:
     case ORC_X86_INSN_ENCODING_O:
     case ORC_X86_INSN_ENCODING_OI:
       *p->codeptr++ = orc_x86_insn_get_rex (p, needs_rexw, 0, 0, xinsn->operands[0].reg);
@@ -781,6 +810,7 @@ orc_x86_insn_output_modrm (OrcCompiler *p, const OrcX86Insn *xinsn)
     case ORC_X86_INSN_ENCODING_RRI:
     case ORC_X86_INSN_ENCODING_RM:
     case ORC_X86_INSN_ENCODING_RMI:
+    case ORC_X86_INSN_ENCODING_RMV:
       if (xinsn->operands[1].type == ORC_X86_INSN_OPERAND_TYPE_REG)
         orc_x86_emit_modrm_reg (p, xinsn->operands[1].reg,
             xinsn->operands[0].reg);
@@ -936,6 +966,9 @@ orc_x86_insn_get_vex_vvvv (const OrcX86Insn *xinsn)
     case ORC_X86_INSN_ENCODING_RVR: 
       vvvv = (~xinsn->operands[1].reg & 0xF) << 3 & X86_VEX_vvvv_MASK;
       break;
+    case ORC_X86_INSN_ENCODING_RMV:
+      vvvv = (~xinsn->operands[2].reg & 0xF) << 3 & X86_VEX_vvvv_MASK;
+      break;
     default:
       break;
   }
@@ -998,15 +1031,18 @@ orc_x86_insn_get_vex3_byte2 (OrcCompiler *p, const OrcX86Insn *xinsn)
     switch (xinsn->encoding) {
       case ORC_X86_INSN_ENCODING_RM:
       case ORC_X86_INSN_ENCODING_RMI:
+      case ORC_X86_INSN_ENCODING_RMV:
       case ORC_X86_INSN_ENCODING_RR:
       case ORC_X86_INSN_ENCODING_RRI:
-        byte2 |= orc_x86_insn_get_vex_rex (p, xinsn->operands[0].reg, 0, xinsn->operands[1].reg);
+        byte2 |= orc_x86_insn_get_vex_rex (p, xinsn->operands[0].reg,
+            orc_x86_insn_get_index_reg (xinsn), xinsn->operands[1].reg);
         break;
   
       case ORC_X86_INSN_ENCODING_MI:
       case ORC_X86_INSN_ENCODING_MR:
       case ORC_X86_INSN_ENCODING_MRI:
-        byte2 |= orc_x86_insn_get_vex_rex (p, xinsn->operands[1].reg, 0, xinsn->operands[0].reg);
+        byte2 |= orc_x86_insn_get_vex_rex (p, xinsn->operands[1].reg,
+            orc_x86_insn_get_index_reg (xinsn), xinsn->operands[0].reg);
         break;
   
       case ORC_X86_INSN_ENCODING_O:
@@ -1021,7 +1057,8 @@ orc_x86_insn_get_vex3_byte2 (OrcCompiler *p, const OrcX86Insn *xinsn)
       case ORC_X86_INSN_ENCODING_RVMI:
       case ORC_X86_INSN_ENCODING_RVMR:
       case ORC_X86_INSN_ENCODING_RVR:
-        byte2 |= orc_x86_insn_get_vex_rex (p, xinsn->operands[0].reg, 0, xinsn->operands[2].reg);
+        byte2 |= orc_x86_insn_get_vex_rex (p, xinsn->operands[0].reg,
+            orc_x86_insn_get_index_reg (xinsn), xinsn->operands[2].reg);
         break;
 
       default:
@@ -1111,6 +1148,12 @@ orc_x86_insn_output_vex (OrcCompiler *p, const OrcX86Insn *xinsn)
       }
     }
 
+    /* Check if we need to use X̅ for the index */
+    if (orc_x86_insn_get_index_reg (xinsn) & 8) {
+      use_vex3 = TRUE;
+      goto done;
+    }
+
     /* Check if we need REX.W */
     use_vex3 = orc_x86_insn_need_rex_w (xinsn);
     if (use_vex3)
@@ -1178,15 +1221,18 @@ orc_x86_insn_get_evex_byte2 (OrcCompiler *p, const OrcX86Insn *xinsn)
     switch (xinsn->encoding) {
       case ORC_X86_INSN_ENCODING_RM:
       case ORC_X86_INSN_ENCODING_RMI:
+      case ORC_X86_INSN_ENCODING_RMV:
       case ORC_X86_INSN_ENCODING_RR:
       case ORC_X86_INSN_ENCODING_RRI:
-        byte2 |= orc_x86_insn_get_evex_rex (p, xinsn->operands[0].reg, 0, xinsn->operands[1].reg);
+        byte2 |= orc_x86_insn_get_evex_rex (p, xinsn->operands[0].reg,
+            orc_x86_insn_get_index_reg (xinsn), xinsn->operands[1].reg);
         break;
   
       case ORC_X86_INSN_ENCODING_MI:
       case ORC_X86_INSN_ENCODING_MR:
       case ORC_X86_INSN_ENCODING_MRI:
-        byte2 |= orc_x86_insn_get_evex_rex (p, xinsn->operands[1].reg, 0, xinsn->operands[0].reg);
+        byte2 |= orc_x86_insn_get_evex_rex (p, xinsn->operands[1].reg,
+            orc_x86_insn_get_index_reg (xinsn), xinsn->operands[0].reg);
         break;
   
       case ORC_X86_INSN_ENCODING_O:
@@ -1201,7 +1247,8 @@ orc_x86_insn_get_evex_byte2 (OrcCompiler *p, const OrcX86Insn *xinsn)
       case ORC_X86_INSN_ENCODING_RVMI:
       case ORC_X86_INSN_ENCODING_RVMR:
       case ORC_X86_INSN_ENCODING_RVR:
-        byte2 |= orc_x86_insn_get_evex_rex (p, xinsn->operands[0].reg, 0, xinsn->operands[2].reg);
+        byte2 |= orc_x86_insn_get_evex_rex (p, xinsn->operands[0].reg,
+            orc_x86_insn_get_index_reg (xinsn), xinsn->operands[2].reg);
         break;
 
       default:
@@ -1258,12 +1305,25 @@ orc_x86_insn_get_evex_byte34 (OrcCompiler *p, const OrcX86Insn *xinsn,
           Vp = 0x0;
       }
       break;
+    case ORC_X86_INSN_ENCODING_RMV:
+      if (orc_x86_get_regnum_full (xinsn->operands[2].reg, &vnum)) {
+        vvvv = (~vnum & 0xF) << 3 & X86_VEX_vvvv_MASK;
+        if (vnum & 0x10)
+          Vp = 0x0;
+      }
+      break;
 
     default:
       break;
   }
   b3 |= vvvv;
 
+  // The vector index of a VSIB memory operand extends to 32 registers
+  // with V̅'
+  if (orc_x86_get_regnum_full (orc_x86_insn_get_index_reg (xinsn), &vnum) &&
+      (vnum & 0x10))
+    Vp = 0x0;
+
   // Opcode prefix, we use the same representation as the expected value
   b3 |= xinsn->opcode_prefix;
 
@@ -1356,6 +1416,7 @@ orc_x86_recalc_offsets (OrcCompiler *p)
 
   minptr = p->code;
   p->codeptr = p->code;
+  p->n_fixups = 0;
   for(i=0;i<p->n_output_insns;i++){
     unsigned char *ptr;
 
@@ -1378,9 +1439,6 @@ orc_x86_recalc_offsets (OrcCompiler *p)
     }
 
   }
-
-  p->codeptr = p->code;
-  p->n_fixups = 0;
 }
 
 /* Operand size and Address size. Vol.1, Ch.3, 3.6.1 */
@@ -1522,7 +1580,7 @@ orc_x86_get_output_insn (OrcCompiler *p)
 {
   OrcX86Insn *xinsn;
   if (p->n_output_insns >= p->n_output_insns_alloc) {
-    p->n_output_insns_alloc += 10;
+    p->n_output_insns_alloc = MAX (64, p->n_output_insns_alloc * 2);
     p->output_insns = orc_realloc (p->output_insns,
         sizeof(OrcX86Insn) * p->n_output_insns_alloc);
   }
@@ -1616,7 +1674,11 @@ orc_x86_insn_encoding_from_operands (OrcX86InsnEncoding *encoding, int operands,
       goto error;
     }
   } else if (operands & ORC_X86_INSN_OPERAND_OP3_REG) {
-    if (e == ORC_X86_INSN_ENCODING_MR ||
+    /* Only a memory for the second operand, like the gathers */
+    if (e == ORC_X86_INSN_ENCODING_RM &&
+        !(operands & ORC_X86_INSN_OPERAND_OP2_REG)) {
+      e = ORC_X86_INSN_ENCODING_RMV;
+    } else if (e == ORC_X86_INSN_ENCODING_MR ||
         e == ORC_X86_INSN_ENCODING_RM) {
       e = ORC_X86_INSN_ENCODING_RVM;
     } else if (e == ORC_X86_INSN_ENCODING_RR) {
@@ -1781,6 +1843,13 @@ orc_x86_output_insns (OrcCompiler *p)
   OrcX86Insn *xinsn;
   int i;
 
+  /* orc_x86_calculate_offsets() leaves the final machine code in place,
+   * it is only emitted again along with the assembly code */
+  if (!p->need_asm)
+    return;
+
+  p->codeptr = p->code;
+  p->n_fixups = 0;
   for(i=0;i<p->n_output_insns;i++){
     xinsn = ((OrcX86Insn *)p->output_insns) + i;
 
@@ -2400,7 +2469,7 @@ orc_x86_emit_cpuinsn_memoffset (OrcCompiler *p, int index, int size,
 
   xinsn = orc_x86_get_output_insn (p);
   orc_x86_insn_from_opcode (xinsn, opcode, size);
-  orc_x86_insn_operand_set (&xinsn->operands[0], ORC_X86_INSN_OPERAND_TYPE_REG,
+  orc_x86_insn_operand_set (&xinsn->operands[0], ORC_X86_INSN_OPERAND_TYPE_OFF,
       opsize, srcdest);
   xinsn->offset = offset;
   xinsn->encoding = ORC_X86_INSN_ENCODING_M;
@@ -2428,9 +2497,14 @@ orc_x86_emit_label (OrcCompiler *p, int label)
 void
 orc_x86_emit_cpuinsn_comment (OrcCompiler *p, const char * format, ...)
 {
-  OrcX86Insn *xinsn = orc_x86_get_output_insn (p);
+  OrcX86Insn *xinsn;
   va_list varargs;
 
+  /* Comments only go to the assembly code */
+  if (!p->need_asm)
+    return;
+
+  xinsn = orc_x86_get_output_insn (p);
   xinsn->type = ORC_X86_INSN_TYPE_COMMENT;
   va_start (varargs, format);
   vsnprintf (xinsn->comment, 40 - 1, format, varargs);
@@ -2656,6 +2730,8 @@ orc_x86_insn_encoding_to_string (OrcX86InsnEncoding enc)
       return "RVMI";
     case ORC_X86_INSN_ENCODING_RVMR:
       return "RVMR";
+    case ORC_X86_INSN_ENCODING_RMV:
+      return "RMV";
     case ORC_X86_INSN_ENCODING_RR:
       return "RR";
     case ORC_X86_INSN_ENCODING_RVR:
@@ -298,6 +298,7 @@ typedef enum _OrcX86InsnOperands {
   ORC_X86_INSN_TYPE_REG16TO64_REGM8      = (ORC_X86_INSN_OPERAND_REG_REGM | ORC_X86_INSN_OPERAND_OP1_16TO64 | ORC_X86_INSN_OPERAND_OP2_8), /* For example MOVZX r32, r/m8 */
   ORC_X86_INSN_TYPE_REG64_MEM            = (ORC_X86_INSN_OPERAND_OP1_REG | ORC_X86_INSN_OPERAND_OP1_64 | ORC_X86_INSN_OPERAND_OP2_MEM), /* For example LEAQ r64, m */
   ORC_X86_INSN_TYPE_MEM32                = (ORC_X86_INSN_OPERAND_OP1_MEM | ORC_X86_INSN_OPERAND_OP1_32), /* For example LDMXCSR m32 */
+  ORC_X86_INSN_TYPE_MEM8                 = (ORC_X86_INSN_OPERAND_OP1_MEM | ORC_X86_INSN_OPERAND_OP1_8), /* For example PREFETCHT0 m8 */
   ORC_X86_INSN_TYPE_REG32_IMM32          = (ORC_X86_INSN_OPERAND_REG_IMM | ORC_X86_INSN_OPERAND_OP1_32 | ORC_X86_INSN_OPERAND_OP2_32), /* For example MOV r32, imm32 */
   ORC_X86_INSN_TYPE_REGM64_REG64         = (ORC_X86_INSN_OPERAND_REGM_REG | ORC_X86_INSN_OPERAND_OP1_64 | ORC_X86_INSN_OPERAND_OP2_64), /* For example MOV r/m64, r64 */
   ORC_X86_INSN_TYPE_REGM32_REG32         = (ORC_X86_INSN_OPERAND_REGM_REG | ORC_X86_INSN_OPERAND_OP1_32 | ORC_X86_INSN_OPERAND_OP2_32), /* For example MOV r/m32, r32 */
@@ -487,6 +488,10 @@ typedef enum _OrcX86OpcodeIdx {
   ORC_X86_endbr32,
   /* 80 */
   ORC_X86_mov_imm64_r,
+  ORC_X86_sfence,
+  ORC_X86_prefetchnta,
+  ORC_X86_prefetcht0,
+  ORC_X86_bts,
 } OrcX86OpcodeIdx;
 
 typedef enum _OrcX86InsnOperandType {
@@ -531,6 +536,7 @@ typedef enum _OrcX86InsnEncoding {
   ORC_X86_INSN_ENCODING_RVM,  /* VEX. For three operands, like VPSRLW xmm1, xmm2, xmm3/m128 */
   ORC_X86_INSN_ENCODING_RVMI, /* VEX. For four operands, like VPBLENDD xmm1, xmm2, xmm3/m128, imm8 */
   ORC_X86_INSN_ENCODING_RVMR, /* VEX. For four opeands using imm for a register like VBLENDVPD xmm1, xmm2, xmm3/m128, xmm4 */
+  ORC_X86_INSN_ENCODING_RMV,  /* VEX. For register, memory and register, like VPGATHERDD xmm1, vm32x, xmm2 */
   ORC_X86_INSN_ENCODING_RR,   /* VEX (AVX512). For two operands, like KMOVW k1, r32 */
   ORC_X86_INSN_ENCODING_RVR,  /* VEX (AVX512). For three operands, like KANDNW k1, k2, k3 */
   ORC_X86_INSN_ENCODING_RRI,  /* VEX (AVX512). For three operands, like KSHIFTLW k1, k2, imm8 */
@@ -644,6 +650,14 @@ ORC_API void orc_x86_emit_pop (OrcCompiler *compiler, int size, int reg);
 
 #define orc_x86_emit_rdtsc(p) \
   orc_x86_emit_cpuinsn_none (p, ORC_X86_rdtsc)
+#define orc_x86_emit_sfence(p) \
+  orc_x86_emit_cpuinsn_none (p, ORC_X86_sfence)
+#define orc_x86_emit_prefetchnta_memoffset(p,offset,reg) \
+  orc_x86_emit_cpuinsn_memoffset (p, ORC_X86_prefetchnta, 1, offset, reg)
+#define orc_x86_emit_prefetcht0_memoffset(p,offset,reg) \
+  orc_x86_emit_cpuinsn_memoffset (p, ORC_X86_prefetcht0, 1, offset, reg)
+#define orc_x86_emit_bts_reg_reg(p,size,src,dest) \
+  orc_x86_emit_cpuinsn_size (p, ORC_X86_bts, size, src, dest)
 #define orc_x86_emit_ret(p) \
   orc_x86_emit_cpuinsn_none (p, ((p)->is_64bit) ? ORC_X86_retq : ORC_X86_ret)
 
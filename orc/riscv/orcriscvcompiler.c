@@ -33,10 +33,12 @@
 #include <orc/orclimits.h>
 #include <orc/orcprogram.h>
 #include <orc/orcutils.h>
+#include <orc/orcutils-private.h>
 
 #include <orc/riscv/orcriscv-internal.h>
 #include <orc/riscv/orcriscv.h>
 #include <orc/riscv/orcriscvinsn.h>
+#include <stdlib.h>
 #include <string.h>
 
 typedef enum
@@ -120,11 +122,7 @@ orc_riscv_compiler_add_label (OrcCompiler *c, int label)
 void
 orc_riscv_compiler_add_fixup (OrcCompiler *c, int label)
 {
-  ORC_ASSERT (c->n_fixups < ORC_N_FIXUPS);
-  c->fixups[c->n_fixups].ptr = c->codeptr;
-  c->fixups[c->n_fixups].label = label;
-  c->fixups[c->n_fixups].type = 0;
-  c->n_fixups++;
+  orc_compiler_add_fixup (c, c->codeptr, label, 0);
 }
 
 static void
@@ -225,7 +223,7 @@ orc_riscv_compiler_bytes_to_sew (int bytes)
 static void
 orc_riscv_compiler_load_constants (OrcCompiler *c)
 {
-  for (int i = 0; i < ORC_N_COMPILER_VARIABLES; i++) {
+  for (int i = 0; i < c->n_vars; i++) {
     OrcVariable *var = c->vars + i;
     if (var->name == NULL)
       continue;
@@ -345,7 +343,7 @@ orc_riscv_compiler_emit_loop (OrcCompiler *c, OrcRiscvVtype vtype)
   orc_compiler_append_code (c, "/* loop tail */\n");
 
   for (int i = 0, length_shift = 0; i < 4; i++) {
-    for (int j = 0; j < ORC_N_COMPILER_VARIABLES; j++) {
+    for (int j = 0; j < c->n_vars; j++) {
       const OrcVariable *var = c->vars + j;
 
       if (var->size != 1 << i)
@@ -389,7 +387,7 @@ orc_riscv_compiler_compute_initial_vtype (OrcCompiler *c)
 static void
 orc_riscv_compiler_add_strides (OrcCompiler *c)
 {
-  for (int i = 0; i < ORC_N_COMPILER_VARIABLES; i++) {
+  for (int i = 0; i < c->n_vars; i++) {
     if (c->vars[i].name == NULL)
       continue;
     switch (c->vars[i].vartype) {
@@ -464,7 +462,7 @@ orc_riscv_compiler_emit_full_loop (OrcCompiler *c)
 static void
 orc_riscv_compiler_save_accumulators (OrcCompiler *c)
 {
-  for (int i = 0; i < ORC_N_COMPILER_VARIABLES; i++) {
+  for (int i = 0; i < c->n_vars; i++) {
     if (c->vars[i].vartype == ORC_VAR_TYPE_ACCUMULATOR) {
       const OrcRiscvSEW sew = orc_riscv_compiler_bytes_to_sew (c->vars[i].size);
       const OrcRiscvVtype vtype = orc_riscv_compiler_compute_vtype (c, sew, 0);
@@ -530,7 +528,7 @@ orc_riscv_compiler_get_temp_regs (OrcCompiler *c, OrcInstruction *insn,
   if (info->needs_mask_reg)
     used[ORC_RISCV_V0] = TRUE;
 
-  for (int i = 0; i < ORC_N_COMPILER_VARIABLES; i++) {
+  for (int i = 0; i < c->n_vars; i++) {
     if (c->vars[i].alloc < ORC_RISCV_V0 || c->vars[i].alloc > ORC_RISCV_V31)
       continue;
     if (c->vars[i].first_use != -1 &&
@@ -566,10 +564,10 @@ orc_riscv_compiler_var_priority_comp (const void *var_x, const void *var_y)
 static void
 orc_riscv_compiler_reallocate_registers (OrcCompiler *c)
 {
-  OrcVariable *vars[ORC_N_COMPILER_VARIABLES] = { NULL };
+  OrcVariable **vars = orc_malloc (sizeof (OrcVariable *) * c->n_vars);
 
   int n_vars = 0;
-  for (int i = 0; i < ORC_N_COMPILER_VARIABLES; i++)
+  for (int i = 0; i < c->n_vars; i++)
     if (c->vars[i].alloc >= ORC_RISCV_V0 && c->vars[i].alloc <= ORC_RISCV_V31)
       vars[n_vars++] = &c->vars[i];
 
@@ -614,6 +612,8 @@ orc_riscv_compiler_reallocate_registers (OrcCompiler *c)
       ORC_COMPILER_ERROR (c, "cannot allocate register for var %s",
           vars[i]->name);
   }
+
+  free (vars);
 }
 
 static void
@@ -621,14 +621,14 @@ orc_riscv_compiler_compute_loop_shift (OrcCompiler *c)
 {
   OrcRiscvLMUL lmul = ORC_RISCV_LMUL_8;
 
-  for (OrcVariable * x = c->vars; x < c->vars + ORC_N_COMPILER_VARIABLES; x++) {
+  for (OrcVariable * x = c->vars; x < c->vars + c->n_vars; x++) {
     if (x->alloc < ORC_RISCV_V0 || x->alloc > ORC_RISCV_V31)
       continue;
 
     while ((x->alloc - ORC_RISCV_V0) & ((1 << lmul) - 1))
       lmul--;
 
-    for (OrcVariable * y = c->vars; y < c->vars + ORC_N_COMPILER_VARIABLES; y++) {
+    for (OrcVariable * y = c->vars; y < c->vars + c->n_vars; y++) {
       if (y->alloc <= x->alloc || y->alloc > ORC_RISCV_V31)
         continue;
 
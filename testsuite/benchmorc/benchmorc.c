@@ -1,10 +1,39 @@
+#include "config.h"
+
+#define ORC_ENABLE_UNSTABLE_API
 
 #include <orc/orc.h>
 #include <orc-test/orctest.h>
+#include <orc-test/orcarray.h>
+#include <orc-test/orcrandom.h>
 #include <orc/orcparse.h>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+
+/* benchmorc runs every program of an .orc file for a range of sizes, with
+ * aligned and misaligned arrays, on every executable target and subset of
+ * its instruction set flags, on the emulator and on the backup function
+ * when the program has one. Each configuration is warmed up, then timed
+ * in batches long enough to hide the cost of reading the timestamp
+ * counter, and the median over all batches is reported together with the
+ * minimum and the median absolute deviation. Results are printed as a
+ * table, as CSV or as JSON for tracking regressions between releases. */
+
+#define BENCH_MAX_SIZES 32
+#define BENCH_MAX_VARIANTS 64
+#define BENCH_MAX_SAMPLES 1000
+/* Shortest batch of runs, in seconds */
+#define BENCH_MIN_BATCH_TIME 20e-6
 
 static char * read_file (const char *filename);
 void output_code (OrcProgram *p, FILE *output);
@@ -18,6 +47,596 @@ double weights_feathers[];
 /* double weights_preston[]; */
 double weights_n900[];
 
+typedef enum {
+  BENCH_FORMAT_TEXT,
+  BENCH_FORMAT_CSV,
+  BENCH_FORMAT_JSON
+} BenchFormat;
+
+typedef enum {
+  BENCH_MODE_COMPILED,
+  BENCH_MODE_EMULATE,
+  BENCH_MODE_BACKUP
+} BenchMode;
+
+typedef struct _BenchVariant BenchVariant;
+struct _BenchVariant {
+  BenchMode mode;
+  OrcTarget *target;
+  unsigned int flags;
+  const char *name;
+  char flags_name[256];
+};
+
+typedef struct _BenchResult BenchResult;
+struct _BenchResult {
+  int n;
+  int m;
+  int misaligned;
+  int bytes_per_element;
+  int n_samples;
+  /* in cycles per element */
+  double median;
+  double min;
+  double mad;
+  double gb_per_s;
+};
+
+typedef struct _BenchOptions BenchOptions;
+struct _BenchOptions {
+  BenchFormat format;
+  FILE *output;
+  int sizes[BENCH_MAX_SIZES];
+  int n_sizes;
+  int heights[BENCH_MAX_SIZES];
+  int n_heights;
+  const char *targets;
+  const char *programs;
+  orc_bool flag_subsets;
+  orc_bool misaligned;
+  int warmup;
+  int min_samples;
+  double min_time;
+};
+
+static BenchOptions opts;
+static OrcRandomContext bench_random;
+static double bench_tick_rate;
+static int bench_n_results;
+
+static orc_uint64
+bench_stamp (void)
+{
+#if defined(__GNUC__) && (defined(HAVE_I386) || defined(HAVE_AMD64))
+  orc_uint32 lo, hi;
+
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((orc_uint64) hi << 32) | lo;
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+  return __rdtsc ();
+#elif defined(__GNUC__) && defined(HAVE_AARCH64)
+  orc_uint64 ts;
+
+  __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (ts));
+  return ts;
+#elif defined(_WIN32)
+  LARGE_INTEGER pc;
+
+  QueryPerformanceCounter (&pc);
+  return pc.QuadPart;
+#else
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (orc_uint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static double
+bench_wall_time (void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER pf, pc;
+
+  QueryPerformanceFrequency (&pf);
+  QueryPerformanceCounter (&pc);
+  return (double) pc.QuadPart / pf.QuadPart;
+#else
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+/* Number of timestamp ticks per second, needed for GB/s */
+static double
+bench_calibrate (void)
+{
+  orc_uint64 start_ticks, end_ticks;
+  double start, end;
+
+  start = bench_wall_time ();
+  start_ticks = bench_stamp ();
+  do {
+    end = bench_wall_time ();
+  } while (end - start < 0.05);
+  end_ticks = bench_stamp ();
+
+  return (end_ticks - start_ticks) / (end - start);
+}
+
+static orc_bool
+bench_name_in_list (const char *name, const char *list)
+{
+  int len = strlen (name);
+  const char *s = list;
+
+  if (list == NULL)
+    return TRUE;
+
+  while (*s) {
+    const char *end = strchr (s, ',');
+    int l = end ? end - s : (int) strlen (s);
+
+    if (l == len && strncmp (s, name, len) == 0)
+      return TRUE;
+    if (end == NULL)
+      break;
+    s = end + 1;
+  }
+
+  return FALSE;
+}
+
+static int
+bench_parse_list (const char *s, int *values, int max)
+{
+  int n = 0;
+  char *end;
+
+  while (*s && n < max) {
+    values[n] = strtol (s, &end, 0);
+    if (end == s || values[n] <= 0)
+      return 0;
+    n++;
+    if (*end != ',')
+      break;
+    s = end + 1;
+  }
+
+  return n;
+}
+
+static int
+bench_compare_double (const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+static double
+bench_median (double *values, int n)
+{
+  qsort (values, n, sizeof (double), bench_compare_double);
+  if (n & 1)
+    return values[n / 2];
+  return 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+static void
+bench_flags_name (OrcTarget *target, unsigned int flags, char *s, int len)
+{
+  int i;
+
+  s[0] = 0;
+  for (i = 0; i < 32; i++) {
+    const char *name;
+
+    if (!(flags & (1U << i)))
+      continue;
+    name = orc_target_get_flag_name (target, i);
+    if (name == NULL || name[0] == 0)
+      continue;
+    if (s[0])
+      strncat (s, ",", len - strlen (s) - 1);
+    strncat (s, name, len - strlen (s) - 1);
+  }
+}
+
+static orc_bool
+bench_is_isa_flag (OrcTarget *target, int shift)
+{
+  const char *name = orc_target_get_flag_name (target, shift);
+
+  /* The base instruction set and the flags that only change code
+   * generation are kept in every subset */
+  if (name == NULL || name[0] == 0)
+    return FALSE;
+  if (strcmp (name, orc_target_get_name (target)) == 0)
+    return FALSE;
+  if (strcmp (name, "frame_pointer") == 0 ||
+      strcmp (name, "short_jumps") == 0 || strcmp (name, "64bit") == 0)
+    return FALSE;
+  return TRUE;
+}
+
+static int
+bench_add_variant (BenchVariant *variants, int n_variants, BenchMode mode,
+    OrcTarget *target, unsigned int flags, const char *name)
+{
+  BenchVariant *v;
+
+  if (n_variants >= BENCH_MAX_VARIANTS)
+    return n_variants;
+
+  v = variants + n_variants;
+  v->mode = mode;
+  v->target = target;
+  v->flags = flags;
+  v->name = name;
+  v->flags_name[0] = 0;
+  if (target)
+    bench_flags_name (target, flags, v->flags_name, sizeof (v->flags_name));
+
+  return n_variants + 1;
+}
+
+/* Every executable target with its default flags and, for flag subsets,
+ * with its instruction set extensions removed one by one starting with
+ * the newest */
+static int
+bench_get_variants (BenchVariant *variants)
+{
+  int n_variants = 0;
+  int i, j;
+
+  if (bench_name_in_list ("backup", opts.targets))
+    n_variants = bench_add_variant (variants, n_variants, BENCH_MODE_BACKUP,
+        NULL, 0, "backup");
+  if (bench_name_in_list ("emulate", opts.targets))
+    n_variants = bench_add_variant (variants, n_variants, BENCH_MODE_EMULATE,
+        NULL, 0, "emulate");
+
+  for (i = 0; i < orc_target_n_get (); i++) {
+    OrcTarget *target = orc_target_get_by_idx (i);
+    const char *name = orc_target_get_name (target);
+    unsigned int flags;
+
+    if (!orc_target_is_executable (target))
+      continue;
+    if (!bench_name_in_list (name, opts.targets))
+      continue;
+
+    flags = orc_target_get_default_flags (target);
+    n_variants = bench_add_variant (variants, n_variants, BENCH_MODE_COMPILED,
+        target, flags, name);
+    if (!opts.flag_subsets)
+      continue;
+
+    for (j = 31; j >= 0; j--) {
+      if (!(flags & (1U << j)) || !bench_is_isa_flag (target, j))
+        continue;
+      flags &= ~(1U << j);
+      n_variants = bench_add_variant (variants, n_variants,
+          BENCH_MODE_COMPILED, target, flags, name);
+    }
+  }
+
+  return n_variants;
+}
+
+static void
+bench_output_header (void)
+{
+  FILE *f = opts.output;
+
+  switch (opts.format) {
+    case BENCH_FORMAT_TEXT:
+      fprintf (f, "# orc %s, %.0f ticks/s\n", orc_version_string (),
+          bench_tick_rate);
+      fprintf (f, "%-40s %-8s %7s %4s %3s %10s %10s %7s %8s  %s\n",
+          "program", "target", "n", "m", "mis", "cyc/elem", "min", "mad",
+          "GB/s", "flags");
+      break;
+    case BENCH_FORMAT_CSV:
+      fprintf (f, "program,target,flags,n,m,misaligned,bytes_per_element,"
+          "samples,cycles_per_element,cycles_per_element_min,"
+          "cycles_per_element_mad,gb_per_s\n");
+      break;
+    case BENCH_FORMAT_JSON:
+      fprintf (f, "{\n  \"orc_version\": \"%s\",\n", orc_version_string ());
+      fprintf (f, "  \"tick_rate\": %.0f,\n  \"results\": [", bench_tick_rate);
+      break;
+  }
+}
+
+static void
+bench_output_result (OrcProgram *p, BenchVariant *v, BenchResult *r)
+{
+  FILE *f = opts.output;
+
+  switch (opts.format) {
+    case BENCH_FORMAT_TEXT:
+      fprintf (f, "%-40s %-8s %7d %4d %3s %10.3f %10.3f %6.1f%% %8.2f  %s\n",
+          p->name, v->name, r->n, r->m, r->misaligned ? "yes" : "no",
+          r->median, r->min,
+          r->median > 0 ? 100.0 * r->mad / r->median : 0.0, r->gb_per_s,
+          v->flags_name);
+      break;
+    case BENCH_FORMAT_CSV:
+      fprintf (f, "%s,%s,\"%s\",%d,%d,%d,%d,%d,%g,%g,%g,%g\n",
+          p->name, v->name, v->flags_name, r->n, r->m, r->misaligned,
+          r->bytes_per_element, r->n_samples, r->median, r->min, r->mad,
+          r->gb_per_s);
+      break;
+    case BENCH_FORMAT_JSON:
+      fprintf (f, "%s\n    {\"program\": \"%s\", \"target\": \"%s\", "
+          "\"flags\": \"%s\", \"n\": %d, \"m\": %d, \"misaligned\": %s, "
+          "\"bytes_per_element\": %d, \"samples\": %d, "
+          "\"cycles_per_element\": %g, \"cycles_per_element_min\": %g, "
+          "\"cycles_per_element_mad\": %g, \"gb_per_s\": %g}",
+          bench_n_results ? "," : "", p->name, v->name, v->flags_name,
+          r->n, r->m, r->misaligned ? "true" : "false",
+          r->bytes_per_element, r->n_samples, r->median, r->min, r->mad,
+          r->gb_per_s);
+      break;
+  }
+  bench_n_results++;
+}
+
+static void
+bench_output_footer (void)
+{
+  if (opts.format == BENCH_FORMAT_JSON)
+    fprintf (opts.output, "\n  ]\n}\n");
+}
+
+static void
+bench_setup_executor (OrcExecutor *ex, OrcProgram *p, OrcArray **arrays,
+    int n, int m)
+{
+  int i;
+
+  orc_executor_set_n (ex, n);
+  orc_executor_set_m (ex, m);
+  for (i = ORC_VAR_D1; i <= ORC_VAR_S8; i++) {
+    if (arrays[i] == NULL)
+      continue;
+    orc_executor_set_array (ex, i, arrays[i]->data);
+    orc_executor_set_stride (ex, i, arrays[i]->stride);
+  }
+}
+
+static void
+bench_run (OrcExecutor *ex, OrcProgram *p, OrcArray **arrays, int n, int m,
+    BenchMode mode, int reps)
+{
+  int i;
+
+  for (i = 0; i < reps; i++) {
+    /* 2D code advances the array pointers of the executor */
+    if (m > 1)
+      bench_setup_executor (ex, p, arrays, n, m);
+    /* Call the code directly, like the functions generated by orcc */
+    if (mode == BENCH_MODE_BACKUP) {
+      ((OrcExecutorFunc) p->backup_func) (ex);
+    } else {
+      ((OrcExecutorFunc) p->code_exec) (ex);
+    }
+  }
+}
+
+static orc_bool
+bench_variant (OrcProgram *p, BenchVariant *v, OrcArray **arrays,
+    BenchResult *r)
+{
+  double samples[BENCH_MAX_SAMPLES];
+  double deviations[BENCH_MAX_SAMPLES];
+  OrcCompileResult result;
+  OrcExecutor *ex;
+  orc_uint64 start, ticks;
+  orc_uint64 min_ticks;
+  double elapsed;
+  int n_elements = r->n * r->m;
+  int reps;
+  int i;
+
+  switch (v->mode) {
+    case BENCH_MODE_BACKUP:
+      if (p->backup_func == NULL)
+        return FALSE;
+      break;
+    case BENCH_MODE_EMULATE:
+      result = orc_program_compile_full (p, NULL, 0);
+      if (ORC_COMPILE_RESULT_IS_FATAL (result))
+        return FALSE;
+      break;
+    case BENCH_MODE_COMPILED:
+      result = orc_program_compile_full (p, v->target, v->flags);
+      if (!ORC_COMPILE_RESULT_IS_SUCCESSFUL (result)) {
+        orc_program_reset (p);
+        return FALSE;
+      }
+      break;
+  }
+
+  ex = orc_executor_new (p);
+  for (i = 0; i < ORC_N_VARIABLES; i++) {
+    if (p->vars[i].vartype != ORC_VAR_TYPE_PARAM)
+      continue;
+    switch (p->vars[i].param_type) {
+      case ORC_PARAM_TYPE_FLOAT:
+        orc_executor_set_param_float (ex, i, 1.0f);
+        break;
+      case ORC_PARAM_TYPE_DOUBLE:
+        orc_executor_set_param_double (ex, i, 1.0);
+        break;
+      case ORC_PARAM_TYPE_INT64:
+        orc_executor_set_param_int64 (ex, i, 2);
+        break;
+      default:
+        orc_executor_set_param (ex, i, 2);
+        break;
+    }
+  }
+  bench_setup_executor (ex, p, arrays, r->n, r->m);
+
+  for (i = 0; i < opts.warmup; i++)
+    bench_run (ex, p, arrays, r->n, r->m, v->mode, 1);
+
+  /* Batch enough runs that a sample is much longer than a timestamp */
+  min_ticks = BENCH_MIN_BATCH_TIME * bench_tick_rate;
+  for (reps = 1; reps < (1 << 20); reps *= 2) {
+    start = bench_stamp ();
+    bench_run (ex, p, arrays, r->n, r->m, v->mode, reps);
+    if (bench_stamp () - start >= min_ticks)
+      break;
+  }
+
+  r->n_samples = 0;
+  elapsed = 0;
+  while (r->n_samples < BENCH_MAX_SAMPLES &&
+      (r->n_samples < opts.min_samples || elapsed < opts.min_time)) {
+    start = bench_stamp ();
+    bench_run (ex, p, arrays, r->n, r->m, v->mode, reps);
+    ticks = bench_stamp () - start;
+
+    samples[r->n_samples++] = (double) ticks / reps / n_elements;
+    elapsed += ticks / bench_tick_rate;
+  }
+
+  orc_executor_free (ex);
+  orc_program_reset (p);
+
+  r->median = bench_median (samples, r->n_samples);
+  r->min = samples[0];
+  for (i = 0; i < r->n_samples; i++) {
+    double d = samples[i] - r->median;
+    deviations[i] = d < 0 ? -d : d;
+  }
+  r->mad = bench_median (deviations, r->n_samples);
+  r->gb_per_s = 0;
+  if (r->median > 0)
+    r->gb_per_s = r->bytes_per_element * bench_tick_rate / r->median / 1e9;
+
+  return TRUE;
+}
+
+static void
+bench_program (OrcProgram *p, BenchVariant *variants, int n_variants)
+{
+  OrcArray *arrays[ORC_N_VARIABLES];
+  BenchResult r;
+  int bytes_per_element = 0;
+  int i, j, k, misaligned, v;
+
+  for (i = ORC_VAR_D1; i <= ORC_VAR_S8; i++) {
+    if (p->vars[i].size > 0)
+      bytes_per_element += p->vars[i].size;
+  }
+
+  for (i = 0; i < opts.n_sizes; i++) {
+    int n = p->constant_n > 0 ? p->constant_n : opts.sizes[i];
+
+    for (j = 0; j < (p->is_2d ? opts.n_heights : 1); j++) {
+      int m = 1;
+
+      if (p->is_2d)
+        m = p->constant_m > 0 ? p->constant_m : opts.heights[j];
+
+      for (misaligned = 0; misaligned <= opts.misaligned; misaligned++) {
+        memset (arrays, 0, sizeof (arrays));
+        for (k = ORC_VAR_D1; k <= ORC_VAR_S8; k++) {
+          if (p->vars[k].size == 0)
+            continue;
+          arrays[k] = orc_array_new (n, m, p->vars[k].size,
+              misaligned ? k - ORC_VAR_D1 + 1 : 0, p->vars[k].alignment);
+          orc_array_set_random (arrays[k], &bench_random);
+          /* Keep float data away from denormals and special values */
+          orc_array_set_pattern_2 (arrays[k], &bench_random,
+              ORC_PATTERN_FLOAT_SMALL);
+        }
+
+        for (v = 0; v < n_variants; v++) {
+          memset (&r, 0, sizeof (r));
+          r.n = n;
+          r.m = m;
+          r.misaligned = misaligned;
+          r.bytes_per_element = bytes_per_element;
+          if (bench_variant (p, variants + v, arrays, &r))
+            bench_output_result (p, variants + v, &r);
+        }
+
+        for (k = ORC_VAR_D1; k <= ORC_VAR_S8; k++) {
+          if (arrays[k])
+            orc_array_free (arrays[k]);
+        }
+      }
+
+      if (p->constant_m > 0)
+        break;
+    }
+
+    if (p->constant_n > 0)
+      break;
+  }
+}
+
+/* The weighted score benchmorc used to print, kept for comparing with
+ * old numbers */
+static void
+bench_score (OrcProgram **programs, int n)
+{
+  double sum;
+  int i;
+
+  sum = 0;
+  for(i=0;i<n;i++){
+    double perf;
+    double weight;
+
+    perf = orc_test_performance_full (programs[i], 0, NULL);
+    /* weight = weights_ginger[i]; */
+    weight = weights_feathers[i];
+    /* weight = weights_n900[i]; */
+
+    sum += weight * perf;
+  }
+  printf("score %g\n", 100.0/sum);
+}
+
+static void
+help (void)
+{
+  printf("Usage:\n");
+  printf("  benchmorc [OPTION...] [FILE]\n");
+  printf("\n");
+  printf("Benchmarks the programs in FILE, bench10.orc by default.\n");
+  printf("\n");
+  printf("Options:\n");
+  printf("  -h, --help              Show help options\n");
+  printf("  -o, --output FILE       Write results to FILE\n");
+  printf("  --format FORMAT         Output format: text, csv or json\n");
+  printf("  --sizes N,...           Values of n (default 16,256,4096,65536)\n");
+  printf("  --heights M,...         Values of m for 2D programs (default 16)\n");
+  printf("  --targets NAME,...      Targets to run, including backup and emulate\n");
+  printf("  --programs NAME,...     Programs to run (default all)\n");
+  printf("  --no-flag-subsets       Only use the default flags of each target\n");
+  printf("  --no-misaligned         Only use aligned arrays\n");
+  printf("  --warmup N              Runs before timing (default 3)\n");
+  printf("  --min-samples N         Minimum number of samples (default 10)\n");
+  printf("  --min-time MS           Minimum time per configuration (default 2)\n");
+  printf("  --quick                 Same as --sizes 1000 --no-flag-subsets\n");
+  printf("                          --no-misaligned --min-samples 5\n");
+  printf("  --score                 Only print the weighted score of bench10.orc\n");
+  printf("\n");
+
+  exit (0);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -25,8 +644,11 @@ main (int argc, char *argv[])
   int n;
   int i;
   OrcProgram **programs;
+  BenchVariant variants[BENCH_MAX_VARIANTS];
+  int n_variants;
   const char *filename = NULL;
-  double sum;
+  const char *output_file = NULL;
+  orc_bool score = FALSE;
 
   orc_init ();
   orc_test_init ();
@@ -36,6 +658,70 @@ main (int argc, char *argv[])
 #else
   filename = "bench10.orc";
 #endif
+
+  opts.format = BENCH_FORMAT_TEXT;
+  opts.n_sizes = bench_parse_list ("16,256,4096,65536", opts.sizes,
+      BENCH_MAX_SIZES);
+  opts.n_heights = bench_parse_list ("16", opts.heights, BENCH_MAX_SIZES);
+  opts.flag_subsets = TRUE;
+  opts.misaligned = TRUE;
+  opts.warmup = 3;
+  opts.min_samples = 10;
+  opts.min_time = 2e-3;
+
+  for(i=1;i<argc;i++){
+    if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+      help();
+    } else if ((strcmp(argv[i], "--output") == 0 ||
+          strcmp(argv[i], "-o") == 0) && i + 1 < argc) {
+      output_file = argv[++i];
+    } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+      i++;
+      if (strcmp(argv[i], "text") == 0) {
+        opts.format = BENCH_FORMAT_TEXT;
+      } else if (strcmp(argv[i], "csv") == 0) {
+        opts.format = BENCH_FORMAT_CSV;
+      } else if (strcmp(argv[i], "json") == 0) {
+        opts.format = BENCH_FORMAT_JSON;
+      } else {
+        help();
+      }
+    } else if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+      opts.n_sizes = bench_parse_list (argv[++i], opts.sizes, BENCH_MAX_SIZES);
+      if (opts.n_sizes == 0) help();
+    } else if (strcmp(argv[i], "--heights") == 0 && i + 1 < argc) {
+      opts.n_heights = bench_parse_list (argv[++i], opts.heights,
+          BENCH_MAX_SIZES);
+      if (opts.n_heights == 0) help();
+    } else if (strcmp(argv[i], "--targets") == 0 && i + 1 < argc) {
+      opts.targets = argv[++i];
+    } else if (strcmp(argv[i], "--programs") == 0 && i + 1 < argc) {
+      opts.programs = argv[++i];
+    } else if (strcmp(argv[i], "--no-flag-subsets") == 0) {
+      opts.flag_subsets = FALSE;
+    } else if (strcmp(argv[i], "--no-misaligned") == 0) {
+      opts.misaligned = FALSE;
+    } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+      opts.warmup = strtol (argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--min-samples") == 0 && i + 1 < argc) {
+      opts.min_samples = ORC_CLAMP (strtol (argv[++i], NULL, 0), 1,
+          BENCH_MAX_SAMPLES);
+    } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+      opts.min_time = strtod (argv[++i], NULL) * 1e-3;
+    } else if (strcmp(argv[i], "--quick") == 0) {
+      opts.n_sizes = bench_parse_list ("1000", opts.sizes, BENCH_MAX_SIZES);
+      opts.flag_subsets = FALSE;
+      opts.misaligned = FALSE;
+      opts.min_samples = 5;
+    } else if (strcmp(argv[i], "--score") == 0) {
+      score = TRUE;
+    } else if (argv[i][0] != '-') {
+      filename = argv[i];
+    } else {
+      help();
+    }
+  }
+
   code = read_file (filename);
   if (!code) {
     printf("benchmorc needs bench10.orc file in current directory\n");
@@ -45,46 +731,44 @@ main (int argc, char *argv[])
   n = orc_parse (code, &programs);
   free (code);
 
-#if 0
-  sum = 0;
-  for(i=0;i<n;i++){
-    double perf;
-    double weight;
+  if (score) {
+    bench_score (programs, n);
+  } else {
+    opts.output = stdout;
+    if (output_file) {
+      opts.output = fopen (output_file, "w");
+      if (opts.output == NULL) {
+        printf("could not open %s\n", output_file);
+        exit(1);
+      }
+    }
 
-    perf = orc_test_performance_full (programs[i], 0, NULL);
+    orc_random_init (&bench_random, 0x12345678);
+    bench_tick_rate = bench_calibrate ();
+    n_variants = bench_get_variants (variants);
 
-    if (perf == 0) {
-      weight = 0;
-    } else {
-      weight = 1.0/perf/281.0;
-      sum++;
+    bench_output_header ();
+    for(i=0;i<n;i++){
+      if (bench_name_in_list (programs[i]->name, opts.programs))
+        bench_program (programs[i], variants, n_variants);
     }
-    printf(" %g, /* %s */\n", weight, programs[i]->name);
-  }
-  printf("sum = %g\n", sum);
-#else
-  sum = 0;
-  for(i=0;i<n;i++){
-    double perf;
-    double weight;
+    bench_output_footer ();
 
-    perf = orc_test_performance_full (programs[i], 0, NULL);
-    /* weight = weights_ginger[i]; */
-    weight = weights_feathers[i];
-    /* weight = weights_n900[i]; */
+    if (opts.output != stdout)
+      fclose (opts.output);
+  }
 
-    sum += weight * perf;
+  for(i=0;i<n;i++){
     orc_program_free (programs[i]);
   }
   free (programs);
-  printf("score %g\n", 100.0/sum);
-#endif
 
   if (error) return 1;
   return 0;
 }
 
 
+
 static char *
 read_file (const char *filename)
 {
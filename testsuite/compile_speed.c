@@ -0,0 +1,77 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ORC_ENABLE_UNSTABLE_API
+
+#include <orc/orc.h>
+#include <orc-test/orctest.h>
+#include <orc/orcparse.h>
+
+#include "common.h"
+
+#define N_ROUNDS 100
+#define SMALL_PROGRAM 10
+
+/* Measures how long it takes to compile the programs of a file for
+ * every target, for the programs that are created at run time */
+int
+main (int argc, char *argv[])
+{
+  OrcProgram **programs;
+  char *code;
+  int i, j, k, n, s;
+  const char *filename = NULL;
+
+  orc_init ();
+
+  if (argc >= 2) {
+    filename = argv[1];
+  }
+
+  code = read_file (filename);
+  if (!code) {
+    printf ("compile_speed <file.orc>\n");
+    exit (1);
+  }
+
+  s = orc_parse (code, &programs);
+  n = orc_target_n_get ();
+
+  printf ("%-10s %12s %12s\n", "target", "all (us)", "small (us)");
+  for (j = 0; j < n; j++) {
+    OrcTarget *t = orc_target_get_by_idx (j);
+    unsigned int flags = orc_target_get_default_flags (t);
+    double all = 0, small = 0;
+    int n_small = 0;
+
+    for (i = 0; i < s; i++) {
+      OrcProgram *p = programs[i];
+      clock_t start;
+      double elapsed;
+
+      start = clock ();
+      for (k = 0; k < N_ROUNDS; k++)
+        orc_program_compile_full (p, t, flags);
+      elapsed = (double) (clock () - start) / CLOCKS_PER_SEC / N_ROUNDS;
+
+      all += elapsed;
+      if (p->n_insns <= SMALL_PROGRAM) {
+        small += elapsed;
+        n_small++;
+      }
+    }
+
+    printf ("%-10s %12.1f %12.1f\n", orc_target_get_name (t),
+        all / s * 1e6, n_small ? small / n_small * 1e6 : 0);
+  }
+
+  for (i = 0; i < s; i++)
+    orc_program_free (programs[i]);
+  free (programs);
+  free (code);
+
+  return 0;
+}
@@ -55,6 +55,49 @@ add_constant (OrcProgram *program, int size, const char *name)
   return orc_program_add_constant (program, size, 0, name);
 }
 
+/* Programs are not limited to ORC_N_INSNS instructions, and the compiler
+ * needs more than ORC_N_COMPILER_VARIABLES variables for this one */
+static void
+test_long_program (int n_insns)
+{
+  OrcProgram *p;
+  int i;
+
+  p = orc_program_new ();
+  orc_program_add_destination (p, 2, "d1");
+  orc_program_add_source (p, 2, "s1");
+  orc_program_add_source (p, 2, "s2");
+  orc_program_add_parameter (p, 2, "p1");
+  orc_program_add_constant (p, 2, 3, "c1");
+  orc_program_add_temporary (p, 2, "t1");
+  orc_program_add_temporary (p, 2, "t2");
+
+  orc_program_append_str (p, "addw", "t1", "s1", "s2");
+  orc_program_append_str (p, "subw", "t2", "s1", "s2");
+  for (i = 0; i < n_insns; i++) {
+    switch (i % 4) {
+      case 0:
+        orc_program_append_str (p, "mullw", "t1", "t1", "c1");
+        break;
+      case 1:
+        orc_program_append_str (p, "addw", "t2", "t2", "t1");
+        break;
+      case 2:
+        orc_program_append_str (p, "xorw", "t1", "t1", "p1");
+        break;
+      case 3:
+        orc_program_append_str (p, "subw", "t2", "t2", "s1");
+        break;
+    }
+  }
+  orc_program_append_str (p, "addw", "d1", "t1", "t2");
+
+  if (orc_test_compare_output_full (p, 0) == ORC_TEST_FAILED)
+    error = TRUE;
+
+  orc_program_free (p);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -68,6 +111,8 @@ main (int argc, char *argv[])
   test_simple (ORC_MAX_PARAM_VARS, orc_program_add_parameter);
   test_simple (ORC_MAX_ACCUM_VARS, orc_program_add_accumulator);
 
+  test_long_program (4 * ORC_N_INSNS);
+
   if (error) return 1;
   return 0;
 }
@@ -0,0 +1,201 @@
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ORC_ENABLE_UNSTABLE_API
+
+#include <orc/orc.h>
+#include <orc/orcparse.h>
+#include <orc-test/orctest.h>
+
+#define N 300
+#define M 256
+
+static int error = FALSE;
+
+static union {
+  orc_uint64 align;
+  orc_uint8 data[8 * N * M + 64];
+} src;
+
+/* Every kind of accumulator, fed straight from a source and from a temp,
+ * with a split accumulator and on 2D arrays */
+static const char *source =
+    ".function acc_maxub\n"
+    ".accumulator 1 a1\n.source 1 s1\n"
+    "accmaxub a1, s1\n"
+    "\n"
+    ".function acc_minub\n"
+    ".accumulator 1 a1\n.source 1 s1\n"
+    "accminub a1, s1\n"
+    "\n"
+    ".function acc_maxsw\n"
+    ".accumulator 2 a1\n.source 2 s1\n"
+    "accmaxsw a1, s1\n"
+    "\n"
+    ".function acc_minsw\n"
+    ".accumulator 2 a1\n.source 2 s1\n"
+    "accminsw a1, s1\n"
+    "\n"
+    ".function acc_orl\n"
+    ".accumulator 4 a1\n.source 4 s1\n"
+    "accorl a1, s1\n"
+    "\n"
+    ".function acc_andl\n"
+    ".accumulator 4 a1\n.source 4 s1\n"
+    "accandl a1, s1\n"
+    "\n"
+    ".function acc_q\n"
+    ".accumulator 8 a1\n.source 8 s1\n"
+    "accq a1, s1\n"
+    "\n"
+    ".function acc_f\n"
+    ".accumulator 4 a1\n.source 4 s1\n"
+    "accf a1, s1\n"
+    "\n"
+    ".function acc_d\n"
+    ".accumulator 8 a1\n.source 8 s1\n"
+    "accd a1, s1\n"
+    "\n"
+    ".function acc_minsw_convubw\n"
+    ".accumulator 2 a1\n.source 1 s1\n.temp 2 t1\n"
+    "convubw t1, s1\n"
+    "accminsw a1, t1\n"
+    "\n"
+    ".function acc_maxsw_unroll4\n"
+    ".flags unroll 4\n"
+    ".accumulator 2 a1\n.source 2 s1\n"
+    "accmaxsw a1, s1\n"
+    "\n"
+    ".function acc_andl_2d\n"
+    ".flags 2d\n"
+    ".accumulator 4 a1\n.source 4 s1\n"
+    "accandl a1, s1\n";
+
+static orc_uint64
+get_accumulator (OrcProgram *p, OrcExecutor *ex)
+{
+  if (p->vars[ORC_VAR_A1].size == 8)
+    return orc_executor_get_accumulator_int64 (ex, ORC_VAR_A1);
+  return (orc_uint32) orc_executor_get_accumulator (ex, ORC_VAR_A1);
+}
+
+static void
+check (OrcProgram *p, int n, int m, int offset)
+{
+  int size = p->vars[ORC_VAR_S1].size;
+  OrcExecutor *ex;
+  orc_uint64 acc[3];
+
+  ex = orc_executor_new (p);
+  orc_executor_set_n (ex, n);
+  orc_executor_set_m (ex, m);
+  orc_executor_set_stride (ex, ORC_VAR_S1, size * N);
+
+  /* 2D code moves the array pointers of the executor along the rows */
+  orc_executor_set_array (ex, ORC_VAR_S1, src.data + offset * size);
+  orc_executor_emulate (ex);
+  acc[0] = get_accumulator (p, ex);
+  orc_executor_set_array (ex, ORC_VAR_S1, src.data + offset * size);
+  orc_executor_run (ex);
+  acc[1] = get_accumulator (p, ex);
+  /* The tiles of 2D programs are combined like the chunks of the
+   * emulation */
+  orc_executor_set_array (ex, ORC_VAR_S1, src.data + offset * size);
+  orc_executor_run_parallel (ex, 4);
+  acc[2] = get_accumulator (p, ex);
+  orc_executor_free (ex);
+
+  if (acc[0] != acc[1] || acc[0] != acc[2]) {
+    printf ("%s: n %d m %d offset %d: %" PRIx64 " %" PRIx64 " %" PRIx64 "\n",
+        orc_program_get_name (p), n, m, offset, acc[0], acc[1], acc[2]);
+    error = TRUE;
+  }
+}
+
+static void
+fill (OrcProgram *p)
+{
+  const char *name = orc_program_get_name (p);
+  int i;
+
+  /* Sums of small multiples of 1/8 are exact in any order */
+  if (strcmp (name, "acc_f") == 0) {
+    float *f = (float *) src.data;
+    for (i = 0; i < sizeof (src.data) / 4; i++)
+      f[i] = (rand () % 2001 - 1000) / 8.0f;
+  } else if (strcmp (name, "acc_d") == 0) {
+    double *d = (double *) src.data;
+    for (i = 0; i < sizeof (src.data) / 8; i++)
+      d[i] = (rand () % 2001 - 1000) / 8.0;
+  } else if (strcmp (name, "acc_orl") == 0) {
+    /* Sparse bits, so that the result depends on every element */
+    orc_uint32 *l = (orc_uint32 *) src.data;
+    for (i = 0; i < sizeof (src.data) / 4; i++)
+      l[i] = 1u << (rand () % 32) & 1u << (rand () % 32);
+  } else if (strcmp (name, "acc_andl") == 0 ||
+      strcmp (name, "acc_andl_2d") == 0) {
+    orc_uint32 *l = (orc_uint32 *) src.data;
+    for (i = 0; i < sizeof (src.data) / 4; i++)
+      l[i] = ~(1u << (rand () % 32) & 1u << (rand () % 32));
+  } else {
+    for (i = 0; i < sizeof (src.data); i++)
+      src.data[i] = rand ();
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  OrcProgram **programs = NULL;
+  int n_programs;
+  int i, n, offset;
+
+  orc_init ();
+  orc_test_init ();
+
+  n_programs = orc_parse (source, &programs);
+  if (n_programs != 12) {
+    printf ("parsed %d programs\n", n_programs);
+    return 1;
+  }
+
+  for (i = 0; i < n_programs; i++) {
+    OrcProgram *p = programs[i];
+
+    fill (p);
+    if (ORC_COMPILE_RESULT_IS_SUCCESSFUL (orc_program_compile (p))) {
+      if (p->is_2d) {
+        check (p, N, M, 0);
+        check (p, 37, 5, 1);
+      } else {
+        for (n = 0; n < N; n++) {
+          for (offset = 0; offset < 2; offset++) {
+            check (p, n, 1, offset);
+          }
+        }
+      }
+    }
+    orc_program_free (p);
+  }
+  free (programs);
+
+  /* An accumulator only starts from the identity of one operation */
+  n_programs = orc_parse (".function mixed\n"
+      ".accumulator 4 a1\n.source 4 s1\n"
+      "accl a1, s1\naccorl a1, s1\n", &programs);
+  for (i = 0; i < n_programs; i++) {
+    if (ORC_COMPILE_RESULT_IS_SUCCESSFUL (orc_program_compile (programs[i]))) {
+      printf ("accl and accorl on the same accumulator accepted\n");
+      error = TRUE;
+    }
+    orc_program_free (programs[i]);
+  }
+  free (programs);
+
+  if (error) return 1;
+  return 0;
+}
@@ -0,0 +1,166 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#include <orc/orc.h>
+#include <orc/orcdebug.h>
+
+#define N 1000
+
+orc_int16 src1[N];
+orc_int16 src2[N];
+orc_int16 dest1[N];
+orc_int16 dest2[N];
+
+static OrcProgram *
+create_program (void)
+{
+  OrcProgram *p;
+
+  p = orc_program_new ();
+  orc_program_set_name (p, "test_code_cache");
+  orc_program_add_destination (p, 2, "d1");
+  orc_program_add_source (p, 2, "s1");
+  orc_program_add_source (p, 2, "s2");
+  orc_program_add_parameter (p, 2, "p1");
+  orc_program_add_temporary (p, 2, "t1");
+
+  orc_program_append_str (p, "addw", "t1", "s1", "s2");
+  orc_program_append_str (p, "mullw", "d1", "t1", "p1");
+
+  return p;
+}
+
+static void
+run_program (OrcProgram *p, orc_int16 *dest)
+{
+  OrcExecutor *ex;
+
+  ex = orc_executor_new (p);
+  orc_executor_set_n (ex, N);
+  orc_executor_set_array_str (ex, "d1", dest);
+  orc_executor_set_array_str (ex, "s1", src1);
+  orc_executor_set_array_str (ex, "s2", src2);
+  orc_executor_set_param_str (ex, "p1", 3);
+  orc_executor_run (ex);
+  orc_executor_free (ex);
+}
+
+#ifndef _WIN32
+static int
+count_entries (const char *dir, int remove_entries)
+{
+  struct dirent *entry;
+  char path[1024];
+  DIR *d;
+  int count = 0;
+
+  d = opendir (dir);
+  if (d == NULL)
+    return 0;
+
+  while ((entry = readdir (d)) != NULL) {
+    if (entry->d_name[0] == '.')
+      continue;
+    count++;
+    if (remove_entries) {
+      snprintf (path, sizeof (path), "%s/%s", dir, entry->d_name);
+      unlink (path);
+    }
+  }
+  closedir (d);
+
+  return count;
+}
+#endif
+
+int
+main (int argc, char *argv[])
+{
+#ifdef _WIN32
+  return 77;
+#else
+  char dir[] = "/tmp/orc-code-cache-XXXXXX";
+  OrcProgram *p1;
+  OrcProgram *p2;
+  OrcCompileResult result;
+  int error = FALSE;
+  OrcCode *code;
+  void *code_exec;
+  int i;
+
+  orc_init ();
+
+  if (mkdtemp (dir) == NULL) {
+    printf ("could not create temporary directory\n");
+    return 77;
+  }
+  orc_code_cache_set_directory (dir);
+
+  for (i = 0; i < N; i++) {
+    src1[i] = rand ();
+    src2[i] = rand ();
+  }
+
+  p1 = create_program ();
+  result = orc_program_compile (p1);
+  if (!ORC_COMPILE_RESULT_IS_SUCCESSFUL (result) ||
+      count_entries (dir, FALSE) == 0) {
+    /* Nothing was generated for this target, so nothing was cached */
+    printf ("code cache not used by the default target\n");
+    orc_program_free (p1);
+    count_entries (dir, TRUE);
+    rmdir (dir);
+    return 77;
+  }
+  run_program (p1, dest1);
+
+  p2 = create_program ();
+  result = orc_program_compile (p2);
+  if (!ORC_COMPILE_RESULT_IS_SUCCESSFUL (result)) {
+    printf ("cached compile failed\n");
+    error = TRUE;
+  } else {
+    run_program (p2, dest2);
+
+    if (memcmp (dest1, dest2, sizeof (dest1)) != 0) {
+      printf ("cached code gives different results\n");
+      error = TRUE;
+    }
+    code = p1->orccode;
+    code_exec = p1->code_exec;
+    if (strcmp (orc_program_get_asm_code (p1),
+            orc_program_get_asm_code (p2)) != 0) {
+      printf ("cached assembly listing differs\n");
+      error = TRUE;
+    }
+    /* The assembly listing is created from a copy of the program, the
+     * code of the program may be running in another thread */
+    if (p1->orccode != code || p1->code_exec != code_exec) {
+      printf ("creating the assembly listing replaced the code\n");
+      error = TRUE;
+    }
+    if (count_entries (dir, FALSE) != 1) {
+      printf ("unexpected number of cache entries\n");
+      error = TRUE;
+    }
+  }
+
+  orc_program_free (p1);
+  orc_program_free (p2);
+
+  orc_code_cache_set_directory (NULL);
+  count_entries (dir, TRUE);
+  rmdir (dir);
+
+  if (error) return 1;
+  return 0;
+#endif
+}
@@ -0,0 +1,103 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <orc/orc.h>
+#include <orc/orcdebug.h>
+
+#if defined(HAVE_THREAD_PTHREAD)
+#include <pthread.h>
+#endif
+
+#define N 256
+#define N_THREADS 4
+#define N_ITERATIONS 200
+
+static int error = FALSE;
+
+/* Compiles, runs and frees programs of varying length, so that code of
+ * many sizes is allocated and freed concurrently */
+static void *
+compile_programs (void *data)
+{
+  orc_int32 src[N];
+  orc_int32 dest[N];
+  int seed = (int) (orc_intptr) data;
+  int i, j, k;
+
+  for (j = 0; j < N; j++)
+    src[j] = j * (seed + 1);
+
+  for (i = 0; i < N_ITERATIONS; i++) {
+    OrcProgram *p;
+    OrcExecutor *ex;
+    int n_adds = 1 + (i * 7 + seed) % 40;
+    char name[64];
+
+    sprintf (name, "test_codemem_%d_%d", seed, i);
+    p = orc_program_new ();
+    orc_program_set_name (p, name);
+    orc_program_add_destination (p, 4, "d1");
+    orc_program_add_source (p, 4, "s1");
+    orc_program_add_constant (p, 4, 1, "c1");
+    orc_program_add_temporary (p, 4, "t1");
+
+    orc_program_append_str (p, "copyl", "t1", "s1", NULL);
+    for (k = 0; k < n_adds; k++)
+      orc_program_append_str (p, "addl", "t1", "t1", "c1");
+    orc_program_append_str (p, "copyl", "d1", "t1", NULL);
+
+    if (ORC_COMPILE_RESULT_IS_FATAL (orc_program_compile (p))) {
+      printf ("compile failed\n");
+      error = TRUE;
+      orc_program_free (p);
+      break;
+    }
+
+    ex = orc_executor_new (p);
+    orc_executor_set_n (ex, N);
+    orc_executor_set_array_str (ex, "d1", dest);
+    orc_executor_set_array_str (ex, "s1", src);
+    orc_executor_run (ex);
+    orc_executor_free (ex);
+
+    for (j = 0; j < N; j++) {
+      if (dest[j] != src[j] + n_adds) {
+        printf ("%s: wrong result at %d\n", name, j);
+        error = TRUE;
+        break;
+      }
+    }
+
+    orc_program_free (p);
+  }
+
+  return NULL;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int i;
+#if defined(HAVE_THREAD_PTHREAD)
+  pthread_t threads[N_THREADS];
+#endif
+
+  orc_init ();
+
+#if defined(HAVE_THREAD_PTHREAD)
+  for (i = 0; i < N_THREADS; i++)
+    pthread_create (&threads[i], NULL, compile_programs,
+        (void *) (orc_intptr) i);
+  for (i = 0; i < N_THREADS; i++)
+    pthread_join (threads[i], NULL);
+#else
+  for (i = 0; i < N_THREADS; i++)
+    compile_programs ((void *) (orc_intptr) i);
+#endif
+
+  if (error) return 1;
+  return 0;
+}
@@ -0,0 +1,144 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ORC_ENABLE_UNSTABLE_API
+
+#include <orc/orc.h>
+#include <orc/orcparse.h>
+#include <orc-test/orctest.h>
+
+#define N 3000
+#define M 7
+
+static int error = FALSE;
+
+static orc_uint8 src1_data[N * M];
+static orc_int16 src2_data[N * M];
+static orc_int16 dest_data[N * M];
+static orc_int16 emul_data[N * M];
+
+/* Temporaries, a parameter, a constant and an accumulator, in 1D and 2D */
+static const char *source =
+    ".function emulate_context\n"
+    ".dest 2 d1\n.source 1 s1\n.source 2 s2\n.param 2 p1\n"
+    ".accumulator 4 a1\n.temp 2 t1\n.temp 4 t2\n"
+    "convubw t1, s1\n"
+    "addw t1, t1, s2\n"
+    "mullw t1, t1, p1\n"
+    "subw d1, t1, 3\n"
+    "convswl t2, t1\n"
+    "accl a1, t2\n"
+    "\n"
+    ".function emulate_context_2d\n"
+    ".flags 2d\n"
+    ".dest 2 d1\n.source 1 s1\n.source 2 s2\n.temp 2 t1\n"
+    "convubw t1, s1\n"
+    "avgsw d1, t1, s2\n";
+
+/* The context is reused across calls, and across values of n that are
+ * smaller and larger than the emulation chunk */
+static void
+check (OrcProgram *p, OrcEmulateContext *ctx, int n, int m)
+{
+  OrcExecutor *ex;
+  int acc[2];
+  int i;
+
+  memset (dest_data, 0x55, sizeof (dest_data));
+  memset (emul_data, 0x55, sizeof (emul_data));
+
+  ex = orc_executor_new (p);
+  orc_executor_set_n (ex, n);
+  orc_executor_set_array_str (ex, "s1", src1_data);
+  orc_executor_set_array_str (ex, "s2", src2_data);
+  if (p->is_2d) {
+    orc_executor_set_m (ex, m);
+    orc_executor_set_stride (ex, ORC_VAR_D1, N * 2);
+    orc_executor_set_stride (ex, ORC_VAR_S1, N);
+    orc_executor_set_stride (ex, ORC_VAR_S2, N * 2);
+  } else {
+    orc_executor_set_param_str (ex, "p1", n + 7);
+  }
+
+  orc_executor_set_array_str (ex, "d1", emul_data);
+  orc_executor_emulate (ex);
+  acc[0] = orc_executor_get_accumulator (ex, ORC_VAR_A1);
+
+  /* 2D code moves the array pointers of the executor along the rows */
+  orc_executor_set_array_str (ex, "s1", src1_data);
+  orc_executor_set_array_str (ex, "s2", src2_data);
+  orc_executor_set_array_str (ex, "d1", dest_data);
+  orc_executor_emulate_with_context (ex, ctx);
+  acc[1] = orc_executor_get_accumulator (ex, ORC_VAR_A1);
+  orc_executor_free (ex);
+
+  if (!p->is_2d && acc[0] != acc[1]) {
+    printf ("%s: n %d: accumulator %d != %d\n", orc_program_get_name (p),
+        n, acc[1], acc[0]);
+    error = TRUE;
+  }
+  for (i = 0; i < N * M; i++) {
+    if (dest_data[i] != emul_data[i]) {
+      printf ("%s: n %d m %d: wrong result at %d: %d != %d\n",
+          orc_program_get_name (p), n, m, i, dest_data[i], emul_data[i]);
+      error = TRUE;
+      break;
+    }
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const int sizes[] = { 1, 15, 16, 17, 255, 1023, 1024, 1025, 2049,
+      N, 0 };
+  OrcProgram **programs = NULL;
+  int n_programs;
+  int i, j;
+
+  orc_init ();
+  orc_test_init ();
+
+  for (i = 0; i < N * M; i++) {
+    src1_data[i] = rand ();
+    src2_data[i] = rand ();
+  }
+
+  n_programs = orc_parse (source, &programs);
+  if (n_programs != 2) {
+    printf ("parsed %d programs\n", n_programs);
+    return 1;
+  }
+
+  for (i = 0; i < n_programs; i++) {
+    OrcProgram *p = programs[i];
+    OrcEmulateContext *ctx;
+
+    orc_program_compile (p);
+    if (p->orccode == NULL) {
+      printf ("%s: no code\n", orc_program_get_name (p));
+      error = TRUE;
+      orc_program_free (p);
+      continue;
+    }
+
+    ctx = orc_emulate_context_new (p->orccode);
+    for (j = 0; j < ARRAY_SIZE (sizes); j++) {
+      if (p->is_2d) {
+        check (p, ctx, sizes[j], M);
+        check (p, ctx, sizes[j], 1);
+      } else {
+        check (p, ctx, sizes[j], 1);
+      }
+    }
+    orc_emulate_context_free (ctx);
+    orc_program_free (p);
+  }
+  free (programs);
+
+  if (error) return 1;
+  return 0;
+}
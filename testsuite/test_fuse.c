@@ -0,0 +1,149 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <orc/orc.h>
+#include <orc-test/orctest.h>
+
+#define N 1001
+
+orc_uint8 src1[N];
+orc_int16 src2[N];
+orc_int16 tmp1[N];
+orc_int16 dest1[N];
+orc_int16 dest2[N];
+
+static int error = FALSE;
+
+/* d1 = s1 * p1 + 3 */
+static OrcProgram *
+create_first (void)
+{
+  OrcProgram *p;
+
+  p = orc_program_new ();
+  orc_program_set_name (p, "scale");
+  orc_program_add_destination (p, 2, "d1");
+  orc_program_add_source (p, 1, "s1");
+  orc_program_add_parameter (p, 2, "p1");
+  orc_program_add_constant (p, 2, 3, "c1");
+  orc_program_add_temporary (p, 2, "t1");
+
+  orc_program_append_str (p, "convubw", "t1", "s1", NULL);
+  orc_program_append_str (p, "mullw", "t1", "t1", "p1");
+  orc_program_append_str (p, "addw", "d1", "t1", "c1");
+
+  return p;
+}
+
+/* d1 = (s1 + s2) >> 3, with explicit loads and stores */
+static OrcProgram *
+create_second (void)
+{
+  OrcProgram *p;
+
+  p = orc_program_new ();
+  orc_program_set_name (p, "add");
+  orc_program_add_destination (p, 2, "d1");
+  orc_program_add_source (p, 2, "s1");
+  orc_program_add_source (p, 2, "s2");
+  orc_program_add_constant (p, 2, 3, "c1");
+  orc_program_add_temporary (p, 2, "t1");
+  orc_program_add_temporary (p, 2, "t2");
+
+  orc_program_append_str (p, "loadw", "t1", "s1", NULL);
+  orc_program_append_str (p, "addw", "t2", "t1", "s2");
+  orc_program_append_str (p, "shrsw", "t2", "t2", "c1");
+  orc_program_append_str (p, "storew", "d1", "t2", NULL);
+
+  return p;
+}
+
+static void
+run_program (OrcProgram *p, void *d1, void *s1, void *s2)
+{
+  OrcExecutor *ex;
+
+  if (ORC_COMPILE_RESULT_IS_FATAL (orc_program_compile (p))) {
+    printf ("%s: compile failed\n", orc_program_get_name (p));
+    error = TRUE;
+    return;
+  }
+
+  ex = orc_executor_new (p);
+  orc_executor_set_n (ex, N);
+  orc_executor_set_array_str (ex, "d1", d1);
+  orc_executor_set_array_str (ex, "s1", s1);
+  if (s2)
+    orc_executor_set_array_str (ex, "s2", s2);
+  orc_executor_set_param_str (ex, "p1", 7);
+  orc_executor_run (ex);
+  orc_executor_free (ex);
+}
+
+int
+main (int argc, char *argv[])
+{
+  OrcProgram *first, *second, *fused;
+  int dests[1] = { ORC_VAR_D1 };
+  int srcs[1] = { ORC_VAR_S1 };
+  int i;
+
+  orc_init ();
+  orc_test_init ();
+
+  for (i = 0; i < N; i++) {
+    src1[i] = rand ();
+    src2[i] = rand ();
+  }
+
+  first = create_first ();
+  second = create_second ();
+
+  fused = orc_program_fuse (first, second, 1, dests, srcs);
+  if (orc_program_get_error (fused)[0] != '\0') {
+    printf ("fuse failed: %s\n", orc_program_get_error (fused));
+    return 1;
+  }
+  /* The shared constant and the temporaries of the second program are
+   * folded into those of the first one */
+  if (fused->n_const_vars != 1 || fused->n_temp_vars != 3) {
+    printf ("unexpected variables: %d constants, %d temporaries\n",
+        fused->n_const_vars, fused->n_temp_vars);
+    error = TRUE;
+  }
+
+  run_program (first, tmp1, src1, NULL);
+  run_program (second, dest1, tmp1, src2);
+  run_program (fused, dest2, src1, src2);
+  for (i = 0; i < N; i++) {
+    if (dest1[i] != dest2[i]) {
+      printf ("wrong result at %d: %d != %d\n", i, dest2[i], dest1[i]);
+      error = TRUE;
+      break;
+    }
+  }
+
+  if (orc_test_compare_output_full (fused, 0) == ORC_TEST_FAILED) {
+    printf ("fused program does not match the emulation\n");
+    error = TRUE;
+  }
+  orc_program_free (fused);
+
+  /* The source of the first program is 8-bit */
+  dests[0] = ORC_VAR_D1;
+  srcs[0] = ORC_VAR_S1;
+  fused = orc_program_fuse (second, first, 1, dests, srcs);
+  if (orc_program_get_error (fused)[0] == '\0') {
+    printf ("arrays of different sizes were fused\n");
+    error = TRUE;
+  }
+  orc_program_free (fused);
+
+  orc_program_free (first);
+  orc_program_free (second);
+
+  if (error) return 1;
+  return 0;
+}
@@ -0,0 +1,134 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ORC_ENABLE_UNSTABLE_API
+
+#include <orc/orc.h>
+#include <orc/orcparse.h>
+#include <orc-test/orctest.h>
+
+/* Destinations larger than this are not worth testing */
+#define MAX_DEST_SIZE (256 * 1024 * 1024)
+#define GUARD 64
+
+static int error = FALSE;
+
+/* A 4 byte destination for a 1 byte source, so that the destination
+ * crosses the threshold with as little memory as possible */
+static const char *source =
+    ".function nontemporal\n"
+    ".dest 4 d1\n.source 1 s1\n.temp 2 t1\n"
+    "convubw t1, s1\n"
+    "mullw t1, t1, t1\n"
+    "convuwl d1, t1\n";
+
+static void
+check (OrcProgram *p, orc_uint8 *src, orc_uint32 *dest, orc_uint32 *emul,
+    int n, int offset)
+{
+  OrcExecutor *ex;
+  size_t size = sizeof (orc_uint32) * (n + offset + GUARD);
+
+  memset (dest, 0x55, size);
+  memset (emul, 0x55, size);
+
+  ex = orc_executor_new (p);
+  orc_executor_set_n (ex, n);
+  orc_executor_set_array_str (ex, "s1", src);
+  orc_executor_set_array_str (ex, "d1", emul + offset);
+  orc_executor_emulate (ex);
+  orc_executor_set_array_str (ex, "d1", dest + offset);
+  orc_executor_run (ex);
+  orc_executor_free (ex);
+
+  if (memcmp (dest, emul, size) != 0) {
+    printf ("n %d offset %d: wrong result\n", n, offset);
+    error = TRUE;
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  OrcProgram **programs = NULL;
+  OrcProgram *p;
+  orc_uint8 *src;
+  orc_uint32 *dest, *emul;
+  int l1, l2, l3;
+  int threshold, n_max;
+  int i;
+
+  orc_init ();
+  orc_test_init ();
+
+  /* The destination is written with non-temporal stores once it is
+   * larger than half of the last level cache */
+  orc_get_data_cache_sizes (&l1, &l2, &l3);
+  threshold = (l3 > 0 ? l3 / 2 : l2) / sizeof (orc_uint32);
+  if (threshold <= 0 ||
+      (threshold + 4096) * sizeof (orc_uint32) > MAX_DEST_SIZE) {
+    printf ("no usable cache size\n");
+    return 77;
+  }
+  n_max = threshold + 4096;
+
+  if (orc_parse (source, &programs) != 1) {
+    printf ("parse failed\n");
+    return 1;
+  }
+  p = programs[0];
+  free (programs);
+
+  if (!ORC_COMPILE_RESULT_IS_SUCCESSFUL (orc_program_compile (p))) {
+    orc_program_free (p);
+    return 0;
+  }
+
+  /* The targets with vector registers of 16 bytes or more have the
+   * uncached loop */
+  if (strcmp (orc_target_get_name (p->target), "sse") == 0 ||
+      strcmp (orc_target_get_name (p->target), "avx") == 0 ||
+      strcmp (orc_target_get_name (p->target), "avx512") == 0) {
+    const char *asm_code = orc_program_get_asm_code (p);
+
+    if (strstr (asm_code, "movnt") == NULL ||
+        strstr (asm_code, "sfence") == NULL) {
+      printf ("%s: no non-temporal stores\n",
+          orc_target_get_name (p->target));
+      error = TRUE;
+    }
+  }
+
+  src = malloc (n_max + GUARD);
+  dest = malloc (sizeof (orc_uint32) * (n_max + 1 + GUARD));
+  emul = malloc (sizeof (orc_uint32) * (n_max + 1 + GUARD));
+  if (src == NULL || dest == NULL || emul == NULL) {
+    printf ("could not allocate %d elements\n", n_max);
+    free (src);
+    free (dest);
+    free (emul);
+    orc_program_free (p);
+    return 77;
+  }
+  for (i = 0; i < n_max + GUARD; i++)
+    src[i] = rand ();
+
+  /* Below, at and above the threshold, with aligned and unaligned
+   * destinations */
+  check (p, src, dest, emul, threshold - 4096, 0);
+  check (p, src, dest, emul, threshold, 0);
+  check (p, src, dest, emul, threshold, 1);
+  check (p, src, dest, emul, n_max, 0);
+  check (p, src, dest, emul, n_max - 1, 1);
+
+  free (src);
+  free (dest);
+  free (emul);
+  orc_program_free (p);
+
+  if (error) return 1;
+  return 0;
+}
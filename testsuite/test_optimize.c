@@ -0,0 +1,272 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ORC_ENABLE_UNSTABLE_API
+#include <orc/orc.h>
+#include <orc/orcdebug.h>
+
+#define N 100
+
+orc_int16 src1[N];
+orc_int16 src2[N];
+orc_int16 dest1[N];
+orc_int16 dest2[N];
+orc_int8 src3[N];
+orc_int8 dest3[N];
+
+static int error = FALSE;
+
+/* The emulator runs the optimized instructions too, so the results are
+ * checked against plain C */
+static OrcProgram *
+create_cse_program (void)
+{
+  OrcProgram *p;
+
+  p = orc_program_new ();
+  orc_program_set_name (p, "test_optimize");
+  orc_program_add_destination (p, 2, "d1");
+  orc_program_add_destination (p, 2, "d2");
+  orc_program_add_source (p, 2, "s1");
+  orc_program_add_source (p, 2, "s2");
+  orc_program_add_parameter (p, 2, "p1");
+  orc_program_add_temporary (p, 2, "t1");
+  orc_program_add_temporary (p, 2, "t2");
+  orc_program_add_temporary (p, 2, "t3");
+  orc_program_add_temporary (p, 2, "t4");
+
+  orc_program_append_str (p, "addw", "t1", "s1", "s2");
+  orc_program_append_str (p, "addw", "t2", "s2", "s1");
+  orc_program_append_str (p, "copyw", "t3", "t2", NULL);
+  orc_program_append_str (p, "mullw", "t4", "t3", "p1");
+  orc_program_append_str (p, "mullw", "t3", "t1", "p1");
+  orc_program_append_str (p, "subw", "t3", "t3", "s1");
+  orc_program_append_str (p, "xorw", "t2", "t4", "t3");
+  orc_program_append_str (p, "copyw", "t1", "t2", NULL);
+  orc_program_append_str (p, "addw", "d1", "t1", "t4");
+  orc_program_append_str (p, "subw", "t4", "s2", "s1");
+  orc_program_append_str (p, "addw", "d2", "s1", "s2");
+
+  return p;
+}
+
+static OrcProgram *
+create_simplify_program (void)
+{
+  OrcProgram *p;
+
+  p = orc_program_new ();
+  orc_program_set_name (p, "test_optimize_simplify");
+  orc_program_add_destination (p, 2, "d1");
+  orc_program_add_destination (p, 2, "d2");
+  orc_program_add_destination (p, 1, "d3");
+  orc_program_add_source (p, 2, "s1");
+  orc_program_add_source (p, 1, "s3");
+  orc_program_add_constant (p, 2, 4, "c1");
+  orc_program_add_constant (p, 2, 256, "c2");
+  orc_program_add_constant (p, 2, 300, "c3");
+  orc_program_add_constant (p, 2, -1, "c4");
+  orc_program_add_temporary (p, 2, "t1");
+  orc_program_add_temporary (p, 2, "t2");
+  orc_program_add_temporary (p, 2, "t3");
+
+  orc_program_append_str (p, "mullw", "t1", "s1", "c1");
+  orc_program_append_str (p, "mulhuw", "t2", "c2", "t1");
+  orc_program_append_str (p, "addw", "t3", "c3", "c1");
+  orc_program_append_str (p, "div255w", "t3", "t3", NULL);
+  orc_program_append_str (p, "andw", "t2", "t2", "c4");
+  orc_program_append_str (p, "addw", "d1", "t2", "t3");
+  orc_program_append_str (p, "swapw", "t1", "s1", NULL);
+  orc_program_append_str (p, "swapw", "d2", "t1", NULL);
+  orc_program_append_str (p, "convubw", "t1", "s3", NULL);
+  orc_program_append_str (p, "convwb", "d3", "t1", NULL);
+
+  return p;
+}
+
+/* The gain only depends on the parameters, so it is computed once before
+ * the loop on the targets that hoist invariant instructions */
+static OrcProgram *
+create_invariant_program (void)
+{
+  OrcProgram *p;
+
+  p = orc_program_new ();
+  orc_program_set_name (p, "test_optimize_invariant");
+  orc_program_add_destination (p, 2, "d1");
+  orc_program_add_source (p, 2, "s1");
+  orc_program_add_parameter (p, 1, "p1");
+  orc_program_add_parameter (p, 2, "p2");
+  orc_program_add_constant (p, 2, 3, "c1");
+  orc_program_add_temporary (p, 2, "t1");
+  orc_program_add_temporary (p, 2, "t2");
+  orc_program_add_temporary (p, 2, "t3");
+
+  orc_program_append_str (p, "convsbw", "t1", "p1", NULL);
+  orc_program_append_str (p, "mullw", "t2", "t1", "c1");
+  orc_program_append_str (p, "addw", "t2", "t2", "p2");
+  orc_program_append_str (p, "mullw", "t3", "s1", "t2");
+  orc_program_append_str (p, "subw", "d1", "t3", "t1");
+
+  return p;
+}
+
+/* Run with d1 and s1 at the same address, the sources are loaded again
+ * after the store to d1 and the loads can not be moved above it */
+static OrcProgram *
+create_alias_program (void)
+{
+  OrcProgram *p;
+
+  p = orc_program_new ();
+  orc_program_set_name (p, "test_optimize_alias");
+  orc_program_add_destination (p, 2, "d1");
+  orc_program_add_destination (p, 2, "d2");
+  orc_program_add_source (p, 2, "s1");
+  orc_program_add_source (p, 2, "s2");
+
+  orc_program_append_str (p, "mullw", "d1", "s1", "s2");
+  orc_program_append_str (p, "addw", "d2", "s1", "s2");
+
+  return p;
+}
+
+static OrcProgram *
+compile_program (OrcProgram *p, int n_insns)
+{
+  if (ORC_COMPILE_RESULT_IS_FATAL (orc_program_compile (p))) {
+    printf ("%s: compile failed\n", p->name);
+    exit (1);
+  }
+
+  if (!orc_compiler_flag_check ("noopt") && p->orccode->n_insns != n_insns) {
+    printf ("%s: unexpected number of instructions %d\n", p->name,
+        p->orccode->n_insns);
+    error = TRUE;
+  }
+
+  return p;
+}
+
+int
+main (int argc, char *argv[])
+{
+  OrcProgram *p;
+  OrcExecutor *ex;
+  int i;
+
+  orc_init ();
+
+  for (i = 0; i < N; i++) {
+    src1[i] = rand ();
+    src2[i] = rand ();
+    src3[i] = rand ();
+  }
+
+  /* The second addw, the second mullw, the copies, the unused subw and
+   * the repeated loads of s1 and s2 are gone. Sources are loaded again
+   * after the store to d1 and t1 no longer holds s1 + s2 at the end, so
+   * 13 instructions are left out of 21 */
+  p = compile_program (create_cse_program (), 13);
+  ex = orc_executor_new (p);
+  orc_executor_set_n (ex, N);
+  orc_executor_set_array_str (ex, "d1", dest1);
+  orc_executor_set_array_str (ex, "d2", dest2);
+  orc_executor_set_array_str (ex, "s1", src1);
+  orc_executor_set_array_str (ex, "s2", src2);
+  orc_executor_set_param_str (ex, "p1", 7);
+  orc_executor_run (ex);
+
+  for (i = 0; i < N; i++) {
+    orc_int16 t1 = src1[i] + src2[i];
+    orc_int16 t4 = t1 * 7;
+    orc_int16 t3 = (orc_int16) (t1 * 7) - src1[i];
+
+    if (dest1[i] != (orc_int16) ((t4 ^ t3) + t4) ||
+        dest2[i] != (orc_int16) (src1[i] + src2[i])) {
+      printf ("%s: wrong result at %d\n", p->name, i);
+      error = TRUE;
+      break;
+    }
+  }
+
+  orc_executor_free (ex);
+  orc_program_free (p);
+
+  /* The multiplies become shifts, t3 is folded into a constant and the
+   * swaps and conversions cancel out, leaving the loads, the stores, the
+   * two shifts, the constant and the addw */
+  p = compile_program (create_simplify_program (), 10);
+  ex = orc_executor_new (p);
+  orc_executor_set_n (ex, N);
+  orc_executor_set_array_str (ex, "d1", dest1);
+  orc_executor_set_array_str (ex, "d2", dest2);
+  orc_executor_set_array_str (ex, "d3", dest3);
+  orc_executor_set_array_str (ex, "s1", src1);
+  orc_executor_set_array_str (ex, "s3", src3);
+  orc_executor_run (ex);
+
+  for (i = 0; i < N; i++) {
+    orc_uint16 t1 = (orc_uint16) (src1[i] * 4);
+    orc_int16 t2 = (t1 * 256) >> 16;
+
+    if (dest1[i] != (orc_int16) (t2 + ((304 * 0x8081u) >> 23)) ||
+        dest2[i] != src1[i] || dest3[i] != src3[i]) {
+      printf ("%s: wrong result at %d\n", p->name, i);
+      error = TRUE;
+      break;
+    }
+  }
+
+  orc_executor_free (ex);
+  orc_program_free (p);
+
+  p = compile_program (create_alias_program (), 8);
+  ex = orc_executor_new (p);
+  for (i = 0; i < N; i++)
+    dest1[i] = src1[i];
+  orc_executor_set_n (ex, N);
+  orc_executor_set_array_str (ex, "d1", dest1);
+  orc_executor_set_array_str (ex, "d2", dest2);
+  orc_executor_set_array_str (ex, "s1", dest1);
+  orc_executor_set_array_str (ex, "s2", src2);
+  orc_executor_run (ex);
+
+  for (i = 0; i < N; i++) {
+    orc_int16 t1 = src1[i] * src2[i];
+
+    if (dest1[i] != t1 || dest2[i] != (orc_int16) (t1 + src2[i])) {
+      printf ("%s: wrong result at %d\n", p->name, i);
+      error = TRUE;
+      break;
+    }
+  }
+
+  orc_executor_free (ex);
+  orc_program_free (p);
+
+  p = compile_program (create_invariant_program (), 10);
+  ex = orc_executor_new (p);
+  orc_executor_set_n (ex, N);
+  orc_executor_set_array_str (ex, "d1", dest1);
+  orc_executor_set_array_str (ex, "s1", src1);
+  orc_executor_set_param_str (ex, "p1", -5);
+  orc_executor_set_param_str (ex, "p2", 1000);
+  orc_executor_run (ex);
+
+  for (i = 0; i < N; i++) {
+    if (dest1[i] != (orc_int16) (src1[i] * (-5 * 3 + 1000) + 5)) {
+      printf ("%s: wrong result at %d\n", p->name, i);
+      error = TRUE;
+      break;
+    }
+  }
+
+  orc_executor_free (ex);
+  orc_program_free (p);
+
+  if (error) return 1;
+  return 0;
+}
@@ -0,0 +1,215 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <orc/orc.h>
+#include <orc/orcdebug.h>
+
+#define N 1000
+#define M 300
+#define STRIDE (N * 2 + 32)
+
+orc_int16 src1[M * STRIDE / 2];
+orc_int16 src2[M * STRIDE / 2];
+orc_int16 dest1[M * STRIDE / 2];
+orc_int16 dest2[M * STRIDE / 2];
+
+static int error = FALSE;
+
+static OrcProgram *
+create_program (int is_2d)
+{
+  OrcProgram *p;
+
+  p = orc_program_new ();
+  orc_program_set_name (p, is_2d ? "test_parallel_2d" : "test_parallel");
+  if (is_2d)
+    orc_program_set_2d (p);
+  orc_program_add_destination (p, 2, "d1");
+  orc_program_add_source (p, 2, "s1");
+  orc_program_add_source (p, 2, "s2");
+  orc_program_add_temporary (p, 2, "t1");
+  if (is_2d) {
+    orc_program_add_temporary (p, 4, "t2");
+    orc_program_add_accumulator (p, 4, "a1");
+  }
+
+  orc_program_append_str (p, "addw", "t1", "s1", "s2");
+  orc_program_append_str (p, "mullw", "d1", "t1", "s2");
+  if (is_2d) {
+    orc_program_append_str (p, "convuwl", "t2", "d1", NULL);
+    orc_program_append_str (p, "accl", "a1", "t2", NULL);
+  }
+
+  return p;
+}
+
+static int
+run_program (OrcProgram *p, orc_int16 *dest, int n, int m, int n_threads)
+{
+  OrcExecutor *ex;
+  int acc;
+
+  ex = orc_executor_new (p);
+  orc_executor_set_n (ex, n);
+  orc_executor_set_array_str (ex, "d1", dest);
+  orc_executor_set_array_str (ex, "s1", src1);
+  orc_executor_set_array_str (ex, "s2", src2);
+  if (m > 0) {
+    orc_executor_set_m (ex, m);
+    orc_executor_set_stride (ex, ORC_VAR_D1, STRIDE);
+    orc_executor_set_stride (ex, ORC_VAR_S1, STRIDE);
+    orc_executor_set_stride (ex, ORC_VAR_S2, STRIDE);
+  }
+  if (n_threads > 0) {
+    orc_executor_run_parallel (ex, n_threads);
+  } else {
+    orc_executor_run (ex);
+  }
+  acc = orc_executor_get_accumulator (ex, ORC_VAR_A1);
+  orc_executor_free (ex);
+
+  return acc;
+}
+
+static void
+test_program (int is_2d, int n, int m, int n_threads)
+{
+  OrcProgram *p;
+  int acc1, acc2;
+
+  p = create_program (is_2d);
+  if (ORC_COMPILE_RESULT_IS_FATAL (orc_program_compile (p))) {
+    printf ("compile failed\n");
+    error = TRUE;
+    orc_program_free (p);
+    return;
+  }
+
+  memset (dest1, 0, sizeof (dest1));
+  memset (dest2, 0, sizeof (dest2));
+  acc1 = run_program (p, dest1, n, m, 0);
+  acc2 = run_program (p, dest2, n, m, n_threads);
+
+  if (memcmp (dest1, dest2, sizeof (dest1)) != 0) {
+    printf ("%s n=%d m=%d threads=%d: results differ\n",
+        is_2d ? "2d" : "1d", n, m, n_threads);
+    error = TRUE;
+  }
+  if (is_2d && acc1 != acc2) {
+    printf ("2d n=%d m=%d threads=%d: accumulator %d != %d\n",
+        n, m, n_threads, acc2, acc1);
+    error = TRUE;
+  }
+
+  orc_program_free (p);
+}
+
+/* Programs whose sources are not read at the index of the destination,
+ * which the tiles of a 1D call cannot be offset for */
+static const struct {
+  const char *opcode;
+  int size;
+  int n_params;
+  int params[2];
+} indexed_programs[] = {
+  { "loadupdb", 1, 0, { 0, 0 } },
+  { "loadupib", 1, 0, { 0, 0 } },
+  { "ldresnearb", 1, 2, { 3 << 16, 0x8000 } },
+  { "ldresnearl", 4, 2, { 3 << 16, 0x8000 } },
+  { "ldreslinb", 1, 2, { 0x18000, 0x6000 } },
+  { "ldreslinl", 4, 2, { 0x18000, 0x6000 } },
+  { "loadoffw", 2, 1, { 5, 0 } },
+};
+
+static void
+run_indexed_program (OrcProgram *p, int i, void *dest, int n, int n_threads)
+{
+  OrcExecutor *ex;
+
+  ex = orc_executor_new (p);
+  orc_executor_set_n (ex, n);
+  orc_executor_set_array_str (ex, "d1", dest);
+  orc_executor_set_array_str (ex, "s1", src1);
+  if (indexed_programs[i].n_params > 0)
+    orc_executor_set_param_str (ex, "p1", indexed_programs[i].params[0]);
+  if (indexed_programs[i].n_params > 1)
+    orc_executor_set_param_str (ex, "p2", indexed_programs[i].params[1]);
+  if (n_threads > 0) {
+    orc_executor_run_parallel (ex, n_threads);
+  } else {
+    orc_executor_run (ex);
+  }
+  orc_executor_free (ex);
+}
+
+static void
+test_indexed_program (int i, int n, int n_threads)
+{
+  OrcProgram *p;
+
+  p = orc_program_new ();
+  orc_program_set_name (p, indexed_programs[i].opcode);
+  orc_program_add_destination (p, indexed_programs[i].size, "d1");
+  orc_program_add_source (p, indexed_programs[i].size, "s1");
+  if (indexed_programs[i].n_params > 0)
+    orc_program_add_parameter (p, 4, "p1");
+  if (indexed_programs[i].n_params > 1)
+    orc_program_add_parameter (p, 4, "p2");
+  if (indexed_programs[i].n_params == 2) {
+    orc_program_append_str_2 (p, indexed_programs[i].opcode, 0, "d1", "s1",
+        "p1", "p2");
+  } else if (indexed_programs[i].n_params == 1) {
+    orc_program_append_str (p, indexed_programs[i].opcode, "d1", "s1", "p1");
+  } else {
+    orc_program_append_str (p, indexed_programs[i].opcode, "d1", "s1", NULL);
+  }
+  if (ORC_COMPILE_RESULT_IS_FATAL (orc_program_compile (p))) {
+    printf ("%s: compile failed\n", indexed_programs[i].opcode);
+    error = TRUE;
+    orc_program_free (p);
+    return;
+  }
+
+  memset (dest1, 0, sizeof (dest1));
+  memset (dest2, 0, sizeof (dest2));
+  run_indexed_program (p, i, dest1, n, 0);
+  run_indexed_program (p, i, dest2, n, n_threads);
+
+  if (memcmp (dest1, dest2, sizeof (dest1)) != 0) {
+    printf ("%s n=%d threads=%d: results differ\n",
+        indexed_programs[i].opcode, n, n_threads);
+    error = TRUE;
+  }
+
+  orc_program_free (p);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int i;
+
+  orc_init ();
+
+  for (i = 0; i < M * STRIDE / 2; i++) {
+    src1[i] = rand ();
+    src2[i] = rand ();
+  }
+
+  test_program (FALSE, N * M, 0, 4);
+  test_program (FALSE, N * M - 13, 0, 3);
+  test_program (FALSE, 100, 0, 4);
+  test_program (TRUE, N, M, 4);
+  test_program (TRUE, N - 7, M - 1, 2);
+  test_program (TRUE, N, 1, 4);
+
+  for (i = 0; i < sizeof (indexed_programs) / sizeof (indexed_programs[0]);
+      i++)
+    test_indexed_program (i, N * M / 4, 4);
+
+  if (error) return 1;
+  return 0;
+}
@@ -0,0 +1,138 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ORC_ENABLE_UNSTABLE_API
+
+#include <orc/orc.h>
+#include <orc/orcparse.h>
+#include <orc-test/orctest.h>
+
+static int error = FALSE;
+
+static const char *source =
+    ".function prefetch_row\n"
+    ".flags 2d\n"
+    ".dest 2 d1\n.source 1 s1\n.source 2 s2\n.temp 2 t1\n"
+    "convubw t1, s1\n"
+    "subw d1, s2, t1\n";
+
+/* Whether every "# PREFETCH NEXT ROW" comment of @asm_code is followed
+ * by a prefetch before the next comment, and there are @n_sources of
+ * them */
+static orc_bool
+check_asm (const char *asm_code, int n_sources)
+{
+  const char *s = asm_code;
+  int n = 0;
+
+  while ((s = strstr (s, "# PREFETCH NEXT ROW")) != NULL) {
+    const char *next;
+    const char *prefetch;
+
+    s++;
+    next = strchr (s, '#');
+    prefetch = strstr (s, "prefetcht0");
+    if (prefetch == NULL || (next && prefetch > next))
+      return FALSE;
+    n++;
+  }
+
+  return n == n_sources;
+}
+
+/* The arrays are allocated to the exact size of the @m rows, so the
+ * prefetches of the row after the last one point past them */
+static void
+check (OrcProgram *p, int n, int m, int offset)
+{
+  int stride = n + offset;
+  orc_uint8 *s1 = malloc (stride * m);
+  orc_int16 *s2 = malloc (sizeof (orc_int16) * stride * m);
+  orc_int16 *d1 = malloc (sizeof (orc_int16) * stride * m);
+  orc_int16 *emul = malloc (sizeof (orc_int16) * stride * m);
+  OrcExecutor *ex;
+  int i;
+
+  for (i = 0; i < stride * m; i++) {
+    s1[i] = rand ();
+    s2[i] = rand ();
+  }
+  memset (d1, 0x55, sizeof (orc_int16) * stride * m);
+  memset (emul, 0x55, sizeof (orc_int16) * stride * m);
+
+  ex = orc_executor_new (p);
+  orc_executor_set_n (ex, n);
+  orc_executor_set_m (ex, m);
+  orc_executor_set_stride (ex, ORC_VAR_S1, stride);
+  orc_executor_set_stride (ex, ORC_VAR_S2, stride * 2);
+  orc_executor_set_stride (ex, ORC_VAR_D1, stride * 2);
+
+  orc_executor_set_array_str (ex, "s1", s1 + offset);
+  orc_executor_set_array_str (ex, "s2", s2 + offset);
+  orc_executor_set_array_str (ex, "d1", emul + offset);
+  orc_executor_emulate (ex);
+  /* 2D code moves the array pointers of the executor along the rows */
+  orc_executor_set_array_str (ex, "s1", s1 + offset);
+  orc_executor_set_array_str (ex, "s2", s2 + offset);
+  orc_executor_set_array_str (ex, "d1", d1 + offset);
+  orc_executor_run (ex);
+  orc_executor_free (ex);
+
+  if (memcmp (d1, emul, sizeof (orc_int16) * stride * m) != 0) {
+    printf ("n %d m %d offset %d: wrong result\n", n, m, offset);
+    error = TRUE;
+  }
+
+  free (s1);
+  free (s2);
+  free (d1);
+  free (emul);
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const int sizes[] = { 1, 7, 64, 1000, 1920 };
+  OrcProgram **programs = NULL;
+  OrcProgram *p;
+  const char *name;
+  int i;
+
+  orc_init ();
+  orc_test_init ();
+
+  if (orc_parse (source, &programs) != 1) {
+    printf ("parse failed\n");
+    return 1;
+  }
+  p = programs[0];
+  free (programs);
+
+  if (!ORC_COMPILE_RESULT_IS_SUCCESSFUL (orc_program_compile (p))) {
+    orc_program_free (p);
+    return 0;
+  }
+
+  /* The targets with vector registers of 16 bytes or more prefetch the
+   * next row of both sources */
+  name = orc_target_get_name (p->target);
+  if ((strcmp (name, "sse") == 0 || strcmp (name, "avx") == 0 ||
+          strcmp (name, "avx512") == 0) &&
+      !check_asm (orc_program_get_asm_code (p), 2)) {
+    printf ("%s: no prefetch of the next row\n", name);
+    error = TRUE;
+  }
+
+  for (i = 0; i < ARRAY_SIZE (sizes); i++) {
+    check (p, sizes[i], 1, 0);
+    check (p, sizes[i], 5, 0);
+    check (p, sizes[i], 5, 3);
+  }
+  orc_program_free (p);
+
+  if (error) return 1;
+  return 0;
+}
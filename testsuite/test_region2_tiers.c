@@ -0,0 +1,216 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ORC_ENABLE_UNSTABLE_API
+
+#include <orc/orc.h>
+#include <orc/orcparse.h>
+#include <orc-test/orctest.h>
+
+/* Working sets larger than this are not worth testing */
+#define MAX_ELEMENTS (16 * 1024 * 1024)
+#define GUARD 64
+/* Of the arrays, enough for every target */
+#define ALIGNMENT 64
+/* Bytes of all the arrays per element, see source */
+#define BYTES_PER_ELEMENT 5
+
+static int error = FALSE;
+
+static const char *source =
+    ".function tiers\n"
+    ".dest 2 d1\n.source 1 s1\n.source 2 s2\n.temp 2 t1\n"
+    "convubw t1, s1\n"
+    "addw d1, t1, s2\n"
+    "\n"
+    /* A longer body is unrolled less, which leaves room for the tiers
+     * to unroll further */
+    ".function tiers_long\n"
+    ".dest 2 d1\n.source 1 s1\n.source 2 s2\n.temp 2 t1\n"
+    "convubw t1, s1\n"
+    "addw t1, t1, s2\n"
+    "mullw t1, t1, s2\n"
+    "shrsw t1, t1, 2\n"
+    "subw t1, t1, s2\n"
+    "maxsw d1, t1, s2\n"
+    "\n"
+    ".function tiers_2d\n"
+    ".flags 2d\n"
+    ".dest 2 d1\n.source 1 s1\n.source 2 s2\n.temp 2 t1\n"
+    "convubw t1, s1\n"
+    "addw d1, t1, s2\n";
+
+static void *mem[4];
+static orc_uint8 *src1;
+static orc_int16 *src2;
+static orc_int16 *dest;
+static orc_int16 *emul;
+
+static void *
+align (void *ptr)
+{
+  return ORC_PTR_OFFSET (ptr,
+      ALIGNMENT - ((orc_intptr) ptr & (ALIGNMENT - 1)));
+}
+
+/* Runs @n elements on each of @m rows, the working set is n * m. The
+ * specialized code is compiled for n, like a program with a constant n */
+static void
+check (OrcProgram *p, int n, int m, int offset, orc_bool specialized)
+{
+  OrcExecutor *ex;
+  size_t size = sizeof (orc_int16) * ((size_t) n * m + offset + GUARD);
+
+  memset (dest, 0x55, size);
+  memset (emul, 0x55, size);
+
+  ex = orc_executor_new (p);
+  orc_executor_set_n (ex, n);
+  if (p->is_2d) {
+    orc_executor_set_m (ex, m);
+    orc_executor_set_stride (ex, ORC_VAR_D1, n * 2);
+    orc_executor_set_stride (ex, ORC_VAR_S1, n);
+    orc_executor_set_stride (ex, ORC_VAR_S2, n * 2);
+  }
+
+  orc_executor_set_array_str (ex, "s1", src1 + offset);
+  orc_executor_set_array_str (ex, "s2", src2);
+  orc_executor_set_array_str (ex, "d1", emul + offset);
+  orc_executor_emulate (ex);
+  /* 2D code moves the array pointers of the executor along the rows */
+  orc_executor_set_array_str (ex, "s1", src1 + offset);
+  orc_executor_set_array_str (ex, "s2", src2);
+  orc_executor_set_array_str (ex, "d1", dest + offset);
+  if (specialized)
+    orc_executor_run_specialized (ex);
+  else
+    orc_executor_run (ex);
+  orc_executor_free (ex);
+
+  if (memcmp (dest, emul, size) != 0) {
+    printf ("%s: n %d m %d offset %d%s: wrong result\n",
+        orc_program_get_name (p), n, m, offset,
+        specialized ? " specialized" : "");
+    error = TRUE;
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const int deltas[] = { -256, -64, -1, 0, 1, 64, 256 };
+  OrcProgram **programs = NULL;
+  int n_programs;
+  int l1, l2, l3;
+  int sizes[3];
+  int i, j, k;
+
+  orc_init ();
+  orc_test_init ();
+
+  /* The L1 and L2 tiers start once the working set of the call no
+   * longer fits in that level, past them is the memory tier */
+  orc_get_data_cache_sizes (&l1, &l2, &l3);
+  sizes[0] = l1 / BYTES_PER_ELEMENT;
+  sizes[1] = l2 / BYTES_PER_ELEMENT;
+  sizes[2] = 2 * sizes[1];
+  if (sizes[0] <= 256 || sizes[1] <= sizes[0] || sizes[2] > MAX_ELEMENTS) {
+    printf ("no usable cache sizes\n");
+    return 77;
+  }
+
+  mem[0] = malloc (sizes[2] + 256 + GUARD + ALIGNMENT);
+  mem[1] = malloc (sizeof (orc_int16) * (sizes[2] + 256 + GUARD) + ALIGNMENT);
+  mem[2] = malloc (sizeof (orc_int16) * (sizes[2] + 256 + 1 + GUARD) +
+      ALIGNMENT);
+  mem[3] = malloc (sizeof (orc_int16) * (sizes[2] + 256 + 1 + GUARD) +
+      ALIGNMENT);
+  src1 = align (mem[0]);
+  src2 = align (mem[1]);
+  dest = align (mem[2]);
+  emul = align (mem[3]);
+  for (i = 0; i < sizes[2] + 256 + GUARD; i++) {
+    src1[i] = rand ();
+    src2[i] = rand ();
+  }
+
+  n_programs = orc_parse (source, &programs);
+  if (n_programs != 3) {
+    printf ("parsed %d programs\n", n_programs);
+    return 1;
+  }
+
+  for (i = 0; i < n_programs; i++) {
+    OrcProgram *p = programs[i];
+    const char *name;
+
+    if (!ORC_COMPILE_RESULT_IS_SUCCESSFUL (orc_program_compile (p))) {
+      orc_program_free (p);
+      continue;
+    }
+
+    /* The targets with vector registers of 16 bytes or more have the
+     * L1 and L2 tiers */
+    name = orc_target_get_name (p->target);
+    if (strcmp (name, "sse") == 0 || strcmp (name, "avx") == 0 ||
+        strcmp (name, "avx512") == 0) {
+      const char *asm_code = orc_program_get_asm_code (p);
+
+      if (strstr (asm_code, "# REGION 2 TIER 1") == NULL ||
+          strstr (asm_code, "# REGION 2 TIER 2") == NULL) {
+        printf ("%s: %s: missing tiers\n", orc_program_get_name (p), name);
+        error = TRUE;
+      }
+    }
+
+    /* Inside each tier and around both boundaries */
+    check (p, 1000, 1, 0, FALSE);
+    for (j = 0; j < 3; j++) {
+      for (k = 0; k < ARRAY_SIZE (deltas); k++) {
+        if (p->is_2d) {
+          /* The working set of 2D calls counts every row */
+          check (p, (sizes[j] + deltas[k]) / 4, 4, 0, FALSE);
+        } else {
+          check (p, sizes[j] + deltas[k], 1, 0, FALSE);
+          check (p, sizes[j] + deltas[k], 1, 1, FALSE);
+        }
+      }
+    }
+
+    /* When n is known at compile time only the tier it picks is
+     * emitted, as for specialized code and for a constant n */
+    if (!p->is_2d) {
+      for (j = 0; j < 3; j++) {
+        check (p, sizes[j] + 256, 1, 0, TRUE);
+        check (p, sizes[j] + 256, 1, 1, TRUE);
+      }
+      /* Without the loop that aligns the pointers, as the specialized
+       * code for aligned arrays. A failed compile would otherwise go
+       * unnoticed, the specialized calls run the generic code then */
+      orc_program_set_var_alignment (p, ORC_VAR_D1, ALIGNMENT);
+      orc_program_set_var_alignment (p, ORC_VAR_S1, ALIGNMENT);
+      orc_program_set_var_alignment (p, ORC_VAR_S2, ALIGNMENT);
+      for (j = 0; j < 3; j++) {
+        orc_program_set_constant_n (p, sizes[j] + 256);
+        if (!ORC_COMPILE_RESULT_IS_SUCCESSFUL (orc_program_compile (p))) {
+          printf ("%s: %s: could not compile for n %d\n",
+              orc_program_get_name (p), name, sizes[j] + 256);
+          error = TRUE;
+          continue;
+        }
+        check (p, sizes[j] + 256, 1, 0, FALSE);
+      }
+    }
+    orc_program_free (p);
+  }
+  free (programs);
+
+  for (i = 0; i < ARRAY_SIZE (mem); i++)
+    free (mem[i]);
+
+  if (error) return 1;
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ORC_ENABLE_UNSTABLE_API
+
+#include <orc/orc.h>
+#include <orc-test/orctest.h>
+
+#define N 333
+#define SRC_N 1024
+
+static int error = FALSE;
+
+static orc_uint32 src_data[SRC_N];
+static orc_uint32 dest_data[N + 16];
+static orc_uint32 emul_data[N + 16];
+
+/* d1 = ldresXXX s1 from p1 in steps of p2, p1 and p2 being 16.16 fixed
+ * point positions */
+static OrcProgram *
+create_program (const char *opcode, int size)
+{
+  OrcProgram *p;
+
+  p = orc_program_new ();
+  orc_program_set_name (p, opcode);
+  orc_program_add_destination (p, size, "d1");
+  orc_program_add_source (p, size, "s1");
+  orc_program_add_parameter (p, 4, "p1");
+  orc_program_add_parameter (p, 4, "p2");
+
+  orc_program_append_str_2 (p, opcode, 0, "d1", "s1", "p1", "p2");
+
+  return p;
+}
+
+static void
+check (OrcProgram *p, int n, int offset, int increment)
+{
+  OrcExecutor *ex;
+  int i;
+
+  memset (dest_data, 0x55, sizeof (dest_data));
+  memset (emul_data, 0x55, sizeof (emul_data));
+
+  ex = orc_executor_new (p);
+  orc_executor_set_n (ex, n);
+  orc_executor_set_array_str (ex, "s1", src_data);
+  orc_executor_set_param_str (ex, "p1", offset);
+  orc_executor_set_param_str (ex, "p2", increment);
+
+  orc_executor_set_array_str (ex, "d1", emul_data);
+  orc_executor_emulate (ex);
+  orc_executor_set_array_str (ex, "d1", dest_data);
+  orc_executor_run (ex);
+  orc_executor_free (ex);
+
+  for (i = 0; i < ARRAY_SIZE (dest_data); i++) {
+    if (dest_data[i] != emul_data[i]) {
+      printf ("%s: n %d offset 0x%x increment 0x%x: wrong result at %d: "
+          "0x%08x != 0x%08x\n", orc_program_get_name (p), n, offset,
+          increment, i, dest_data[i], emul_data[i]);
+      error = TRUE;
+      return;
+    }
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const struct {
+    const char *opcode;
+    int size;
+  } opcodes[] = {
+    { "ldresnearb", 1 },
+    { "ldresnearl", 4 },
+    { "ldreslinb", 1 },
+    { "ldreslinl", 4 },
+  };
+  /* Downscaling, upscaling and the identity, starting at different
+   * subpixel positions */
+  static const int increments[] = { 0x10000, 0x8000, 0x5555, 0x1c000,
+    0x28f5c, 0x3 };
+  static const int offsets[] = { 0, 0x8000, 0xff80, 0x38000 };
+  static const int sizes[] = { N, 64, 33, 16, 7, 1 };
+  int i, j, k, l;
+
+  orc_init ();
+  orc_test_init ();
+
+  for (i = 0; i < SRC_N; i++)
+    src_data[i] = ((orc_uint32) rand () << 16) ^ rand ();
+
+  for (i = 0; i < ARRAY_SIZE (opcodes); i++) {
+    OrcProgram *p = create_program (opcodes[i].opcode, opcodes[i].size);
+
+    if (!ORC_COMPILE_RESULT_IS_SUCCESSFUL (orc_program_compile (p))) {
+      /* Emulated, nothing to compare with */
+      orc_program_free (p);
+      continue;
+    }
+
+    for (j = 0; j < ARRAY_SIZE (sizes); j++) {
+      for (k = 0; k < ARRAY_SIZE (offsets); k++) {
+        for (l = 0; l < ARRAY_SIZE (increments); l++) {
+          check (p, sizes[j], offsets[k], increments[l]);
+        }
+      }
+    }
+    orc_program_free (p);
+  }
+
+  if (error) return 1;
+  return 0;
+}
@@ -0,0 +1,211 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ORC_ENABLE_UNSTABLE_API
+#include <orc/orc.h>
+#include <orc-test/orctest.h>
+
+#if defined(HAVE_THREAD_PTHREAD)
+#include <pthread.h>
+#endif
+
+#define N 2048
+#define M 4
+#define GUARD 64
+#define N_THREADS 4
+#define N_ITERATIONS 200
+
+static int error = FALSE;
+
+static orc_uint8 src1_data[M * N + 2 * GUARD];
+static orc_int16 src2_data[M * N + 2 * GUARD];
+static orc_int16 dest_data[M * N + 2 * GUARD];
+
+/* Aligns to 64 bytes and then moves by @offset elements */
+#define ALIGNED(data, offset) \
+  ((void *) ((((orc_intptr) (data) + 63) & ~(orc_intptr) 63) + \
+      (offset) * sizeof ((data)[0])))
+
+/* d1 = s1 + s2, with arrays of different sizes */
+static OrcProgram *
+create_program (int is_2d)
+{
+  OrcProgram *p;
+
+  p = orc_program_new ();
+  orc_program_set_name (p, is_2d ? "specialize_2d" : "specialize");
+  if (is_2d)
+    orc_program_set_2d (p);
+  orc_program_add_destination (p, 2, "d1");
+  orc_program_add_source (p, 1, "s1");
+  orc_program_add_source (p, 2, "s2");
+  orc_program_add_temporary (p, 2, "t1");
+
+  orc_program_append_str (p, "convubw", "t1", "s1", NULL);
+  orc_program_append_str (p, "addw", "d1", "t1", "s2");
+
+  return p;
+}
+
+/* The same executor is used for all the calls, so that the specialized
+ * code of the previous call is never picked for another one */
+static void
+check (OrcExecutor *ex, int n, int m, int offset)
+{
+  OrcProgram *p = ex->program;
+  orc_uint8 *s1 = ALIGNED (src1_data, offset);
+  orc_int16 *s2 = ALIGNED (src2_data, offset);
+  orc_int16 *d1 = ALIGNED (dest_data, offset);
+  /* 2D rows are padded so that the strides keep the alignment */
+  int row = n + 32;
+  int i, j;
+
+  memset (dest_data, 0x55, sizeof (dest_data));
+
+  orc_executor_set_n (ex, n);
+  orc_executor_set_array_str (ex, "d1", d1);
+  orc_executor_set_array_str (ex, "s1", s1);
+  orc_executor_set_array_str (ex, "s2", s2);
+  if (m) {
+    orc_executor_set_m (ex, m);
+    orc_executor_set_stride (ex, ORC_VAR_D1, row * 2);
+    orc_executor_set_stride (ex, ORC_VAR_S1, row);
+    orc_executor_set_stride (ex, ORC_VAR_S2, row * 2);
+  }
+  orc_executor_run_specialized (ex);
+
+  for (j = 0; j < MAX (m, 1); j++) {
+    /* The elements after each row must not be written */
+    for (i = 0; i < (m ? row : n + GUARD); i++) {
+      orc_int16 expected = i < n ?
+          (orc_int16) (s1[j * row + i] + s2[j * row + i]) : 0x5555;
+
+      if (m && j * row + i >= M * N)
+        break;
+      if (d1[j * row + i] != expected) {
+        printf ("%s: n %d m %d offset %d: wrong result at %d,%d: %d != %d\n",
+            orc_program_get_name (p), n, m, offset, j, i,
+            d1[j * row + i], expected);
+        error = TRUE;
+        return;
+      }
+    }
+  }
+}
+
+/* Runs specialized calls of the program @data with its own arrays, so
+ * that the threads look variants up while others append new ones */
+static void *
+run_specialized (void *data)
+{
+  static const int sizes[] = { 1000, 640, 320, 1001, 64, 7, 1920, 33,
+      2000, 100 };
+  OrcProgram *p = data;
+  orc_uint8 s1[N + 64];
+  orc_int16 s2[N + 32];
+  orc_int16 d1[N + 32];
+  orc_uint8 *s1_aligned = ALIGNED (s1, 0);
+  orc_int16 *s2_aligned = ALIGNED (s2, 0);
+  orc_int16 *d1_aligned = ALIGNED (d1, 0);
+  OrcExecutor *ex;
+  int i, j;
+
+  for (i = 0; i < N; i++) {
+    s1_aligned[i] = i * 7;
+    s2_aligned[i] = i * 13;
+  }
+
+  ex = orc_executor_new (p);
+  for (i = 0; i < N_ITERATIONS; i++) {
+    int n = sizes[i % ARRAY_SIZE (sizes)];
+
+    orc_executor_set_n (ex, n);
+    orc_executor_set_array_str (ex, "d1", d1_aligned);
+    orc_executor_set_array_str (ex, "s1", s1_aligned);
+    orc_executor_set_array_str (ex, "s2", s2_aligned);
+    orc_executor_run_specialized (ex);
+
+    for (j = 0; j < n; j++) {
+      if (d1_aligned[j] != (orc_int16) (s1_aligned[j] + s2_aligned[j])) {
+        printf ("%s: n %d: wrong result at %d in a thread\n",
+            orc_program_get_name (p), n, j);
+        error = TRUE;
+        break;
+      }
+    }
+  }
+  orc_executor_free (ex);
+
+  return NULL;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const int sizes[] = { 1920, 1923, 100, 64, 33, 16, 7, 1 };
+  OrcProgram *p;
+  OrcExecutor *ex;
+  int i, k;
+
+  orc_init ();
+  orc_test_init ();
+
+  for (i = 0; i < ARRAY_SIZE (src1_data); i++) {
+    src1_data[i] = rand ();
+    src2_data[i] = rand ();
+  }
+
+  p = create_program (FALSE);
+  if (!ORC_COMPILE_RESULT_IS_SUCCESSFUL (orc_program_compile (p))) {
+    /* Nothing to specialize for */
+    orc_program_free (p);
+    return 0;
+  }
+  ex = orc_executor_new (p);
+  for (k = 0; k < 2; k++) {
+    /* Aligned, then not aligned, arrays. The second round only uses
+     * the variants compiled in the first one or the generic code */
+    for (i = 0; i < ARRAY_SIZE (sizes); i++) {
+      check (ex, sizes[i], 0, 0);
+      check (ex, sizes[i], 0, 1);
+      check (ex, sizes[i], 0, 1);
+    }
+  }
+  orc_executor_free (ex);
+  orc_program_free (p);
+
+  /* More sizes than variants, from several threads at once */
+  p = create_program (FALSE);
+  if (ORC_COMPILE_RESULT_IS_SUCCESSFUL (orc_program_compile (p))) {
+#if defined(HAVE_THREAD_PTHREAD)
+    pthread_t threads[N_THREADS];
+
+    for (i = 0; i < N_THREADS; i++)
+      pthread_create (&threads[i], NULL, run_specialized, p);
+    for (i = 0; i < N_THREADS; i++)
+      pthread_join (threads[i], NULL);
+#else
+    for (i = 0; i < N_THREADS; i++)
+      run_specialized (p);
+#endif
+  }
+  orc_program_free (p);
+
+  p = create_program (TRUE);
+  if (ORC_COMPILE_RESULT_IS_SUCCESSFUL (orc_program_compile (p))) {
+    ex = orc_executor_new (p);
+    check (ex, 1920, M, 0);
+    check (ex, 1920, M, 3);
+    check (ex, 100, M, 0);
+    check (ex, 7, 1, 0);
+    check (ex, 1920, M, 0);
+    orc_executor_free (ex);
+  }
+  orc_program_free (p);
+
+  if (error) return 1;
+  return 0;
+}
@@ -0,0 +1,104 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ORC_ENABLE_UNSTABLE_API
+#include <orc/orc.h>
+#include <orc-test/orctest.h>
+
+static int error = FALSE;
+
+static const char *targets[] = { "mmx", "sse", "avx" };
+
+/* Every parameter and constant is loaded once before the loop and kept
+ * for all of it, which is more than the vector registers of the x86
+ * targets can hold, together with the temporaries */
+static OrcProgram *
+create_program (void)
+{
+  OrcProgram *p;
+  char name[8];
+  int i;
+
+  p = orc_program_new ();
+  orc_program_set_name (p, "test_spill");
+  orc_program_add_destination (p, 2, "d1");
+  for (i = 0; i < ORC_MAX_SRC_VARS / 2; i++) {
+    sprintf (name, "s%d", i + 1);
+    orc_program_add_source (p, 2, name);
+  }
+  for (i = 0; i < ORC_MAX_PARAM_VARS; i++) {
+    sprintf (name, "p%d", i + 1);
+    orc_program_add_parameter (p, 2, name);
+  }
+  for (i = 0; i < ORC_MAX_CONST_VARS; i++) {
+    sprintf (name, "c%d", i + 1);
+    orc_program_add_constant (p, 2, 3 + i * 7, name);
+  }
+  for (i = 0; i < 4; i++) {
+    sprintf (name, "t%d", i + 1);
+    orc_program_add_temporary (p, 2, name);
+  }
+
+  orc_program_append_str (p, "mullw", "t1", "s1", "p1");
+  orc_program_append_str (p, "mullw", "t2", "s2", "p2");
+  orc_program_append_str (p, "mullw", "t3", "s3", "p3");
+  orc_program_append_str (p, "mullw", "t4", "s4", "p4");
+  orc_program_append_str (p, "addw", "t1", "t1", "c1");
+  orc_program_append_str (p, "subw", "t2", "t2", "c2");
+  orc_program_append_str (p, "xorw", "t3", "t3", "c3");
+  orc_program_append_str (p, "addw", "t4", "t4", "c4");
+  orc_program_append_str (p, "mullw", "t1", "t1", "p5");
+  orc_program_append_str (p, "mullw", "t2", "t2", "p6");
+  orc_program_append_str (p, "mullw", "t3", "t3", "p7");
+  orc_program_append_str (p, "mullw", "t4", "t4", "p8");
+  orc_program_append_str (p, "andw", "t1", "t1", "c5");
+  orc_program_append_str (p, "orw", "t2", "t2", "c6");
+  orc_program_append_str (p, "subw", "t3", "t3", "c7");
+  orc_program_append_str (p, "addw", "t4", "t4", "c8");
+  orc_program_append_str (p, "addw", "t1", "t1", "t2");
+  orc_program_append_str (p, "addw", "t3", "t3", "t4");
+  orc_program_append_str (p, "xorw", "d1", "t1", "t3");
+
+  return p;
+}
+
+int
+main (int argc, char *argv[])
+{
+  OrcProgram *p;
+  int i;
+
+  orc_init ();
+  orc_test_init ();
+
+  p = create_program ();
+
+  for (i = 0; i < sizeof (targets) / sizeof (targets[0]); i++) {
+    OrcTarget *target = orc_target_get_by_name (targets[i]);
+    OrcCompileResult result;
+
+    if (target == NULL || !orc_target_is_executable (target))
+      continue;
+
+    result = orc_program_compile_for_target (p, target);
+    if (!ORC_COMPILE_RESULT_IS_SUCCESSFUL (result)) {
+      printf ("%s: compile failed: %s\n", targets[i],
+          orc_program_get_error (p));
+      error = TRUE;
+      continue;
+    }
+
+    if (orc_test_compare_output_full_for_target (p, 0, targets[i])
+        != ORC_TEST_OK) {
+      printf ("%s: wrong result\n", targets[i]);
+      error = TRUE;
+    }
+  }
+
+  orc_program_free (p);
+
+  if (error) return 1;
+  return 0;
+}
@@ -0,0 +1,166 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ORC_ENABLE_UNSTABLE_API
+
+#include <orc/orc.h>
+#include <orc/orcdebug.h>
+
+#define N 1000
+#define M 10
+
+orc_int16 src1[N * M];
+orc_int16 dest1[N * M];
+
+static int error = FALSE;
+
+static OrcProgram *
+create_program (int is_2d)
+{
+  OrcProgram *p;
+
+  p = orc_program_new ();
+  orc_program_set_name (p, is_2d ? "test_stats_2d" : "test_stats");
+  if (is_2d)
+    orc_program_set_2d (p);
+  orc_program_add_destination (p, 2, "d1");
+  orc_program_add_source (p, 2, "s1");
+
+  orc_program_append_str (p, "addw", "d1", "s1", "s1");
+
+  return p;
+}
+
+static void
+check_stats (OrcCode *code, const char *name, int n_calls, int n_elements,
+    int min_n, int max_n, int min_m, int max_m)
+{
+  OrcCodeStats stats;
+
+  if (!orc_code_get_stats (code, &stats)) {
+    printf ("%s: no counters\n", name);
+    error = TRUE;
+    return;
+  }
+  if (stats.n_calls != n_calls || stats.n_elements != n_elements ||
+      stats.min_n != min_n || stats.max_n != max_n ||
+      stats.min_m != min_m || stats.max_m != max_m) {
+    printf ("%s: unexpected counters calls=%d elements=%d n=[%d,%d] "
+        "m=[%d,%d]\n", name, (int) stats.n_calls, (int) stats.n_elements,
+        stats.min_n, stats.max_n, stats.min_m, stats.max_m);
+    error = TRUE;
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  OrcProgram *p;
+  OrcExecutor *ex;
+  OrcCode *code;
+  int i;
+
+#ifdef _WIN32
+  _putenv ("ORC_CODE=stats");
+#else
+  setenv ("ORC_CODE", "stats", 1);
+#endif
+  orc_init ();
+
+  for (i = 0; i < N * M; i++)
+    src1[i] = rand ();
+
+  /* Through orc_executor_run() */
+  p = create_program (FALSE);
+  if (ORC_COMPILE_RESULT_IS_FATAL (orc_program_compile (p))) {
+    printf ("compile failed\n");
+    return 1;
+  }
+  ex = orc_executor_new (p);
+  code = orc_program_take_code (p);
+  orc_executor_set_array_str (ex, "d1", dest1);
+  orc_executor_set_array_str (ex, "s1", src1);
+  orc_executor_set_n (ex, N);
+  orc_executor_run (ex);
+  orc_executor_set_n (ex, 10);
+  orc_executor_run (ex);
+  check_stats (code, "1d", 2, N + 10, 10, N, 1, 1);
+
+  /* The way the functions generated by orcc call the code */
+  ex->program = NULL;
+  ex->arrays[ORC_VAR_A2] = code;
+  ex->n = 100;
+  code->exec (ex);
+  check_stats (code, "orcc", 3, N + 110, 10, N, 1, 1);
+
+  for (i = 0; i < N; i++) {
+    if (dest1[i] != (orc_int16) (src1[i] * 2)) {
+      printf ("wrong result at %d\n", i);
+      error = TRUE;
+      break;
+    }
+  }
+
+  orc_code_reset_stats (code);
+  check_stats (code, "reset", 0, 0, 0, 0, 0, 0);
+  orc_executor_free (ex);
+  orc_program_free (p);
+  orc_code_free (code);
+
+  p = create_program (TRUE);
+  if (ORC_COMPILE_RESULT_IS_FATAL (orc_program_compile (p))) {
+    printf ("compile failed\n");
+    return 1;
+  }
+  ex = orc_executor_new (p);
+  code = orc_program_take_code (p);
+  orc_executor_set_array_str (ex, "d1", dest1);
+  orc_executor_set_array_str (ex, "s1", src1);
+  orc_executor_set_stride (ex, ORC_VAR_D1, N * 2);
+  orc_executor_set_stride (ex, ORC_VAR_S1, N * 2);
+  orc_executor_set_n (ex, N);
+  orc_executor_set_m (ex, M);
+  orc_executor_run (ex);
+  check_stats (code, "2d", 1, N * M, N, N, M, M);
+  orc_executor_free (ex);
+
+  orc_program_free (p);
+  orc_code_free (code);
+
+  /* The specialized code is counted on its own, not on the generic code */
+  p = create_program (FALSE);
+  if (ORC_COMPILE_RESULT_IS_FATAL (orc_program_compile (p))) {
+    printf ("compile failed\n");
+    return 1;
+  }
+  if (p->target && orc_target_is_executable (p->target)) {
+    memset (dest1, 0, sizeof (dest1));
+    ex = orc_executor_new (p);
+    orc_executor_set_array_str (ex, "d1", dest1);
+    orc_executor_set_array_str (ex, "s1", src1);
+    orc_executor_set_n (ex, N);
+    for (i = 0; i < 5; i++)
+      orc_executor_run_specialized (ex);
+    orc_executor_free (ex);
+
+    if (p->n_variants != 1) {
+      printf ("specialized: %d variants\n", p->n_variants);
+      error = TRUE;
+    }
+    check_stats (p->orccode, "specialized", 0, 0, 0, 0, 0, 0);
+    for (i = 0; i < N; i++) {
+      if (dest1[i] != (orc_int16) (src1[i] * 2)) {
+        printf ("specialized: wrong result at %d\n", i);
+        error = TRUE;
+        break;
+      }
+    }
+  }
+  orc_program_free (p);
+
+  if (error) return 1;
+  return 0;
+}
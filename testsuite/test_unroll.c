@@ -0,0 +1,167 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ORC_ENABLE_UNSTABLE_API
+
+#include <orc/orc.h>
+#include <orc/orcparse.h>
+#include <orc-test/orctest.h>
+
+#define N 300
+
+static int error = FALSE;
+
+static orc_uint8 src1_data[N + 64];
+static orc_uint8 src2_data[N + 64];
+static orc_uint8 dest_data[N + 64];
+static orc_uint8 emul_data[N + 64];
+
+/* The unrolled loop, the elements it leaves and the accumulators, split
+ * across the copies of the body, with every unroll factor */
+static const char *source =
+    ".function add_unroll1\n"
+    ".flags unroll 1\n"
+    ".dest 1 d1\n.source 1 s1\n.source 1 s2\n"
+    "addusb d1, s1, s2\n"
+    "\n"
+    ".function add_unroll2\n"
+    ".flags unroll 2\n"
+    ".dest 1 d1\n.source 1 s1\n.source 1 s2\n"
+    "addusb d1, s1, s2\n"
+    "\n"
+    ".function add_unroll4\n"
+    ".flags unroll 4\n"
+    ".dest 1 d1\n.source 1 s1\n.source 1 s2\n"
+    "addusb d1, s1, s2\n"
+    "\n"
+    ".function add_unroll8\n"
+    ".flags unroll 8\n"
+    ".dest 1 d1\n.source 1 s1\n.source 1 s2\n"
+    "addusb d1, s1, s2\n"
+    "\n"
+    ".function sad_unroll8\n"
+    ".flags unroll 8\n"
+    ".accumulator 4 a1\n.source 1 s1\n.source 1 s2\n"
+    "accsadubl a1, s1, s2\n"
+    "\n"
+    ".function accw_unroll4\n"
+    ".flags unroll 4\n"
+    ".accumulator 2 a1\n.source 1 s1\n.source 1 s2\n.temp 2 t1\n"
+    "convubw t1, s1\n"
+    "accw a1, t1\n"
+    "\n"
+    ".function add_auto\n"
+    ".dest 1 d1\n.source 1 s1\n.source 1 s2\n"
+    "addusb d1, s1, s2\n";
+
+static void
+check (OrcProgram *p, int n, int offset)
+{
+  OrcExecutor *ex;
+  int acc[2];
+
+  memset (dest_data, 0x55, sizeof (dest_data));
+  memset (emul_data, 0x55, sizeof (emul_data));
+
+  ex = orc_executor_new (p);
+  orc_executor_set_n (ex, n);
+  orc_executor_set_array_str (ex, "s1", src1_data + offset);
+  orc_executor_set_array_str (ex, "s2", src2_data);
+
+  if (p->vars[ORC_VAR_D1].size > 0)
+    orc_executor_set_array_str (ex, "d1", emul_data + offset);
+  orc_executor_emulate (ex);
+  acc[0] = orc_executor_get_accumulator (ex, ORC_VAR_A1);
+  if (p->vars[ORC_VAR_D1].size > 0)
+    orc_executor_set_array_str (ex, "d1", dest_data + offset);
+  orc_executor_run (ex);
+  acc[1] = orc_executor_get_accumulator (ex, ORC_VAR_A1);
+  orc_executor_free (ex);
+
+  if (memcmp (dest_data, emul_data, sizeof (dest_data)) != 0 ||
+      acc[0] != acc[1]) {
+    printf ("%s: n %d offset %d: wrong result\n", orc_program_get_name (p),
+        n, offset);
+    error = TRUE;
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const int expected[] = { 1, 2, 4, 8, 8, 4, 0 };
+  OrcProgram **programs = NULL;
+  int n_programs;
+  int i, n, offset;
+
+  orc_init ();
+  orc_test_init ();
+
+  for (i = 0; i < ARRAY_SIZE (src1_data); i++) {
+    src1_data[i] = rand ();
+    src2_data[i] = rand ();
+  }
+
+  n_programs = orc_parse (source, &programs);
+  if (n_programs != ARRAY_SIZE (expected)) {
+    printf ("parsed %d programs\n", n_programs);
+    return 1;
+  }
+
+  for (i = 0; i < n_programs; i++) {
+    OrcProgram *p = programs[i];
+    OrcBytecode *bytecode;
+    OrcProgram *copy;
+
+    if (orc_program_get_unroll (p) != expected[i]) {
+      printf ("%s: unroll %d\n", orc_program_get_name (p),
+          orc_program_get_unroll (p));
+      error = TRUE;
+    }
+
+    /* The bytecode, and so the code cache, tells the factors apart */
+    bytecode = orc_bytecode_from_program (p);
+    copy = orc_program_new_from_static_bytecode (bytecode->bytecode);
+    if (orc_program_get_unroll (copy) != expected[i]) {
+      printf ("%s: unroll %d after bytecode\n", orc_program_get_name (p),
+          orc_program_get_unroll (copy));
+      error = TRUE;
+    }
+    orc_program_free (copy);
+    orc_bytecode_free (bytecode);
+
+    if (ORC_COMPILE_RESULT_IS_SUCCESSFUL (orc_program_compile (p))) {
+      for (n = 0; n < N; n++) {
+        for (offset = 0; offset < 2; offset++) {
+          check (p, n, offset);
+        }
+      }
+    }
+    orc_program_free (p);
+  }
+  free (programs);
+
+  /* Factors that are not powers of two up to 8 are refused */
+  {
+    OrcParseError **errors = NULL;
+    int n_errors = 0;
+
+    orc_parse_code (".function add\n.flags unroll 3\n"
+        ".dest 1 d1\n.source 1 s1\ncopyb d1, s1\n", &programs, &n_programs,
+        &errors, &n_errors);
+    if (n_errors == 0) {
+      printf ("unroll 3 accepted\n");
+      error = TRUE;
+    }
+    for (i = 0; i < n_programs; i++)
+      orc_program_free (programs[i]);
+    free (programs);
+    orc_parse_error_freev (errors);
+  }
+
+  if (error) return 1;
+  return 0;
+}
@@ -1044,8 +1044,17 @@ output_code_execute (OrcProgram *p, FILE *output, int is_inline)
   for(i=0;i<4;i++){
     var = &p->vars[ORC_VAR_A1 + i];
     if (var->size) {
-      fprintf(output, "  *%s = orc_executor_get_accumulator (ex, %s);\n",
-          varnames[ORC_VAR_A1 + i], enumnames[ORC_VAR_A1 + i]);
+      const char *getter = "orc_executor_get_accumulator";
+
+      if (var->type_name && strcmp (var->type_name, "float") == 0) {
+        getter = "orc_executor_get_accumulator_float";
+      } else if (var->type_name && strcmp (var->type_name, "double") == 0) {
+        getter = "orc_executor_get_accumulator_double";
+      } else if (var->size == 8) {
+        getter = "orc_executor_get_accumulator_int64";
+      }
+      fprintf(output, "  *%s = %s (ex, %s);\n",
+          varnames[ORC_VAR_A1 + i], getter, enumnames[ORC_VAR_A1 + i]);
     }
   }
   fprintf(output, "}\n");
@@ -1139,6 +1148,10 @@ output_program_generation (OrcProgram *p, FILE *output, int is_inline)
     fprintf(output, "    orc_program_set_n_maximum (p, %d);\n",
         p->n_maximum);
   }
+  if (p->unroll != 0) {
+    REQUIRE(0,4,42,1);
+    fprintf(output, "    orc_program_set_unroll (p, %d);\n", p->unroll);
+  }
   if (p->is_2d) {
     fprintf(output, "    orc_program_set_2d (p);\n");
     if (p->constant_m != 0) {